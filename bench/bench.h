@@ -0,0 +1,54 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Shared helpers for the notepad_core benchmark harness.
+  Provides corpus generation, timing and isolated peak-RSS measurement.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+struct BenchOptions
+{
+    size_t sizeMB = 64;
+    std::string filter;
+};
+
+struct BenchResult
+{
+    double seconds = 0;
+    long peakKb = -1;
+    uint64_t checksum = 0;
+};
+
+double NowSeconds();
+uint64_t Checksum(const void *data, size_t bytes);
+std::string MakeCorpus(const std::string &kind, size_t bytes);
+std::string WriteTempFile(const std::string &data, const std::string &tag);
+bool WantSuite(const BenchOptions &opts, const char *suite);
+BenchResult RunIsolated(const std::function<uint64_t()> &body);
+void PrintResult(const char *suite, const std::string &name, size_t bytes, const BenchResult &r);
+
+void RunCodecBench(const BenchOptions &opts);
+void RunUtf8Bench(const BenchOptions &opts);
+void RunSaveBench(const BenchOptions &opts);
+void RunUtf16Bench(const BenchOptions &opts);
+void RunScanBench(const BenchOptions &opts);
+void RunViewerBench(const BenchOptions &opts);
+void RunJournalBench(const BenchOptions &opts);
+void RunPieceBench(const BenchOptions &opts);
+void RunRegexBench(const BenchOptions &opts);
+void RunReplaceBench(const BenchOptions &opts);
+void RunFindAllBench(const BenchOptions &opts);
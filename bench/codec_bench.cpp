@@ -0,0 +1,143 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Codec benchmarks: whole-buffer decode (the original LoadFile path) versus the
+  memory-mapped, chunked decoder used by the streaming loader, plus first-chunk latency.
+*/
+
+#include "bench.h"
+#include "core/textcodec.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAP_VIEW_SIZE (64u << 20)
+#define LOAD_CHUNK_SIZE (1u << 20)
+
+// Mirrors the original LoadFile: read everything, validate, decode to a second copy,
+// then hand a third copy to the editor.
+static uint64_t DecodeWholeFile(const std::string &path)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    std::vector<uint8_t> data(static_cast<size_t>(size));
+    size_t got = fread(data.data(), 1, data.size(), f);
+    fclose(f);
+    data.resize(got);
+    auto [enc, le] = DetectEncoding(data.data(), data.size());
+    (void)le;
+    size_t skip = BomLength(enc);
+    std::u16string text(MaxDecodedLength(data.size() - skip), u'\0');
+    DecodeResult r = DecodeChunk(enc, data.data() + skip, data.size() - skip, &text[0], true);
+    text.resize(r.written);
+    std::u16string editor = text;
+    return Checksum(editor.data(), editor.size() * sizeof(char16_t));
+}
+
+static uint64_t DecodeMappedChunks(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    fstat(fd, &st);
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    std::u16string editor;
+    editor.reserve(MaxDecodedLength(size));
+    std::vector<char16_t> chunk(MaxDecodedLength(LOAD_CHUNK_SIZE));
+    Encoding enc = Encoding::UTF8;
+    uint64_t pos = 0;
+    bool first = true;
+    while (pos < size)
+    {
+        uint64_t viewStart = pos - pos % 4096;
+        size_t viewSize = static_cast<size_t>(std::min<uint64_t>(MAP_VIEW_SIZE, size - viewStart));
+        void *view = mmap(nullptr, viewSize, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(viewStart));
+        if (view == MAP_FAILED)
+            break;
+        const uint8_t *base = static_cast<const uint8_t *>(view);
+        if (first)
+        {
+            enc = DetectBom(base, viewSize);
+            pos = BomLength(enc);
+            first = false;
+        }
+        while (pos < viewStart + viewSize)
+        {
+            size_t len = static_cast<size_t>(std::min<uint64_t>(LOAD_CHUNK_SIZE, viewStart + viewSize - pos));
+            bool final = pos + len >= size;
+            DecodeResult r = DecodeChunk(enc, base + (pos - viewStart), len, chunk.data(), final);
+            editor.append(chunk.data(), r.written);
+            if (r.consumed == 0)
+                break;
+            pos += r.consumed;
+        }
+        munmap(view, viewSize);
+    }
+    close(fd);
+    return Checksum(editor.data(), editor.size() * sizeof(char16_t));
+}
+
+// Time to the first decoded screen: validating the whole file first (the original
+// DetectEncoding) versus deciding from DETECT_PREFIX_SIZE bytes.
+static uint64_t DecodeFirstChunk(const std::string &path, bool prefixOnly)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = static_cast<size_t>(st.st_size);
+    void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return 0;
+    const uint8_t *data = static_cast<const uint8_t *>(view);
+    Encoding enc = prefixOnly ? DetectPrefixEncoding(data, size, true).first : DetectEncoding(data, size).first;
+    size_t len = std::min<size_t>(size, 64u << 10);
+    std::vector<char16_t> chunk(MaxDecodedLength(len));
+    DecodeResult r = DecodeChunk(enc, data, len, chunk.data(), len == size);
+    munmap(view, size);
+    return Checksum(chunk.data(), r.written * sizeof(char16_t));
+}
+
+void RunCodecBench(const BenchOptions &opts)
+{
+    size_t bytes = opts.sizeMB << 20;
+    for (const char *kind : {"ascii", "cjk", "mixed"})
+    {
+        std::string path = WriteTempFile(MakeCorpus(kind, bytes), kind);
+        PrintResult("codec", std::string("decode/whole-file/") + kind, bytes, RunIsolated([&]
+                                                                                         { return DecodeWholeFile(path); }));
+        PrintResult("codec", std::string("decode/mapped-chunks/") + kind, bytes, RunIsolated([&]
+                                                                                           { return DecodeMappedChunks(path); }));
+        unlink(path.c_str());
+    }
+    for (size_t mb : {opts.sizeMB / 4, opts.sizeMB})
+    {
+        std::string path = WriteTempFile(MakeCorpus("mixed", mb << 20), "first");
+        std::string suffix = "/mixed-" + std::to_string(mb) + "MB";
+        PrintResult("codec", "first-chunk/full-scan" + suffix, 64u << 10, RunIsolated([&]
+                                                                                  { return DecodeFirstChunk(path, false); }));
+        PrintResult("codec", "first-chunk/prefix" + suffix, 64u << 10, RunIsolated([&]
+                                                                               { return DecodeFirstChunk(path, true); }));
+        unlink(path.c_str());
+    }
+}
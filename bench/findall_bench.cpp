@@ -0,0 +1,105 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Find All match set: a full scan for every match against binary search for Find Next, and
+  the update one keystroke makes against scanning the document again.
+*/
+
+#include "bench.h"
+#include "core/matchset.h"
+#include "core/piecetable.h"
+#include "core/textcodec.h"
+#include <algorithm>
+#include <random>
+#include <string>
+
+#define FINDALL_BENCH_MATCHES 1000000
+#define FINDALL_BENCH_CHUNK_UNITS (1u << 20)
+#define FINDALL_BENCH_QUERIES 100000
+#define FINDALL_BENCH_KEYSTROKES 10000
+
+static void ScanAll(const PieceTable &table, const NoCasePattern &pattern, MatchSet &set)
+{
+    std::vector<TextSpan> matches;
+    for (size_t pos = FindPiecesPrepared(table, pattern, 0); pos != TEXT_NPOS; pos = FindPiecesPrepared(table, pattern, pos + pattern.length))
+        matches.push_back({pos, pattern.length});
+    ClearMatches(set);
+    AppendMatches(set, matches.data(), matches.size());
+}
+
+void RunFindAllBench(const BenchOptions &opts)
+{
+    std::string corpus = MakeCorpus("ascii", opts.sizeMB << 19);
+    std::u16string text(MaxDecodedLength(corpus.size()), u'\0');
+    text.resize(DecodeUtf8(reinterpret_cast<const uint8_t *>(corpus.data()), corpus.size(), &text[0], true).written);
+    std::string().swap(corpus);
+    std::u16string find = u"Needle";
+    size_t stride = text.size() / FINDALL_BENCH_MATCHES;
+    for (size_t i = 0; i < FINDALL_BENCH_MATCHES; ++i)
+        std::copy(find.begin(), find.end(), text.begin() + static_cast<std::ptrdiff_t>(i * stride));
+    PieceTable loaded;
+    for (size_t i = 0; i < text.size(); i += FINDALL_BENCH_CHUNK_UNITS)
+        AppendPieceBuffer(loaded, text.substr(i, FINDALL_BENCH_CHUNK_UNITS));
+    NoCasePattern pattern;
+    PrepareNoCase(pattern, find.data(), find.size());
+    MatchSet scanned;
+    ScanAll(loaded, pattern, scanned);
+    std::string mb = std::to_string((text.size() * sizeof(char16_t)) >> 20) + "MB";
+    size_t bytes = text.size() * 2;
+
+    PrintResult("findall", "scan/all " + mb, bytes, RunIsolated([&]
+                                                                 {
+        MatchSet set;
+        ScanAll(loaded, pattern, set);
+        return set.count; }));
+    std::vector<size_t> offsets(FINDALL_BENCH_QUERIES);
+    std::mt19937_64 rng(1);
+    for (size_t &offset : offsets)
+        offset = rng() % loaded.length;
+    std::string queries = std::to_string(FINDALL_BENCH_QUERIES) + " queries " + mb;
+    PrintResult("findall", "next/search " + queries, bytes, RunIsolated([&]
+                                                                         {
+        uint64_t sum = 0;
+        for (size_t offset : offsets)
+            sum += FindPiecesPrepared(loaded, pattern, offset);
+        return sum; }));
+    PrintResult("findall", "next/binary " + queries, bytes, RunIsolated([&]
+                                                                         {
+        uint64_t sum = 0;
+        for (size_t offset : offsets)
+        {
+            size_t index = MatchIndexAt(scanned, offset);
+            sum += index < scanned.count ? MatchAt(scanned, index).start : TEXT_NPOS;
+        }
+        return sum; }));
+    // Typing one unit at a time in random places, keeping the set current after each. The run
+    // is forked, so it edits the loaded table and set in place.
+    std::string keystrokes = std::to_string(FINDALL_BENCH_KEYSTROKES) + " keystrokes " + mb;
+    PrintResult("findall", "edit/update " + keystrokes, bytes, RunIsolated([&]
+                                                                           {
+        PieceTable &table = loaded;
+        MatchSet &set = scanned;
+        MatchFinder finder = [&](size_t from, TextSpan &match)
+        {
+            match.start = FindPiecesPrepared(table, pattern, from);
+            match.length = pattern.length;
+            return match.start != TEXT_NPOS;
+        };
+        std::mt19937_64 keys(2);
+        for (size_t i = 0; i < FINDALL_BENCH_KEYSTROKES; ++i)
+        {
+            size_t offset = keys() % table.length;
+            char16_t c = u"Nex "[keys() % 4];
+            ReplacePieces(table, offset, 0, &c, 1);
+            EditMatches(set, offset, 0, 1, offset >= pattern.length - 1 ? offset - (pattern.length - 1) : 0, finder);
+        }
+        return set.count; }));
+}
@@ -0,0 +1,89 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Journal benchmarks: recording keystrokes as edit records versus re-encoding the whole
+  document once per autosave, and parsing a journal back for replay.
+*/
+
+#include "bench.h"
+#include "core/editjournal.h"
+#include <string>
+#include <vector>
+
+#define JOURNAL_KEYSTROKES 1000000
+#define JOURNAL_BATCH_BYTES (64u << 10)
+
+// Types the corpus one unit at a time at a caret that occasionally jumps, handing off a full
+// batch the way the UI thread hands records to the writer.
+static uint64_t RecordKeystrokes(const std::u16string &text, std::vector<uint8_t> &journal)
+{
+    std::vector<uint8_t> batch;
+    batch.reserve(JOURNAL_BATCH_BYTES + 64);
+    uint64_t caret = 0;
+    for (size_t i = 0; i < JOURNAL_KEYSTROKES; ++i)
+    {
+        if (i % 97 == 0)
+            caret = (caret * 31 + i) % (i + 1);
+        char16_t c = text[i % text.size()];
+        AppendJournalEdit(batch, caret++, 0, &c, 1);
+        if (batch.size() >= JOURNAL_BATCH_BYTES)
+        {
+            journal.insert(journal.end(), batch.begin(), batch.end());
+            batch.clear();
+        }
+    }
+    journal.insert(journal.end(), batch.begin(), batch.end());
+    return journal.size();
+}
+
+static uint64_t ReencodeDocument(const std::u16string &text)
+{
+    std::vector<uint8_t> out(MaxEncodedLength(Encoding::UTF8, text.size()));
+    EncodeResult r = EncodeChunk(Encoding::UTF8, LineEnding::CRLF, text.data(), text.size(), out.data(), true);
+    return Checksum(out.data(), r.written);
+}
+
+static uint64_t ParseJournal(const std::vector<uint8_t> &journal)
+{
+    uint64_t sum = 0;
+    JournalRecord record;
+    size_t pos = JOURNAL_HEADER_SIZE;
+    while (size_t n = ReadJournalRecord(journal.data() + pos, journal.size() - pos, record))
+    {
+        sum += record.offset + record.text.size();
+        pos += n;
+    }
+    return sum;
+}
+
+void RunJournalBench(const BenchOptions &opts)
+{
+    size_t bytes = opts.sizeMB << 20;
+    std::string corpus = MakeCorpus("mixed", bytes);
+    std::u16string text(MaxDecodedLength(corpus.size()), u'\0');
+    DecodeResult d = DecodeUtf8(reinterpret_cast<const uint8_t *>(corpus.data()), corpus.size(), &text[0], true);
+    text.resize(d.written);
+    std::string().swap(corpus);
+    size_t typed = JOURNAL_KEYSTROKES * sizeof(char16_t);
+    PrintResult("journal", "record/1M keystrokes", typed, RunIsolated([&]
+                                                                     {
+        std::vector<uint8_t> journal;
+        AppendJournalHeader(journal);
+        return RecordKeystrokes(text, journal); }));
+    PrintResult("journal", "autosave/re-encode once", bytes, RunIsolated([&]
+                                                                         { return ReencodeDocument(text); }));
+    std::vector<uint8_t> journal;
+    AppendJournalHeader(journal);
+    AppendJournalSnapshot(journal, text.data(), text.size());
+    RecordKeystrokes(text, journal);
+    PrintResult("journal", "replay/parse snapshot+1M edits", journal.size(), RunIsolated([&]
+                                                                                        { return ParseJournal(journal); }));
+}
@@ -0,0 +1,189 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Benchmark harness entry point for the portable notepad_core library.
+  Usage: notepad_core_bench [suite] [--size MB]
+*/
+
+#include "bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+#include <sys/wait.h>
+
+double NowSeconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t Checksum(const void *data, size_t bytes)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t h = 1469598103934665603ull ^ bytes;
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 1099511628211ull;
+    }
+    for (; i < bytes; ++i)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+std::string MakeCorpus(const std::string &kind, size_t bytes)
+{
+    static const char *ascii[] = {
+        "2026-10-17T08:15:02.113Z INFO  [worker-3] request id=7f3a9c21 GET /api/items completed in 12 ms\n",
+        "2026-10-17T08:15:02.118Z WARN  [worker-1] slow query on table orders took 812 ms\n",
+        "2026-10-17T08:15:02.240Z ERROR [scheduler] job 4411 failed: connection reset by peer\n",
+        "\tat com.example.service.Handler.process(Handler.java:214)\n"};
+    static const char *cjk[] = {
+        "これは大きなログファイルの読み込み速度を測定するための日本語のテキストです。\n",
+        "東京都の天気は晴れ、最高気温は二十三度の予報となっています。\n",
+        "文字コードの変換処理がボトルネックにならないことを確認します。\n",
+        "中文测试文本，用于验证多字节字符的解码性能。한국어 텍스트도 포함합니다.\n"};
+    static const char *mixed[] = {
+        "2026-10-17 08:15:02 INFO  ユーザー user-42 がログインしました (session=ab12)\n",
+        "2026-10-17 08:15:03 WARN  キャッシュの有効期限切れ: key=profile:1337 — refreshing\n",
+        "2026-10-17 08:15:04 DEBUG payload={\"name\":\"Müller\",\"city\":\"Zürich\",\"emoji\":\"🙂\"}\n",
+        "2026-10-17 08:15:05 INFO  request completed in 8 ms\n"};
+    const char **lines = kind == "cjk" ? cjk : kind == "mixed" ? mixed : ascii;
+    std::string out;
+    out.reserve(bytes + 256);
+    uint32_t seed = 12345;
+    while (out.size() < bytes)
+    {
+        seed = seed * 1103515245u + 12345u;
+        out += lines[(seed >> 16) & 3];
+    }
+    return out;
+}
+
+std::string WriteTempFile(const std::string &data, const std::string &tag)
+{
+    const char *dir = getenv("TMPDIR");
+    std::string path = std::string(dir ? dir : "/tmp") + "/notepad_bench_" + tag + "_" + std::to_string(getpid());
+    std::ofstream f(path, std::ios::binary);
+    f.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return path;
+}
+
+bool WantSuite(const BenchOptions &opts, const char *suite)
+{
+    return opts.filter.empty() || opts.filter == suite;
+}
+
+static long ReadProcStatusKb(const char *field)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f)
+        return -1;
+    char line[256];
+    long value = -1;
+    size_t len = strlen(field);
+    while (fgets(line, sizeof(line), f))
+    {
+        if (strncmp(line, field, len) == 0)
+        {
+            value = strtol(line + len, nullptr, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+// Runs body in a forked child so each case gets its own peak-RSS high-water mark.
+BenchResult RunIsolated(const std::function<uint64_t()> &body)
+{
+    BenchResult result;
+    int fds[2];
+    if (pipe(fds) != 0)
+        return result;
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        FILE *clear = fopen("/proc/self/clear_refs", "w");
+        if (clear)
+        {
+            fputs("5", clear);
+            fclose(clear);
+        }
+        long baseKb = ReadProcStatusKb("VmRSS:");
+        double start = NowSeconds();
+        BenchResult child;
+        child.checksum = body();
+        child.seconds = NowSeconds() - start;
+        long peakKb = ReadProcStatusKb("VmHWM:");
+        child.peakKb = (peakKb >= 0 && baseKb >= 0) ? peakKb - baseKb : -1;
+        ssize_t written = write(fds[1], &child, sizeof(child));
+        _exit(written == static_cast<ssize_t>(sizeof(child)) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid > 0)
+    {
+        if (read(fds[0], &result, sizeof(result)) != static_cast<ssize_t>(sizeof(result)))
+            result = BenchResult();
+        waitpid(pid, nullptr, 0);
+    }
+    close(fds[0]);
+    return result;
+}
+
+void PrintResult(const char *suite, const std::string &name, size_t bytes, const BenchResult &r)
+{
+    double mbps = r.seconds > 0 ? bytes / (1024.0 * 1024.0) / r.seconds : 0;
+    printf("%-8s %-34s %9.1f ms %9.1f MB/s  peak +%7.1f MB  sum %016llx\n", suite, name.c_str(),
+           r.seconds * 1000.0, mbps, r.peakKb / 1024.0, static_cast<unsigned long long>(r.checksum));
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions opts;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            opts.sizeMB = static_cast<size_t>(strtoul(argv[++i], nullptr, 10));
+        else
+            opts.filter = argv[i];
+    }
+    if (WantSuite(opts, "codec"))
+        RunCodecBench(opts);
+    if (WantSuite(opts, "utf8"))
+        RunUtf8Bench(opts);
+    if (WantSuite(opts, "save"))
+        RunSaveBench(opts);
+    if (WantSuite(opts, "utf16"))
+        RunUtf16Bench(opts);
+    if (WantSuite(opts, "scan"))
+        RunScanBench(opts);
+    if (WantSuite(opts, "viewer"))
+        RunViewerBench(opts);
+    if (WantSuite(opts, "journal"))
+        RunJournalBench(opts);
+    if (WantSuite(opts, "piece"))
+        RunPieceBench(opts);
+    if (WantSuite(opts, "regex"))
+        RunRegexBench(opts);
+    if (WantSuite(opts, "replace"))
+        RunReplaceBench(opts);
+    if (WantSuite(opts, "findall"))
+        RunFindAllBench(opts);
+    return 0;
+}
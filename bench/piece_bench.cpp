@@ -0,0 +1,251 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Piece table benchmarks on a document of at least PIECE_BENCH_MIN_MB: random and typed
+  inserts, random deletes, random reads, line lookups, word deletes at growing sizes and an
+  undoable Replace All, against copying the whole text out once and scanning it for a line.
+*/
+
+#include "bench.h"
+#include "core/piecetable.h"
+#include "core/textcodec.h"
+#include "core/undohistory.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define PIECE_BENCH_MIN_MB 128
+#define PIECE_BENCH_OPS 1000000
+#define PIECE_BENCH_CHUNK_UNITS (1u << 20)
+#define PIECE_BENCH_READ_UNITS 64
+#define PIECE_BENCH_WORD_OPS 100000
+#define PIECE_BENCH_MATCH_UNITS 4
+
+static uint32_t NextRandom(uint32_t &seed)
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 8;
+}
+
+static size_t RandomOffset(uint32_t &seed, size_t length)
+{
+    uint64_t r = (static_cast<uint64_t>(NextRandom(seed)) << 24) ^ NextRandom(seed);
+    return static_cast<size_t>(r % (length + 1));
+}
+
+static std::vector<std::u16string> SplitChunks(const std::u16string &text)
+{
+    std::vector<std::u16string> chunks;
+    for (size_t pos = 0; pos < text.size(); pos += PIECE_BENCH_CHUNK_UNITS)
+        chunks.push_back(text.substr(pos, PIECE_BENCH_CHUNK_UNITS));
+    return chunks;
+}
+
+// Hands the decoded buffers over as the async load does, without copying them.
+static void LoadPieces(PieceTable &table, std::vector<std::u16string> chunks)
+{
+    for (std::u16string &chunk : chunks)
+        AppendPieceBuffer(table, std::move(chunk));
+}
+
+static uint64_t InsertRandom(PieceTable &table, const std::u16string &text)
+{
+    uint32_t seed = 7;
+    for (size_t i = 0; i < PIECE_BENCH_OPS; ++i)
+        ReplacePieces(table, RandomOffset(seed, table.length), 0, &text[i % text.size()], 1);
+    return table.length + table.blocks.size();
+}
+
+// Runs of keystrokes at a caret that jumps now and then, with the odd backspace.
+static uint64_t InsertTyped(PieceTable &table, const std::u16string &text)
+{
+    uint32_t seed = 11;
+    size_t caret = table.length / 2;
+    for (size_t i = 0; i < PIECE_BENCH_OPS; ++i)
+    {
+        if (i % 97 == 0)
+            caret = RandomOffset(seed, table.length);
+        if (i % 13 == 12 && caret > 0)
+        {
+            ReplacePieces(table, --caret, 1, nullptr, 0);
+            continue;
+        }
+        ReplacePieces(table, caret++, 0, &text[i % text.size()], 1);
+    }
+    return table.length + table.blocks.size();
+}
+
+static uint64_t DeleteRandom(PieceTable &table)
+{
+    uint32_t seed = 13;
+    for (size_t i = 0; i < PIECE_BENCH_OPS && table.length; ++i)
+        ReplacePieces(table, RandomOffset(seed, table.length - 1), 1 + NextRandom(seed) % 16, nullptr, 0);
+    return table.length + table.blocks.size();
+}
+
+static uint64_t ReadRandom(const PieceTable &table)
+{
+    uint32_t seed = 17;
+    char16_t buf[PIECE_BENCH_READ_UNITS];
+    uint64_t sum = 0;
+    for (size_t i = 0; i < PIECE_BENCH_OPS; ++i)
+    {
+        size_t n = CopyPieces(table, RandomOffset(seed, table.length), PIECE_BENCH_READ_UNITS, buf);
+        sum += n ? buf[0] + buf[n - 1] : 0;
+    }
+    return sum;
+}
+
+// What a whole-text read costs: the document copied out in one piece.
+static uint64_t CopyWhole(const PieceTable &table)
+{
+    std::u16string text(table.length, u'\0');
+    CopyPieces(table, 0, table.length, &text[0]);
+    return Checksum(text.data(), text.size() * sizeof(char16_t));
+}
+
+static uint64_t LineStarts(const PieceTable &table)
+{
+    uint32_t seed = 19;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < PIECE_BENCH_OPS; ++i)
+        sum += PieceLineStart(table, 1 + RandomOffset(seed, table.lines));
+    return sum;
+}
+
+static uint64_t LinesAt(const PieceTable &table)
+{
+    uint32_t seed = 23;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < PIECE_BENCH_OPS; ++i)
+        sum += PieceLineAt(table, RandomOffset(seed, table.length));
+    return sum;
+}
+
+// Ctrl+Backspace at a random caret: find where the word starts and delete back to it.
+static uint64_t DeleteWordsBackward(PieceTable &table)
+{
+    uint32_t seed = 29;
+    for (size_t i = 0; i < PIECE_BENCH_WORD_OPS && table.length; ++i)
+    {
+        size_t caret = RandomOffset(seed, table.length);
+        size_t start = PieceWordStart(table, caret);
+        ReplacePieces(table, start, caret - start, nullptr, 0);
+    }
+    return table.length + table.blocks.size();
+}
+
+// Replace All as the document does it: PIECE_BENCH_OPS evenly spaced matches swapped for one
+// shared replacement, spliced in and recorded as one undo step.
+static void ReplaceEvenly(PieceTable &table, UndoHistory &history)
+{
+    size_t stride = table.length / PIECE_BENCH_OPS;
+    Piece piece = AddPieceText(table, u"12345", 5);
+    UndoEdit edit;
+    size_t last = 0;
+    for (size_t i = 0; i < PIECE_BENCH_OPS; ++i)
+    {
+        size_t pos = i * stride;
+        CollectPieces(table, last, pos - last, edit.inserted);
+        edit.inserted.push_back(piece);
+        last = pos + PIECE_BENCH_MATCH_UNITS;
+    }
+    edit.removedLength = last;
+    edit.insertedLength = last + PIECE_BENCH_OPS * (piece.length - PIECE_BENCH_MATCH_UNITS);
+    CollectPieces(table, 0, last, edit.removed);
+    SplicePieces(table, 0, last, edit.inserted.data(), edit.inserted.size());
+    RecordUndo(history, std::move(edit), false);
+}
+
+static uint64_t UndoRedo(PieceTable &table, UndoHistory &history)
+{
+    const UndoStep *step = TakeUndo(history);
+    for (const UndoEdit &edit : step->edits)
+        SplicePieces(table, edit.offset, edit.insertedLength, edit.removed.data(), edit.removed.size());
+    uint64_t undone = table.length;
+    step = TakeRedo(history);
+    for (const UndoEdit &edit : step->edits)
+        SplicePieces(table, edit.offset, edit.removedLength, edit.inserted.data(), edit.inserted.size());
+    return undone + table.length;
+}
+
+// What Go To cost before the index: one scan of the whole text for the last line.
+static uint64_t LastLineScan(const std::u16string &text, size_t lines)
+{
+    return LineStartOffset(text.data(), text.size(), lines + 1);
+}
+
+static uint64_t FindMissing(const PieceTable &table)
+{
+    const std::u16string missing = u"NeedleThatIsNotThere";
+    return FindPiecesNoCase(table, missing.data(), missing.size(), 0);
+}
+
+void RunPieceBench(const BenchOptions &opts)
+{
+    size_t bytes = (std::max)(opts.sizeMB, static_cast<size_t>(PIECE_BENCH_MIN_MB)) << 20;
+    std::string corpus = MakeCorpus("ascii", bytes / 2);
+    std::u16string text(MaxDecodedLength(corpus.size()), u'\0');
+    text.resize(DecodeUtf8(reinterpret_cast<const uint8_t *>(corpus.data()), corpus.size(), &text[0], true).written);
+    std::string().swap(corpus);
+    std::string mb = std::to_string((text.size() * sizeof(char16_t)) >> 20) + "MB";
+    size_t edited = PIECE_BENCH_OPS * sizeof(char16_t);
+    std::vector<std::u16string> chunks = SplitChunks(text);
+    PieceTable loaded;
+    LoadPieces(loaded, chunks);
+    PrintResult("piece", "load/take buffers " + mb, text.size() * 2, RunIsolated([&]
+                                                                                 {
+        PieceTable table;
+        for (std::u16string &chunk : chunks)
+            AppendPieceBuffer(table, std::move(chunk));
+        return table.length; }));
+    PrintResult("piece", "copy/whole document " + mb, text.size() * 2, RunIsolated([&]
+                                                                                   { return CopyWhole(loaded); }));
+    PrintResult("piece", "insert/1M random", edited, RunIsolated([&]
+                                                                 { return InsertRandom(loaded, text); }));
+    PrintResult("piece", "insert/1M typed", edited, RunIsolated([&]
+                                                                { return InsertTyped(loaded, text); }));
+    PrintResult("piece", "delete/1M random", edited, RunIsolated([&]
+                                                                 { return DeleteRandom(loaded); }));
+    PrintResult("piece", "lines/scan to last line " + mb, text.size() * 2, RunIsolated([&]
+                                                                                        { return LastLineScan(text, loaded.lines); }));
+    // Same work on documents of growing size; the time should stay flat
+    for (size_t unitsMB : {static_cast<size_t>(1), static_cast<size_t>(16), text.size() >> 19})
+    {
+        PieceTable sized;
+        LoadPieces(sized, SplitChunks(text.substr(0, unitsMB << 19)));
+        std::string label = "word/100k ctrl+backspace " + std::to_string(unitsMB) + "MB";
+        PrintResult("piece", label, PIECE_BENCH_WORD_OPS, RunIsolated([&]
+                                                                      { return DeleteWordsBackward(sized); }));
+    }
+    PrintResult("piece", "undo/replace all 1M matches", PIECE_BENCH_OPS, RunIsolated([&]
+                                                                                    {
+        UndoHistory history;
+        ReplaceEvenly(loaded, history);
+        return loaded.length + history.cost; }));
+    PrintResult("piece", "undo/replace all, undo, redo", PIECE_BENCH_OPS, RunIsolated([&]
+                                                                                     {
+        UndoHistory history;
+        ReplaceEvenly(loaded, history);
+        return UndoRedo(loaded, history); }));
+    PieceTable fragmented;
+    LoadPieces(fragmented, std::move(chunks));
+    InsertRandom(fragmented, text);
+    std::u16string().swap(text);
+    PrintResult("piece", "lines/1M line starts", PIECE_BENCH_OPS, RunIsolated([&]
+                                                                             { return LineStarts(fragmented); }));
+    PrintResult("piece", "lines/1M lines at offset", PIECE_BENCH_OPS, RunIsolated([&]
+                                                                                 { return LinesAt(fragmented); }));
+    PrintResult("piece", "read/1M random 64 units", PIECE_BENCH_OPS * PIECE_BENCH_READ_UNITS * 2, RunIsolated([&]
+                                                                                                          { return ReadRandom(fragmented); }));
+    PrintResult("piece", "find/fragmented " + mb, fragmented.length * 2, RunIsolated([&]
+                                                                                     { return FindMissing(fragmented); }));
+}
@@ -0,0 +1,76 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Regex find throughput: the automaton engine counting every match in a log against
+  std::wregex walking a slice of the same text.
+*/
+
+#include "bench.h"
+#include "core/textcodec.h"
+#include "core/textregex.h"
+#include <algorithm>
+#include <regex>
+#include <string>
+
+// std::wregex backtracks, so it gets a slice of the corpus and the result is per byte
+#define REGEX_BENCH_STD_UNITS (8u << 20)
+
+static uint64_t CountCore(Regex &regex, const std::u16string &text)
+{
+    uint64_t count = 0;
+    RegexMatch match;
+    for (size_t pos = 0; pos <= text.size() && FindRegex(regex, text.data(), text.size(), pos, TEXT_NPOS, match);)
+    {
+        ++count;
+        pos = match.end > match.start ? match.end : match.start + 1;
+    }
+    return count;
+}
+
+static uint64_t CountStd(const std::wregex &regex, const std::wstring &text)
+{
+    uint64_t count = 0;
+    for (std::wsregex_iterator it(text.begin(), text.end(), regex), end; it != end; ++it)
+        ++count;
+    return count;
+}
+
+void RunRegexBench(const BenchOptions &opts)
+{
+    size_t bytes = opts.sizeMB << 20;
+    std::string corpus = MakeCorpus("ascii", bytes);
+    std::u16string text(MaxDecodedLength(corpus.size()), u'\0');
+    text.resize(DecodeUtf8(reinterpret_cast<const uint8_t *>(corpus.data()), corpus.size(), &text[0], true).written);
+    std::string().swap(corpus);
+    std::wstring slice(text.begin(), text.begin() + static_cast<std::ptrdiff_t>((std::min)(text.size(), static_cast<size_t>(REGEX_BENCH_STD_UNITS))));
+    static const struct
+    {
+        const char *name;
+        const char16_t *pattern;
+    } cases[] = {
+        {"timestamp", u"\\d{4}-\\d{2}-\\d{2}T\\d{2}:\\d{2}:\\d{2}"},
+        {"request-id", u"id=[0-9a-f]{8}"},
+        {"alternation", u"ERROR|FATAL"},
+        {"groups", u"(\\w+)\\.java:(\\d+)"},
+    };
+    for (const auto &c : cases)
+    {
+        std::u16string pattern = c.pattern;
+        Regex regex;
+        if (!CompileRegex(regex, pattern.data(), pattern.size(), false))
+            continue;
+        std::wregex reference(std::wstring(pattern.begin(), pattern.end()));
+        PrintResult("regex", std::string("find-all/std-wregex/") + c.name, slice.size() * sizeof(char16_t), RunIsolated([&]
+                                                                                                                   { return CountStd(reference, slice); }));
+        PrintResult("regex", std::string("find-all/core/") + c.name, text.size() * sizeof(char16_t), RunIsolated([&]
+                                                                                                           { return CountCore(regex, text); }));
+    }
+}
@@ -0,0 +1,172 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Replace All throughput: the original lowercase-copy rebuild against the piece table edit,
+  one million matches in a 100 MB document.
+*/
+
+#include "bench.h"
+#include "core/textcodec.h"
+#include "core/textreplace.h"
+#include "core/workpool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cwctype>
+#include <string>
+
+#define REPLACE_BENCH_MIN_MB 100
+#define REPLACE_BENCH_MATCHES 1000000
+#define REPLACE_BENCH_CHUNK_UNITS (1u << 20)
+// Thread counts run up to at least this many, even on fewer cores
+#define REPLACE_BENCH_MIN_THREADS 4
+
+static char16_t Lower(char16_t c)
+{
+    return static_cast<char16_t>(towlower(static_cast<wint_t>(c)));
+}
+
+// Mirrors the original FindDlgProc Replace All up to SetEditorText. Its reserve goes through
+// unsigned arithmetic, so it only survives a replacement at least as long as the needle.
+static uint64_t ReplaceLowerCopy(const std::u16string &text, const std::u16string &find, const std::u16string &replacement)
+{
+    std::u16string findLower = find;
+    std::transform(findLower.begin(), findLower.end(), findLower.begin(), Lower);
+    std::u16string lower = text;
+    std::transform(lower.begin(), lower.end(), lower.begin(), Lower);
+    std::u16string newText;
+    newText.reserve(text.size() + (replacement.size() - find.size()) * 10);
+    size_t lastPos = 0, pos = 0;
+    while ((pos = lower.find(findLower, lastPos)) != std::u16string::npos)
+    {
+        newText += text.substr(lastPos, pos - lastPos);
+        newText += replacement;
+        lastPos = pos + find.size();
+    }
+    newText += text.substr(lastPos);
+    return newText.size();
+}
+
+// Builds the edit for a literal or regex pattern on the given number of threads, 0 meaning
+// the sequential builder.
+static void BuildEdit(PieceTable &table, const std::u16string &find, bool regex, const std::u16string &replacement,
+                      size_t threads, ReplaceAllEdit &replace)
+{
+    replace.selStart = replace.selEnd = table.length / 2;
+    if (regex)
+    {
+        Regex compiled;
+        CompileRegex(compiled, find.data(), find.size(), false);
+        if (threads)
+            BuildReplaceAllRegexParallel(table, compiled, replacement.data(), replacement.size(), replace, threads);
+        else
+            BuildReplaceAllRegex(table, compiled, replacement.data(), replacement.size(), replace);
+        return;
+    }
+    NoCasePattern pattern;
+    PrepareNoCase(pattern, find.data(), find.size());
+    if (threads)
+        BuildReplaceAllParallel(table, pattern, replacement.data(), replacement.size(), replace, threads);
+    else
+        BuildReplaceAll(table, pattern, replacement.data(), replacement.size(), replace);
+}
+
+// What ReplaceAllInDocument does short of the control: build the edit, apply it, record undo.
+static uint64_t ReplacePieces(PieceTable &table, const std::u16string &find, bool regex, const std::u16string &replacement,
+                              size_t threads)
+{
+    ReplaceAllEdit replace;
+    BuildEdit(table, find, regex, replacement, threads, replace);
+    UndoEdit &edit = replace.edit;
+    CollectPieces(table, edit.offset, edit.removedLength, edit.removed);
+    SplicePieces(table, edit.offset, edit.removedLength, edit.inserted.data(), edit.inserted.size());
+    UndoHistory history;
+    RecordUndo(history, std::move(edit), false);
+    return replace.count + replace.newSelStart + table.length;
+}
+
+static std::u16string DocumentText(const PieceTable &table)
+{
+    std::u16string text(table.length, u'\0');
+    text.resize(CopyPieces(table, 0, table.length, &text[0]));
+    return text;
+}
+
+// The parallel builders must leave the document exactly as the sequential one does.
+static bool SameAsSequential(const PieceTable &loaded, const std::u16string &find, bool regex, const std::u16string &replacement,
+                             size_t threads)
+{
+    PieceTable tables[2] = {loaded, loaded};
+    ReplaceAllEdit replaces[2];
+    for (size_t i = 0; i < 2; ++i)
+    {
+        BuildEdit(tables[i], find, regex, replacement, i ? threads : 0, replaces[i]);
+        UndoEdit &edit = replaces[i].edit;
+        SplicePieces(tables[i], edit.offset, edit.removedLength, edit.inserted.data(), edit.inserted.size());
+    }
+    return replaces[0].count == replaces[1].count && replaces[0].newSelStart == replaces[1].newSelStart &&
+           tables[0].lines == tables[1].lines && DocumentText(tables[0]) == DocumentText(tables[1]);
+}
+
+void RunReplaceBench(const BenchOptions &opts)
+{
+    size_t bytes = (std::max)(opts.sizeMB, static_cast<size_t>(REPLACE_BENCH_MIN_MB)) << 20;
+    std::string corpus = MakeCorpus("ascii", bytes / 2);
+    std::u16string text(MaxDecodedLength(corpus.size()), u'\0');
+    text.resize(DecodeUtf8(reinterpret_cast<const uint8_t *>(corpus.data()), corpus.size(), &text[0], true).written);
+    std::string().swap(corpus);
+    std::u16string find = u"Needle";
+    size_t stride = text.size() / REPLACE_BENCH_MATCHES;
+    for (size_t i = 0; i < REPLACE_BENCH_MATCHES; ++i)
+        std::copy(find.begin(), find.end(), text.begin() + static_cast<std::ptrdiff_t>(i * stride));
+    // Loaded the way the file loader hands its chunks over; every run edits its own copy
+    PieceTable loaded;
+    for (size_t i = 0; i < text.size(); i += REPLACE_BENCH_CHUNK_UNITS)
+        AppendPieceBuffer(loaded, text.substr(i, REPLACE_BENCH_CHUNK_UNITS));
+    std::string mb = std::to_string((text.size() * sizeof(char16_t)) >> 20) + "MB";
+    for (const char16_t *replacement : {u"Thread", u"pin", u"longer replacement"})
+    {
+        std::u16string with = replacement;
+        std::string label = std::to_string(find.size()) + "->" + std::to_string(with.size()) + " " + mb;
+        if (with.size() >= find.size())
+            PrintResult("replace", "all/lower-copy " + label, text.size() * 2, RunIsolated([&]
+                                                                                          { return ReplaceLowerCopy(text, find, with); }));
+        PrintResult("replace", "all/pieces " + label, text.size() * 2, RunIsolated([&]
+                                                                                  { return ReplacePieces(loaded, find, false, with, 0); }));
+    }
+    // Scaling over threads, for a literal and for a regex whose replacement differs per match
+    size_t most = (std::max)(DefaultWorkerCount(), static_cast<size_t>(REPLACE_BENCH_MIN_THREADS));
+    static const struct
+    {
+        const char *name;
+        const char16_t *find;
+        bool regex;
+        const char16_t *replacement;
+    } cases[] = {
+        {"literal", u"Needle", false, u"Thread"},
+        {"regex groups", u"id=([0-9a-f]+)", true, u"id=<$1>"},
+    };
+    for (const auto &c : cases)
+    {
+        std::u16string find = c.find;
+        std::u16string with = c.replacement;
+        PrintResult("replace", std::string("scale/") + c.name + " sequential " + mb, text.size() * 2, RunIsolated([&]
+                                                                                                                   { return ReplacePieces(loaded, find, c.regex, with, 0); }));
+        for (size_t threads = 1; threads <= most; threads = threads < most && threads * 2 > most ? most : threads * 2)
+        {
+            if (!SameAsSequential(loaded, find, c.regex, with, threads))
+                fprintf(stderr, "replace: %s on %zu threads differs from the sequential result\n", c.name, threads);
+            PrintResult("replace", std::string("scale/") + c.name + " " + std::to_string(threads) + " threads " + mb, text.size() * 2, RunIsolated([&]
+                                                                                                                                              { return ReplacePieces(loaded, find, c.regex, with, threads); }));
+            if (threads == most)
+                break;
+        }
+    }
+}
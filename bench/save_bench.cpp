@@ -0,0 +1,149 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Save benchmarks: the original normalize-then-convert EncodeText path versus the
+  fused chunked encoder writing straight to the file descriptor.
+*/
+
+#include "bench.h"
+#include "core/textcodec.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SAVE_CHUNK_UNITS (32u << 10)
+
+static bool WriteAll(int fd, const void *data, size_t len)
+{
+    const char *p = static_cast<const char *>(data);
+    while (len)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static size_t Utf8Length(const std::u16string &text)
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char16_t c = text[i];
+        if (c < 0x80)
+            bytes += 1;
+        else if (c < 0x800)
+            bytes += 2;
+        else if (c >= 0xD800 && c <= 0xDBFF && i + 1 < text.size())
+        {
+            bytes += 4;
+            ++i;
+        }
+        else
+            bytes += 3;
+    }
+    return bytes;
+}
+
+// Mirrors the original EncodeText + SaveToPath: a normalized copy of the document, a sizing
+// pass and a conversion pass (WideCharToMultiByte twice) or push_back per byte for UTF-16,
+// then one WriteFile of the whole buffer. Both paths report the bytes written.
+static uint64_t SaveThreePass(const std::u16string &text, Encoding enc, const std::string &path)
+{
+    std::u16string converted;
+    converted.reserve(text.size() + text.size() / 10);
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char16_t c = text[i];
+        if (c == u'\r' || c == u'\n')
+        {
+            if (c == u'\r' && i + 1 < text.size() && text[i + 1] == u'\n')
+                ++i;
+            converted += u"\r\n";
+        }
+        else
+            converted += c;
+    }
+    std::vector<uint8_t> result;
+    if (enc == Encoding::UTF8)
+    {
+        result.resize(Utf8Length(converted));
+        EncodeResult r = EncodeChunk(Encoding::UTF8, LineEnding::CRLF, converted.data(), converted.size(), result.data(), true);
+        result.resize(r.written);
+    }
+    else
+    {
+        result.push_back(0xFF);
+        result.push_back(0xFE);
+        result.reserve(result.size() + converted.size() * 2);
+        for (char16_t c : converted)
+        {
+            result.push_back(static_cast<uint8_t>(c & 0xFF));
+            result.push_back(static_cast<uint8_t>((c >> 8) & 0xFF));
+        }
+    }
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    bool ok = fd >= 0 && WriteAll(fd, result.data(), result.size());
+    if (fd >= 0)
+        close(fd);
+    return ok ? result.size() : 0;
+}
+
+static uint64_t SaveFused(const std::u16string &text, Encoding enc, const std::string &path)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return 0;
+    uint8_t bom[3];
+    size_t bomLen = EncodeBom(enc, bom);
+    bool ok = WriteAll(fd, bom, bomLen);
+    std::vector<uint8_t> out(MaxEncodedLength(enc, SAVE_CHUNK_UNITS));
+    uint64_t bytes = bomLen;
+    size_t pos = 0;
+    while (ok && pos < text.size())
+    {
+        size_t len = std::min<size_t>(SAVE_CHUNK_UNITS, text.size() - pos);
+        EncodeResult r = EncodeChunk(enc, LineEnding::CRLF, text.data() + pos, len, out.data(), pos + len == text.size());
+        ok = WriteAll(fd, out.data(), r.written);
+        bytes += r.written;
+        pos += r.consumed;
+    }
+    close(fd);
+    return ok ? bytes : 0;
+}
+
+void RunSaveBench(const BenchOptions &opts)
+{
+    size_t bytes = opts.sizeMB << 20;
+    std::string path = WriteTempFile(std::string(), "save");
+    for (const char *kind : {"ascii", "cjk", "mixed"})
+    {
+        std::string corpus = MakeCorpus(kind, bytes);
+        std::u16string text(MaxDecodedLength(corpus.size()), u'\0');
+        DecodeResult d = DecodeUtf8(reinterpret_cast<const uint8_t *>(corpus.data()), corpus.size(), &text[0], true);
+        text.resize(d.written);
+        std::string().swap(corpus);
+        for (Encoding enc : {Encoding::UTF8, Encoding::UTF16LE})
+        {
+            const char *encName = enc == Encoding::UTF8 ? "utf8" : "utf16le";
+            PrintResult("save", std::string("encode/three-pass/") + encName + "/" + kind, bytes, RunIsolated([&]
+                                                                                                            { return SaveThreePass(text, enc, path); }));
+            PrintResult("save", std::string("encode/fused-chunks/") + encName + "/" + kind, bytes, RunIsolated([&]
+                                                                                                              { return SaveFused(text, enc, path); }));
+        }
+    }
+    unlink(path.c_str());
+}
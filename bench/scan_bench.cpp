@@ -0,0 +1,119 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Scan benchmarks for the algorithms behind Find, Print and Go To, comparing the
+  original copy-and-lowercase / per-line string code with the notepad_core versions.
+*/
+
+#include "bench.h"
+#include "core/textcodec.h"
+#include "core/textscan.h"
+#include <algorithm>
+#include <cwctype>
+#include <string>
+#include <vector>
+
+static char16_t Lower(char16_t c)
+{
+    return static_cast<char16_t>(towlower(static_cast<wint_t>(c)));
+}
+
+// Mirrors the original DoFind: lowercase copies of the document and the pattern.
+static uint64_t FindLowerCopy(const std::u16string &text, const std::u16string &pattern, size_t from = 0)
+{
+    std::u16string textLower = text;
+    std::transform(textLower.begin(), textLower.end(), textLower.begin(), Lower);
+    std::u16string findLower = pattern;
+    std::transform(findLower.begin(), findLower.end(), findLower.begin(), Lower);
+    return textLower.find(findLower, from);
+}
+
+static uint64_t FindCore(const std::u16string &text, const std::u16string &pattern, size_t from = 0)
+{
+    return FindNoCase(text.data(), text.size(), pattern.data(), pattern.size(), from);
+}
+
+// Mirrors the original FilePrint split into one std::wstring per line.
+static uint64_t SplitStrings(const std::u16string &text)
+{
+    std::vector<std::u16string> lines;
+    std::u16string line;
+    for (size_t i = 0; i <= text.size(); ++i)
+    {
+        if (i == text.size() || text[i] == u'\n' || text[i] == u'\r')
+        {
+            lines.push_back(line);
+            line.clear();
+            if (i < text.size() && text[i] == u'\r' && i + 1 < text.size() && text[i + 1] == u'\n')
+                ++i;
+        }
+        else
+            line += text[i];
+    }
+    return lines.size();
+}
+
+static uint64_t SplitSpans(const std::u16string &text)
+{
+    return SplitLines(text.data(), text.size()).size();
+}
+
+// Mirrors the original GotoDlgProc loop.
+static uint64_t GotoLoop(const std::u16string &text, int line)
+{
+    int current = 1;
+    size_t pos = 0;
+    for (size_t i = 0; i < text.size() && current < line; ++i)
+        if (text[i] == u'\n')
+        {
+            ++current;
+            pos = i + 1;
+        }
+    return current < line ? text.size() : pos;
+}
+
+void RunScanBench(const BenchOptions &opts)
+{
+    size_t bytes = opts.sizeMB << 20;
+    for (const char *kind : {"ascii", "mixed"})
+    {
+        std::string corpus = MakeCorpus(kind, bytes);
+        std::u16string text(MaxDecodedLength(corpus.size()), u'\0');
+        text.resize(DecodeUtf8(reinterpret_cast<const uint8_t *>(corpus.data()), corpus.size(), &text[0], true).written);
+        std::string().swap(corpus);
+        std::u16string missing = u"NeedleThatIsNotThere";
+        // Find Next from a caret halfway down to a match three quarters of the way in
+        std::u16string needle = u"needlethatisthere";
+        std::u16string next = text;
+        std::copy(needle.begin(), needle.end(), next.begin() + next.size() / 4 * 3);
+        auto upper = [](char16_t c)
+        { return static_cast<char16_t>(c - u'a' + u'A'); };
+        std::transform(needle.begin(), needle.end(), needle.begin(), upper);
+        int lastLine = static_cast<int>(SplitSpans(text));
+        size_t units = text.size() * sizeof(char16_t);
+        PrintResult("scan", std::string("find/lower-copy/") + kind, units, RunIsolated([&]
+                                                                                      { return FindLowerCopy(text, missing); }));
+        PrintResult("scan", std::string("find/core/") + kind, units, RunIsolated([&]
+                                                                                { return FindCore(text, missing); }));
+        PrintResult("scan", std::string("find-next/lower-copy/") + kind, units, RunIsolated([&]
+                                                                                           { return FindLowerCopy(next, needle, next.size() / 2); }));
+        PrintResult("scan", std::string("find-next/core/") + kind, units, RunIsolated([&]
+                                                                                     { return FindCore(next, needle, next.size() / 2); }));
+        PrintResult("scan", std::string("split/strings/") + kind, units, RunIsolated([&]
+                                                                                    { return SplitStrings(text); }));
+        PrintResult("scan", std::string("split/spans/") + kind, units, RunIsolated([&]
+                                                                                  { return SplitSpans(text); }));
+        PrintResult("scan", std::string("goto/loop/") + kind, units, RunIsolated([&]
+                                                                                { return GotoLoop(text, lastLine); }));
+        PrintResult("scan", std::string("goto/core/") + kind, units, RunIsolated([&]
+                                                                                { return LineStartOffset(text.data(), text.size(), static_cast<size_t>(lastLine)); }));
+    }
+}
@@ -0,0 +1,110 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  UTF-16 benchmarks: the original per-unit append/push_back loops versus the
+  byte-swap kernels at each SIMD dispatch level, for UTF-16BE open and save.
+*/
+
+#include "bench.h"
+#include "core/cpu.h"
+#include "core/textcodec.h"
+#include <string>
+#include <vector>
+
+// Mirrors the original DecodeText UTF-16BE branch.
+static uint64_t DecodeAppend(const std::vector<uint8_t> &data)
+{
+    std::u16string result;
+    for (size_t i = 2; i + 1 < data.size(); i += 2)
+        result += static_cast<char16_t>((data[i] << 8) | data[i + 1]);
+    return Checksum(result.data(), result.size() * sizeof(char16_t));
+}
+
+static uint64_t DecodeSwap(const std::vector<uint8_t> &data, SimdLevel level)
+{
+    ForceSimdLevel(level);
+    std::u16string result(MaxDecodedLength(data.size() - 2), u'\0');
+    DecodeResult r = DecodeChunk(Encoding::UTF16BE, data.data() + 2, data.size() - 2, &result[0], true);
+    return Checksum(result.data(), r.written * sizeof(char16_t));
+}
+
+// Mirrors the original EncodeText: normalized copy, then two push_back calls per unit.
+static uint64_t EncodePushBack(const std::u16string &text)
+{
+    std::u16string converted;
+    converted.reserve(text.size() + text.size() / 10);
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char16_t c = text[i];
+        if (c == u'\r' || c == u'\n')
+        {
+            if (c == u'\r' && i + 1 < text.size() && text[i + 1] == u'\n')
+                ++i;
+            converted += u'\n';
+        }
+        else
+            converted += c;
+    }
+    std::vector<uint8_t> result;
+    result.push_back(0xFE);
+    result.push_back(0xFF);
+    result.reserve(result.size() + converted.size() * 2);
+    for (char16_t c : converted)
+    {
+        result.push_back(static_cast<uint8_t>((c >> 8) & 0xFF));
+        result.push_back(static_cast<uint8_t>(c & 0xFF));
+    }
+    return Checksum(result.data(), result.size());
+}
+
+static uint64_t EncodeSwap(const std::u16string &text, SimdLevel level)
+{
+    ForceSimdLevel(level);
+    std::vector<uint8_t> result(2 + MaxEncodedLength(Encoding::UTF16BE, text.size()));
+    size_t bom = EncodeBom(Encoding::UTF16BE, result.data());
+    EncodeResult r = EncodeChunk(Encoding::UTF16BE, LineEnding::LF, text.data(), text.size(), result.data() + bom, true);
+    return Checksum(result.data(), bom + r.written);
+}
+
+void RunUtf16Bench(const BenchOptions &opts)
+{
+    size_t bytes = opts.sizeMB << 20;
+    SimdLevel best = DetectSimdLevel();
+    for (const char *kind : {"ascii", "cjk"})
+    {
+        std::string corpus = MakeCorpus(kind, bytes / 2);
+        std::u16string text(MaxDecodedLength(corpus.size()), u'\0');
+        text.resize(DecodeUtf8(reinterpret_cast<const uint8_t *>(corpus.data()), corpus.size(), &text[0], true).written);
+        std::vector<uint8_t> be(2 + text.size() * 2);
+        EncodeBom(Encoding::UTF16BE, be.data());
+        CopyUtf16Units(reinterpret_cast<const uint8_t *>(text.data()), be.data() + 2, text.size(), true);
+        size_t size = be.size();
+        PrintResult("utf16", std::string("decode-be/append/") + kind, size, RunIsolated([&]
+                                                                                       { return DecodeAppend(be); }));
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::SSSE3, SimdLevel::AVX2})
+        {
+            if (level > best)
+                continue;
+            PrintResult("utf16", std::string("decode-be/") + SimdLevelName(level) + "/" + kind, size, RunIsolated([&]
+                                                                                                              { return DecodeSwap(be, level); }));
+        }
+        PrintResult("utf16", std::string("encode-be/push_back/") + kind, size, RunIsolated([&]
+                                                                                          { return EncodePushBack(text); }));
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::SSSE3, SimdLevel::AVX2})
+        {
+            if (level > best)
+                continue;
+            PrintResult("utf16", std::string("encode-be/") + SimdLevelName(level) + "/" + kind, size, RunIsolated([&]
+                                                                                                              { return EncodeSwap(text, level); }));
+        }
+    }
+    ForceSimdLevel(SimdLevel::AVX2);
+}
@@ -0,0 +1,94 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  UTF-8 benchmarks: the validate/size/convert three-pass path versus the fused
+  single-pass decoder at each SIMD dispatch level.
+*/
+
+#include "bench.h"
+#include "core/cpu.h"
+#include "core/textcodec.h"
+#include <string>
+
+// Sizing pass of the old path (MultiByteToWideChar with a null output buffer).
+static size_t CountUtf16Units(const uint8_t *data, size_t size)
+{
+    size_t units = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        if ((data[i] & 0xC0) != 0x80)
+            ++units;
+        if (data[i] >= 0xF0)
+            ++units;
+    }
+    return units;
+}
+
+// Mirrors the original DetectEncoding + DecodeText: a validation pass whose result is
+// discarded, a pass to size the output, then the conversion itself.
+static uint64_t DecodeThreePass(const std::string &corpus)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(corpus.data());
+    ForceSimdLevel(SimdLevel::Scalar);
+    bool invalid = false;
+    if (Utf8ValidPrefix(data, corpus.size(), invalid) < corpus.size())
+        return 0;
+    std::u16string text(CountUtf16Units(data, corpus.size()), u'\0');
+    DecodeResult r = DecodeUtf8(data, corpus.size(), &text[0], true);
+    return Checksum(text.data(), r.written * sizeof(char16_t));
+}
+
+static uint64_t DecodeFused(const std::string &corpus, SimdLevel level)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(corpus.data());
+    ForceSimdLevel(level);
+    std::u16string text(MaxDecodedLength(corpus.size()), u'\0');
+    DecodeResult r = DecodeUtf8(data, corpus.size(), &text[0], true);
+    if (r.invalid)
+        return 0;
+    return Checksum(text.data(), r.written * sizeof(char16_t));
+}
+
+static uint64_t Validate(const std::string &corpus, SimdLevel level)
+{
+    ForceSimdLevel(level);
+    bool invalid = false;
+    return Utf8ValidPrefix(reinterpret_cast<const uint8_t *>(corpus.data()), corpus.size(), invalid);
+}
+
+void RunUtf8Bench(const BenchOptions &opts)
+{
+    size_t bytes = opts.sizeMB << 20;
+    SimdLevel best = DetectSimdLevel();
+    for (const char *kind : {"ascii", "cjk", "mixed"})
+    {
+        std::string corpus = MakeCorpus(kind, bytes);
+        PrintResult("utf8", std::string("decode/three-pass/") + kind, bytes, RunIsolated([&]
+                                                                                        { return DecodeThreePass(corpus); }));
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2})
+        {
+            if (level > best)
+                continue;
+            std::string name = std::string("decode/fused-") + SimdLevelName(level) + "/" + kind;
+            PrintResult("utf8", name, bytes, RunIsolated([&]
+                                                         { return DecodeFused(corpus, level); }));
+        }
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2})
+        {
+            if (level > best)
+                continue;
+            std::string name = std::string("validate/") + SimdLevelName(level) + "/" + kind;
+            PrintResult("utf8", name, bytes, RunIsolated([&]
+                                                         { return Validate(corpus, level); }));
+        }
+    }
+    ForceSimdLevel(SimdLevel::AVX2);
+}
@@ -0,0 +1,80 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Large file viewer benchmarks: decoding the whole file up front, as the RichEdit path
+  must, against building the sparse line index and decoding one screen of lines.
+*/
+
+#include "bench.h"
+#include "core/lineindex.h"
+#include "core/textcodec.h"
+#include <algorithm>
+#include <string>
+
+#define SCREEN_LINES 60
+
+static uint64_t DecodeWhole(const std::string &data)
+{
+    std::u16string text(MaxDecodedLength(data.size()), u'\0');
+    DecodeResult r = DecodeChunk(Encoding::UTF8, reinterpret_cast<const uint8_t *>(data.data()), data.size(), &text[0], true);
+    return Checksum(text.data(), r.written * sizeof(char16_t));
+}
+
+static uint64_t IndexOnly(const std::string &data)
+{
+    const uint8_t *file = reinterpret_cast<const uint8_t *>(data.data());
+    LineIndex index;
+    InitLineIndex(index, Encoding::UTF8, 0);
+    for (uint64_t end = 0; end < data.size();)
+    {
+        end = std::min<uint64_t>(end + (16u << 20), data.size());
+        ExtendLineIndex(index, file, end);
+    }
+    FinishLineIndex(index);
+    return index.lineCount;
+}
+
+// Builds the index, then decodes one screen at the middle of the file as Go To would.
+static uint64_t IndexAndScreen(const std::string &data)
+{
+    const uint8_t *file = reinterpret_cast<const uint8_t *>(data.data());
+    LineIndex index;
+    InitLineIndex(index, Encoding::UTF8, 0);
+    ExtendLineIndex(index, file, data.size());
+    FinishLineIndex(index);
+    std::u16string line;
+    uint64_t sum = 0;
+    uint64_t start = LineStartByte(index, file, data.size(), index.lineCount / 2);
+    for (int row = 0; row < SCREEN_LINES && start != LINE_NPOS; ++row)
+    {
+        uint64_t end = LineEndByte(Encoding::UTF8, file, data.size(), start, data.size());
+        line.resize(MaxDecodedLength(static_cast<size_t>(end - start)));
+        DecodeResult r = DecodeChunk(Encoding::UTF8, file + start, static_cast<size_t>(end - start), &line[0], true);
+        sum += Checksum(line.data(), r.written * sizeof(char16_t));
+        start = SkipLineBreak(Encoding::UTF8, file, data.size(), end);
+    }
+    return sum;
+}
+
+void RunViewerBench(const BenchOptions &opts)
+{
+    size_t bytes = opts.sizeMB << 20;
+    for (const char *kind : {"ascii", "mixed"})
+    {
+        std::string data = MakeCorpus(kind, bytes);
+        PrintResult("viewer", std::string("decode-whole/") + kind, data.size(), RunIsolated([&]
+                                                                                            { return DecodeWhole(data); }));
+        PrintResult("viewer", std::string("index/") + kind, data.size(), RunIsolated([&]
+                                                                                     { return IndexOnly(data); }));
+        PrintResult("viewer", std::string("index+screen/") + kind, data.size(), RunIsolated([&]
+                                                                                            { return IndexAndScreen(data); }));
+    }
+}
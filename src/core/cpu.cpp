@@ -0,0 +1,90 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  CPU feature detection and runtime SIMD dispatch helpers for the portable core.
+  Kernels are compiled per instruction set and selected once from CPUID.
+*/
+
+#include "cpu.h"
+
+#if defined(NOTEPAD_X86) && defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+static SimdLevel g_forcedLevel = SimdLevel::AVX2;
+
+static SimdLevel QueryCpu()
+{
+    SimdLevel level = SimdLevel::Scalar;
+#if defined(NOTEPAD_X86) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4] = {};
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    if (sse2)
+        level = SimdLevel::SSE2;
+    if (sse2 && ssse3)
+        level = SimdLevel::SSSE3;
+    if (sse2 && ssse3 && avx2)
+        level = SimdLevel::AVX2;
+#elif defined(NOTEPAD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        level = SimdLevel::SSE2;
+    if (level == SimdLevel::SSE2 && __builtin_cpu_supports("ssse3"))
+        level = SimdLevel::SSSE3;
+    if (level == SimdLevel::SSSE3 && __builtin_cpu_supports("avx2"))
+        level = SimdLevel::AVX2;
+#endif
+    return level;
+}
+
+SimdLevel DetectSimdLevel()
+{
+    static const SimdLevel level = QueryCpu();
+    return level;
+}
+
+SimdLevel ActiveSimdLevel()
+{
+    SimdLevel level = DetectSimdLevel();
+    return static_cast<int>(g_forcedLevel) < static_cast<int>(level) ? g_forcedLevel : level;
+}
+
+void ForceSimdLevel(SimdLevel level)
+{
+    g_forcedLevel = level;
+}
+
+const char *SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SSE2:
+        return "sse2";
+    case SimdLevel::SSSE3:
+        return "ssse3";
+    case SimdLevel::AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,69 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  CPU feature detection and runtime SIMD dispatch helpers for the portable core.
+  Kernels are compiled per instruction set and selected once from CPUID.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NOTEPAD_X86 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define NOTEPAD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NOTEPAD_TARGET(isa)
+#endif
+
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    SSSE3,
+    AVX2
+};
+
+SimdLevel DetectSimdLevel();
+SimdLevel ActiveSimdLevel();
+// Caps dispatch at level (never above what the CPU supports); used by benchmarks.
+void ForceSimdLevel(SimdLevel level);
+const char *SimdLevelName(SimdLevel level);
+
+inline unsigned CountTrailingZeros(uint32_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Index of the highest set bit; mask must not be zero.
+inline unsigned HighestSetBit(uint32_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index = 0;
+    _BitScanReverse(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return 31u - static_cast<unsigned>(__builtin_clz(mask));
+#endif
+}
@@ -0,0 +1,179 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Record format of the edit journal used for crash recovery and hot exit.
+  Records are built in memory by the UI thread and written out in batches by the caller.
+*/
+
+#include "editjournal.h"
+#include <cstring>
+
+static void PutU32(uint8_t *o, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        o[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static void PutU64(uint8_t *o, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i)
+        o[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static uint32_t GetU32(const uint8_t *p)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i)
+        v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static uint64_t GetU64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i)
+        v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+// FNV-1a over 8-byte words so checksumming a snapshot is not the slow part of writing it.
+static uint32_t RecordChecksum(const uint8_t *p, size_t size)
+{
+    uint64_t h = 1469598103934665603ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 1099511628211ull;
+    }
+    for (; i < size; ++i)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// Reserves the record header and the fixed fields; the caller fills in the rest, then
+// SealRecord writes the size and checksum.
+static uint8_t *BeginRecord(std::vector<uint8_t> &out, JournalRecordType type, size_t fixed, size_t units, size_t &start)
+{
+    start = out.size();
+    out.resize(start + JOURNAL_RECORD_HEADER + 1 + fixed + units * 2);
+    uint8_t *p = out.data() + start + JOURNAL_RECORD_HEADER;
+    p[0] = static_cast<uint8_t>(type);
+    return p + 1;
+}
+
+static void SealRecord(std::vector<uint8_t> &out, size_t start)
+{
+    uint8_t *p = out.data() + start;
+    size_t payload = out.size() - start - JOURNAL_RECORD_HEADER;
+    PutU32(p, static_cast<uint32_t>(payload));
+    PutU32(p + 4, RecordChecksum(p + JOURNAL_RECORD_HEADER, payload));
+}
+
+// Text is stored in host order, which is little-endian on every Windows target.
+static void PutText(uint8_t *o, const char16_t *text, size_t length)
+{
+    if (length)
+        memcpy(o, text, length * 2);
+}
+
+void AppendJournalHeader(std::vector<uint8_t> &out)
+{
+    size_t start = out.size();
+    out.resize(start + JOURNAL_HEADER_SIZE);
+    PutU32(out.data() + start, JOURNAL_MAGIC);
+}
+
+void AppendJournalDocument(std::vector<uint8_t> &out, const char16_t *path, size_t pathLength, Encoding encoding,
+                           LineEnding lineEnding, uint64_t fileSize, uint64_t fileTime)
+{
+    size_t start;
+    uint8_t *p = BeginRecord(out, JournalRecordType::Document, 18, pathLength, start);
+    p[0] = static_cast<uint8_t>(encoding);
+    p[1] = static_cast<uint8_t>(lineEnding);
+    PutU64(p + 2, fileSize);
+    PutU64(p + 10, fileTime);
+    PutText(p + 18, path, pathLength);
+    SealRecord(out, start);
+}
+
+void AppendJournalSnapshot(std::vector<uint8_t> &out, const char16_t *text, size_t length)
+{
+    size_t start;
+    uint8_t *p = BeginRecord(out, JournalRecordType::Snapshot, 0, length, start);
+    PutText(p, text, length);
+    SealRecord(out, start);
+}
+
+void AppendJournalEdit(std::vector<uint8_t> &out, uint64_t offset, uint64_t removed, const char16_t *text, size_t length)
+{
+    size_t start;
+    uint8_t *p = BeginRecord(out, JournalRecordType::Edit, 16, length, start);
+    PutU64(p, offset);
+    PutU64(p + 8, removed);
+    PutText(p + 16, text, length);
+    SealRecord(out, start);
+}
+
+bool CheckJournalHeader(const uint8_t *data, size_t size)
+{
+    return size >= JOURNAL_HEADER_SIZE && GetU32(data) == JOURNAL_MAGIC;
+}
+
+size_t ReadJournalRecord(const uint8_t *data, size_t size, JournalRecord &record)
+{
+    if (size < JOURNAL_RECORD_HEADER + 1)
+        return 0;
+    size_t payload = GetU32(data);
+    if (payload < 1 || payload > size - JOURNAL_RECORD_HEADER)
+        return 0;
+    const uint8_t *p = data + JOURNAL_RECORD_HEADER;
+    if (RecordChecksum(p, payload) != GetU32(data + 4))
+        return 0;
+    size_t fixed = 0;
+    record.type = static_cast<JournalRecordType>(p[0]);
+    switch (record.type)
+    {
+    case JournalRecordType::Document:
+        fixed = 18;
+        break;
+    case JournalRecordType::Snapshot:
+        break;
+    case JournalRecordType::Edit:
+        fixed = 16;
+        break;
+    default:
+        return 0;
+    }
+    if (payload - 1 < fixed || (payload - 1 - fixed) % 2)
+        return 0;
+    const uint8_t *f = p + 1;
+    if (record.type == JournalRecordType::Document)
+    {
+        if (f[0] > static_cast<uint8_t>(Encoding::ANSI) || f[1] > static_cast<uint8_t>(LineEnding::CR))
+            return 0;
+        record.encoding = static_cast<Encoding>(f[0]);
+        record.lineEnding = static_cast<LineEnding>(f[1]);
+        record.fileSize = GetU64(f + 2);
+        record.fileTime = GetU64(f + 10);
+    }
+    else if (record.type == JournalRecordType::Edit)
+    {
+        record.offset = GetU64(f);
+        record.removed = GetU64(f + 8);
+    }
+    size_t units = (payload - 1 - fixed) / 2;
+    record.text.resize(units);
+    if (units)
+        memcpy(&record.text[0], f + fixed, units * 2);
+    return JOURNAL_RECORD_HEADER + payload;
+}
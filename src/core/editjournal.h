@@ -0,0 +1,59 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Record format of the edit journal used for crash recovery and hot exit.
+  Each record is length-prefixed and checksummed so a torn write at a crash ends replay cleanly.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "textcodec.h"
+
+#define JOURNAL_MAGIC 0x314A4E4Cu
+#define JOURNAL_HEADER_SIZE 4
+#define JOURNAL_RECORD_HEADER 8
+
+// Offsets and lengths count UTF-16 units of the editor text. A Document record names the
+// file the following records apply to; a Snapshot replaces the text outright.
+enum class JournalRecordType : uint8_t
+{
+    Document = 1,
+    Snapshot = 2,
+    Edit = 3
+};
+
+struct JournalRecord
+{
+    JournalRecordType type = JournalRecordType::Edit;
+    uint64_t offset = 0;
+    uint64_t removed = 0;
+    uint64_t fileSize = 0;
+    uint64_t fileTime = 0;
+    Encoding encoding = Encoding::UTF8;
+    LineEnding lineEnding = LineEnding::CRLF;
+    std::u16string text;
+};
+
+void AppendJournalHeader(std::vector<uint8_t> &out);
+void AppendJournalDocument(std::vector<uint8_t> &out, const char16_t *path, size_t pathLength, Encoding encoding,
+                           LineEnding lineEnding, uint64_t fileSize, uint64_t fileTime);
+void AppendJournalSnapshot(std::vector<uint8_t> &out, const char16_t *text, size_t length);
+// Replaces removed units at offset with text.
+void AppendJournalEdit(std::vector<uint8_t> &out, uint64_t offset, uint64_t removed, const char16_t *text, size_t length);
+
+bool CheckJournalHeader(const uint8_t *data, size_t size);
+// Parses the record at data and returns its size, or 0 at the end of the journal or at the
+// first torn or corrupt record.
+size_t ReadJournalRecord(const uint8_t *data, size_t size, JournalRecord &record);
@@ -17,6 +17,7 @@
 
 HWND g_hwndMain = nullptr;
 HWND g_hwndEditor = nullptr;
+HWND g_hwndViewer = nullptr;
 HWND g_hwndStatus = nullptr;
 HWND g_hwndFindDlg = nullptr;
 HACCEL g_hAccel = nullptr;
@@ -24,11 +25,10 @@ AppState g_state;
 WNDPROC g_origEditorProc = nullptr;
 WNDPROC g_origStatusProc = nullptr;
 ULONG_PTR g_gdiplusToken = 0;
-Gdiplus::Image *g_bgImage = nullptr;
 HBITMAP g_bgBitmap = nullptr;
 int g_bgBitmapW = 0;
 int g_bgBitmapH = 0;
 HBRUSH g_hbrStatusDark = nullptr;
 HBRUSH g_hbrMenuDark = nullptr;
 PAGESETUPDLGW g_pageSetup = {sizeof(g_pageSetup)};
-std::wstring g_statusTexts[4];
+wchar_t g_statusTexts[STATUS_PART_COUNT][STATUS_TEXT_MAX];
@@ -22,6 +22,7 @@
 
 extern HWND g_hwndMain;
 extern HWND g_hwndEditor;
+extern HWND g_hwndViewer;
 extern HWND g_hwndStatus;
 extern HWND g_hwndFindDlg;
 extern HACCEL g_hAccel;
@@ -29,11 +30,10 @@ extern AppState g_state;
 extern WNDPROC g_origEditorProc;
 extern WNDPROC g_origStatusProc;
 extern ULONG_PTR g_gdiplusToken;
-extern Gdiplus::Image *g_bgImage;
 extern HBITMAP g_bgBitmap;
 extern int g_bgBitmapW;
 extern int g_bgBitmapH;
 extern HBRUSH g_hbrStatusDark;
 extern HBRUSH g_hbrMenuDark;
 extern PAGESETUPDLGW g_pageSetup;
-extern std::wstring g_statusTexts[4];
+extern wchar_t g_statusTexts[STATUS_PART_COUNT][STATUS_TEXT_MAX];
@@ -0,0 +1,252 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Sparse line-offset index built incrementally from a mapped file.
+  Scans for CR/LF in the file's own encoding without decoding the text.
+*/
+
+#include "lineindex.h"
+#include <algorithm>
+#include <cstring>
+
+template <int W, bool BE>
+static inline uint32_t UnitAt(const uint8_t *p)
+{
+    if (W == 1)
+        return p[0];
+    return BE ? (static_cast<uint32_t>(p[0]) << 8 | p[1]) : (p[0] | static_cast<uint32_t>(p[1]) << 8);
+}
+
+// First offset in [p, to) holding a byte up to CR, or to. Skips eight bytes at a time while
+// none of them is below 0x0E.
+static inline uint64_t SkipPlainBytes(const uint8_t *file, uint64_t p, uint64_t to)
+{
+    uint64_t word;
+    while (p + 8 <= to)
+    {
+        memcpy(&word, file + p, 8);
+        if ((word - 0x0E0E0E0E0E0E0E0Eull) & ~word & 0x8080808080808080ull)
+            break;
+        p += 8;
+    }
+    while (p < to && file[p] > '\r')
+        ++p;
+    return p;
+}
+
+// Calls onLine with the start offset of every line that begins in [from, to). A CR at the
+// end of the range stays pending until the next unit shows whether it is part of a CRLF.
+// Stops early and returns false when onLine does.
+template <int W, bool BE, typename OnLine>
+static bool ScanUnits(const uint8_t *file, uint64_t from, uint64_t to, bool &pendingCR, OnLine &onLine)
+{
+    uint64_t p = from;
+    while (p + W <= to)
+    {
+        if (W == 1 && !pendingCR)
+        {
+            p = SkipPlainBytes(file, p, to);
+            if (p >= to)
+                break;
+        }
+        uint32_t u = UnitAt<W, BE>(file + p);
+        if (pendingCR)
+        {
+            pendingCR = false;
+            if (u == '\n')
+            {
+                p += W;
+                if (!onLine(p))
+                    return false;
+                continue;
+            }
+            if (!onLine(p))
+                return false;
+        }
+        p += W;
+        if (u == '\r')
+            pendingCR = true;
+        else if (u == '\n' && !onLine(p))
+            return false;
+    }
+    return true;
+}
+
+template <typename OnLine>
+static bool ScanLines(Encoding encoding, const uint8_t *file, uint64_t from, uint64_t to, bool &pendingCR, OnLine onLine)
+{
+    switch (encoding)
+    {
+    case Encoding::UTF16LE:
+        return ScanUnits<2, false>(file, from, to, pendingCR, onLine);
+    case Encoding::UTF16BE:
+        return ScanUnits<2, true>(file, from, to, pendingCR, onLine);
+    default:
+        return ScanUnits<1, false>(file, from, to, pendingCR, onLine);
+    }
+}
+
+static inline uint64_t UnitSize(Encoding encoding)
+{
+    return (encoding == Encoding::UTF16LE || encoding == Encoding::UTF16BE) ? 2 : 1;
+}
+
+static inline uint32_t UnitAtOffset(Encoding encoding, const uint8_t *file, uint64_t p)
+{
+    switch (encoding)
+    {
+    case Encoding::UTF16LE:
+        return UnitAt<2, false>(file + p);
+    case Encoding::UTF16BE:
+        return UnitAt<2, true>(file + p);
+    default:
+        return file[p];
+    }
+}
+
+static inline void AddLine(LineIndex &index, uint64_t start)
+{
+    if (index.lineCount % LINE_INDEX_STRIDE == 0)
+    {
+        index.checkpoints.push_back(start);
+        index.anchor = start;
+    }
+    else if (start - index.anchor >= LINE_INDEX_MARK_BYTES)
+    {
+        index.marks.push_back({index.lineCount, start});
+        index.anchor = start;
+    }
+    ++index.lineCount;
+}
+
+void InitLineIndex(LineIndex &index, Encoding encoding, uint64_t start)
+{
+    index = LineIndex();
+    index.encoding = encoding;
+    index.indexed = start;
+    index.anchor = start;
+    index.checkpoints.push_back(start);
+}
+
+void ExtendLineIndex(LineIndex &index, const uint8_t *file, uint64_t end)
+{
+    if (end <= index.indexed)
+        return;
+    auto onLine = [&](uint64_t start)
+    {
+        AddLine(index, start);
+        return true;
+    };
+    ScanLines(index.encoding, file, index.indexed, end, index.pendingCR, onLine);
+    index.indexed = end;
+}
+
+void FinishLineIndex(LineIndex &index)
+{
+    if (index.pendingCR)
+        AddLine(index, index.indexed);
+    index.pendingCR = false;
+    index.complete = true;
+}
+
+uint64_t LineStartByte(const LineIndex &index, const uint8_t *file, uint64_t size, uint64_t line)
+{
+    if (index.checkpoints.empty() || (index.complete && line >= index.lineCount))
+        return LINE_NPOS;
+    size_t k = static_cast<size_t>((std::min)(line / LINE_INDEX_STRIDE, static_cast<uint64_t>(index.checkpoints.size() - 1)));
+    uint64_t current = static_cast<uint64_t>(k) * LINE_INDEX_STRIDE;
+    uint64_t found = index.checkpoints[k];
+    auto mark = std::upper_bound(index.marks.begin(), index.marks.end(), line,
+                                 [](uint64_t l, const LineMark &m) { return l < m.line; });
+    if (mark != index.marks.begin() && (mark - 1)->line > current)
+    {
+        current = (mark - 1)->line;
+        found = (mark - 1)->start;
+    }
+    if (current == line)
+        return found;
+    bool pendingCR = false;
+    auto onLine = [&](uint64_t start)
+    {
+        found = start;
+        return ++current < line;
+    };
+    if (!ScanLines(index.encoding, file, found, size, pendingCR, onLine))
+        return found;
+    return (pendingCR && current + 1 == line) ? size : LINE_NPOS;
+}
+
+uint64_t LineAtByte(const LineIndex &index, const uint8_t *file, uint64_t size, uint64_t offset)
+{
+    if (index.checkpoints.empty())
+        return 0;
+    auto it = std::upper_bound(index.checkpoints.begin(), index.checkpoints.end(), offset);
+    if (it == index.checkpoints.begin())
+        return 0;
+    size_t k = static_cast<size_t>(it - index.checkpoints.begin() - 1);
+    uint64_t line = static_cast<uint64_t>(k) * LINE_INDEX_STRIDE;
+    uint64_t from = index.checkpoints[k];
+    auto mark = std::upper_bound(index.marks.begin(), index.marks.end(), offset,
+                                 [](uint64_t o, const LineMark &m) { return o < m.start; });
+    if (mark != index.marks.begin() && (mark - 1)->start > from)
+    {
+        line = (mark - 1)->line;
+        from = (mark - 1)->start;
+    }
+    offset = (std::min)(offset, size);
+    bool pendingCR = false;
+    auto onLine = [&](uint64_t)
+    {
+        ++line;
+        return true;
+    };
+    ScanLines(index.encoding, file, from, offset, pendingCR, onLine);
+    // A CR just before offset starts a new line unless offset is the LF of a CRLF
+    if (pendingCR && (offset + UnitSize(index.encoding) > size || UnitAtOffset(index.encoding, file, offset) != '\n'))
+        ++line;
+    return line;
+}
+
+uint64_t LineEndByte(Encoding encoding, const uint8_t *file, uint64_t size, uint64_t start, uint64_t limit)
+{
+    uint64_t w = UnitSize(encoding);
+    uint64_t to = (std::min)(limit, size);
+    if (w == 1)
+    {
+        uint64_t p = start;
+        while ((p = SkipPlainBytes(file, p, to)) < to)
+        {
+            if (file[p] == '\r' || file[p] == '\n')
+                return p;
+            ++p;
+        }
+    }
+    else
+    {
+        for (uint64_t p = start; p + w <= to; p += w)
+        {
+            uint32_t u = UnitAtOffset(encoding, file, p);
+            if (u == '\r' || u == '\n')
+                return p;
+        }
+    }
+    return to == size ? size : LINE_NPOS;
+}
+
+uint64_t SkipLineBreak(Encoding encoding, const uint8_t *file, uint64_t size, uint64_t end)
+{
+    uint64_t w = UnitSize(encoding);
+    if (end + w > size)
+        return LINE_NPOS;
+    if (UnitAtOffset(encoding, file, end) == '\r' && end + 2 * w <= size && UnitAtOffset(encoding, file, end + w) == '\n')
+        return end + 2 * w;
+    return end + w;
+}
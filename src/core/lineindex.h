@@ -0,0 +1,66 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Sparse line-offset index over an encoded file for the large-file viewer.
+  Records the byte offset of every LINE_INDEX_STRIDE-th line so lookups stay bounded.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "textcodec.h"
+
+#define LINE_INDEX_STRIDE 1024
+// A line starting this many bytes past the last checkpoint or mark is marked as well, so no
+// lookup scans much further than this from where it starts, however long the lines are
+#define LINE_INDEX_MARK_BYTES (1u << 20)
+#define LINE_NPOS (~static_cast<uint64_t>(0))
+
+struct LineMark
+{
+    uint64_t line;
+    uint64_t start;
+};
+
+// Line breaks are CRLF, CR or LF, as in SplitLines. Offsets are bytes from the start of the
+// file; UTF-16 offsets stay on code unit boundaries. Checkpoints hold the start of every
+// LINE_INDEX_STRIDE-th line and marks the lines after long stretches without one.
+struct LineIndex
+{
+    Encoding encoding = Encoding::UTF8;
+    uint64_t lineCount = 1;
+    uint64_t indexed = 0;
+    // Start of the last checkpoint or mark
+    uint64_t anchor = 0;
+    bool pendingCR = false;
+    bool complete = false;
+    std::vector<uint64_t> checkpoints;
+    std::vector<LineMark> marks;
+};
+
+// Starts an empty index whose first line begins at start (after the BOM).
+void InitLineIndex(LineIndex &index, Encoding encoding, uint64_t start);
+// Indexes file bytes [index.indexed, end). Can be called repeatedly with a growing end.
+void ExtendLineIndex(LineIndex &index, const uint8_t *file, uint64_t end);
+// Resolves a CR left at the end of the last ExtendLineIndex call once the file is done.
+void FinishLineIndex(LineIndex &index);
+
+// Lookups work from the nearest checkpoint and scan the file past index.indexed when the
+// index is still being built. Lines are 0-based.
+uint64_t LineStartByte(const LineIndex &index, const uint8_t *file, uint64_t size, uint64_t line);
+uint64_t LineAtByte(const LineIndex &index, const uint8_t *file, uint64_t size, uint64_t offset);
+// Offset of the CR or LF ending the line that starts at start, or size for the last line.
+// Only bytes before limit are looked at; LINE_NPOS when the line runs on past it.
+uint64_t LineEndByte(Encoding encoding, const uint8_t *file, uint64_t size, uint64_t start, uint64_t limit);
+// Start of the line after the break at end, or LINE_NPOS when end is the end of the file.
+uint64_t SkipLineBreak(Encoding encoding, const uint8_t *file, uint64_t size, uint64_t end);
@@ -0,0 +1,246 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Find All match set: blocks of sorted starts with binary search over the blocks and inside
+  them, and the edit update that searches again only until the match chain is back in step.
+*/
+
+#include "matchset.h"
+#include "piecetable.h"
+#include "textregex.h"
+#include <algorithm>
+#include <iterator>
+
+void ClearMatches(MatchSet &set)
+{
+    set.blocks.clear();
+    set.firsts.clear();
+    set.count = 0;
+}
+
+static void CountMatches(MatchSet &set)
+{
+    set.firsts.resize(set.blocks.size());
+    size_t count = 0;
+    for (size_t b = 0; b < set.blocks.size(); ++b)
+    {
+        set.firsts[b] = count;
+        count += set.blocks[b].starts.size();
+    }
+    set.count = count;
+}
+
+// A new block is opened once the last one holds limit matches or the start would not fit in
+// 32 bits from its base.
+static void PushMatch(std::vector<MatchBlock> &blocks, const TextSpan &match, size_t limit)
+{
+    if (blocks.empty() || blocks.back().starts.size() >= limit || match.start - blocks.back().base > UINT32_MAX)
+    {
+        blocks.emplace_back();
+        blocks.back().base = match.start;
+    }
+    MatchBlock &block = blocks.back();
+    block.starts.push_back(static_cast<uint32_t>(match.start - block.base));
+    block.lengths.push_back(static_cast<uint32_t>(match.length));
+}
+
+void AppendMatches(MatchSet &set, const TextSpan *matches, size_t count)
+{
+    if (!count)
+        return;
+    for (size_t i = 0; i < count; ++i)
+        PushMatch(set.blocks, matches[i], MATCH_BLOCK_MAX);
+    CountMatches(set);
+}
+
+// First index in [0, count) for which before(index) is false; before holds up to it and not
+// after.
+template <typename Before>
+static size_t FirstNotBefore(size_t count, Before before)
+{
+    size_t lo = 0, hi = count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (before(mid))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// The block holding index; the last block for the index one past the end.
+static size_t BlockOf(const MatchSet &set, size_t index)
+{
+    if (index >= set.count)
+        return set.blocks.size() - 1;
+    return static_cast<size_t>(std::upper_bound(set.firsts.begin(), set.firsts.end(), index) - set.firsts.begin()) - 1;
+}
+
+static TextSpan BlockMatch(const MatchBlock &block, size_t k)
+{
+    TextSpan match;
+    match.start = block.base + block.starts[k];
+    match.length = block.lengths[k];
+    return match;
+}
+
+TextSpan MatchAt(const MatchSet &set, size_t index)
+{
+    size_t b = BlockOf(set, index);
+    return BlockMatch(set.blocks[b], index - set.firsts[b]);
+}
+
+size_t MatchIndexAt(const MatchSet &set, size_t offset)
+{
+    auto blockBefore = [&](size_t b) { return BlockMatch(set.blocks[b], set.blocks[b].starts.size() - 1).start < offset; };
+    size_t b = FirstNotBefore(set.blocks.size(), blockBefore);
+    if (b == set.blocks.size())
+        return set.count;
+    const MatchBlock &block = set.blocks[b];
+    return set.firsts[b] + FirstNotBefore(block.starts.size(), [&](size_t k) { return BlockMatch(block, k).start < offset; });
+}
+
+// Matches do not overlap, so their ends are in order as well.
+size_t MatchIndexEndingAfter(const MatchSet &set, size_t offset)
+{
+    auto endsBy = [&](const MatchBlock &block, size_t k)
+    {
+        TextSpan match = BlockMatch(block, k);
+        return match.start + match.length <= offset;
+    };
+    size_t b = FirstNotBefore(set.blocks.size(), [&](size_t b) { return endsBy(set.blocks[b], set.blocks[b].starts.size() - 1); });
+    if (b == set.blocks.size())
+        return set.count;
+    const MatchBlock &block = set.blocks[b];
+    return set.firsts[b] + FirstNotBefore(block.starts.size(), [&](size_t k) { return endsBy(block, k); });
+}
+
+size_t NextMatchFrom(const TextSpan &match)
+{
+    return match.length ? match.start + match.length : match.start + 1;
+}
+
+// Replaces matches [first, last) with found. The blocks holding first and last are rebuilt
+// around them, taking in the next block too when they would come out less than half full,
+// and the matches from last on are moved by the edit.
+static void SpliceMatches(MatchSet &set, size_t first, size_t last, const std::vector<TextSpan> &found, size_t removed, size_t inserted)
+{
+    if (set.blocks.empty())
+    {
+        AppendMatches(set, found.data(), found.size());
+        return;
+    }
+    size_t firstBlock = BlockOf(set, first);
+    size_t lastBlock = BlockOf(set, last);
+    std::vector<TextSpan> matches;
+    const MatchBlock &head = set.blocks[firstBlock];
+    for (size_t k = 0; k < first - set.firsts[firstBlock]; ++k)
+        matches.push_back(BlockMatch(head, k));
+    matches.insert(matches.end(), found.begin(), found.end());
+    size_t k = last < set.count ? last - set.firsts[lastBlock] : set.blocks[lastBlock].starts.size();
+    for (;;)
+    {
+        const MatchBlock &tail = set.blocks[lastBlock];
+        for (; k < tail.starts.size(); ++k)
+        {
+            TextSpan match = BlockMatch(tail, k);
+            match.start = match.start - removed + inserted;
+            matches.push_back(match);
+        }
+        if (matches.size() >= MATCH_BLOCK_MAX / 2 || lastBlock + 1 == set.blocks.size())
+            break;
+        ++lastBlock;
+        k = 0;
+    }
+    for (size_t b = lastBlock + 1; b < set.blocks.size(); ++b)
+        set.blocks[b].base = set.blocks[b].base - removed + inserted;
+    // Spread evenly, so a block that overflows by one does not leave a block of one behind
+    size_t pieces = (matches.size() + MATCH_BLOCK_MAX - 1) / MATCH_BLOCK_MAX;
+    size_t limit = pieces ? (matches.size() + pieces - 1) / pieces : MATCH_BLOCK_MAX;
+    std::vector<MatchBlock> rebuilt;
+    for (const TextSpan &match : matches)
+        PushMatch(rebuilt, match, limit);
+    set.blocks.erase(set.blocks.begin() + firstBlock, set.blocks.begin() + lastBlock + 1);
+    set.blocks.insert(set.blocks.begin() + firstBlock, std::make_move_iterator(rebuilt.begin()), std::make_move_iterator(rebuilt.end()));
+    CountMatches(set);
+}
+
+TextSpan EditMatches(MatchSet &set, size_t offset, size_t removed, size_t inserted, size_t settled, const MatchFinder &find)
+{
+    size_t editEnd = offset + removed;
+    // Matches from moved on start after the edit; an end inside the removed text goes to the
+    // end of the inserted one.
+    auto movedStart = [&](size_t start) { return start - removed + inserted; };
+    auto mapEnd = [&](size_t end)
+    {
+        if (end <= offset)
+            return end;
+        return end >= editEnd ? end - removed + inserted : offset + inserted;
+    };
+    size_t first = MatchIndexAt(set, settled);
+    size_t moved = (std::max)(first, MatchIndexAt(set, editEnd));
+    size_t from = settled;
+    if (first > 0)
+        from = (std::max)(from, NextMatchFrom(MatchAt(set, first - 1)));
+    std::vector<TextSpan> found;
+    size_t last = set.count;
+    size_t next = moved;
+    TextSpan match;
+    while (find(from, match))
+    {
+        while (next < set.count && movedStart(MatchAt(set, next).start) < match.start)
+            ++next;
+        if (next < set.count)
+        {
+            TextSpan old = MatchAt(set, next);
+            if (movedStart(old.start) == match.start && old.length == match.length)
+            {
+                last = next;
+                break;
+            }
+        }
+        found.push_back(match);
+        from = NextMatchFrom(match);
+    }
+    TextSpan changed;
+    changed.start = TEXT_NPOS;
+    size_t lo = TEXT_NPOS, hi = 0;
+    if (first < last)
+    {
+        TextSpan head = MatchAt(set, first), tail = MatchAt(set, last - 1);
+        lo = (std::min)(head.start, offset);
+        hi = mapEnd(tail.start + tail.length);
+    }
+    if (!found.empty())
+    {
+        lo = (std::min)(lo, found.front().start);
+        hi = (std::max)(hi, found.back().start + found.back().length);
+    }
+    SpliceMatches(set, first, last, found, removed, inserted);
+    if (lo == TEXT_NPOS)
+        return changed;
+    changed.start = lo;
+    changed.length = hi - lo;
+    return changed;
+}
+
+// A regex may look one unit back for \b or ^, so settled is the line break before the line.
+size_t MatchSettledOffset(const PieceTable &table, size_t offset, size_t literalLength, const Regex *regex)
+{
+    if (!regex)
+        return offset + 1 >= literalLength ? offset + 1 - literalLength : 0;
+    if (regex->crossesLines)
+        return TEXT_NPOS;
+    size_t lineStart = PieceLineStart(table, PieceLineAt(table, offset) + 1);
+    return lineStart ? lineStart - 1 : 0;
+}
@@ -0,0 +1,72 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  The matches a Find All turns up, kept sorted in blocks so Find Next can binary search them
+  and an edit only rewrites the few it may have changed.
+*/
+
+#pragma once
+
+#include "textscan.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Matches per block; an edit rebuilds the blocks it touches and moves the bases of the rest
+#define MATCH_BLOCK_MAX 4096
+
+struct PieceTable;
+struct Regex;
+
+// Starts are kept from base in 32 bits, so a block never spans more than UINT32_MAX units.
+struct MatchBlock
+{
+    size_t base = 0;
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> lengths;
+};
+
+// Non-overlapping matches in document order, as one search chain finds them: each search
+// goes on from the end of the match before, or one past it when that match was empty.
+struct MatchSet
+{
+    std::vector<MatchBlock> blocks;
+    // Matches in the blocks before each block
+    std::vector<size_t> firsts;
+    size_t count = 0;
+};
+
+// The first match in the chain starting at or after from, in the text as it is now.
+using MatchFinder = std::function<bool(size_t from, TextSpan &match)>;
+
+void ClearMatches(MatchSet &set);
+// The matches follow those already in the set.
+void AppendMatches(MatchSet &set, const TextSpan *matches, size_t count);
+TextSpan MatchAt(const MatchSet &set, size_t index);
+// Index of the first match starting at or after offset, set.count when there is none.
+size_t MatchIndexAt(const MatchSet &set, size_t offset);
+// Index of the first match ending after offset, set.count when there is none.
+size_t MatchIndexEndingAfter(const MatchSet &set, size_t offset);
+size_t NextMatchFrom(const TextSpan &match);
+
+// After removed units at offset were replaced by inserted ones. Matches starting before
+// settled are kept as they are and those starting after the edit are moved by its length; the
+// chain is searched again from settled until it lands on one of the moved matches. settled
+// must be far enough before offset that no match starting before it can reach the edit.
+// Returns the span whose matches changed, at TEXT_NPOS when none did.
+TextSpan EditMatches(MatchSet &set, size_t offset, size_t removed, size_t inserted, size_t settled, const MatchFinder &find);
+
+// settled for an edit at offset of the document as it is after it: the length of a literal
+// less one before offset, or the end of the line before for a regex, whose matches stay
+// within a line. TEXT_NPOS when regex can match a line break and the whole chain must be
+// searched again.
+size_t MatchSettledOffset(const PieceTable &table, size_t offset, size_t literalLength, const Regex *regex);
@@ -0,0 +1,872 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Piece table holding the editor's document. Block lengths are summed in a Fenwick tree so
+  finding the piece at an offset stays logarithmic however fragmented the document gets.
+*/
+
+#include "piecetable.h"
+#include "textcodec.h"
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+#include <iterator>
+
+// Appends the line breaks of text[begin, end) to breaks. A run starts fresh at begin, so an
+// LF typed after a CR typed separately still counts.
+static void ScanBreaks(std::vector<size_t> &breaks, const char16_t *text, size_t begin, size_t end)
+{
+    size_t i = begin;
+    while ((i += FindLineBreak(text + i, end - i)) < end)
+    {
+        if (text[i] == u'\r' || i == begin || text[i - 1] != u'\r')
+            breaks.push_back(i);
+        ++i;
+    }
+}
+
+static const std::vector<size_t> &BufferBreaks(const PieceTable &table, uint32_t buffer)
+{
+    return buffer ? table.originalBreaks[buffer - 1] : table.addedBreaks;
+}
+
+static size_t CountBreaks(const PieceTable &table, uint32_t buffer, size_t start, size_t length)
+{
+    const std::vector<size_t> &breaks = BufferBreaks(table, buffer);
+    auto first = std::lower_bound(breaks.begin(), breaks.end(), start);
+    return static_cast<size_t>(std::lower_bound(first, breaks.end(), start + length) - first);
+}
+
+static void RebuildBlockTree(PieceTable &table)
+{
+    size_t count = table.blocks.size();
+    table.tree.assign(count + 1, 0);
+    table.lineTree.assign(count + 1, 0);
+    for (size_t i = 1; i <= count; ++i)
+    {
+        table.tree[i] += table.blocks[i - 1].length;
+        table.lineTree[i] += table.blocks[i - 1].lines;
+        size_t parent = i + (i & (0 - i));
+        if (parent <= count)
+        {
+            table.tree[parent] += table.tree[i];
+            table.lineTree[parent] += table.lineTree[i];
+        }
+    }
+}
+
+// Deltas wrap for shrinking blocks, which unsigned addition undoes.
+static void AddBlockLength(PieceTable &table, size_t block, size_t delta, size_t lineDelta)
+{
+    table.blocks[block].length += delta;
+    table.blocks[block].lines += lineDelta;
+    for (size_t i = block + 1; i < table.tree.size(); i += i & (0 - i))
+    {
+        table.tree[i] += delta;
+        table.lineTree[i] += lineDelta;
+    }
+}
+
+// Sum over the first count blocks.
+static size_t SumBlocks(const std::vector<size_t> &tree, size_t count)
+{
+    size_t sum = 0;
+    for (size_t i = count; i; i -= i & (0 - i))
+        sum += tree[i];
+    return sum;
+}
+
+// Block holding offset, which becomes the offset inside it. At a boundary between blocks the
+// earlier one is picked when preferEnd is set, so an insert can extend the piece before it.
+static size_t FindBlock(const PieceTable &table, size_t &offset, bool preferEnd)
+{
+    size_t count = table.blocks.size();
+    size_t step = 1;
+    while (step * 2 <= count)
+        step *= 2;
+    size_t pos = 0;
+    for (; step; step /= 2)
+    {
+        if (pos + step > count)
+            continue;
+        size_t sum = table.tree[pos + step];
+        if (preferEnd ? sum < offset : sum <= offset)
+        {
+            pos += step;
+            offset -= sum;
+        }
+    }
+    if (pos == count && pos > 0)
+    {
+        --pos;
+        offset += table.blocks[pos].length;
+    }
+    return pos;
+}
+
+// Block holding the line-th break (1-based, at most table.lines), which becomes its number
+// inside the block.
+static size_t FindLineBlock(const PieceTable &table, size_t &line)
+{
+    size_t count = table.blocks.size();
+    size_t step = 1;
+    while (step * 2 <= count)
+        step *= 2;
+    size_t pos = 0;
+    for (; step; step /= 2)
+    {
+        if (pos + step <= count && table.lineTree[pos + step] < line)
+        {
+            pos += step;
+            line -= table.lineTree[pos];
+        }
+    }
+    return pos;
+}
+
+size_t SeekPieceBlock(const PieceTable &table, size_t offset, size_t &blockStart)
+{
+    size_t local = offset;
+    size_t block = table.blocks.empty() ? 0 : FindBlock(table, local, false);
+    blockStart = offset - local;
+    return block;
+}
+
+void ClearPieces(PieceTable &table)
+{
+    std::vector<std::u16string>().swap(table.original);
+    std::u16string().swap(table.added);
+    std::vector<std::vector<size_t>>().swap(table.originalBreaks);
+    std::vector<size_t>().swap(table.addedBreaks);
+    std::vector<PieceBlock>().swap(table.blocks);
+    std::vector<size_t>().swap(table.tree);
+    std::vector<size_t>().swap(table.lineTree);
+    table.length = 0;
+    table.lines = 0;
+}
+
+// Spreads an overfull block evenly over as many blocks as it takes; a splice can add any
+// number of pieces at once.
+static void SplitFullBlock(PieceTable &table, size_t b)
+{
+    if (table.blocks[b].pieces.size() <= PIECE_BLOCK_MAX)
+        return;
+    std::vector<Piece> pieces = std::move(table.blocks[b].pieces);
+    size_t count = pieces.size();
+    size_t parts = count / PIECE_BLOCK_MAX + 1;
+    std::vector<PieceBlock> split(parts);
+    for (size_t i = 0; i < parts; ++i)
+    {
+        PieceBlock &block = split[i];
+        block.pieces.assign(pieces.begin() + i * count / parts, pieces.begin() + (i + 1) * count / parts);
+        for (const Piece &piece : block.pieces)
+        {
+            block.length += piece.length;
+            block.lines += piece.lines;
+        }
+    }
+    table.blocks[b] = std::move(split[0]);
+    table.blocks.insert(table.blocks.begin() + b + 1, std::make_move_iterator(split.begin() + 1), std::make_move_iterator(split.end()));
+    RebuildBlockTree(table);
+}
+
+void AppendPieceBuffer(PieceTable &table, std::u16string &&text)
+{
+    if (text.empty())
+        return;
+    // Decoders size their output for the worst case; do not keep that slack for good
+    if (text.capacity() > text.size() + text.size() / 4)
+        text.shrink_to_fit();
+    std::vector<size_t> breaks;
+    ScanBreaks(breaks, text.data(), 0, text.size());
+    Piece piece;
+    piece.length = text.size();
+    piece.lines = static_cast<uint32_t>(breaks.size());
+    table.original.push_back(std::move(text));
+    table.originalBreaks.push_back(std::move(breaks));
+    piece.buffer = static_cast<uint32_t>(table.original.size());
+    if (table.blocks.empty() || table.blocks.back().pieces.size() >= PIECE_BLOCK_MAX)
+    {
+        table.blocks.emplace_back();
+        RebuildBlockTree(table);
+    }
+    table.blocks.back().pieces.push_back(piece);
+    AddBlockLength(table, table.blocks.size() - 1, piece.length, piece.lines);
+    table.length += piece.length;
+    table.lines += piece.lines;
+}
+
+// Puts a piece boundary at offset inside the block and returns the index of the first piece
+// at or after it.
+static size_t SplitPieceAt(const PieceTable &table, PieceBlock &block, size_t offset)
+{
+    size_t i = 0;
+    while (i < block.pieces.size() && offset >= block.pieces[i].length)
+    {
+        offset -= block.pieces[i].length;
+        ++i;
+    }
+    if (offset == 0 || i == block.pieces.size())
+        return i;
+    Piece tail = block.pieces[i];
+    tail.start += offset;
+    tail.length -= offset;
+    block.pieces[i].length = offset;
+    block.pieces[i].lines = static_cast<uint32_t>(CountBreaks(table, tail.buffer, block.pieces[i].start, offset));
+    tail.lines -= block.pieces[i].lines;
+    block.pieces.insert(block.pieces.begin() + i + 1, tail);
+    return i + 1;
+}
+
+static void ErasePieces(PieceTable &table, size_t offset, size_t removed)
+{
+    size_t local = offset;
+    size_t b = FindBlock(table, local, false);
+    bool reshaped = false;
+    table.length -= removed;
+    while (removed && b < table.blocks.size())
+    {
+        PieceBlock &block = table.blocks[b];
+        size_t n = (std::min)(removed, block.length - local);
+        size_t first = SplitPieceAt(table, block, local);
+        size_t last = SplitPieceAt(table, block, local + n);
+        size_t lines = 0;
+        for (size_t p = first; p < last; ++p)
+            lines += block.pieces[p].lines;
+        block.pieces.erase(block.pieces.begin() + first, block.pieces.begin() + last);
+        removed -= n;
+        local = 0;
+        table.lines -= lines;
+        if (reshaped)
+        {
+            block.length -= n;
+            block.lines -= lines;
+        }
+        else
+            AddBlockLength(table, b, 0 - n, 0 - lines);
+        if (block.pieces.empty())
+        {
+            table.blocks.erase(table.blocks.begin() + b);
+            reshaped = true;
+            continue;
+        }
+        if (block.pieces.size() > PIECE_BLOCK_MAX)
+        {
+            SplitFullBlock(table, b);
+            ++b;
+        }
+        ++b;
+    }
+    if (reshaped)
+        RebuildBlockTree(table);
+}
+
+static void InsertPieces(PieceTable &table, size_t offset, const Piece *pieces, size_t count)
+{
+    if (!count)
+        return;
+    if (table.blocks.empty())
+    {
+        table.blocks.emplace_back();
+        RebuildBlockTree(table);
+    }
+    size_t local = offset;
+    size_t b = FindBlock(table, local, true);
+    PieceBlock &block = table.blocks[b];
+    size_t i = SplitPieceAt(table, block, local);
+    size_t length = 0, lines = 0;
+    for (size_t p = 0; p < count; ++p)
+    {
+        length += pieces[p].length;
+        lines += pieces[p].lines;
+    }
+    // Typing appends to the add buffer right behind the previous keystroke's text
+    Piece *prev = i > 0 ? &block.pieces[i - 1] : nullptr;
+    const Piece &piece = pieces[0];
+    if (count == 1 && prev && prev->buffer == 0 && piece.buffer == 0 && prev->start + prev->length == piece.start)
+    {
+        prev->length += piece.length;
+        prev->lines += piece.lines;
+    }
+    else
+        block.pieces.insert(block.pieces.begin() + i, pieces, pieces + count);
+    AddBlockLength(table, b, length, lines);
+    table.length += length;
+    table.lines += lines;
+    SplitFullBlock(table, b);
+}
+
+Piece AddPieceText(PieceTable &table, const char16_t *text, size_t length)
+{
+    Piece piece;
+    piece.start = table.added.size();
+    piece.length = length;
+    table.added.append(text, length);
+    size_t breaks = table.addedBreaks.size();
+    ScanBreaks(table.addedBreaks, table.added.data(), piece.start, table.added.size());
+    piece.lines = static_cast<uint32_t>(table.addedBreaks.size() - breaks);
+    return piece;
+}
+
+void CollectPieces(const PieceTable &table, size_t offset, size_t count, std::vector<Piece> &out)
+{
+    if (offset >= table.length || !count)
+        return;
+    size_t end = offset + (std::min)(count, table.length - offset);
+    size_t pos = 0;
+    for (size_t b = SeekPieceBlock(table, offset, pos); b < table.blocks.size() && pos < end; ++b)
+    {
+        for (const Piece &piece : table.blocks[b].pieces)
+        {
+            if (pos >= end)
+                break;
+            if (pos + piece.length > offset)
+            {
+                size_t from = offset > pos ? offset - pos : 0;
+                size_t to = (std::min)(end - pos, piece.length);
+                Piece part = piece;
+                if (from || to < piece.length)
+                {
+                    part.start += from;
+                    part.length = to - from;
+                    part.lines = static_cast<uint32_t>(CountBreaks(table, part.buffer, part.start, part.length));
+                }
+                out.push_back(part);
+            }
+            pos += piece.length;
+        }
+    }
+}
+
+static size_t CountNextBreaks(const PieceTable &table, PieceCollector &collector, uint32_t buffer, size_t start, size_t length)
+{
+    const std::vector<size_t> &breaks = BufferBreaks(table, buffer);
+    size_t &at = collector.breakIndex;
+    if (!collector.breakSeeked)
+    {
+        at = static_cast<size_t>(std::lower_bound(breaks.begin(), breaks.end(), start) - breaks.begin());
+        collector.breakSeeked = true;
+    }
+    while (at < breaks.size() && breaks[at] < start)
+        ++at;
+    size_t first = at;
+    while (at < breaks.size() && breaks[at] < start + length)
+        ++at;
+    return at - first;
+}
+
+void CollectNextPieces(const PieceTable &table, PieceCollector &collector, size_t offset, size_t count, std::vector<Piece> &out)
+{
+    if (offset >= table.length || !count)
+        return;
+    size_t end = offset + (std::min)(count, table.length - offset);
+    if (!collector.seeked)
+    {
+        collector.block = SeekPieceBlock(table, offset, collector.pos);
+        collector.index = 0;
+        collector.breakSeeked = false;
+        collector.seeked = true;
+    }
+    while (collector.block < table.blocks.size())
+    {
+        const std::vector<Piece> &pieces = table.blocks[collector.block].pieces;
+        if (collector.index == pieces.size())
+        {
+            ++collector.block;
+            collector.index = 0;
+            continue;
+        }
+        const Piece &piece = pieces[collector.index];
+        size_t pos = collector.pos;
+        if (pos >= end)
+            return;
+        if (pos + piece.length > offset)
+        {
+            size_t from = offset > pos ? offset - pos : 0;
+            size_t to = (std::min)(end - pos, piece.length);
+            Piece part = piece;
+            if (from || to < piece.length)
+            {
+                part.start += from;
+                part.length = to - from;
+                part.lines = static_cast<uint32_t>(CountNextBreaks(table, collector, part.buffer, part.start, part.length));
+            }
+            out.push_back(part);
+            if (to < piece.length)
+                return;
+        }
+        collector.pos += piece.length;
+        ++collector.index;
+        collector.breakSeeked = false;
+    }
+}
+
+void SplicePieces(PieceTable &table, size_t offset, size_t removed, const Piece *pieces, size_t count)
+{
+    offset = (std::min)(offset, table.length);
+    removed = (std::min)(removed, table.length - offset);
+    if (removed)
+        ErasePieces(table, offset, removed);
+    InsertPieces(table, offset, pieces, count);
+}
+
+void ReplacePieces(PieceTable &table, size_t offset, size_t removed, const char16_t *text, size_t length)
+{
+    Piece piece = AddPieceText(table, text, length);
+    SplicePieces(table, offset, removed, &piece, length ? 1 : 0);
+}
+
+// Text of a buffer still in use, from start to end, and where it lands in the new buffer.
+struct LiveRange
+{
+    size_t start;
+    size_t end;
+    size_t to;
+};
+
+// Break offsets are carried over rather than scanned again, so a CRLF split between two
+// appends keeps counting the way it did.
+size_t CompactPieces(PieceTable &table, const std::vector<std::vector<Piece> *> &kept)
+{
+    std::vector<std::vector<LiveRange>> live(table.original.size() + 1);
+    auto note = [&](const Piece &piece)
+    {
+        if (piece.length)
+            live[piece.buffer].push_back({piece.start, piece.start + piece.length, 0});
+    };
+    for (const PieceBlock &block : table.blocks)
+        for (const Piece &piece : block.pieces)
+            note(piece);
+    for (const std::vector<Piece> *pieces : kept)
+        for (const Piece &piece : *pieces)
+            note(piece);
+    size_t dropped = 0;
+    for (size_t b = 0; b < live.size(); ++b)
+    {
+        std::vector<LiveRange> &ranges = live[b];
+        std::sort(ranges.begin(), ranges.end(), [](const LiveRange &x, const LiveRange &y) { return x.start < y.start; });
+        size_t merged = 0, used = 0;
+        for (const LiveRange &range : ranges)
+        {
+            if (merged && range.start <= ranges[merged - 1].end)
+                ranges[merged - 1].end = (std::max)(ranges[merged - 1].end, range.end);
+            else
+                ranges[merged++] = range;
+        }
+        ranges.resize(merged);
+        for (LiveRange &range : ranges)
+        {
+            range.to = range.start;
+            used += range.end - range.start;
+        }
+        std::u16string &text = b ? table.original[b - 1] : table.added;
+        std::vector<size_t> &breaks = b ? table.originalBreaks[b - 1] : table.addedBreaks;
+        if (used == text.size())
+            continue;
+        std::u16string compacted;
+        std::vector<size_t> compactedBreaks;
+        compacted.reserve(used);
+        for (LiveRange &range : ranges)
+        {
+            range.to = compacted.size();
+            compacted.append(text, range.start, range.end - range.start);
+            auto first = std::lower_bound(breaks.begin(), breaks.end(), range.start);
+            auto last = std::lower_bound(first, breaks.end(), range.end);
+            for (auto it = first; it != last; ++it)
+                compactedBreaks.push_back(*it - range.start + range.to);
+        }
+        dropped += text.size() - used;
+        text.swap(compacted);
+        breaks.swap(compactedBreaks);
+    }
+    auto move = [&](Piece &piece)
+    {
+        if (!piece.length)
+            return;
+        const std::vector<LiveRange> &ranges = live[piece.buffer];
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), piece.start, [](size_t start, const LiveRange &range) { return start < range.start; });
+        --it;
+        piece.start = piece.start - it->start + it->to;
+    };
+    for (PieceBlock &block : table.blocks)
+        for (Piece &piece : block.pieces)
+            move(piece);
+    for (std::vector<Piece> *pieces : kept)
+        for (Piece &piece : *pieces)
+            move(piece);
+    return dropped;
+}
+
+size_t CopyPieces(const PieceTable &table, size_t offset, size_t count, char16_t *out)
+{
+    if (offset >= table.length)
+        return 0;
+    count = (std::min)(count, table.length - offset);
+    auto copy = [&](const char16_t *text, size_t length, size_t pos)
+    {
+        memcpy(out + (pos - offset), text, length * sizeof(char16_t));
+        return true;
+    };
+    ForEachPieceSpan(table, offset, offset + count, copy);
+    return count;
+}
+
+const char16_t *PieceSpanAt(const PieceTable &table, size_t offset, size_t &length)
+{
+    length = 0;
+    if (offset >= table.length)
+        return nullptr;
+    size_t local = offset;
+    const PieceBlock &block = table.blocks[FindBlock(table, local, false)];
+    for (const Piece &piece : block.pieces)
+    {
+        if (local < piece.length)
+        {
+            length = piece.length - local;
+            return PieceText(table, piece) + local;
+        }
+        local -= piece.length;
+    }
+    return nullptr;
+}
+
+char16_t PieceCharAt(const PieceTable &table, size_t offset)
+{
+    size_t length = 0;
+    const char16_t *text = PieceSpanAt(table, offset, length);
+    return text ? *text : u'\0';
+}
+
+void SeekPieceCursor(PieceCursor &cursor, size_t offset)
+{
+    cursor = PieceCursor();
+    cursor.pos = offset;
+}
+
+// Points the cursor at the whole piece holding offset.
+static bool LoadPieceCursor(const PieceTable &table, PieceCursor &cursor, size_t offset)
+{
+    if (offset >= table.length)
+        return false;
+    size_t local = offset;
+    const PieceBlock &block = table.blocks[FindBlock(table, local, false)];
+    for (const Piece &piece : block.pieces)
+    {
+        if (local < piece.length)
+        {
+            cursor.span = PieceText(table, piece);
+            cursor.spanStart = offset - local;
+            cursor.spanLength = piece.length;
+            return true;
+        }
+        local -= piece.length;
+    }
+    return false;
+}
+
+bool NextPieceChar(const PieceTable &table, PieceCursor &cursor, char16_t &c)
+{
+    size_t at = cursor.pos;
+    if (!cursor.span || at < cursor.spanStart || at - cursor.spanStart >= cursor.spanLength)
+    {
+        if (!LoadPieceCursor(table, cursor, at))
+            return false;
+    }
+    c = cursor.span[at - cursor.spanStart];
+    ++cursor.pos;
+    return true;
+}
+
+bool PrevPieceChar(const PieceTable &table, PieceCursor &cursor, char16_t &c)
+{
+    if (cursor.pos == 0)
+        return false;
+    size_t at = cursor.pos - 1;
+    if (!cursor.span || at < cursor.spanStart || at - cursor.spanStart >= cursor.spanLength)
+    {
+        if (!LoadPieceCursor(table, cursor, at))
+            return false;
+    }
+    c = cursor.span[at - cursor.spanStart];
+    --cursor.pos;
+    return true;
+}
+
+static bool IsWordSpace(char16_t c)
+{
+    return iswspace(static_cast<wint_t>(c)) != 0;
+}
+
+size_t PieceWordStart(const PieceTable &table, size_t offset)
+{
+    PieceCursor cursor;
+    SeekPieceCursor(cursor, (std::min)(offset, table.length));
+    char16_t c = 0;
+    bool more = PrevPieceChar(table, cursor, c);
+    while (more && IsWordSpace(c))
+        more = PrevPieceChar(table, cursor, c);
+    while (more && !IsWordSpace(c))
+        more = PrevPieceChar(table, cursor, c);
+    return more ? cursor.pos + 1 : cursor.pos;
+}
+
+size_t PieceWordEnd(const PieceTable &table, size_t offset)
+{
+    PieceCursor cursor;
+    SeekPieceCursor(cursor, (std::min)(offset, table.length));
+    char16_t c = 0;
+    bool more = NextPieceChar(table, cursor, c);
+    while (more && !IsWordSpace(c))
+        more = NextPieceChar(table, cursor, c);
+    while (more && IsWordSpace(c))
+        more = NextPieceChar(table, cursor, c);
+    return more ? cursor.pos - 1 : cursor.pos;
+}
+
+// Whether the document from offset on matches the folded pattern from its unit at to the end.
+static bool PiecesMatchPrepared(const PieceTable &table, const NoCasePattern &prepared, size_t at, size_t offset)
+{
+    bool equal = true;
+    auto compare = [&](const char16_t *span, size_t n, size_t pos)
+    {
+        equal = MatchesPreparedAt(prepared, at + (pos - offset), span, n);
+        return equal;
+    };
+    ForEachPieceSpan(table, offset, offset + prepared.length - at, compare);
+    return equal;
+}
+
+// A match starting at text + at that runs past the end of its run, which ends at end.
+static bool MatchesAcross(const PieceTable &table, const NoCasePattern &prepared, const char16_t *text, size_t length,
+                          size_t at, size_t end)
+{
+    return MatchesPreparedAt(prepared, 0, text + at, length - at) &&
+           PiecesMatchPrepared(table, prepared, length - at, end);
+}
+
+// Each run is searched in place; a match crossing into the next run can only start in the
+// last patternLen - 1 units and is checked there against the following pieces, so nothing
+// is copied.
+size_t FindPiecesPrepared(const PieceTable &table, const NoCasePattern &prepared, size_t from, size_t lastStart)
+{
+    size_t m = prepared.length;
+    if (m == 0 || from > table.length || m > table.length - from || from > lastStart)
+        return TEXT_NPOS;
+    size_t stop = lastStart < table.length - m ? lastStart + m : table.length;
+    size_t found = TEXT_NPOS;
+    auto scan = [&](const char16_t *text, size_t length, size_t offset)
+    {
+        size_t pos = FindPrepared(prepared, text, length, 0);
+        if (pos != TEXT_NPOS)
+        {
+            found = offset + pos;
+            return false;
+        }
+        size_t end = offset + length;
+        for (size_t at = length >= m ? length - m + 1 : 0; at < length && end - length + at + m <= table.length; ++at)
+            if (MatchesAcross(table, prepared, text, length, at, end))
+            {
+                found = offset + at;
+                return false;
+            }
+        return true;
+    };
+    ForEachPieceSpan(table, from, stop, scan);
+    return found <= lastStart ? found : TEXT_NPOS;
+}
+
+size_t FindPiecesPreparedBackward(const PieceTable &table, const NoCasePattern &prepared, size_t last)
+{
+    size_t m = prepared.length;
+    if (m == 0 || m > table.length)
+        return TEXT_NPOS;
+    last = (std::min)(last, table.length - m);
+    size_t found = TEXT_NPOS;
+    auto scan = [&](const char16_t *text, size_t length, size_t offset)
+    {
+        // Starts that cross into the next run come after every start inside this one
+        size_t end = offset + length;
+        for (size_t at = length; at-- > (length >= m ? length - m + 1 : 0);)
+            if (offset + at <= last && offset + at + m <= table.length && MatchesAcross(table, prepared, text, length, at, end))
+            {
+                found = offset + at;
+                return false;
+            }
+        if (last >= offset)
+        {
+            size_t pos = FindPreparedBackward(prepared, text, length, last - offset);
+            if (pos != TEXT_NPOS)
+            {
+                found = offset + pos;
+                return false;
+            }
+        }
+        return true;
+    };
+    ForEachPieceSpanBackward(table, 0, last + m, scan);
+    return found;
+}
+
+size_t FindPiecesNoCase(const PieceTable &table, const char16_t *pattern, size_t patternLen, size_t from)
+{
+    NoCasePattern prepared;
+    PrepareNoCase(prepared, pattern, patternLen);
+    return FindPiecesPrepared(table, prepared, from);
+}
+
+size_t FindPiecesNoCaseBackward(const PieceTable &table, const char16_t *pattern, size_t patternLen, size_t last)
+{
+    NoCasePattern prepared;
+    PrepareNoCase(prepared, pattern, patternLen);
+    return FindPiecesPreparedBackward(table, prepared, last);
+}
+
+size_t FindPiecesWrapped(const PieceTable &table, const char16_t *pattern, size_t patternLen,
+                         size_t selStart, size_t selEnd, bool forward)
+{
+    NoCasePattern prepared;
+    PrepareNoCase(prepared, pattern, patternLen);
+    size_t pos = TEXT_NPOS;
+    if (forward)
+    {
+        pos = FindPiecesPrepared(table, prepared, selEnd);
+        if (pos == TEXT_NPOS)
+            pos = FindPiecesPrepared(table, prepared, 0);
+    }
+    else
+    {
+        if (selStart > 0)
+            pos = FindPiecesPreparedBackward(table, prepared, selStart - 1);
+        if (pos == TEXT_NPOS)
+            pos = FindPiecesPreparedBackward(table, prepared, TEXT_NPOS);
+    }
+    return pos;
+}
+
+bool PiecesEqualNoCase(const PieceTable &table, size_t offset, const char16_t *text, size_t length)
+{
+    if (offset > table.length || length > table.length - offset)
+        return false;
+    bool equal = true;
+    auto compare = [&](const char16_t *span, size_t n, size_t pos)
+    {
+        equal = EqualsNoCase(span, text + (pos - offset), n);
+        return equal;
+    };
+    ForEachPieceSpan(table, offset, offset + length, compare);
+    return equal;
+}
+
+size_t PieceLineStart(const PieceTable &table, size_t line)
+{
+    if (line <= 1)
+        return 0;
+    size_t index = line - 1;
+    if (index > table.lines)
+        return table.length;
+    size_t b = FindLineBlock(table, index);
+    size_t pos = SumBlocks(table.tree, b);
+    for (const Piece &piece : table.blocks[b].pieces)
+    {
+        if (index > piece.lines)
+        {
+            index -= piece.lines;
+            pos += piece.length;
+            continue;
+        }
+        const std::vector<size_t> &breaks = BufferBreaks(table, piece.buffer);
+        size_t i = static_cast<size_t>(std::lower_bound(breaks.begin(), breaks.end(), piece.start) - breaks.begin()) + index - 1;
+        size_t at = breaks[i] - piece.start;
+        const char16_t *text = PieceText(table, piece);
+        pos += at + 1;
+        // The LF of a CRLF is not a break of its own
+        if (text[at] == u'\r' && at + 1 < piece.length && text[at + 1] == u'\n' && (i + 1 == breaks.size() || breaks[i + 1] != breaks[i] + 1))
+            ++pos;
+        return pos;
+    }
+    return table.length;
+}
+
+size_t PieceLineAt(const PieceTable &table, size_t offset)
+{
+    if (offset >= table.length)
+        return table.lines;
+    size_t local = offset;
+    size_t b = FindBlock(table, local, false);
+    size_t line = SumBlocks(table.lineTree, b);
+    for (const Piece &piece : table.blocks[b].pieces)
+    {
+        if (local < piece.length)
+            return line + CountBreaks(table, piece.buffer, piece.start, local);
+        local -= piece.length;
+        line += piece.lines;
+    }
+    return line;
+}
+
+static bool RefillLineReader(const PieceTable &table, PieceLineReader &reader)
+{
+    if (!reader.spanLength)
+        reader.span = PieceSpanAt(table, reader.pos, reader.spanLength);
+    return reader.spanLength != 0;
+}
+
+static void SkipLineReader(PieceLineReader &reader, size_t n)
+{
+    reader.span += n;
+    reader.spanLength -= n;
+    reader.pos += n;
+}
+
+bool NextPieceLine(const PieceTable &table, PieceLineReader &reader, const char16_t *&line, size_t &length)
+{
+    if (reader.done)
+        return false;
+    const char16_t *first = u"";
+    size_t firstLength = 0;
+    bool copied = false;
+    for (;;)
+    {
+        if (!RefillLineReader(table, reader))
+        {
+            reader.done = true;
+            break;
+        }
+        const char16_t *span = reader.span;
+        size_t n = 0;
+        while (n < reader.spanLength && span[n] != u'\r' && span[n] != u'\n')
+            ++n;
+        if (n && !firstLength && !copied)
+        {
+            first = span;
+            firstLength = n;
+        }
+        else if (n)
+        {
+            if (!copied)
+                reader.scratch.assign(first, firstLength);
+            copied = true;
+            reader.scratch.append(span, n);
+        }
+        bool atBreak = n < reader.spanLength;
+        SkipLineReader(reader, n);
+        if (!atBreak)
+            continue;
+        char16_t c = *reader.span;
+        SkipLineReader(reader, 1);
+        if (c == u'\r' && RefillLineReader(table, reader) && *reader.span == u'\n')
+            SkipLineReader(reader, 1);
+        break;
+    }
+    line = copied ? reader.scratch.data() : first;
+    length = copied ? reader.scratch.size() : firstLength;
+    return true;
+}
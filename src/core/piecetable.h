@@ -0,0 +1,216 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Piece table holding the editor's document: immutable loaded buffers plus one append-only
+  buffer for typed text, so edits never move the text that was already there. Line breaks
+  are indexed alongside, so line and offset lookups take O(log n).
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "textscan.h"
+
+#define PIECE_BLOCK_MAX 128
+
+// buffer 0 is the add buffer, buffer n > 0 is original[n - 1]. lines counts the line breaks
+// that end inside the piece; it shares a word with buffer since undo keeps many pieces.
+struct Piece
+{
+    uint32_t buffer = 0;
+    uint32_t lines = 0;
+    size_t start = 0;
+    size_t length = 0;
+};
+
+// Pieces are kept in blocks with a cached length so an edit only touches one short vector.
+struct PieceBlock
+{
+    size_t length = 0;
+    size_t lines = 0;
+    std::vector<Piece> pieces;
+};
+
+// tree and lineTree are Fenwick trees over the block lengths and line counts. Each buffer
+// keeps the sorted offsets of its line breaks: every CR, and every LF that does not follow a
+// CR appended in the same call, so a CRLF counts once at its CR. This matches SplitLines
+// for the editor's text, which only ever has CR line breaks.
+struct PieceTable
+{
+    std::vector<std::u16string> original;
+    std::u16string added;
+    std::vector<std::vector<size_t>> originalBreaks;
+    std::vector<size_t> addedBreaks;
+    std::vector<PieceBlock> blocks;
+    std::vector<size_t> tree;
+    std::vector<size_t> lineTree;
+    size_t length = 0;
+    size_t lines = 0;
+};
+
+void ClearPieces(PieceTable &table);
+// Takes over text as a new original buffer at the end of the document.
+void AppendPieceBuffer(PieceTable &table, std::u16string &&text);
+// Replaces removed units at offset with text. Offsets past the end are clamped.
+void ReplacePieces(PieceTable &table, size_t offset, size_t removed, const char16_t *text, size_t length);
+// Appends text to the add buffer and returns a piece for it, to be spliced in later.
+Piece AddPieceText(PieceTable &table, const char16_t *text, size_t length);
+// Appends the pieces covering [offset, offset + count) to out, trimmed to the range.
+void CollectPieces(const PieceTable &table, size_t offset, size_t count, std::vector<Piece> &out);
+
+// Where the last CollectNextPieces stopped: the piece it ended in and the first line break
+// of that piece's buffer not yet passed.
+struct PieceCollector
+{
+    bool seeked = false;
+    size_t block = 0;
+    size_t index = 0;
+    size_t pos = 0;
+    bool breakSeeked = false;
+    size_t breakIndex = 0;
+};
+
+// CollectPieces for ranges taken left to right, each at or after the end of the one before,
+// as Replace All does. It walks on from the last range instead of seeking, so collecting a
+// whole document costs one pass. Text may be added in between but the pieces may not change.
+void CollectNextPieces(const PieceTable &table, PieceCollector &collector, size_t offset, size_t count, std::vector<Piece> &out);
+// Replaces removed units at offset with pieces that already point into the table's buffers,
+// as collected from it or returned by AddPieceText, and are not empty. Nothing is copied.
+void SplicePieces(PieceTable &table, size_t offset, size_t removed, const Piece *pieces, size_t count);
+// Copies the text the document and the pieces in kept still use into new buffers, drops the
+// rest and moves every piece to where its text went. Returns the units dropped.
+size_t CompactPieces(PieceTable &table, const std::vector<std::vector<Piece> *> &kept);
+// Copies up to count units starting at offset and returns how many were copied.
+size_t CopyPieces(const PieceTable &table, size_t offset, size_t count, char16_t *out);
+char16_t PieceCharAt(const PieceTable &table, size_t offset);
+// Contiguous text starting at offset up to the end of its piece; nullptr at the end.
+const char16_t *PieceSpanAt(const PieceTable &table, size_t offset, size_t &length);
+
+inline const char16_t *PieceText(const PieceTable &table, const Piece &piece)
+{
+    const std::u16string &buffer = piece.buffer ? table.original[piece.buffer - 1] : table.added;
+    return buffer.data() + piece.start;
+}
+
+// Walks the document a character at a time from any offset in either direction. The piece
+// under the cursor is kept, so a step only seeks again when it crosses into another piece.
+struct PieceCursor
+{
+    size_t pos = 0;
+    size_t spanStart = 0;
+    size_t spanLength = 0;
+    const char16_t *span = nullptr;
+};
+
+void SeekPieceCursor(PieceCursor &cursor, size_t offset);
+// Reads the character at the cursor and steps past it; false at the end of the document.
+bool NextPieceChar(const PieceTable &table, PieceCursor &cursor, char16_t &c);
+// Steps back and reads the character before the cursor; false at the start.
+bool PrevPieceChar(const PieceTable &table, PieceCursor &cursor, char16_t &c);
+
+// Start of what Ctrl+Backspace deletes before offset: the whitespace behind it, then the word
+// behind that.
+size_t PieceWordStart(const PieceTable &table, size_t offset);
+// End of what Ctrl+Delete deletes from offset: the word under it, then the whitespace after.
+size_t PieceWordEnd(const PieceTable &table, size_t offset);
+
+// Index of the block holding offset and the document offset its first piece starts at.
+size_t SeekPieceBlock(const PieceTable &table, size_t offset, size_t &blockStart);
+
+// Calls visit(text, length, offset) for each contiguous run of [start, end) in order and stops
+// early when it returns false. The pointers are only valid until the next edit.
+template <typename Visit>
+void ForEachPieceSpan(const PieceTable &table, size_t start, size_t end, Visit visit)
+{
+    if (end > table.length)
+        end = table.length;
+    if (start >= end)
+        return;
+    size_t pos = 0;
+    for (size_t b = SeekPieceBlock(table, start, pos); b < table.blocks.size(); ++b)
+    {
+        for (const Piece &piece : table.blocks[b].pieces)
+        {
+            if (pos + piece.length > start)
+            {
+                size_t from = start > pos ? start - pos : 0;
+                size_t to = end - pos < piece.length ? end - pos : piece.length;
+                if (!visit(PieceText(table, piece) + from, to - from, pos + from))
+                    return;
+            }
+            pos += piece.length;
+            if (pos >= end)
+                return;
+        }
+    }
+}
+
+// Same runs in reverse order, from end back to start.
+template <typename Visit>
+void ForEachPieceSpanBackward(const PieceTable &table, size_t start, size_t end, Visit visit)
+{
+    if (end > table.length)
+        end = table.length;
+    if (start >= end)
+        return;
+    size_t pos = 0;
+    size_t b = SeekPieceBlock(table, end - 1, pos);
+    pos += table.blocks[b].length;
+    for (++b; b-- > 0;)
+    {
+        const PieceBlock &block = table.blocks[b];
+        for (size_t p = block.pieces.size(); p-- > 0;)
+        {
+            const Piece &piece = block.pieces[p];
+            pos -= piece.length;
+            if (pos < end)
+            {
+                size_t from = start > pos ? start - pos : 0;
+                size_t to = end - pos < piece.length ? end - pos : piece.length;
+                if (!visit(PieceText(table, piece) + from, to - from, pos + from))
+                    return;
+            }
+            if (pos <= start)
+                return;
+        }
+    }
+}
+
+// The textscan searches over a piece table; matches may cross piece boundaries.
+// Leftmost match starting in [from, lastStart]; the scan stops a pattern length past lastStart.
+size_t FindPiecesPrepared(const PieceTable &table, const NoCasePattern &prepared, size_t from, size_t lastStart = TEXT_NPOS);
+size_t FindPiecesPreparedBackward(const PieceTable &table, const NoCasePattern &prepared, size_t last);
+size_t FindPiecesNoCase(const PieceTable &table, const char16_t *pattern, size_t patternLen, size_t from);
+size_t FindPiecesNoCaseBackward(const PieceTable &table, const char16_t *pattern, size_t patternLen, size_t last);
+size_t FindPiecesWrapped(const PieceTable &table, const char16_t *pattern, size_t patternLen,
+                         size_t selStart, size_t selEnd, bool forward);
+bool PiecesEqualNoCase(const PieceTable &table, size_t offset, const char16_t *text, size_t length);
+
+// Offset of 1-based line, or the end of the document past the last line.
+size_t PieceLineStart(const PieceTable &table, size_t line);
+// 0-based line holding offset.
+size_t PieceLineAt(const PieceTable &table, size_t offset);
+
+// Walks the document line by line with SplitLines' rules. A line inside one piece is returned
+// in place; only lines crossing a piece boundary are copied into scratch.
+struct PieceLineReader
+{
+    size_t pos = 0;
+    bool done = false;
+    const char16_t *span = nullptr;
+    size_t spanLength = 0;
+    std::u16string scratch;
+};
+
+bool NextPieceLine(const PieceTable &table, PieceLineReader &reader, const char16_t *&line, size_t &length);
@@ -0,0 +1,261 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Portable text codec shared by the editor and the Linux benchmark harness.
+  Decodes byte chunks to UTF-16 so large files can be streamed without a full copy.
+*/
+
+#include "textcodec.h"
+
+Encoding DetectBom(const uint8_t *data, size_t size)
+{
+    if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+        return Encoding::UTF8BOM;
+    if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+        return Encoding::UTF16LE;
+    if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF)
+        return Encoding::UTF16BE;
+    return Encoding::UTF8;
+}
+
+LineEnding DetectLineEnding(const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (data[i] == '\r')
+            return (i + 1 < size && data[i + 1] == '\n') ? LineEnding::CRLF : LineEnding::CR;
+        if (data[i] == '\n')
+            return LineEnding::LF;
+    }
+    return LineEnding::CRLF;
+}
+
+std::pair<Encoding, LineEnding> DetectEncoding(const uint8_t *data, size_t size)
+{
+    Encoding enc = DetectBom(data, size);
+    if (enc == Encoding::UTF8)
+    {
+        bool invalid = false;
+        if (Utf8ValidPrefix(data, size, invalid) < size)
+            enc = Encoding::ANSI;
+    }
+    return {enc, DetectLineEnding(data, size)};
+}
+
+std::pair<Encoding, LineEnding> DetectPrefixEncoding(const uint8_t *data, size_t size, bool complete)
+{
+    if (size > DETECT_PREFIX_SIZE)
+    {
+        size = DETECT_PREFIX_SIZE;
+        complete = false;
+    }
+    Encoding enc = DetectBom(data, size);
+    if (enc == Encoding::UTF8)
+    {
+        bool invalid = false;
+        size_t valid = Utf8ValidPrefix(data, size, invalid);
+        if (invalid || (complete && valid < size))
+            enc = Encoding::ANSI;
+    }
+    return {enc, DetectLineEnding(data, size)};
+}
+
+size_t BomLength(Encoding encoding)
+{
+    switch (encoding)
+    {
+    case Encoding::UTF8BOM:
+        return 3;
+    case Encoding::UTF16LE:
+    case Encoding::UTF16BE:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+size_t MaxDecodedLength(size_t bytes)
+{
+    return bytes;
+}
+
+static DecodeResult DecodeUtf16(const uint8_t *data, size_t size, char16_t *out, bool bigEndian, bool final)
+{
+    DecodeResult r;
+    size_t units = size / 2;
+    CopyUtf16Units(data, reinterpret_cast<uint8_t *>(out), units, bigEndian);
+    r.written = units;
+    r.consumed = final ? size : units * 2;
+    return r;
+}
+
+DecodeResult DecodeChunk(Encoding encoding, const uint8_t *data, size_t size, char16_t *out, bool final)
+{
+    switch (encoding)
+    {
+    case Encoding::UTF8:
+    case Encoding::UTF8BOM:
+        return DecodeUtf8(data, size, out, final);
+    case Encoding::UTF16LE:
+        return DecodeUtf16(data, size, out, false, final);
+    case Encoding::UTF16BE:
+        return DecodeUtf16(data, size, out, true, final);
+    case Encoding::ANSI:
+        break;
+    }
+    DecodeResult r;
+    r.invalid = true;
+    return r;
+}
+
+size_t EncodeBom(Encoding encoding, uint8_t *out)
+{
+    switch (encoding)
+    {
+    case Encoding::UTF8BOM:
+        out[0] = 0xEF;
+        out[1] = 0xBB;
+        out[2] = 0xBF;
+        return 3;
+    case Encoding::UTF16LE:
+        out[0] = 0xFF;
+        out[1] = 0xFE;
+        return 2;
+    case Encoding::UTF16BE:
+        out[0] = 0xFE;
+        out[1] = 0xFF;
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+// A lone CR expanding to CRLF is the worst case for UTF-16; for UTF-8 it is a BMP
+// character above U+07FF.
+size_t MaxEncodedLength(Encoding encoding, size_t units)
+{
+    if (encoding == Encoding::UTF16LE || encoding == Encoding::UTF16BE)
+        return units * 4;
+    return units * 3;
+}
+
+template <Encoding E>
+static inline uint8_t *PutUnit(uint8_t *o, uint32_t c)
+{
+    if (E == Encoding::UTF16BE)
+    {
+        o[0] = static_cast<uint8_t>(c >> 8);
+        o[1] = static_cast<uint8_t>(c);
+    }
+    else
+    {
+        o[0] = static_cast<uint8_t>(c);
+        o[1] = static_cast<uint8_t>(c >> 8);
+    }
+    return o + 2;
+}
+
+static inline uint8_t *PutUtf8(uint8_t *o, uint32_t cp)
+{
+    if (cp < 0x80)
+        *o++ = static_cast<uint8_t>(cp);
+    else if (cp < 0x800)
+    {
+        *o++ = static_cast<uint8_t>(0xC0 | (cp >> 6));
+        *o++ = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        *o++ = static_cast<uint8_t>(0xE0 | (cp >> 12));
+        *o++ = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+        *o++ = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        *o++ = static_cast<uint8_t>(0xF0 | (cp >> 18));
+        *o++ = static_cast<uint8_t>(0x80 | ((cp >> 12) & 0x3F));
+        *o++ = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+        *o++ = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+    }
+    return o;
+}
+
+template <Encoding E>
+static inline uint8_t *PutChar(uint8_t *o, uint32_t c)
+{
+    if (E == Encoding::UTF8)
+        return PutUtf8(o, c);
+    return PutUnit<E>(o, c);
+}
+
+template <Encoding E>
+static EncodeResult EncodeUnits(LineEnding le, const char16_t *text, size_t size, uint8_t *out, bool final)
+{
+    EncodeResult r;
+    size_t i = 0;
+    uint8_t *o = out;
+    while (i < size)
+    {
+        char16_t c = text[i];
+        if (c == u'\r' || c == u'\n')
+        {
+            if (c == u'\r')
+            {
+                if (i + 1 == size && !final)
+                    break;
+                if (i + 1 < size && text[i + 1] == u'\n')
+                    ++i;
+            }
+            if (le != LineEnding::LF)
+                o = PutChar<E>(o, u'\r');
+            if (le != LineEnding::CR)
+                o = PutChar<E>(o, u'\n');
+            ++i;
+            continue;
+        }
+        if (E != Encoding::UTF8)
+        {
+            size_t run = FindLineBreak(text + i, size - i);
+            CopyUtf16Units(reinterpret_cast<const uint8_t *>(text + i), o, run, E == Encoding::UTF16BE);
+            o += run * 2;
+            i += run;
+            continue;
+        }
+        uint32_t cp = c;
+        if (c >= 0xD800 && c <= 0xDFFF)
+        {
+            if (c <= 0xDBFF && i + 1 == size && !final)
+                break;
+            if (c <= 0xDBFF && i + 1 < size && text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF)
+                cp = 0x10000 + ((c - 0xD800) << 10) + (text[++i] - 0xDC00);
+            else
+                cp = 0xFFFD;
+        }
+        o = PutChar<E>(o, cp);
+        ++i;
+    }
+    r.consumed = i;
+    r.written = static_cast<size_t>(o - out);
+    return r;
+}
+
+EncodeResult EncodeChunk(Encoding encoding, LineEnding le, const char16_t *text, size_t size, uint8_t *out, bool final)
+{
+    switch (encoding)
+    {
+    case Encoding::UTF16LE:
+        return EncodeUnits<Encoding::UTF16LE>(le, text, size, out, final);
+    case Encoding::UTF16BE:
+        return EncodeUnits<Encoding::UTF16BE>(le, text, size, out, final);
+    default:
+        return EncodeUnits<Encoding::UTF8>(le, text, size, out, final);
+    }
+}
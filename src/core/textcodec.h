@@ -0,0 +1,88 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Portable text codec shared by the editor and the Linux benchmark harness.
+  Decodes byte chunks to UTF-16 so large files can be streamed without a full copy.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+enum class Encoding
+{
+    UTF8,
+    UTF8BOM,
+    UTF16LE,
+    UTF16BE,
+    ANSI
+};
+enum class LineEnding
+{
+    CRLF,
+    LF,
+    CR
+};
+
+struct DecodeResult
+{
+    size_t consumed = 0;
+    size_t written = 0;
+    bool invalid = false;
+};
+
+struct EncodeResult
+{
+    size_t consumed = 0;
+    size_t written = 0;
+};
+
+#define DETECT_PREFIX_SIZE (64u << 10)
+
+Encoding DetectBom(const uint8_t *data, size_t size);
+LineEnding DetectLineEnding(const uint8_t *data, size_t size);
+std::pair<Encoding, LineEnding> DetectEncoding(const uint8_t *data, size_t size);
+// Decides from at most DETECT_PREFIX_SIZE leading bytes. A UTF-8 sequence cut by the limit
+// counts as valid unless complete says the prefix is the whole file; callers confirm the
+// rest while decoding and fall back to ANSI on the first invalid chunk.
+std::pair<Encoding, LineEnding> DetectPrefixEncoding(const uint8_t *data, size_t size, bool complete);
+size_t BomLength(Encoding encoding);
+size_t MaxDecodedLength(size_t bytes);
+
+// Decodes as much of data as forms complete characters. Bytes of a sequence split at the end
+// of the chunk are left unconsumed unless final is set. ANSI is code-page specific and left
+// to the platform layer.
+DecodeResult DecodeChunk(Encoding encoding, const uint8_t *data, size_t size, char16_t *out, bool final);
+
+// Writes the byte order mark for encoding (at most 3 bytes) and returns its length.
+size_t EncodeBom(Encoding encoding, uint8_t *out);
+size_t MaxEncodedLength(Encoding encoding, size_t units);
+
+// Normalizes line endings to le and encodes to UTF-8 or UTF-16 in one pass. A trailing CR or
+// high surrogate is left unconsumed unless final is set, so chunks can split anywhere.
+// Unpaired surrogates become U+FFFD in UTF-8 and pass through unchanged in UTF-16. ANSI
+// callers encode to UTF16LE and convert each chunk with the platform code page.
+EncodeResult EncodeChunk(Encoding encoding, LineEnding le, const char16_t *text, size_t size, uint8_t *out, bool final);
+
+// UTF-8 kernels (utf8.cpp), dispatched on the CPU's SIMD level. DecodeUtf8 validates as it
+// decodes, so callers no longer need a separate validation pass.
+DecodeResult DecodeUtf8(const uint8_t *data, size_t size, char16_t *out, bool final);
+
+// Returns the number of leading bytes that form complete, valid UTF-8 sequences.
+size_t Utf8ValidPrefix(const uint8_t *data, size_t size, bool &invalid);
+
+// UTF-16 kernels (utf16.cpp). Copies units code units between buffers of any alignment,
+// swapping each unit's bytes when swap is set (UTF-16BE on a little-endian host).
+void CopyUtf16Units(const uint8_t *src, uint8_t *dst, size_t units, bool swap);
+// Returns the index of the first CR or LF in text, or size if there is none.
+size_t FindLineBreak(const char16_t *text, size_t size);
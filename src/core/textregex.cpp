@@ -0,0 +1,1268 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Regex engine behind Find and Replace: a recursive-descent parser to a small syntax tree,
+  forward and reverse programs over code-unit classes, the lazy DFA scans and the Pike VM.
+*/
+
+#include "textregex.h"
+#include "piecetable.h"
+#include <algorithm>
+#include <cwctype>
+
+#define REGEX_KIND_OTHER 0
+#define REGEX_KIND_WORD 1
+#define REGEX_KIND_BREAK 2
+
+#define REGEX_ASSERT_LINE_START 0
+#define REGEX_ASSERT_LINE_END 1
+#define REGEX_ASSERT_WORD 2
+#define REGEX_ASSERT_NOT_WORD 3
+
+#define REGEX_SET_ANY 0
+#define REGEX_SET_DOT 1
+#define REGEX_SET_WORDS 1024
+#define REGEX_MAX_DEPTH 200
+#define REGEX_MAX_REPEAT 1000
+#define REGEX_UNBOUNDED UINT32_MAX
+#define REGEX_DEAD 0
+#define REGEX_SLOT_NONE UINT32_MAX
+#define REGEX_SLOTS (REGEX_GROUPS * 2)
+
+enum class RegexNodeType : uint8_t
+{
+    Empty,
+    Set,
+    Concat,
+    Alternate,
+    Repeat,
+    Group,
+    Assert
+};
+
+struct RegexNode
+{
+    RegexNodeType type = RegexNodeType::Empty;
+    // The set, group or assertion
+    uint32_t value = 0;
+    uint32_t min = 0;
+    uint32_t max = 0;
+    bool greedy = true;
+    std::vector<uint32_t> children;
+};
+
+// One bit per BMP code unit
+typedef std::vector<uint64_t> RegexBits;
+
+struct RegexParser
+{
+    const char16_t *pattern = nullptr;
+    size_t length = 0;
+    size_t pos = 0;
+    bool ignoreCase = false;
+    size_t depth = 0;
+    size_t groups = 0;
+    bool assertions = false;
+    bool failed = false;
+    size_t errorAt = TEXT_NPOS;
+    std::vector<RegexNode> nodes;
+    std::vector<RegexBits> sets;
+    std::unordered_map<char16_t, uint32_t> literals;
+};
+
+static bool TestBit(const RegexBits &bits, uint32_t unit)
+{
+    return (bits[unit >> 6] >> (unit & 63)) & 1;
+}
+
+static void SetBit(RegexBits &bits, uint32_t unit)
+{
+    bits[unit >> 6] |= static_cast<uint64_t>(1) << (unit & 63);
+}
+
+static std::vector<uint8_t> BuildKindTable()
+{
+    std::vector<uint8_t> table(0x10000, REGEX_KIND_OTHER);
+    for (size_t c = 0; c < table.size(); ++c)
+        if (iswalnum(static_cast<wint_t>(c)) || c == u'_')
+            table[c] = REGEX_KIND_WORD;
+    table[u'\r'] = REGEX_KIND_BREAK;
+    table[u'\n'] = REGEX_KIND_BREAK;
+    return table;
+}
+
+// Word, line break or other for every BMP code unit; \w, ^, $ and \b all read it.
+static const uint8_t *KindTable()
+{
+    static const std::vector<uint8_t> table = BuildKindTable();
+    return table.data();
+}
+
+static bool AssertionHolds(uint32_t assertion, uint8_t left, uint8_t right)
+{
+    switch (assertion)
+    {
+    case REGEX_ASSERT_LINE_START:
+        return left == REGEX_KIND_BREAK;
+    case REGEX_ASSERT_LINE_END:
+        return right == REGEX_KIND_BREAK;
+    case REGEX_ASSERT_WORD:
+        return (left == REGEX_KIND_WORD) != (right == REGEX_KIND_WORD);
+    default:
+        return (left == REGEX_KIND_WORD) == (right == REGEX_KIND_WORD);
+    }
+}
+
+static bool Fail(RegexParser &parser)
+{
+    if (!parser.failed)
+    {
+        parser.failed = true;
+        parser.errorAt = parser.pos;
+    }
+    return false;
+}
+
+static uint32_t AddNode(RegexParser &parser, RegexNodeType type, uint32_t value = 0)
+{
+    parser.nodes.emplace_back();
+    parser.nodes.back().type = type;
+    parser.nodes.back().value = value;
+    return static_cast<uint32_t>(parser.nodes.size() - 1);
+}
+
+// Adds every unit that folds like one already in the set.
+static void CloseCase(RegexBits &bits)
+{
+    const char16_t *fold = FoldTable();
+    RegexBits folded(REGEX_SET_WORDS);
+    for (uint32_t c = 0; c < 0x10000; ++c)
+        if (TestBit(bits, c))
+            SetBit(folded, fold[c]);
+    for (uint32_t c = 0; c < 0x10000; ++c)
+        if (TestBit(folded, fold[c]))
+            SetBit(bits, c);
+}
+
+static uint32_t AddSet(RegexParser &parser, RegexBits &&bits, bool negate)
+{
+    if (parser.ignoreCase)
+        CloseCase(bits);
+    if (negate)
+        for (uint64_t &word : bits)
+            word = ~word;
+    parser.sets.push_back(std::move(bits));
+    return static_cast<uint32_t>(parser.sets.size() - 1);
+}
+
+static uint32_t LiteralSet(RegexParser &parser, char16_t unit)
+{
+    auto found = parser.literals.find(unit);
+    if (found != parser.literals.end())
+        return found->second;
+    RegexBits bits(REGEX_SET_WORDS);
+    SetBit(bits, unit);
+    uint32_t set = AddSet(parser, std::move(bits), false);
+    parser.literals.emplace(unit, set);
+    return set;
+}
+
+static bool IsClassEscape(char16_t c)
+{
+    return c == u'd' || c == u'D' || c == u'w' || c == u'W' || c == u's' || c == u'S';
+}
+
+// \d, \w, \s or their negations, added to bits.
+static void AddClassEscape(RegexBits &bits, char16_t c)
+{
+    const uint8_t *kinds = KindTable();
+    bool negate = c == u'D' || c == u'W' || c == u'S';
+    for (uint32_t u = 0; u < 0x10000; ++u)
+    {
+        bool in;
+        if (c == u'd' || c == u'D')
+            in = u >= u'0' && u <= u'9';
+        else if (c == u'w' || c == u'W')
+            in = kinds[u] == REGEX_KIND_WORD;
+        else
+            in = iswspace(static_cast<wint_t>(u)) != 0;
+        if (in != negate)
+            SetBit(bits, u);
+    }
+}
+
+static bool ParseHex(RegexParser &parser, size_t digits, char16_t &unit)
+{
+    uint32_t value = 0;
+    for (size_t i = 0; i < digits; ++i, ++parser.pos)
+    {
+        if (parser.pos >= parser.length)
+            return Fail(parser);
+        char16_t c = parser.pattern[parser.pos];
+        uint32_t digit;
+        if (c >= u'0' && c <= u'9')
+            digit = c - u'0';
+        else if (c >= u'a' && c <= u'f')
+            digit = c - u'a' + 10;
+        else if (c >= u'A' && c <= u'F')
+            digit = c - u'A' + 10;
+        else
+            return Fail(parser);
+        value = value * 16 + digit;
+    }
+    unit = static_cast<char16_t>(value);
+    return true;
+}
+
+// The unit an escape stands for, with pos just past the backslash. Letters with no meaning
+// stand for themselves; \1-\9 are refused, since backreferences cannot run in linear time.
+static bool ParseEscapeUnit(RegexParser &parser, char16_t &unit)
+{
+    char16_t c = parser.pattern[parser.pos++];
+    switch (c)
+    {
+    case u't':
+        unit = u'\t';
+        return true;
+    case u'r':
+        unit = u'\r';
+        return true;
+    case u'f':
+        unit = u'\f';
+        return true;
+    case u'v':
+        unit = u'\v';
+        return true;
+    case u'0':
+        unit = 0;
+        return true;
+    case u'x':
+        return ParseHex(parser, 2, unit);
+    case u'u':
+        return ParseHex(parser, 4, unit);
+    }
+    if (c >= u'1' && c <= u'9')
+    {
+        --parser.pos;
+        return Fail(parser);
+    }
+    unit = c;
+    return true;
+}
+
+// One end of a range in a bracket expression.
+static bool ParseClassUnit(RegexParser &parser, char16_t &unit)
+{
+    char16_t c = parser.pattern[parser.pos++];
+    if (c != u'\\')
+    {
+        unit = c;
+        return true;
+    }
+    if (parser.pos >= parser.length)
+        return Fail(parser);
+    if (parser.pattern[parser.pos] == u'b')
+    {
+        ++parser.pos;
+        unit = u'\b';
+        return true;
+    }
+    return ParseEscapeUnit(parser, unit);
+}
+
+// A bracket expression, with pos just past the '['.
+static bool ParseClass(RegexParser &parser, uint32_t &set)
+{
+    bool negate = parser.pos < parser.length && parser.pattern[parser.pos] == u'^';
+    if (negate)
+        ++parser.pos;
+    RegexBits bits(REGEX_SET_WORDS);
+    for (bool first = true;; first = false)
+    {
+        if (parser.pos >= parser.length)
+            return Fail(parser);
+        char16_t c = parser.pattern[parser.pos];
+        if (c == u']' && !first)
+        {
+            ++parser.pos;
+            break;
+        }
+        if (c == u'\\' && parser.pos + 1 < parser.length)
+        {
+            char16_t escape = parser.pattern[parser.pos + 1];
+            if (IsClassEscape(escape) || escape == u'n')
+            {
+                parser.pos += 2;
+                if (escape == u'n')
+                {
+                    SetBit(bits, u'\r');
+                    SetBit(bits, u'\n');
+                }
+                else
+                    AddClassEscape(bits, escape);
+                continue;
+            }
+        }
+        char16_t low, high;
+        if (!ParseClassUnit(parser, low))
+            return false;
+        high = low;
+        if (parser.pos + 1 < parser.length && parser.pattern[parser.pos] == u'-' && parser.pattern[parser.pos + 1] != u']')
+        {
+            ++parser.pos;
+            if (!ParseClassUnit(parser, high))
+                return false;
+            if (high < low)
+                return Fail(parser);
+        }
+        for (uint32_t u = low; u <= high; ++u)
+            SetBit(bits, u);
+    }
+    set = AddSet(parser, std::move(bits), negate);
+    return true;
+}
+
+// *, +, ?, {n}, {n,} or {n,m} at pos. A brace that does not form a count is left alone to be
+// read as a literal.
+static bool ParseQuantifier(RegexParser &parser, uint32_t &min, uint32_t &max)
+{
+    char16_t c = parser.pattern[parser.pos];
+    if (c == u'*' || c == u'+' || c == u'?')
+    {
+        ++parser.pos;
+        min = c == u'+' ? 1 : 0;
+        max = c == u'?' ? 1 : REGEX_UNBOUNDED;
+        return true;
+    }
+    if (c != u'{')
+        return false;
+    size_t pos = parser.pos + 1;
+    auto readCount = [&](uint32_t &value)
+    {
+        size_t begin = pos;
+        value = 0;
+        while (pos < parser.length && parser.pattern[pos] >= u'0' && parser.pattern[pos] <= u'9')
+        {
+            value = (std::min)(value * 10 + (parser.pattern[pos] - u'0'), static_cast<uint32_t>(REGEX_MAX_REPEAT + 1));
+            ++pos;
+        }
+        return pos > begin;
+    };
+    if (!readCount(min))
+        return false;
+    max = min;
+    if (pos < parser.length && parser.pattern[pos] == u',')
+    {
+        ++pos;
+        if (!readCount(max))
+            max = REGEX_UNBOUNDED;
+    }
+    if (pos >= parser.length || parser.pattern[pos] != u'}')
+        return false;
+    parser.pos = pos + 1;
+    if (min > REGEX_MAX_REPEAT || (max != REGEX_UNBOUNDED && (max > REGEX_MAX_REPEAT || max < min)))
+        return Fail(parser);
+    return true;
+}
+
+static bool ParseAlternation(RegexParser &parser, uint32_t &node);
+
+static bool ParseAtom(RegexParser &parser, uint32_t &node)
+{
+    char16_t c = parser.pattern[parser.pos];
+    switch (c)
+    {
+    case u'(':
+    {
+        if (++parser.depth > REGEX_MAX_DEPTH)
+            return Fail(parser);
+        ++parser.pos;
+        bool capture = true;
+        if (parser.pos < parser.length && parser.pattern[parser.pos] == u'?')
+        {
+            if (parser.pos + 1 >= parser.length || parser.pattern[parser.pos + 1] != u':')
+                return Fail(parser);
+            parser.pos += 2;
+            capture = false;
+        }
+        size_t group = capture ? ++parser.groups : 0;
+        uint32_t inner;
+        if (!ParseAlternation(parser, inner))
+            return false;
+        if (parser.pos >= parser.length || parser.pattern[parser.pos] != u')')
+            return Fail(parser);
+        ++parser.pos;
+        --parser.depth;
+        node = inner;
+        if (capture && group < REGEX_GROUPS)
+        {
+            node = AddNode(parser, RegexNodeType::Group, static_cast<uint32_t>(group));
+            parser.nodes[node].children.push_back(inner);
+        }
+        return true;
+    }
+    case u'[':
+    {
+        ++parser.pos;
+        uint32_t set;
+        if (!ParseClass(parser, set))
+            return false;
+        node = AddNode(parser, RegexNodeType::Set, set);
+        return true;
+    }
+    case u'.':
+        ++parser.pos;
+        node = AddNode(parser, RegexNodeType::Set, REGEX_SET_DOT);
+        return true;
+    case u'^':
+    case u'$':
+        ++parser.pos;
+        parser.assertions = true;
+        node = AddNode(parser, RegexNodeType::Assert, c == u'^' ? REGEX_ASSERT_LINE_START : REGEX_ASSERT_LINE_END);
+        return true;
+    case u'*':
+    case u'+':
+    case u'?':
+        return Fail(parser);
+    case u'{':
+    {
+        uint32_t min, max;
+        size_t pos = parser.pos;
+        if (ParseQuantifier(parser, min, max) || parser.failed)
+        {
+            parser.pos = pos;
+            return Fail(parser);
+        }
+        ++parser.pos;
+        node = AddNode(parser, RegexNodeType::Set, LiteralSet(parser, c));
+        return true;
+    }
+    case u'\\':
+        break;
+    default:
+        ++parser.pos;
+        node = AddNode(parser, RegexNodeType::Set, LiteralSet(parser, c));
+        return true;
+    }
+    if (++parser.pos >= parser.length)
+        return Fail(parser);
+    char16_t escape = parser.pattern[parser.pos];
+    if (IsClassEscape(escape) || escape == u'n')
+    {
+        ++parser.pos;
+        RegexBits bits(REGEX_SET_WORDS);
+        if (escape == u'n')
+        {
+            SetBit(bits, u'\r');
+            SetBit(bits, u'\n');
+        }
+        else
+            AddClassEscape(bits, escape);
+        node = AddNode(parser, RegexNodeType::Set, AddSet(parser, std::move(bits), false));
+        return true;
+    }
+    if (escape == u'b' || escape == u'B')
+    {
+        ++parser.pos;
+        parser.assertions = true;
+        node = AddNode(parser, RegexNodeType::Assert, escape == u'b' ? REGEX_ASSERT_WORD : REGEX_ASSERT_NOT_WORD);
+        return true;
+    }
+    char16_t unit;
+    if (!ParseEscapeUnit(parser, unit))
+        return false;
+    node = AddNode(parser, RegexNodeType::Set, LiteralSet(parser, unit));
+    return true;
+}
+
+static bool ParseRepeat(RegexParser &parser, uint32_t &node)
+{
+    if (!ParseAtom(parser, node))
+        return false;
+    uint32_t min, max;
+    if (parser.pos >= parser.length || !ParseQuantifier(parser, min, max))
+        return !parser.failed;
+    bool greedy = true;
+    if (parser.pos < parser.length && parser.pattern[parser.pos] == u'?')
+    {
+        greedy = false;
+        ++parser.pos;
+    }
+    uint32_t repeat = AddNode(parser, RegexNodeType::Repeat);
+    RegexNode &added = parser.nodes[repeat];
+    added.min = min;
+    added.max = max;
+    added.greedy = greedy;
+    added.children.push_back(node);
+    node = repeat;
+    if (parser.pos < parser.length)
+    {
+        char16_t c = parser.pattern[parser.pos];
+        if (c == u'*' || c == u'+' || c == u'?')
+            return Fail(parser);
+    }
+    return true;
+}
+
+static bool ParseConcat(RegexParser &parser, uint32_t &node)
+{
+    node = AddNode(parser, RegexNodeType::Concat);
+    while (parser.pos < parser.length && parser.pattern[parser.pos] != u'|' && parser.pattern[parser.pos] != u')')
+    {
+        uint32_t item;
+        if (!ParseRepeat(parser, item))
+            return false;
+        parser.nodes[node].children.push_back(item);
+    }
+    return true;
+}
+
+static bool ParseAlternation(RegexParser &parser, uint32_t &node)
+{
+    uint32_t first;
+    if (!ParseConcat(parser, first))
+        return false;
+    if (parser.pos >= parser.length || parser.pattern[parser.pos] != u'|')
+    {
+        node = first;
+        return true;
+    }
+    node = AddNode(parser, RegexNodeType::Alternate);
+    parser.nodes[node].children.push_back(first);
+    while (parser.pos < parser.length && parser.pattern[parser.pos] == u'|')
+    {
+        ++parser.pos;
+        uint32_t next;
+        if (!ParseConcat(parser, next))
+            return false;
+        parser.nodes[node].children.push_back(next);
+    }
+    return true;
+}
+
+// Instructions Emit would produce, saturating just past REGEX_MAX_PROGRAM.
+static size_t ProgramSize(const RegexParser &parser, uint32_t index)
+{
+    const size_t limit = REGEX_MAX_PROGRAM + 1;
+    const RegexNode &node = parser.nodes[index];
+    size_t size = 0;
+    switch (node.type)
+    {
+    case RegexNodeType::Empty:
+        return 0;
+    case RegexNodeType::Set:
+    case RegexNodeType::Assert:
+        return 1;
+    case RegexNodeType::Concat:
+    case RegexNodeType::Alternate:
+        for (uint32_t child : node.children)
+            size = (std::min)(size + ProgramSize(parser, child), limit);
+        if (node.type == RegexNodeType::Alternate)
+            size += 2 * (node.children.size() - 1);
+        break;
+    case RegexNodeType::Group:
+        size = ProgramSize(parser, node.children[0]) + 2;
+        break;
+    case RegexNodeType::Repeat:
+    {
+        size_t inner = ProgramSize(parser, node.children[0]);
+        size = inner * node.min + (node.max == REGEX_UNBOUNDED ? inner + 2 : (node.max - node.min) * (inner + 1));
+        break;
+    }
+    }
+    return (std::min)(size, limit);
+}
+
+// Reverse programs read the concatenations back to front and carry no captures.
+static void Emit(const RegexParser &parser, uint32_t index, bool reverse, std::vector<RegexInst> &program)
+{
+    const RegexNode &node = parser.nodes[index];
+    auto add = [&](RegexOp op, uint32_t x = 0, uint32_t y = 0)
+    {
+        RegexInst inst;
+        inst.op = op;
+        inst.x = x;
+        inst.y = y;
+        program.push_back(inst);
+        return static_cast<uint32_t>(program.size() - 1);
+    };
+    auto here = [&]()
+    { return static_cast<uint32_t>(program.size()); };
+    switch (node.type)
+    {
+    case RegexNodeType::Empty:
+        break;
+    case RegexNodeType::Set:
+        add(RegexOp::Class, node.value);
+        break;
+    case RegexNodeType::Assert:
+        add(RegexOp::Assert, node.value);
+        break;
+    case RegexNodeType::Concat:
+        if (reverse)
+            for (size_t i = node.children.size(); i-- > 0;)
+                Emit(parser, node.children[i], reverse, program);
+        else
+            for (uint32_t child : node.children)
+                Emit(parser, child, reverse, program);
+        break;
+    case RegexNodeType::Group:
+        if (!reverse)
+            add(RegexOp::Save, node.value * 2);
+        Emit(parser, node.children[0], reverse, program);
+        if (!reverse)
+            add(RegexOp::Save, node.value * 2 + 1);
+        break;
+    case RegexNodeType::Alternate:
+    {
+        std::vector<uint32_t> jumps;
+        for (size_t i = 0; i + 1 < node.children.size(); ++i)
+        {
+            uint32_t split = add(RegexOp::Split, here() + 1);
+            Emit(parser, node.children[i], reverse, program);
+            jumps.push_back(add(RegexOp::Jump));
+            program[split].y = here();
+        }
+        Emit(parser, node.children.back(), reverse, program);
+        for (uint32_t jump : jumps)
+            program[jump].x = here();
+        break;
+    }
+    case RegexNodeType::Repeat:
+    {
+        for (uint32_t i = 0; i < node.min; ++i)
+            Emit(parser, node.children[0], reverse, program);
+        std::vector<uint32_t> splits;
+        if (node.max == REGEX_UNBOUNDED)
+        {
+            uint32_t loop = add(RegexOp::Split);
+            splits.push_back(loop);
+            Emit(parser, node.children[0], reverse, program);
+            add(RegexOp::Jump, loop);
+        }
+        else
+            for (uint32_t i = node.min; i < node.max; ++i)
+            {
+                splits.push_back(add(RegexOp::Split));
+                Emit(parser, node.children[0], reverse, program);
+            }
+        for (uint32_t split : splits)
+        {
+            program[split].x = node.greedy ? split + 1 : here();
+            program[split].y = node.greedy ? here() : split + 1;
+        }
+        break;
+    }
+    }
+}
+
+// Splits the code units into classes no set tells apart, so DFA transitions are per class.
+static void BuildClasses(Regex &regex, const std::vector<RegexBits> &sets)
+{
+    const uint8_t *kinds = KindTable();
+    regex.classOf.assign(kinds, kinds + 0x10000);
+    size_t count = 3;
+    std::vector<int32_t> remap;
+    for (const RegexBits &bits : sets)
+    {
+        remap.assign(count * 2, -1);
+        size_t next = 0;
+        for (uint32_t u = 0; u < 0x10000; ++u)
+        {
+            size_t key = regex.classOf[u] * 2 + (TestBit(bits, u) ? 1 : 0);
+            if (remap[key] < 0)
+                remap[key] = static_cast<int32_t>(next++);
+            regex.classOf[u] = static_cast<uint16_t>(remap[key]);
+        }
+        count = next;
+    }
+    std::vector<uint32_t> sample(count, 0x10000);
+    for (uint32_t u = 0; u < 0x10000; ++u)
+        if (sample[regex.classOf[u]] == 0x10000)
+            sample[regex.classOf[u]] = u;
+    regex.classCount = count;
+    regex.classKind.resize(count);
+    regex.members.resize(sets.size() * count);
+    for (size_t c = 0; c < count; ++c)
+    {
+        regex.classKind[c] = kinds[sample[c]];
+        for (size_t s = 0; s < sets.size(); ++s)
+            regex.members[s * count + c] = TestBit(sets[s], sample[c]) ? 1 : 0;
+    }
+}
+
+static int32_t AddState(const Regex &regex, RegexDfa &dfa, const std::vector<uint32_t> &threads, uint8_t kind)
+{
+    if (threads.empty() || !regex.assertions)
+        kind = REGEX_KIND_OTHER;
+    dfa.key.assign(threads.begin(), threads.end());
+    dfa.key.push_back(kind);
+    auto found = dfa.ids.find(dfa.key);
+    if (found != dfa.ids.end())
+        return found->second;
+    int32_t id = static_cast<int32_t>(dfa.stateKind.size());
+    dfa.pcs.insert(dfa.pcs.end(), threads.begin(), threads.end());
+    dfa.stateStart.push_back(dfa.pcs.size());
+    dfa.stateKind.push_back(kind);
+    dfa.next.resize(dfa.next.size() + regex.classCount, -1);
+    dfa.ids.emplace(dfa.key, id);
+    return id;
+}
+
+// Drops every state, keeping only the dead one as REGEX_DEAD.
+static void ResetDfa(const Regex &regex, RegexDfa &dfa)
+{
+    dfa.pcs.clear();
+    dfa.stateStart.assign(1, 0);
+    dfa.stateKind.clear();
+    dfa.ids.clear();
+    dfa.next.clear();
+    dfa.stepped.clear();
+    AddState(regex, dfa, dfa.stepped, REGEX_KIND_OTHER);
+}
+
+// Whether one more state fits the budget; if not the cache starts over, so state ids held by
+// the caller are no longer valid.
+static bool ReserveState(const Regex &regex, RegexDfa &dfa)
+{
+    if ((dfa.next.size() + regex.classCount) * sizeof(int32_t) <= REGEX_DFA_MAX_BYTES)
+        return true;
+    ResetDfa(regex, dfa);
+    return false;
+}
+
+// Follows jumps, splits, saves and assertions from the state's threads at a position between
+// units of kind left and right, collecting the threads that read a unit into dfa.threads in
+// priority order. Returns whether a Match was reached.
+static bool FollowEpsilons(RegexDfa &dfa, int32_t state, uint8_t left, uint8_t right)
+{
+    if (++dfa.seenMark == 0)
+    {
+        std::fill(dfa.seen.begin(), dfa.seen.end(), 0);
+        dfa.seenMark = 1;
+    }
+    dfa.threads.clear();
+    bool matched = false;
+    for (size_t i = dfa.stateStart[state]; i < dfa.stateStart[state + 1]; ++i)
+    {
+        dfa.stack.push_back(dfa.pcs[i]);
+        while (!dfa.stack.empty())
+        {
+            uint32_t pc = dfa.stack.back();
+            dfa.stack.pop_back();
+            if (dfa.seen[pc] == dfa.seenMark)
+                continue;
+            dfa.seen[pc] = dfa.seenMark;
+            const RegexInst &inst = dfa.program[pc];
+            switch (inst.op)
+            {
+            case RegexOp::Class:
+                dfa.threads.push_back(pc);
+                break;
+            case RegexOp::Split:
+                dfa.stack.push_back(inst.y);
+                dfa.stack.push_back(inst.x);
+                break;
+            case RegexOp::Jump:
+                dfa.stack.push_back(inst.x);
+                break;
+            case RegexOp::Save:
+                dfa.stack.push_back(pc + 1);
+                break;
+            case RegexOp::Assert:
+                if (AssertionHolds(inst.x, left, right))
+                    dfa.stack.push_back(pc + 1);
+                break;
+            case RegexOp::Match:
+                matched = true;
+                if (!dfa.reverse)
+                {
+                    dfa.stack.clear();
+                    return true;
+                }
+                break;
+            }
+        }
+    }
+    return matched;
+}
+
+// Whether the state matches at the end of the scan, next to a unit of kind outside.
+static bool MatchesAtEnd(RegexDfa &dfa, int32_t state, uint8_t outside)
+{
+    uint8_t held = dfa.stateKind[state];
+    return dfa.reverse ? FollowEpsilons(dfa, state, outside, held) : FollowEpsilons(dfa, state, held, outside);
+}
+
+static int32_t TakeTransition(const Regex &regex, RegexDfa &dfa, int32_t state, uint16_t cls)
+{
+    uint8_t kind = regex.classKind[cls];
+    uint8_t held = dfa.stateKind[state];
+    bool matched = dfa.reverse ? FollowEpsilons(dfa, state, kind, held) : FollowEpsilons(dfa, state, held, kind);
+    dfa.stepped.clear();
+    for (uint32_t pc : dfa.threads)
+        if (regex.members[dfa.program[pc].x * regex.classCount + cls])
+            dfa.stepped.push_back(pc + 1);
+    bool kept = ReserveState(regex, dfa);
+    int32_t packed = AddState(regex, dfa, dfa.stepped, kind) * 2 + (matched ? 1 : 0);
+    if (kept)
+        dfa.next[static_cast<size_t>(state) * regex.classCount + cls] = packed;
+    return packed;
+}
+
+static int32_t StartState(const Regex &regex, RegexDfa &dfa, uint8_t kind)
+{
+    ReserveState(regex, dfa);
+    dfa.stepped.assign(1, 0);
+    return AddState(regex, dfa, dfa.stepped, kind);
+}
+
+// The same threads without the restart loop, once no more matches may start.
+static int32_t DropRestart(const Regex &regex, RegexDfa &dfa, int32_t state)
+{
+    dfa.stepped.clear();
+    for (size_t i = dfa.stateStart[state]; i < dfa.stateStart[state + 1]; ++i)
+        if (dfa.pcs[i] >= REGEX_PATTERN_PC)
+            dfa.stepped.push_back(dfa.pcs[i]);
+    uint8_t kind = dfa.stateKind[state];
+    ReserveState(regex, dfa);
+    return AddState(regex, dfa, dfa.stepped, kind);
+}
+
+struct RegexBuffer
+{
+    const char16_t *text;
+    size_t size;
+
+    size_t Length() const { return size; }
+    char16_t At(size_t pos) const { return text[pos]; }
+    void Copy(size_t start, size_t count, char16_t *out) const { std::copy(text + start, text + start + count, out); }
+    template <typename Visit>
+    void Forward(size_t start, size_t end, Visit visit) const
+    {
+        if (start < end)
+            visit(text + start, end - start, start);
+    }
+    template <typename Visit>
+    void Backward(size_t start, size_t end, Visit visit) const { Forward(start, end, visit); }
+};
+
+struct RegexPieces
+{
+    const PieceTable &table;
+
+    size_t Length() const { return table.length; }
+    char16_t At(size_t pos) const { return PieceCharAt(table, pos); }
+    void Copy(size_t start, size_t count, char16_t *out) const { CopyPieces(table, start, count, out); }
+    template <typename Visit>
+    void Forward(size_t start, size_t end, Visit visit) const { ForEachPieceSpan(table, start, end, visit); }
+    template <typename Visit>
+    void Backward(size_t start, size_t end, Visit visit) const { ForEachPieceSpanBackward(table, start, end, visit); }
+};
+
+template <typename Source>
+static uint8_t KindBefore(const Source &source, size_t pos)
+{
+    return pos ? KindTable()[source.At(pos - 1)] : REGEX_KIND_BREAK;
+}
+
+template <typename Source>
+static uint8_t KindAfter(const Source &source, size_t pos)
+{
+    return pos < source.Length() ? KindTable()[source.At(pos)] : REGEX_KIND_BREAK;
+}
+
+// End of the leftmost-first match starting in [from, lastStart], or TEXT_NPOS.
+template <typename Source>
+static size_t ScanForward(Regex &regex, const Source &source, size_t from, size_t lastStart)
+{
+    RegexDfa &dfa = regex.forward;
+    size_t length = source.Length();
+    size_t classCount = regex.classCount;
+    const uint16_t *classOf = regex.classOf.data();
+    int32_t state = StartState(regex, dfa, KindBefore(source, from));
+    size_t found = TEXT_NPOS;
+    bool dead = false;
+    auto scan = [&](const char16_t *text, size_t count, size_t offset)
+    {
+        const int32_t *next = dfa.next.data();
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint16_t cls = classOf[text[i]];
+            int32_t packed = next[static_cast<size_t>(state) * classCount + cls];
+            if (packed < 0)
+            {
+                packed = TakeTransition(regex, dfa, state, cls);
+                next = dfa.next.data();
+            }
+            if (packed & 1)
+                found = offset + i;
+            state = packed >> 1;
+            if (state == REGEX_DEAD)
+            {
+                dead = true;
+                return false;
+            }
+        }
+        return true;
+    };
+    size_t split = lastStart < length ? lastStart + 1 : length;
+    source.Forward(from, split, scan);
+    if (!dead && lastStart < length)
+    {
+        state = DropRestart(regex, dfa, state);
+        dead = state == REGEX_DEAD;
+        if (!dead)
+            source.Forward(split, length, scan);
+    }
+    if (!dead && MatchesAtEnd(dfa, state, REGEX_KIND_BREAK))
+        found = length;
+    return found;
+}
+
+// Earliest start of a match that ends at end and starts no earlier than from.
+template <typename Source>
+static size_t ScanReverse(Regex &regex, const Source &source, size_t from, size_t end)
+{
+    RegexDfa &dfa = regex.reverse;
+    size_t classCount = regex.classCount;
+    const uint16_t *classOf = regex.classOf.data();
+    int32_t state = StartState(regex, dfa, KindAfter(source, end));
+    size_t found = TEXT_NPOS;
+    bool dead = false;
+    auto scan = [&](const char16_t *text, size_t count, size_t offset)
+    {
+        const int32_t *next = dfa.next.data();
+        for (size_t i = count; i-- > 0;)
+        {
+            uint16_t cls = classOf[text[i]];
+            int32_t packed = next[static_cast<size_t>(state) * classCount + cls];
+            if (packed < 0)
+            {
+                packed = TakeTransition(regex, dfa, state, cls);
+                next = dfa.next.data();
+            }
+            if (packed & 1)
+                found = offset + i + 1;
+            state = packed >> 1;
+            if (state == REGEX_DEAD)
+            {
+                dead = true;
+                return false;
+            }
+        }
+        return true;
+    };
+    source.Backward(from, end, scan);
+    if (!dead && MatchesAtEnd(dfa, state, KindBefore(source, from)))
+        found = from;
+    return found;
+}
+
+// Adds the thread at pc and all its epsilon moves at pos; every thread that reads a unit or
+// matches keeps a copy of the capture slots as they stand on its path.
+static void AddVmThread(Regex &regex, RegexThreads &list, uint32_t pc, size_t pos, uint8_t left, uint8_t right)
+{
+    const std::vector<RegexInst> &program = regex.forward.program;
+    std::vector<RegexVmEntry> &stack = regex.vmStack;
+    std::vector<size_t> &slots = regex.vmSlots;
+    RegexVmEntry start;
+    start.pc = pc;
+    start.slot = REGEX_SLOT_NONE;
+    stack.push_back(start);
+    while (!stack.empty())
+    {
+        RegexVmEntry entry = stack.back();
+        stack.pop_back();
+        if (entry.slot != REGEX_SLOT_NONE)
+        {
+            slots[entry.slot] = entry.value;
+            continue;
+        }
+        uint32_t at = entry.pc;
+        if (list.sparse[at] < list.count && list.dense[list.sparse[at]] == at)
+            continue;
+        list.sparse[at] = static_cast<uint32_t>(list.count);
+        list.dense[list.count] = at;
+        size_t index = list.count++;
+        const RegexInst &inst = program[at];
+        RegexVmEntry follow;
+        follow.slot = REGEX_SLOT_NONE;
+        switch (inst.op)
+        {
+        case RegexOp::Class:
+        case RegexOp::Match:
+            std::copy(slots.begin(), slots.end(), list.slots.begin() + index * REGEX_SLOTS);
+            break;
+        case RegexOp::Split:
+            follow.pc = inst.y;
+            stack.push_back(follow);
+            follow.pc = inst.x;
+            stack.push_back(follow);
+            break;
+        case RegexOp::Jump:
+            follow.pc = inst.x;
+            stack.push_back(follow);
+            break;
+        case RegexOp::Save:
+        {
+            RegexVmEntry restore;
+            restore.slot = inst.x;
+            restore.value = slots[inst.x];
+            stack.push_back(restore);
+            slots[inst.x] = pos;
+            follow.pc = at + 1;
+            stack.push_back(follow);
+            break;
+        }
+        case RegexOp::Assert:
+            if (AssertionHolds(inst.x, left, right))
+            {
+                follow.pc = at + 1;
+                stack.push_back(follow);
+            }
+            break;
+        }
+    }
+}
+
+// Runs the Pike VM over a match the DFAs already bounded, to learn where its groups fell.
+template <typename Source>
+static void FillGroups(Regex &regex, const Source &source, RegexMatch &match)
+{
+    size_t length = source.Length();
+    size_t first = match.start ? match.start - 1 : 0;
+    size_t last = match.end < length ? match.end + 1 : length;
+    regex.window.resize(last - first);
+    source.Copy(first, last - first, &regex.window[0]);
+    const uint8_t *kinds = KindTable();
+    auto kindBefore = [&](size_t pos)
+    { return pos ? kinds[regex.window[pos - 1 - first]] : static_cast<uint8_t>(REGEX_KIND_BREAK); };
+    auto kindAfter = [&](size_t pos)
+    { return pos < length ? kinds[regex.window[pos - first]] : static_cast<uint8_t>(REGEX_KIND_BREAK); };
+    const std::vector<RegexInst> &program = regex.forward.program;
+    for (RegexThreads &list : regex.vm)
+        if (list.dense.size() < program.size())
+        {
+            list.sparse.assign(program.size(), 0);
+            list.dense.assign(program.size(), 0);
+            list.slots.assign(program.size() * REGEX_SLOTS, TEXT_NPOS);
+        }
+    regex.vmSlots.assign(REGEX_SLOTS, TEXT_NPOS);
+    RegexThreads *current = &regex.vm[0];
+    RegexThreads *next = &regex.vm[1];
+    current->count = 0;
+    AddVmThread(regex, *current, REGEX_PATTERN_PC, match.start, kindBefore(match.start), kindAfter(match.start));
+    for (size_t pos = match.start;; ++pos)
+    {
+        next->count = 0;
+        for (size_t i = 0; i < current->count; ++i)
+        {
+            const RegexInst &inst = program[current->dense[i]];
+            const size_t *slots = &current->slots[i * REGEX_SLOTS];
+            if (inst.op == RegexOp::Match)
+            {
+                std::copy(slots, slots + REGEX_SLOTS, match.groups);
+                break;
+            }
+            if (inst.op == RegexOp::Class && pos < match.end &&
+                regex.members[inst.x * regex.classCount + regex.classOf[regex.window[pos - first]]])
+            {
+                std::copy(slots, slots + REGEX_SLOTS, regex.vmSlots.begin());
+                AddVmThread(regex, *next, current->dense[i] + 1, pos + 1, kindBefore(pos + 1), kindAfter(pos + 1));
+            }
+        }
+        if (pos == match.end || next->count == 0)
+            break;
+        std::swap(current, next);
+    }
+    match.groups[0] = match.start;
+    match.groups[1] = match.end;
+}
+
+// The forward DFA finds where the leftmost match ends, the reverse DFA run back from there
+// finds where it starts, and only then does the Pike VM look at it for groups.
+template <typename Source>
+static bool FindIn(Regex &regex, const Source &source, size_t from, size_t lastStart, bool groups, RegexMatch &match)
+{
+    if (!regex.compiled || from > source.Length() || from > lastStart)
+        return false;
+    size_t end = ScanForward(regex, source, from, lastStart);
+    if (end == TEXT_NPOS)
+        return false;
+    size_t start = ScanReverse(regex, source, from, end);
+    if (start == TEXT_NPOS)
+        return false;
+    match.start = start;
+    match.end = end;
+    std::fill(std::begin(match.groups), std::end(match.groups), TEXT_NPOS);
+    match.groups[0] = start;
+    match.groups[1] = end;
+    if (groups && regex.groups)
+        FillGroups(regex, source, match);
+    return true;
+}
+
+bool CompileRegex(Regex &regex, const char16_t *pattern, size_t length, bool ignoreCase)
+{
+    regex = Regex();
+    RegexParser parser;
+    parser.pattern = pattern;
+    parser.length = length;
+    parser.ignoreCase = ignoreCase;
+    RegexBits any(REGEX_SET_WORDS, ~static_cast<uint64_t>(0));
+    RegexBits dot = any;
+    dot[u'\r' >> 6] &= ~(static_cast<uint64_t>(1) << (u'\r' & 63));
+    dot[u'\n' >> 6] &= ~(static_cast<uint64_t>(1) << (u'\n' & 63));
+    parser.sets.push_back(std::move(any));
+    parser.sets.push_back(std::move(dot));
+    uint32_t root = 0;
+    bool parsed = ParseAlternation(parser, root);
+    if (parsed && parser.pos < length)
+        parsed = Fail(parser);
+    if (parsed && ProgramSize(parser, root) + REGEX_PATTERN_PC + 1 > REGEX_MAX_PROGRAM)
+    {
+        parser.pos = 0;
+        parsed = Fail(parser);
+    }
+    if (!parsed)
+    {
+        regex.errorAt = parser.errorAt;
+        return false;
+    }
+    regex.groups = (std::min)(parser.groups, static_cast<size_t>(REGEX_GROUPS - 1));
+    regex.assertions = parser.assertions;
+    BuildClasses(regex, parser.sets);
+
+    std::vector<RegexInst> &forward = regex.forward.program;
+    forward.resize(REGEX_PATTERN_PC);
+    forward[0].op = RegexOp::Split;
+    forward[0].x = REGEX_PATTERN_PC;
+    forward[0].y = 1;
+    forward[1].op = RegexOp::Class;
+    forward[1].x = REGEX_SET_ANY;
+    forward[2].op = RegexOp::Jump;
+    forward[2].x = 0;
+    Emit(parser, root, false, forward);
+    forward.emplace_back();
+    for (size_t pc = REGEX_PATTERN_PC; pc < forward.size(); ++pc)
+    {
+        const RegexInst &inst = forward[pc];
+        if (inst.op == RegexOp::Class && (regex.members[inst.x * regex.classCount + regex.classOf[u'\r']] ||
+                                          regex.members[inst.x * regex.classCount + regex.classOf[u'\n']]))
+            regex.crossesLines = true;
+    }
+    Emit(parser, root, true, regex.reverse.program);
+    regex.reverse.program.emplace_back();
+    regex.reverse.reverse = true;
+    for (RegexDfa *dfa : {&regex.forward, &regex.reverse})
+    {
+        dfa->seen.assign(dfa->program.size(), 0);
+        ResetDfa(regex, *dfa);
+    }
+    regex.compiled = true;
+    return true;
+}
+
+bool FindRegex(Regex &regex, const char16_t *text, size_t size, size_t from, size_t lastStart, RegexMatch &match)
+{
+    RegexBuffer source{text, size};
+    return FindIn(regex, source, from, lastStart, true, match);
+}
+
+bool FindPiecesRegex(Regex &regex, const PieceTable &table, size_t from, size_t lastStart, RegexMatch &match)
+{
+    RegexPieces source{table};
+    return FindIn(regex, source, from, lastStart, true, match);
+}
+
+// Matches are walked forward through a window ending at last; the window starts at a line
+// start so a search does not begin in the middle of what would have matched.
+bool FindPiecesRegexBackward(Regex &regex, const PieceTable &table, size_t last, RegexMatch &match)
+{
+    RegexPieces source{table};
+    size_t limit = (std::min)(last, table.length);
+    size_t window = REGEX_BACK_WINDOW;
+    for (;;)
+    {
+        size_t from = limit > window ? limit - window : 0;
+        from = PieceLineStart(table, PieceLineAt(table, from) + 1);
+        bool found = false;
+        RegexMatch candidate;
+        for (size_t pos = from; pos <= limit && FindIn(regex, source, pos, limit, false, candidate);)
+        {
+            match = candidate;
+            found = true;
+            pos = candidate.end > candidate.start ? candidate.end : candidate.start + 1;
+        }
+        if (found)
+        {
+            if (regex.groups)
+                FillGroups(regex, source, match);
+            return true;
+        }
+        if (from == 0)
+            return false;
+        limit = from - 1;
+        window *= 2;
+    }
+}
+
+bool RegexReplacementHasGroups(const char16_t *replacement, size_t length)
+{
+    for (size_t i = 0; i + 1 < length; ++i)
+    {
+        char16_t next = replacement[i + 1];
+        if (replacement[i] == u'\\')
+            ++i;
+        else if (replacement[i] == u'$')
+        {
+            if (next == u'&' || (next >= u'0' && next <= u'9'))
+                return true;
+            if (next == u'$')
+                ++i;
+        }
+    }
+    return false;
+}
+
+void AppendRegexReplacement(std::u16string &out, const char16_t *replacement, size_t length,
+                            const RegexMatch &match, const PieceTable &table)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        char16_t c = replacement[i];
+        char16_t next = i + 1 < length ? replacement[i + 1] : 0;
+        if (c == u'\\' && next)
+        {
+            ++i;
+            out.push_back(next == u'n' || next == u'r' ? u'\r' : next == u't' ? u'\t' : next);
+            continue;
+        }
+        if (c == u'$' && (next == u'&' || (next >= u'0' && next <= u'9')))
+        {
+            ++i;
+            size_t group = next == u'&' ? 0 : next - u'0';
+            size_t start = match.groups[group * 2];
+            size_t end = match.groups[group * 2 + 1];
+            if (start != TEXT_NPOS && end != TEXT_NPOS && end > start)
+            {
+                size_t at = out.size();
+                out.resize(at + end - start);
+                CopyPieces(table, start, end - start, &out[at]);
+            }
+            continue;
+        }
+        if (c == u'$' && next == u'$')
+            ++i;
+        out.push_back(c);
+    }
+}
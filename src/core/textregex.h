@@ -0,0 +1,141 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Regular expressions for find and replace. A pattern compiles to one instruction program that
+  is run as a lazily built DFA to locate matches and as a Pike VM only to fill in capture
+  groups, so matching time stays linear in the text whatever the pattern.
+*/
+
+#pragma once
+
+#include "textscan.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Capture slots kept per match: the whole match plus groups 1-9
+#define REGEX_GROUPS 10
+// Instructions after {n,m} expansion; longer programs are rejected as a syntax error would be
+#define REGEX_MAX_PROGRAM 20000
+// Transition table budget per DFA; past it the cache is dropped and rebuilt as the scan goes
+#define REGEX_DFA_MAX_BYTES (8u << 20)
+// First window Find Previous searches behind the caret; it doubles until a match turns up
+#define REGEX_BACK_WINDOW (64u << 10)
+// The forward program opens with a lazy any-unit loop so one pass tries every start
+#define REGEX_PATTERN_PC 3
+
+struct PieceTable;
+
+enum class RegexOp : uint8_t
+{
+    Class,
+    Split,
+    Jump,
+    Save,
+    Assert,
+    Match
+};
+
+// Class: x is the set. Split: x is tried before y. Jump: x. Save: x is the slot. Assert: x.
+struct RegexInst
+{
+    RegexOp op = RegexOp::Match;
+    uint32_t x = 0;
+    uint32_t y = 0;
+};
+
+// One program run as a DFA built on demand. A state is the ordered list of threads alive
+// between two units, plus the kind of the unit already read for ^, $ and \b.
+struct RegexDfa
+{
+    std::vector<RegexInst> program;
+    // Forward, the first match reached cuts the threads behind it (leftmost-first); in
+    // reverse every thread runs on, so the earliest start is found.
+    bool reverse = false;
+    std::vector<uint32_t> pcs;
+    std::vector<size_t> stateStart;
+    std::vector<uint8_t> stateKind;
+    std::unordered_map<std::u32string, int32_t> ids;
+    // states x classes; -1 until first taken, else next state << 1 | matched before the unit
+    std::vector<int32_t> next;
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> threads;
+    std::vector<uint32_t> stepped;
+    std::vector<uint32_t> seen;
+    uint32_t seenMark = 0;
+    std::u32string key;
+};
+
+// Pike VM work item: a thread to add, or a capture slot to restore once its branch is done.
+struct RegexVmEntry
+{
+    uint32_t pc = 0;
+    uint32_t slot = 0;
+    size_t value = 0;
+};
+
+// Pike VM thread list: a sparse set of program counters with their capture slots.
+struct RegexThreads
+{
+    std::vector<uint32_t> sparse;
+    std::vector<uint32_t> dense;
+    std::vector<size_t> slots;
+    size_t count = 0;
+};
+
+// A compiled pattern. Searching fills the DFA caches in place, so one Regex serves one thread.
+struct Regex
+{
+    bool compiled = false;
+    // Where the pattern stopped parsing when CompileRegex fails
+    size_t errorAt = TEXT_NPOS;
+    // Capture groups usable in a replacement, not counting the whole match
+    size_t groups = 0;
+    bool assertions = false;
+    // A match can run over a line break, so an edit can change matches on the lines before it
+    bool crossesLines = false;
+    // Code units are mapped to classes that every set in the program treats alike
+    std::vector<uint16_t> classOf;
+    size_t classCount = 0;
+    std::vector<uint8_t> classKind;
+    std::vector<uint8_t> members;
+    // Unanchored forward program; the pattern itself starts at REGEX_PATTERN_PC
+    RegexDfa forward;
+    RegexDfa reverse;
+    RegexThreads vm[2];
+    std::vector<RegexVmEntry> vmStack;
+    std::vector<size_t> vmSlots;
+    std::u16string window;
+};
+
+struct RegexMatch
+{
+    size_t start = TEXT_NPOS;
+    size_t end = TEXT_NPOS;
+    // Start/end pairs per group, TEXT_NPOS for groups that took no part in the match
+    size_t groups[REGEX_GROUPS * 2];
+};
+
+// Syntax: . [] [^] \d \w \s \D \W \S \b \B ^ $ | () (?:) * + ? {n,m} and lazy forms, with
+// \n matching either line break. ignoreCase folds with the same table as FindNoCase.
+bool CompileRegex(Regex &regex, const char16_t *pattern, size_t length, bool ignoreCase);
+// Leftmost match starting in [from, lastStart].
+bool FindRegex(Regex &regex, const char16_t *text, size_t size, size_t from, size_t lastStart, RegexMatch &match);
+bool FindPiecesRegex(Regex &regex, const PieceTable &table, size_t from, size_t lastStart, RegexMatch &match);
+// Last match starting at or before last, searching back a line-aligned window at a time.
+bool FindPiecesRegexBackward(Regex &regex, const PieceTable &table, size_t last, RegexMatch &match);
+
+// $0-$9 and $& insert a group and $$ a dollar sign; \n, \r, \t and \\ are escapes.
+bool RegexReplacementHasGroups(const char16_t *replacement, size_t length);
+void AppendRegexReplacement(std::u16string &out, const char16_t *replacement, size_t length,
+                            const RegexMatch &match, const PieceTable &table);
@@ -0,0 +1,356 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Replace All edit construction for literal and regular-expression matches, with the
+  selection carried through it.
+*/
+
+#include "textreplace.h"
+#include "workpool.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// A match as a worker found it. A replacement expanded for this match alone sits in the
+// chunk's own text until the chunk is added to the table.
+struct ReplaceHit
+{
+    size_t start = 0;
+    size_t end = 0;
+    Piece replacement;
+};
+
+// Starts in [start, end) belong to the chunk. gapStart is where the text kept before its
+// first hit begins, the end of the hit before it.
+struct ReplaceChunk
+{
+    size_t start = 0;
+    size_t end = 0;
+    std::vector<ReplaceHit> hits;
+    std::u16string text;
+    size_t base = 0;
+    size_t gapStart = 0;
+    std::vector<Piece> pieces;
+    size_t inserted = 0;
+};
+
+// Every worker shares the prepared pattern; searching does not change it.
+struct LiteralFinder
+{
+    const PieceTable &table;
+    const NoCasePattern &pattern;
+    bool perMatch;
+    std::u16string shared;
+
+    bool Find(size_t, size_t from, size_t lastStart, ReplaceChunk &, ReplaceHit &hit)
+    {
+        size_t pos = FindPiecesPrepared(table, pattern, from, lastStart);
+        if (pos == TEXT_NPOS)
+            return false;
+        hit.start = pos;
+        hit.end = pos + pattern.length;
+        return true;
+    }
+};
+
+// Each worker searches with its own copy of the regex, whose DFA caches fill as it goes.
+struct RegexFinder
+{
+    const PieceTable &table;
+    std::vector<Regex> regexes;
+    const char16_t *replacement;
+    size_t length;
+    bool perMatch;
+    std::u16string shared;
+
+    bool Find(size_t worker, size_t from, size_t lastStart, ReplaceChunk &chunk, ReplaceHit &hit)
+    {
+        RegexMatch match;
+        if (!FindPiecesRegex(regexes[worker], table, from, lastStart, match))
+            return false;
+        hit.start = match.start;
+        hit.end = match.end;
+        if (perMatch)
+        {
+            size_t at = chunk.text.size();
+            AppendRegexReplacement(chunk.text, replacement, length, match, table);
+            chunk.text.resize(at + CollapseLineBreaks(&chunk.text[at], chunk.text.size() - at));
+            hit.replacement.buffer = 0;
+            hit.replacement.start = at;
+            hit.replacement.length = chunk.text.size() - at;
+            hit.replacement.lines = static_cast<uint32_t>(std::count(chunk.text.begin() + static_cast<std::ptrdiff_t>(at), chunk.text.end(), u'\r'));
+        }
+        return true;
+    }
+};
+
+static size_t MapOffset(size_t offset, size_t mapped, size_t start, size_t end, size_t newEnd)
+{
+    if (offset <= start)
+        return mapped;
+    return offset < end ? newEnd : offset - end + newEnd;
+}
+
+static void BeginReplaceAll(ReplaceAllEdit &out)
+{
+    out.edit = UndoEdit();
+    out.collector = PieceCollector();
+    out.count = 0;
+    out.last = 0;
+    out.newSelStart = out.selStart;
+    out.newSelEnd = out.selEnd;
+}
+
+void AddReplaceMatch(ReplaceAllEdit &out, const PieceTable &table, size_t start, size_t end, const Piece &replacement)
+{
+    if (!out.count)
+    {
+        out.edit.offset = start;
+        out.last = start;
+    }
+    CollectNextPieces(table, out.collector, out.last, start - out.last, out.edit.inserted);
+    if (replacement.length)
+        out.edit.inserted.push_back(replacement);
+    out.edit.insertedLength += start - out.last + replacement.length;
+    out.edit.removedLength = end - out.edit.offset;
+    out.last = end;
+    ++out.count;
+    size_t newEnd = out.edit.offset + out.edit.insertedLength;
+    out.newSelStart = MapOffset(out.selStart, out.newSelStart, start, end, newEnd);
+    out.newSelEnd = MapOffset(out.selEnd, out.newSelEnd, start, end, newEnd);
+}
+
+size_t BuildReplaceAll(PieceTable &table, const NoCasePattern &pattern, const char16_t *replacement, size_t length,
+                       ReplaceAllEdit &out)
+{
+    BeginReplaceAll(out);
+    size_t pos = FindPiecesPrepared(table, pattern, 0);
+    if (pos == TEXT_NPOS)
+        return 0;
+    std::u16string text(replacement, length);
+    text.resize(CollapseLineBreaks(&text[0], text.size()));
+    Piece piece = AddPieceText(table, text.data(), text.size());
+    for (; pos != TEXT_NPOS; pos = FindPiecesPrepared(table, pattern, out.last))
+        AddReplaceMatch(out, table, pos, pos + pattern.length, piece);
+    return out.count;
+}
+
+// When the replacement names no group it is expanded once and shared; otherwise every match
+// gets its own expansion.
+size_t BuildReplaceAllRegex(PieceTable &table, Regex &regex, const char16_t *replacement, size_t length,
+                            ReplaceAllEdit &out)
+{
+    BeginReplaceAll(out);
+    RegexMatch match;
+    if (!FindPiecesRegex(regex, table, 0, TEXT_NPOS, match))
+        return 0;
+    bool perMatch = RegexReplacementHasGroups(replacement, length);
+    std::u16string text;
+    Piece piece;
+    auto expand = [&]()
+    {
+        text.clear();
+        AppendRegexReplacement(text, replacement, length, match, table);
+        text.resize(CollapseLineBreaks(&text[0], text.size()));
+        piece = AddPieceText(table, text.data(), text.size());
+    };
+    if (!perMatch)
+        expand();
+    do
+    {
+        if (perMatch)
+            expand();
+        AddReplaceMatch(out, table, match.start, match.end, piece);
+    } while (FindPiecesRegex(regex, table, match.end > match.start ? match.end : match.end + 1, TEXT_NPOS, match));
+    return out.count;
+}
+
+static size_t NextFrom(const ReplaceHit &hit)
+{
+    return hit.end > hit.start ? hit.end : hit.end + 1;
+}
+
+// A hit from an earlier chunk runs past this chunk's start, so the worker may have followed
+// another chain of matches than the sequential search would. Searching on from where that
+// search stands until it lands on one of the worker's hits joins the two chains again.
+template <typename Finder>
+static void ResyncChunk(Finder &finder, ReplaceChunk &chunk, size_t from)
+{
+    std::vector<ReplaceHit> hits;
+    ReplaceHit hit;
+    auto before = [](const ReplaceHit &h, size_t start)
+    { return h.start < start; };
+    while (from < chunk.end && finder.Find(0, from, chunk.end - 1, chunk, hit))
+    {
+        auto same = std::lower_bound(chunk.hits.begin(), chunk.hits.end(), hit.start, before);
+        if (same != chunk.hits.end() && same->start == hit.start)
+        {
+            hits.insert(hits.end(), same, chunk.hits.end());
+            break;
+        }
+        hits.push_back(hit);
+        from = NextFrom(hit);
+    }
+    chunk.hits.swap(hits);
+}
+
+// Where the sequential builder would leave offset: MapOffset against the last hit starting
+// before it, with the length the edit has reached by then.
+static size_t MapThroughChunks(const std::vector<ReplaceChunk> &chunks, size_t editOffset, size_t offset)
+{
+    size_t mapped = offset;
+    size_t inserted = 0;
+    for (const ReplaceChunk &chunk : chunks)
+    {
+        if (chunk.hits.empty())
+            continue;
+        if (chunk.hits.front().start >= offset)
+            break;
+        if (chunk.hits.back().start < offset)
+        {
+            const ReplaceHit &hit = chunk.hits.back();
+            inserted += chunk.inserted;
+            mapped = MapOffset(offset, mapped, hit.start, hit.end, editOffset + inserted);
+            continue;
+        }
+        size_t last = chunk.gapStart;
+        for (const ReplaceHit &hit : chunk.hits)
+        {
+            if (hit.start >= offset)
+                break;
+            inserted += hit.start - last + hit.replacement.length;
+            last = hit.end;
+            mapped = MapOffset(offset, mapped, hit.start, hit.end, editOffset + inserted);
+        }
+        break;
+    }
+    return mapped;
+}
+
+template <typename Finder>
+static size_t BuildReplaceAllChunked(PieceTable &table, Finder &finder, ReplaceAllEdit &out, size_t threads)
+{
+    BeginReplaceAll(out);
+    // Empty matches can start at the very end, so the last chunk owns table.length too
+    size_t starts = table.length + 1;
+    size_t chunkUnits = (std::max)(starts / (threads * REPLACE_CHUNKS_PER_WORKER) + 1, static_cast<size_t>(REPLACE_CHUNK_MIN_UNITS));
+    std::vector<ReplaceChunk> chunks((starts + chunkUnits - 1) / chunkUnits);
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        chunks[i].start = i * chunkUnits;
+        chunks[i].end = (std::min)(chunks[i].start + chunkUnits, starts);
+    }
+    auto find = [&](size_t index, size_t worker)
+    {
+        ReplaceChunk &chunk = chunks[index];
+        ReplaceHit hit;
+        for (size_t from = chunk.start; from < chunk.end && finder.Find(worker, from, chunk.end - 1, chunk, hit); from = NextFrom(hit))
+            chunk.hits.push_back(hit);
+    };
+    RunWorkStealing(chunks.size(), threads, find);
+
+    size_t count = 0;
+    size_t lastEnd = 0;
+    size_t resume = 0;
+    for (ReplaceChunk &chunk : chunks)
+    {
+        if (count && resume > chunk.start)
+            ResyncChunk(finder, chunk, resume);
+        if (chunk.hits.empty())
+            continue;
+        chunk.gapStart = count ? lastEnd : chunk.hits.front().start;
+        count += chunk.hits.size();
+        lastEnd = chunk.hits.back().end;
+        resume = NextFrom(chunk.hits.back());
+    }
+    if (!count)
+        return 0;
+    Piece shared;
+    if (finder.perMatch)
+    {
+        for (ReplaceChunk &chunk : chunks)
+            if (!chunk.hits.empty() && !chunk.text.empty())
+                chunk.base = AddPieceText(table, chunk.text.data(), chunk.text.size()).start;
+    }
+    else
+        shared = AddPieceText(table, finder.shared.data(), finder.shared.size());
+
+    auto collect = [&](size_t index, size_t)
+    {
+        ReplaceChunk &chunk = chunks[index];
+        PieceCollector collector;
+        size_t last = chunk.gapStart;
+        for (ReplaceHit &hit : chunk.hits)
+        {
+            if (finder.perMatch)
+                hit.replacement.start += chunk.base;
+            else
+                hit.replacement = shared;
+            CollectNextPieces(table, collector, last, hit.start - last, chunk.pieces);
+            if (hit.replacement.length)
+                chunk.pieces.push_back(hit.replacement);
+            chunk.inserted += hit.start - last + hit.replacement.length;
+            last = hit.end;
+        }
+    };
+    RunWorkStealing(chunks.size(), threads, collect);
+
+    // A prefix sum of the piece counts places every chunk in the edit, so they copy in parallel
+    std::vector<size_t> placed(chunks.size() + 1, 0);
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        placed[i + 1] = placed[i] + chunks[i].pieces.size();
+        out.edit.insertedLength += chunks[i].inserted;
+    }
+    out.edit.inserted.resize(placed.back());
+    auto stitch = [&](size_t index, size_t)
+    {
+        std::copy(chunks[index].pieces.begin(), chunks[index].pieces.end(), out.edit.inserted.begin() + static_cast<std::ptrdiff_t>(placed[index]));
+    };
+    RunWorkStealing(chunks.size(), threads, stitch);
+    for (const ReplaceChunk &chunk : chunks)
+        if (!chunk.hits.empty())
+        {
+            out.edit.offset = chunk.hits.front().start;
+            break;
+        }
+    out.count = count;
+    out.last = lastEnd;
+    out.edit.removedLength = lastEnd - out.edit.offset;
+    out.newSelStart = MapThroughChunks(chunks, out.edit.offset, out.selStart);
+    out.newSelEnd = MapThroughChunks(chunks, out.edit.offset, out.selEnd);
+    return count;
+}
+
+size_t BuildReplaceAllParallel(PieceTable &table, const NoCasePattern &pattern, const char16_t *replacement, size_t length,
+                               ReplaceAllEdit &out, size_t threads)
+{
+    if (!threads)
+        threads = DefaultWorkerCount();
+    LiteralFinder finder{table, pattern, false, std::u16string(replacement, length)};
+    finder.shared.resize(CollapseLineBreaks(&finder.shared[0], finder.shared.size()));
+    return BuildReplaceAllChunked(table, finder, out, threads);
+}
+
+size_t BuildReplaceAllRegexParallel(PieceTable &table, const Regex &regex, const char16_t *replacement, size_t length,
+                                    ReplaceAllEdit &out, size_t threads)
+{
+    if (!threads)
+        threads = DefaultWorkerCount();
+    RegexFinder finder{table, std::vector<Regex>(threads, regex), replacement, length, RegexReplacementHasGroups(replacement, length), std::u16string()};
+    if (!finder.perMatch)
+    {
+        // Without group references the expansion does not depend on the match
+        AppendRegexReplacement(finder.shared, replacement, length, RegexMatch(), table);
+        finder.shared.resize(CollapseLineBreaks(&finder.shared[0], finder.shared.size()));
+    }
+    return BuildReplaceAllChunked(table, finder, out, threads);
+}
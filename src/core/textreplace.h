@@ -0,0 +1,62 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Replace All as one edit over the piece table: the text between matches is kept as the
+  pieces it already is and every match becomes a piece of its replacement.
+*/
+
+#pragma once
+
+#include "piecetable.h"
+#include "textregex.h"
+#include "textscan.h"
+#include "undohistory.h"
+#include <cstddef>
+
+// Documents from this size on are replaced on every core
+#define REPLACE_PARALLEL_MIN_UNITS (8u << 20)
+// Chunks handed out per worker, so the pool has work to steal when matches bunch up
+#define REPLACE_CHUNKS_PER_WORKER 8
+// Chunks below this size are not worth a task
+#define REPLACE_CHUNK_MIN_UNITS (256u << 10)
+
+// The edit a Replace All makes, built match by match without copying the text it keeps.
+// selStart/selEnd are the selection before it; newSelStart/newSelEnd is where it lands.
+struct ReplaceAllEdit
+{
+    UndoEdit edit;
+    PieceCollector collector;
+    size_t count = 0;
+    // End of the last match; the edit spans [edit.offset, last)
+    size_t last = 0;
+    size_t selStart = 0;
+    size_t selEnd = 0;
+    size_t newSelStart = 0;
+    size_t newSelEnd = 0;
+};
+
+// Matches are added in order and must not overlap. An offset before or at a match start keeps
+// its place, one inside a match moves to the end of its replacement.
+void AddReplaceMatch(ReplaceAllEdit &out, const PieceTable &table, size_t start, size_t end, const Piece &replacement);
+// Both return the number of matches. The replacement text is added to the table's buffers but
+// the table itself is left as it is; the caller applies out.edit.
+size_t BuildReplaceAll(PieceTable &table, const NoCasePattern &pattern, const char16_t *replacement, size_t length,
+                       ReplaceAllEdit &out);
+size_t BuildReplaceAllRegex(PieceTable &table, Regex &regex, const char16_t *replacement, size_t length,
+                            ReplaceAllEdit &out);
+// The same edits, piece for piece, with the work spread over threads (0 for one per core).
+// Workers search their chunk of the document for the matches starting in it, reading past its
+// end as far as a match runs, then the chunks are joined in order where a match from one runs
+// into the next. The regex is copied for every worker.
+size_t BuildReplaceAllParallel(PieceTable &table, const NoCasePattern &pattern, const char16_t *replacement, size_t length,
+                               ReplaceAllEdit &out, size_t threads);
+size_t BuildReplaceAllRegexParallel(PieceTable &table, const Regex &regex, const char16_t *replacement, size_t length,
+                                    ReplaceAllEdit &out, size_t threads);
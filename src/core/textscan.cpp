@@ -0,0 +1,410 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Portable text scanning used by find, print and go-to: case-insensitive search on a fold
+  table with Horspool skips and a SIMD filter, line splitting and line-offset lookup.
+*/
+
+#include "textscan.h"
+#include "cpu.h"
+#include <cwctype>
+
+#ifdef NOTEPAD_X86
+#include <immintrin.h>
+#endif
+
+static std::vector<char16_t> BuildFoldTable()
+{
+    std::vector<char16_t> table(0x10000);
+    for (size_t c = 0; c < table.size(); ++c)
+        table[c] = static_cast<char16_t>(towlower(static_cast<wint_t>(c)));
+    return table;
+}
+
+const char16_t *FoldTable()
+{
+    static const std::vector<char16_t> table = BuildFoldTable();
+    return table.data();
+}
+
+static size_t FoldVariants(const char16_t *fold, char16_t target, char16_t *variants)
+{
+    size_t count = 0;
+    for (size_t c = 0; c < 0x10000; ++c)
+    {
+        if (fold[c] != target)
+            continue;
+        if (count == TEXT_FOLD_VARIANTS)
+            return 0;
+        variants[count++] = static_cast<char16_t>(c);
+    }
+    return count;
+}
+
+void PrepareNoCase(NoCasePattern &prepared, const char16_t *pattern, size_t patternLen)
+{
+    const char16_t *fold = FoldTable();
+    char16_t *folded = prepared.inlineFolded;
+    if (patternLen > TEXT_PATTERN_INLINE)
+    {
+        prepared.heapFolded.resize(patternLen);
+        folded = &prepared.heapFolded[0];
+    }
+    for (size_t k = 0; k < patternLen; ++k)
+        folded[k] = fold[pattern[k]];
+    prepared.folded = folded;
+    prepared.length = patternLen;
+    prepared.firstCount = prepared.lastCount = 0;
+    if (patternLen == 0)
+        return;
+    prepared.firstCount = FoldVariants(fold, folded[0], prepared.firstVariants);
+    prepared.lastCount = FoldVariants(fold, folded[patternLen - 1], prepared.lastVariants);
+    for (size_t &s : prepared.skip)
+        s = patternLen;
+    for (size_t &s : prepared.skipBack)
+        s = patternLen;
+    for (size_t k = 0; k + 1 < patternLen; ++k)
+        prepared.skip[folded[k] & 0xFF] = patternLen - 1 - k;
+    for (size_t k = patternLen - 1; k > 0; --k)
+        prepared.skipBack[folded[k] & 0xFF] = k;
+}
+
+bool MatchesPreparedAt(const NoCasePattern &prepared, size_t at, const char16_t *text, size_t n)
+{
+    const char16_t *fold = FoldTable();
+    const char16_t *folded = prepared.folded + at;
+    for (size_t k = 0; k < n; ++k)
+        if (fold[text[k]] != folded[k])
+            return false;
+    return true;
+}
+
+static inline bool MatchesAt(const char16_t *fold, const NoCasePattern &prepared, const char16_t *text)
+{
+    for (size_t k = 0; k < prepared.length; ++k)
+        if (fold[text[k]] != prepared.folded[k])
+            return false;
+    return true;
+}
+
+// Boyer-Moore-Horspool on folded units, skipping by the low byte of the unit under the
+// pattern's last character.
+static size_t FindHorspool(const char16_t *fold, const NoCasePattern &prepared, const char16_t *text, size_t size, size_t i)
+{
+    size_t m = prepared.length;
+    char16_t lastFolded = prepared.folded[m - 1];
+    while (i + m <= size)
+    {
+        char16_t c = fold[text[i + m - 1]];
+        if (c == lastFolded && MatchesAt(fold, prepared, text + i))
+            return i;
+        i += prepared.skip[c & 0xFF];
+    }
+    return TEXT_NPOS;
+}
+
+// The same run backwards from the highest start i, skipping by the unit under the first
+// character.
+static size_t FindHorspoolBackward(const char16_t *fold, const NoCasePattern &prepared, const char16_t *text, size_t i)
+{
+    char16_t firstFolded = prepared.folded[0];
+    for (;;)
+    {
+        char16_t c = fold[text[i]];
+        if (c == firstFolded && MatchesAt(fold, prepared, text + i))
+            return i;
+        size_t s = prepared.skipBack[c & 0xFF];
+        if (i < s)
+            return TEXT_NPOS;
+        i -= s;
+    }
+}
+
+#ifdef NOTEPAD_X86
+
+// Starts in [i, i + 8) whose first and last units could fold to the pattern's, two mask bits
+// per unit.
+NOTEPAD_TARGET("sse2")
+static inline uint32_t CandidatesSse2(const NoCasePattern &prepared, const __m128i *first, const __m128i *last, const char16_t *text)
+{
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + prepared.length - 1));
+    __m128i hitA = _mm_cmpeq_epi16(a, first[0]);
+    for (size_t k = 1; k < prepared.firstCount; ++k)
+        hitA = _mm_or_si128(hitA, _mm_cmpeq_epi16(a, first[k]));
+    __m128i hitB = _mm_cmpeq_epi16(b, last[0]);
+    for (size_t k = 1; k < prepared.lastCount; ++k)
+        hitB = _mm_or_si128(hitB, _mm_cmpeq_epi16(b, last[k]));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(hitA, hitB)));
+}
+
+NOTEPAD_TARGET("sse2")
+static size_t FindSse2(const char16_t *fold, const NoCasePattern &prepared, const char16_t *text, size_t size, size_t i)
+{
+    __m128i first[TEXT_FOLD_VARIANTS], last[TEXT_FOLD_VARIANTS];
+    for (size_t k = 0; k < prepared.firstCount; ++k)
+        first[k] = _mm_set1_epi16(static_cast<short>(prepared.firstVariants[k]));
+    for (size_t k = 0; k < prepared.lastCount; ++k)
+        last[k] = _mm_set1_epi16(static_cast<short>(prepared.lastVariants[k]));
+    size_t m = prepared.length;
+    for (; i + m - 1 + 8 <= size; i += 8)
+    {
+        uint32_t mask = CandidatesSse2(prepared, first, last, text + i);
+        while (mask)
+        {
+            unsigned k = CountTrailingZeros(mask) / 2;
+            if (MatchesAt(fold, prepared, text + i + k))
+                return i + k;
+            mask &= ~(3u << (2 * k));
+        }
+    }
+    return FindHorspool(fold, prepared, text, size, i);
+}
+
+NOTEPAD_TARGET("sse2")
+static size_t FindBackwardSse2(const char16_t *fold, const NoCasePattern &prepared, const char16_t *text, size_t i)
+{
+    __m128i first[TEXT_FOLD_VARIANTS], last[TEXT_FOLD_VARIANTS];
+    for (size_t k = 0; k < prepared.firstCount; ++k)
+        first[k] = _mm_set1_epi16(static_cast<short>(prepared.firstVariants[k]));
+    for (size_t k = 0; k < prepared.lastCount; ++k)
+        last[k] = _mm_set1_epi16(static_cast<short>(prepared.lastVariants[k]));
+    // Blocks of starts [end - 8, end) going down from the highest start i
+    size_t end = i + 1;
+    for (; end >= 8; end -= 8)
+    {
+        uint32_t mask = CandidatesSse2(prepared, first, last, text + end - 8);
+        while (mask)
+        {
+            unsigned k = HighestSetBit(mask) / 2;
+            if (MatchesAt(fold, prepared, text + end - 8 + k))
+                return end - 8 + k;
+            mask &= ~(3u << (2 * k));
+        }
+    }
+    return end ? FindHorspoolBackward(fold, prepared, text, end - 1) : TEXT_NPOS;
+}
+
+NOTEPAD_TARGET("avx2")
+static inline uint32_t CandidatesAvx2(const NoCasePattern &prepared, const __m256i *first, const __m256i *last, const char16_t *text)
+{
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + prepared.length - 1));
+    __m256i hitA = _mm256_cmpeq_epi16(a, first[0]);
+    for (size_t k = 1; k < prepared.firstCount; ++k)
+        hitA = _mm256_or_si256(hitA, _mm256_cmpeq_epi16(a, first[k]));
+    __m256i hitB = _mm256_cmpeq_epi16(b, last[0]);
+    for (size_t k = 1; k < prepared.lastCount; ++k)
+        hitB = _mm256_or_si256(hitB, _mm256_cmpeq_epi16(b, last[k]));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(hitA, hitB)));
+}
+
+NOTEPAD_TARGET("avx2")
+static size_t FindAvx2(const char16_t *fold, const NoCasePattern &prepared, const char16_t *text, size_t size, size_t i)
+{
+    __m256i first[TEXT_FOLD_VARIANTS], last[TEXT_FOLD_VARIANTS];
+    for (size_t k = 0; k < prepared.firstCount; ++k)
+        first[k] = _mm256_set1_epi16(static_cast<short>(prepared.firstVariants[k]));
+    for (size_t k = 0; k < prepared.lastCount; ++k)
+        last[k] = _mm256_set1_epi16(static_cast<short>(prepared.lastVariants[k]));
+    size_t m = prepared.length;
+    for (; i + m - 1 + 16 <= size; i += 16)
+    {
+        uint32_t mask = CandidatesAvx2(prepared, first, last, text + i);
+        while (mask)
+        {
+            unsigned k = CountTrailingZeros(mask) / 2;
+            if (MatchesAt(fold, prepared, text + i + k))
+                return i + k;
+            mask &= ~(3u << (2 * k));
+        }
+    }
+    return FindSse2(fold, prepared, text, size, i);
+}
+
+NOTEPAD_TARGET("avx2")
+static size_t FindBackwardAvx2(const char16_t *fold, const NoCasePattern &prepared, const char16_t *text, size_t i)
+{
+    __m256i first[TEXT_FOLD_VARIANTS], last[TEXT_FOLD_VARIANTS];
+    for (size_t k = 0; k < prepared.firstCount; ++k)
+        first[k] = _mm256_set1_epi16(static_cast<short>(prepared.firstVariants[k]));
+    for (size_t k = 0; k < prepared.lastCount; ++k)
+        last[k] = _mm256_set1_epi16(static_cast<short>(prepared.lastVariants[k]));
+    size_t end = i + 1;
+    for (; end >= 16; end -= 16)
+    {
+        uint32_t mask = CandidatesAvx2(prepared, first, last, text + end - 16);
+        while (mask)
+        {
+            unsigned k = HighestSetBit(mask) / 2;
+            if (MatchesAt(fold, prepared, text + end - 16 + k))
+                return end - 16 + k;
+            mask &= ~(3u << (2 * k));
+        }
+    }
+    return end ? FindBackwardSse2(fold, prepared, text, end - 1) : TEXT_NPOS;
+}
+
+#endif
+
+size_t FindPrepared(const NoCasePattern &prepared, const char16_t *text, size_t size, size_t from)
+{
+    size_t m = prepared.length;
+    if (m == 0 || m > size || from > size - m)
+        return TEXT_NPOS;
+    const char16_t *fold = FoldTable();
+#ifdef NOTEPAD_X86
+    if (prepared.firstCount && prepared.lastCount)
+    {
+        switch (ActiveSimdLevel())
+        {
+        case SimdLevel::AVX2:
+            return FindAvx2(fold, prepared, text, size, from);
+        case SimdLevel::SSE2:
+        case SimdLevel::SSSE3:
+            return FindSse2(fold, prepared, text, size, from);
+        default:
+            break;
+        }
+    }
+#endif
+    return FindHorspool(fold, prepared, text, size, from);
+}
+
+size_t FindPreparedBackward(const NoCasePattern &prepared, const char16_t *text, size_t size, size_t last)
+{
+    size_t m = prepared.length;
+    if (m == 0 || m > size)
+        return TEXT_NPOS;
+    size_t i = last < size - m ? last : size - m;
+    const char16_t *fold = FoldTable();
+#ifdef NOTEPAD_X86
+    if (prepared.firstCount && prepared.lastCount)
+    {
+        switch (ActiveSimdLevel())
+        {
+        case SimdLevel::AVX2:
+            return FindBackwardAvx2(fold, prepared, text, i);
+        case SimdLevel::SSE2:
+        case SimdLevel::SSSE3:
+            return FindBackwardSse2(fold, prepared, text, i);
+        default:
+            break;
+        }
+    }
+#endif
+    return FindHorspoolBackward(fold, prepared, text, i);
+}
+
+size_t FindNoCase(const char16_t *text, size_t size, const char16_t *pattern, size_t patternLen, size_t from)
+{
+    if (patternLen == 0 || patternLen > size || from > size - patternLen)
+        return TEXT_NPOS;
+    NoCasePattern prepared;
+    PrepareNoCase(prepared, pattern, patternLen);
+    return FindPrepared(prepared, text, size, from);
+}
+
+size_t FindNoCaseBackward(const char16_t *text, size_t size, const char16_t *pattern, size_t patternLen, size_t last)
+{
+    if (patternLen == 0 || patternLen > size)
+        return TEXT_NPOS;
+    NoCasePattern prepared;
+    PrepareNoCase(prepared, pattern, patternLen);
+    return FindPreparedBackward(prepared, text, size, last);
+}
+
+size_t FindWrapped(const char16_t *text, size_t size, const char16_t *pattern, size_t patternLen,
+                   size_t selStart, size_t selEnd, bool forward)
+{
+    if (patternLen == 0 || patternLen > size)
+        return TEXT_NPOS;
+    NoCasePattern prepared;
+    PrepareNoCase(prepared, pattern, patternLen);
+    size_t pos = TEXT_NPOS;
+    if (forward)
+    {
+        pos = FindPrepared(prepared, text, size, selEnd);
+        if (pos == TEXT_NPOS)
+            pos = FindPrepared(prepared, text, size, 0);
+    }
+    else
+    {
+        if (selStart > 0)
+            pos = FindPreparedBackward(prepared, text, size, selStart - 1);
+        if (pos == TEXT_NPOS)
+            pos = FindPreparedBackward(prepared, text, size, TEXT_NPOS);
+    }
+    return pos;
+}
+
+bool EqualsNoCase(const char16_t *a, const char16_t *b, size_t length)
+{
+    const char16_t *fold = FoldTable();
+    for (size_t k = 0; k < length; ++k)
+        if (fold[a[k]] != fold[b[k]])
+            return false;
+    return true;
+}
+
+std::vector<TextSpan> SplitLines(const char16_t *text, size_t size)
+{
+    std::vector<TextSpan> lines;
+    size_t start = 0;
+    for (size_t i = 0; i <= size; ++i)
+    {
+        if (i == size || text[i] == u'\n' || text[i] == u'\r')
+        {
+            TextSpan span;
+            span.start = start;
+            span.length = i - start;
+            lines.push_back(span);
+            if (i < size && text[i] == u'\r' && i + 1 < size && text[i + 1] == u'\n')
+                ++i;
+            start = i + 1;
+        }
+    }
+    return lines;
+}
+
+size_t LineStartOffset(const char16_t *text, size_t size, size_t line)
+{
+    size_t current = 1;
+    size_t i = 0;
+    while (current < line)
+    {
+        while (i < size && text[i] != u'\n' && text[i] != u'\r')
+            ++i;
+        if (i == size)
+            return size;
+        if (text[i] == u'\r' && i + 1 < size && text[i + 1] == u'\n')
+            ++i;
+        ++i;
+        ++current;
+    }
+    return i;
+}
+
+size_t CollapseLineBreaks(char16_t *text, size_t size)
+{
+    size_t out = 0;
+    char16_t prev = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        char16_t c = text[i];
+        bool pairedLF = c == u'\n' && prev == u'\r';
+        prev = c;
+        if (pairedLF)
+            continue;
+        text[out++] = c == u'\n' ? u'\r' : c;
+    }
+    return out;
+}
@@ -0,0 +1,81 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Portable text scanning used by find, print and go-to: case-insensitive search,
+  line splitting and line-offset lookup over UTF-16 buffers.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#define TEXT_NPOS (static_cast<size_t>(-1))
+
+struct TextSpan
+{
+    size_t start = 0;
+    size_t length = 0;
+};
+
+// towlower for every BMP code unit, so folding is one load instead of a locale call.
+const char16_t *FoldTable();
+
+#define TEXT_PATTERN_INLINE 64
+#define TEXT_FOLD_VARIANTS 4
+
+// A search pattern folded once (towlower per code unit, from a table built on first use)
+// with the Horspool skips and the units that fold to its first and last characters for the
+// SIMD filter. Searching with it allocates nothing; patterns longer than TEXT_PATTERN_INLINE
+// keep their folded copy on the heap.
+struct NoCasePattern
+{
+    NoCasePattern() = default;
+    NoCasePattern(const NoCasePattern &) = delete;
+    NoCasePattern &operator=(const NoCasePattern &) = delete;
+
+    const char16_t *folded = nullptr;
+    size_t length = 0;
+    char16_t inlineFolded[TEXT_PATTERN_INLINE];
+    std::u16string heapFolded;
+    // Zero counts mean too many units fold to that character for the filter to pay off
+    char16_t firstVariants[TEXT_FOLD_VARIANTS];
+    char16_t lastVariants[TEXT_FOLD_VARIANTS];
+    size_t firstCount = 0;
+    size_t lastCount = 0;
+    // Indexed by the low byte of a folded unit
+    size_t skip[256];
+    size_t skipBack[256];
+};
+
+void PrepareNoCase(NoCasePattern &prepared, const char16_t *pattern, size_t patternLen);
+size_t FindPrepared(const NoCasePattern &prepared, const char16_t *text, size_t size, size_t from);
+size_t FindPreparedBackward(const NoCasePattern &prepared, const char16_t *text, size_t size, size_t last);
+// Whether the n units of text match the folded pattern starting at its unit at.
+bool MatchesPreparedAt(const NoCasePattern &prepared, size_t at, const char16_t *text, size_t n);
+
+// Case-insensitive (towlower per code unit) search for the first match at or after from.
+size_t FindNoCase(const char16_t *text, size_t size, const char16_t *pattern, size_t patternLen, size_t from);
+// Last match starting at or before last (TEXT_NPOS searches the whole text).
+size_t FindNoCaseBackward(const char16_t *text, size_t size, const char16_t *pattern, size_t patternLen, size_t last);
+// Find Next/Previous from the selection [selStart, selEnd), wrapping around the document.
+size_t FindWrapped(const char16_t *text, size_t size, const char16_t *pattern, size_t patternLen,
+                   size_t selStart, size_t selEnd, bool forward);
+bool EqualsNoCase(const char16_t *a, const char16_t *b, size_t length);
+
+// Splits at CRLF, CR or LF. A trailing line break yields a final empty line.
+std::vector<TextSpan> SplitLines(const char16_t *text, size_t size);
+// Offset of the first character of 1-based line, or size if the text has fewer lines.
+size_t LineStartOffset(const char16_t *text, size_t size, size_t line);
+// Rewrites CRLF and LF as CR in place, the way RichEdit stores paragraph ends, and returns
+// the new size.
+size_t CollapseLineBreaks(char16_t *text, size_t size);
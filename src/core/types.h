@@ -18,12 +18,14 @@
 #include <windows.h>
 #include <string>
 #include <deque>
+#include "textcodec.h"
 
 #define APP_NAME L"Notepad"
 #define ZOOM_MIN 25
 #define ZOOM_MAX 500
 #define ZOOM_DEFAULT 100
 #define MAX_RECENT_FILES 10
+#define VIEWER_THRESHOLD_DEFAULT (256ull << 20)
 
 #ifndef DWMWA_USE_IMMERSIVE_DARK_MODE
 #define DWMWA_USE_IMMERSIVE_DARK_MODE 20
@@ -32,20 +34,18 @@
 #define WM_UAHDRAWMENU 0x0091
 #define WM_UAHDRAWMENUITEM 0x0092
 
-enum class Encoding
-{
-    UTF8,
-    UTF8BOM,
-    UTF16LE,
-    UTF16BE,
-    ANSI
-};
-enum class LineEnding
-{
-    CRLF,
-    LF,
-    CR
-};
+#define WM_APP_LOADCHUNK (WM_APP + 1)
+#define WM_APP_LOADDONE (WM_APP + 2)
+#define WM_APP_INDEXCHUNK (WM_APP + 3)
+#define WM_APP_FOLLOWCHECK (WM_APP + 4)
+#define WM_APP_BGREADY (WM_APP + 5)
+#define WM_APP_FINDALL (WM_APP + 6)
+#define IDT_JOURNAL 1
+#define IDT_STATUS 2
+#define IDT_FINDALL 3
+#define STATUS_TEXT_MAX 256
+#define STATUS_PART_COUNT 5
+
 enum class BgPosition
 {
     TopLeft,
@@ -110,6 +110,7 @@ struct AppState
     LineEnding lineEnding = LineEnding::CRLF;
     std::wstring findText;
     std::wstring replaceText;
+    bool findRegex = false;
     bool wordWrap = false;
     int zoomLevel = ZOOM_DEFAULT;
     bool showStatusBar = true;
@@ -118,9 +119,12 @@ struct AppState
     std::wstring fontName = L"Consolas";
     BYTE windowOpacity = 255;
     bool alwaysOnTop = false;
+    bool followMode = false;
+    bool hotExit = false;
     bool closing = false;
     HFONT hFont = nullptr;
     std::deque<std::wstring> recentFiles;
+    ULONGLONG viewerThreshold = VIEWER_THRESHOLD_DEFAULT;
     BackgroundSettings background;
 };
 
@@ -0,0 +1,218 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Undo history for the piece table document: typing runs coalesce into one step, groups
+  become one step, and the oldest steps are evicted past the memory limit.
+*/
+
+#include "undohistory.h"
+
+static size_t PiecesCost(const UndoEdit &edit)
+{
+    return sizeof(UndoEdit) + (edit.removed.size() + edit.inserted.size()) * sizeof(Piece);
+}
+
+// Cost of an edit while it is applied, when the removed text is only kept by the history.
+static size_t EditCost(const UndoEdit &edit)
+{
+    return PiecesCost(edit) + edit.removedLength * sizeof(char16_t);
+}
+
+static size_t StepCost(const UndoStep &step, bool applied)
+{
+    size_t cost = 0;
+    for (const UndoEdit &edit : step.edits)
+        cost += applied ? EditCost(edit) : PiecesCost(edit) + edit.insertedLength * sizeof(char16_t);
+    return cost;
+}
+
+
+void ClearUndo(UndoHistory &history)
+{
+    std::deque<UndoStep>().swap(history.steps);
+    history.done = 0;
+    history.cost = 0;
+    history.released = 0;
+    history.groupOpen = false;
+    history.sealed = true;
+}
+
+static void DropRedo(UndoHistory &history)
+{
+    while (history.steps.size() > history.done)
+    {
+        history.cost -= history.steps.back().cost;
+        history.released += history.steps.back().cost;
+        history.steps.pop_back();
+    }
+}
+
+// Always keeps the newest step, however large.
+static void EvictOldest(UndoHistory &history)
+{
+    while (history.cost > history.limit && history.done > 1 && !history.groupOpen)
+    {
+        history.cost -= history.steps.front().cost;
+        history.released += history.steps.front().cost;
+        history.steps.pop_front();
+        --history.done;
+    }
+}
+
+// Recounts a step that was undone or redone, which moves the text it keeps from what it
+// removed to what it inserted or back. Nothing is evicted here, so undoing all the way back
+// and redoing again still works; the next record drops the redo steps and evicts as needed.
+static void SetStepCost(UndoHistory &history, UndoStep &step, bool applied)
+{
+    history.cost -= step.cost;
+    step.cost = StepCost(step, applied);
+    history.cost += step.cost;
+}
+
+void BeginUndoGroup(UndoHistory &history)
+{
+    if (history.groupDepth++ == 0)
+        history.groupOpen = false;
+}
+
+void EndUndoGroup(UndoHistory &history)
+{
+    if (--history.groupDepth > 0)
+        return;
+    history.groupOpen = false;
+    history.sealed = true;
+    EvictOldest(history);
+}
+
+static void AppendInserted(UndoEdit &last, UndoEdit &edit)
+{
+    for (const Piece &piece : edit.inserted)
+    {
+        Piece *tail = last.inserted.empty() ? nullptr : &last.inserted.back();
+        if (tail && tail->buffer == piece.buffer && tail->start + tail->length == piece.start)
+        {
+            tail->length += piece.length;
+            tail->lines += piece.lines;
+        }
+        else
+            last.inserted.push_back(piece);
+    }
+    last.insertedLength += edit.insertedLength;
+}
+
+// Joins edit to the typing edit before it when it continues it, and says whether it did.
+static bool ExtendTyping(UndoEdit &last, UndoEdit &edit)
+{
+    if (!edit.removedLength && last.offset + last.insertedLength == edit.offset)
+    {
+        AppendInserted(last, edit);
+        return true;
+    }
+    if (edit.insertedLength || last.insertedLength)
+        return false;
+    // Backspace: the removed text goes in front
+    if (edit.offset + edit.removedLength == last.offset)
+    {
+        edit.removed.insert(edit.removed.end(), last.removed.begin(), last.removed.end());
+        last.removed.swap(edit.removed);
+        last.offset = edit.offset;
+        last.removedLength += edit.removedLength;
+        return true;
+    }
+    // Delete: the removed text goes behind
+    if (edit.offset == last.offset)
+    {
+        last.removed.insert(last.removed.end(), edit.removed.begin(), edit.removed.end());
+        last.removedLength += edit.removedLength;
+        return true;
+    }
+    return false;
+}
+
+void RecordUndo(UndoHistory &history, UndoEdit &&edit, bool typing)
+{
+    DropRedo(history);
+    if (history.groupDepth > 0 && history.groupOpen)
+    {
+        edit.removed.shrink_to_fit();
+        edit.inserted.shrink_to_fit();
+        UndoStep &step = history.steps.back();
+        size_t cost = EditCost(edit);
+        step.edits.push_back(std::move(edit));
+        step.cost += cost;
+        history.cost += cost;
+        return;
+    }
+    if (typing && !history.groupDepth && !history.sealed && !history.steps.empty() && history.steps.back().typing)
+    {
+        UndoStep &step = history.steps.back();
+        UndoEdit &last = step.edits.back();
+        size_t before = EditCost(last);
+        if (ExtendTyping(last, edit))
+        {
+            size_t after = EditCost(last);
+            step.cost += after - before;
+            history.cost += after - before;
+            EvictOldest(history);
+            return;
+        }
+    }
+    if (!typing)
+    {
+        edit.removed.shrink_to_fit();
+        edit.inserted.shrink_to_fit();
+    }
+    UndoStep step;
+    step.typing = typing && !history.groupDepth;
+    step.cost = EditCost(edit);
+    step.edits.push_back(std::move(edit));
+    history.cost += step.cost;
+    history.steps.push_back(std::move(step));
+    history.done = history.steps.size();
+    history.groupOpen = history.groupDepth > 0;
+    history.sealed = !typing || history.groupDepth > 0;
+    EvictOldest(history);
+}
+
+const UndoStep *TakeUndo(UndoHistory &history)
+{
+    if (!history.done || history.groupDepth)
+        return nullptr;
+    history.sealed = true;
+    UndoStep &step = history.steps[--history.done];
+    SetStepCost(history, step, false);
+    return &step;
+}
+
+const UndoStep *TakeRedo(UndoHistory &history)
+{
+    if (history.done == history.steps.size() || history.groupDepth)
+        return nullptr;
+    history.sealed = true;
+    UndoStep &step = history.steps[history.done++];
+    SetStepCost(history, step, true);
+    return &step;
+}
+
+size_t CompactUndoBuffers(UndoHistory &history, PieceTable &table)
+{
+    std::vector<std::vector<Piece> *> kept;
+    for (UndoStep &step : history.steps)
+    {
+        for (UndoEdit &edit : step.edits)
+        {
+            kept.push_back(&edit.removed);
+            kept.push_back(&edit.inserted);
+        }
+    }
+    history.released = 0;
+    return CompactPieces(table, kept);
+}
@@ -0,0 +1,75 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Undo history for the piece table document. Steps hold the pieces of the text before and
+  after each edit, so undo and redo splice them back without copying any text.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include "piecetable.h"
+
+#define UNDO_DEFAULT_LIMIT (64u << 20)
+
+// One replace at offset: removed and inserted are the pieces of the text before and after it.
+// They point into the document's buffers, which keep the text alive until CompactUndoBuffers
+// finds nothing uses it any more.
+struct UndoEdit
+{
+    size_t offset = 0;
+    size_t removedLength = 0;
+    size_t insertedLength = 0;
+    std::vector<Piece> removed;
+    std::vector<Piece> inserted;
+};
+
+// Edits undone and redone as one step. A typing step can still be extended by the next
+// keystroke next to it.
+struct UndoStep
+{
+    std::vector<UndoEdit> edits;
+    size_t cost = 0;
+    bool typing = false;
+};
+
+// steps[0, done) are applied and the rest can be redone. cost is the memory the steps hold:
+// their pieces, and the text only they keep in the buffers, which is what an applied step
+// removed and what an undone one inserted. The oldest steps are dropped when a record takes it past
+// limit; an undo or redo recounts the step without dropping any. released counts what dropped steps held until the buffers are compacted.
+struct UndoHistory
+{
+    std::deque<UndoStep> steps;
+    size_t done = 0;
+    size_t cost = 0;
+    size_t released = 0;
+    size_t limit = UNDO_DEFAULT_LIMIT;
+    int groupDepth = 0;
+    bool groupOpen = false;
+    bool sealed = true;
+};
+
+void ClearUndo(UndoHistory &history);
+// Edits recorded between Begin and EndUndoGroup are undone as one step.
+void BeginUndoGroup(UndoHistory &history);
+void EndUndoGroup(UndoHistory &history);
+// Records an edit already made to the document. Typing edits join the typing step before
+// them when they continue it: inserts right after it, or deletes right before or at it.
+void RecordUndo(UndoHistory &history, UndoEdit &&edit, bool typing);
+// The step to undo, with its edits to be reverted last to first, or nullptr.
+const UndoStep *TakeUndo(UndoHistory &history);
+// The step to redo, with its edits to be applied first to last, or nullptr.
+const UndoStep *TakeRedo(UndoHistory &history);
+// Drops the text no step and not the document uses from table's buffers, so what the dropped
+// steps held is given back. Returns the units dropped.
+size_t CompactUndoBuffers(UndoHistory &history, PieceTable &table);
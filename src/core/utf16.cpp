@@ -0,0 +1,162 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  UTF-16 byte-order kernels: unaligned copy/byte-swap of code units and a line-break
+  scan, with SSE2/SSSE3/AVX2 variants behind the runtime dispatch level.
+*/
+
+#include "textcodec.h"
+#include "cpu.h"
+#include <cstring>
+
+#ifdef NOTEPAD_X86
+#include <immintrin.h>
+#endif
+
+// The editor's wchar_t buffers are little-endian on every supported target, so LE data is a
+// plain copy and BE data needs each unit's bytes swapped.
+static void SwapUtf16Scalar(const uint8_t *src, uint8_t *dst, size_t units)
+{
+    for (size_t k = 0; k < units; ++k)
+    {
+        uint8_t lo = src[2 * k];
+        dst[2 * k] = src[2 * k + 1];
+        dst[2 * k + 1] = lo;
+    }
+}
+
+static size_t FindLineBreakScalar(const char16_t *text, size_t i, size_t size)
+{
+    while (i < size && text[i] != u'\r' && text[i] != u'\n')
+        ++i;
+    return i;
+}
+
+#ifdef NOTEPAD_X86
+
+NOTEPAD_TARGET("sse2")
+static void SwapUtf16Sse2(const uint8_t *src, uint8_t *dst, size_t units)
+{
+    size_t k = 0;
+    for (; k + 8 <= units; k += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * k));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * k), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+    }
+    SwapUtf16Scalar(src + 2 * k, dst + 2 * k, units - k);
+}
+
+NOTEPAD_TARGET("ssse3")
+static void SwapUtf16Ssse3(const uint8_t *src, uint8_t *dst, size_t units)
+{
+    const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t k = 0;
+    for (; k + 16 <= units; k += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * k));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * k + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * k), _mm_shuffle_epi8(a, swap));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * k + 16), _mm_shuffle_epi8(b, swap));
+    }
+    SwapUtf16Scalar(src + 2 * k, dst + 2 * k, units - k);
+}
+
+NOTEPAD_TARGET("avx2")
+static void SwapUtf16Avx2(const uint8_t *src, uint8_t *dst, size_t units)
+{
+    const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t k = 0;
+    for (; k + 32 <= units; k += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * k));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * k + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * k), _mm256_shuffle_epi8(a, swap));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * k + 32), _mm256_shuffle_epi8(b, swap));
+    }
+    SwapUtf16Scalar(src + 2 * k, dst + 2 * k, units - k);
+}
+
+NOTEPAD_TARGET("sse2")
+static size_t FindLineBreakSse2(const char16_t *text, size_t i, size_t size)
+{
+    const __m128i cr = _mm_set1_epi16(0x0D);
+    const __m128i lf = _mm_set1_epi16(0x0A);
+    for (; i + 8 <= size; i += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, cr), _mm_cmpeq_epi16(v, lf))));
+        if (mask)
+            return i + CountTrailingZeros(mask) / 2;
+    }
+    return FindLineBreakScalar(text, i, size);
+}
+
+NOTEPAD_TARGET("avx2")
+static size_t FindLineBreakAvx2(const char16_t *text, size_t i, size_t size)
+{
+    const __m256i cr = _mm256_set1_epi16(0x0D);
+    const __m256i lf = _mm256_set1_epi16(0x0A);
+    for (; i + 16 <= size; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi16(v, cr), _mm256_cmpeq_epi16(v, lf))));
+        if (mask)
+            return i + CountTrailingZeros(mask) / 2;
+    }
+    return FindLineBreakSse2(text, i, size);
+}
+
+#endif
+
+void CopyUtf16Units(const uint8_t *src, uint8_t *dst, size_t units, bool swap)
+{
+    if (!swap)
+    {
+        if (units)
+            memcpy(dst, src, units * 2);
+        return;
+    }
+#ifdef NOTEPAD_X86
+    switch (ActiveSimdLevel())
+    {
+    case SimdLevel::AVX2:
+        SwapUtf16Avx2(src, dst, units);
+        return;
+    case SimdLevel::SSSE3:
+        SwapUtf16Ssse3(src, dst, units);
+        return;
+    case SimdLevel::SSE2:
+        SwapUtf16Sse2(src, dst, units);
+        return;
+    default:
+        break;
+    }
+#endif
+    SwapUtf16Scalar(src, dst, units);
+}
+
+size_t FindLineBreak(const char16_t *text, size_t size)
+{
+#ifdef NOTEPAD_X86
+    switch (ActiveSimdLevel())
+    {
+    case SimdLevel::AVX2:
+        return FindLineBreakAvx2(text, 0, size);
+    case SimdLevel::SSE2:
+    case SimdLevel::SSSE3:
+        return FindLineBreakSse2(text, 0, size);
+    default:
+        break;
+    }
+#endif
+    return FindLineBreakScalar(text, 0, size);
+}
@@ -0,0 +1,382 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Fused UTF-8 validation and UTF-8 to UTF-16 transcoding with SSE2/AVX2 kernels.
+  ASCII runs are widened a block at a time; multi-byte runs are checked as they decode.
+*/
+
+#include "textcodec.h"
+#include "cpu.h"
+
+#ifdef NOTEPAD_X86
+#include <immintrin.h>
+#endif
+
+// Decodes (or with out == nullptr, only checks) the sequence at p. Returns the bytes used,
+// or 0 when the sequence is cut off by the end of the chunk and more data may follow.
+static inline size_t DecodeSequence(const uint8_t *p, size_t avail, bool final, char16_t *&o, bool &invalid)
+{
+    uint8_t c = p[0];
+    size_t len = 0;
+    uint32_t cp = 0;
+    uint8_t lo = 0x80, hi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF)
+    {
+        len = 2;
+        cp = c & 0x1F;
+    }
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+        len = 3;
+        cp = c & 0x0F;
+        if (c == 0xE0)
+            lo = 0xA0;
+        else if (c == 0xED)
+            hi = 0x9F;
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+        len = 4;
+        cp = c & 0x07;
+        if (c == 0xF0)
+            lo = 0x90;
+        else if (c == 0xF4)
+            hi = 0x8F;
+    }
+    size_t k = 1;
+    for (; k < len; ++k)
+    {
+        if (k >= avail)
+        {
+            if (!final)
+                return 0;
+            break;
+        }
+        uint8_t b = p[k];
+        if (b < lo || b > hi)
+            break;
+        lo = 0x80;
+        hi = 0xBF;
+        cp = (cp << 6) | (b & 0x3F);
+    }
+    if (k < len || len == 0)
+    {
+        invalid = true;
+        if (o)
+            *o++ = 0xFFFD;
+        return 1;
+    }
+    if (o)
+    {
+        if (cp >= 0x10000)
+        {
+            cp -= 0x10000;
+            *o++ = static_cast<char16_t>(0xD800 + (cp >> 10));
+            *o++ = static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+        }
+        else
+            *o++ = static_cast<char16_t>(cp);
+    }
+    return len;
+}
+
+// Decodes non-ASCII sequences starting at i until the next ASCII byte.
+static inline bool DecodeMultibyteRun(const uint8_t *data, size_t size, size_t &i, char16_t *&o, bool final, bool &invalid)
+{
+    while (i < size && data[i] >= 0x80)
+    {
+        size_t n = DecodeSequence(data + i, size - i, final, o, invalid);
+        if (!n)
+            return false;
+        i += n;
+    }
+    return true;
+}
+
+static DecodeResult DecodeUtf8Scalar(const uint8_t *data, size_t size, char16_t *out, bool final)
+{
+    DecodeResult r;
+    size_t i = 0;
+    char16_t *o = out;
+    while (i < size)
+    {
+        while (i < size && data[i] < 0x80)
+            *o++ = data[i++];
+        if (!DecodeMultibyteRun(data, size, i, o, final, r.invalid))
+            break;
+    }
+    r.consumed = i;
+    r.written = static_cast<size_t>(o - out);
+    return r;
+}
+
+static size_t Utf8ValidPrefixScalar(const uint8_t *data, size_t size, size_t i, bool &invalid)
+{
+    char16_t *none = nullptr;
+    while (i < size)
+    {
+        if (data[i] < 0x80)
+        {
+            ++i;
+            continue;
+        }
+        bool bad = false;
+        size_t n = DecodeSequence(data + i, size - i, false, none, bad);
+        if (bad)
+        {
+            invalid = true;
+            break;
+        }
+        if (!n)
+            break;
+        i += n;
+    }
+    return i;
+}
+
+#ifdef NOTEPAD_X86
+
+// Output never runs ahead of input (one UTF-16 unit per byte at most), so a full block
+// can be widened even when only its ASCII prefix is kept.
+NOTEPAD_TARGET("sse2")
+static DecodeResult DecodeUtf8Sse2(const uint8_t *data, size_t size, char16_t *out, bool final)
+{
+    DecodeResult r;
+    size_t i = 0;
+    char16_t *o = out;
+    const __m128i zero = _mm_setzero_si128();
+    while (i < size)
+    {
+        while (i + 16 <= size)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(v));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(o), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(o + 8), _mm_unpackhi_epi8(v, zero));
+            unsigned ascii = mask ? CountTrailingZeros(mask) : 16;
+            o += ascii;
+            i += ascii;
+            if (mask)
+                break;
+        }
+        if (i + 16 > size)
+            while (i < size && data[i] < 0x80)
+                *o++ = data[i++];
+        if (!DecodeMultibyteRun(data, size, i, o, final, r.invalid))
+            break;
+    }
+    r.consumed = i;
+    r.written = static_cast<size_t>(o - out);
+    return r;
+}
+
+NOTEPAD_TARGET("sse2")
+static size_t Utf8ValidPrefixSse2(const uint8_t *data, size_t size, bool &invalid)
+{
+    size_t i = 0;
+    while (i + 16 <= size)
+    {
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i))));
+        if (!mask)
+        {
+            i += 16;
+            continue;
+        }
+        i += CountTrailingZeros(mask);
+        char16_t *none = nullptr;
+        bool bad = false;
+        while (i < size && data[i] >= 0x80)
+        {
+            size_t n = DecodeSequence(data + i, size - i, false, none, bad);
+            if (bad)
+            {
+                invalid = true;
+                return i;
+            }
+            if (!n)
+                return i;
+            i += n;
+        }
+    }
+    return Utf8ValidPrefixScalar(data, size, i, invalid);
+}
+
+NOTEPAD_TARGET("avx2")
+static DecodeResult DecodeUtf8Avx2(const uint8_t *data, size_t size, char16_t *out, bool final)
+{
+    DecodeResult r;
+    size_t i = 0;
+    char16_t *o = out;
+    while (i < size)
+    {
+        while (i + 32 <= size)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(o), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(o + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+            unsigned ascii = mask ? CountTrailingZeros(mask) : 32;
+            o += ascii;
+            i += ascii;
+            if (mask)
+                break;
+        }
+        if (i + 32 > size)
+            while (i < size && data[i] < 0x80)
+                *o++ = data[i++];
+        if (!DecodeMultibyteRun(data, size, i, o, final, r.invalid))
+            break;
+    }
+    r.consumed = i;
+    r.written = static_cast<size_t>(o - out);
+    return r;
+}
+
+// Keiser-Lemire lookup validation: three nibble tables classify every byte pair, and a
+// saturating subtract marks where third/fourth continuation bytes are required.
+#define TOO_SHORT (1 << 0)
+#define TOO_LONG (1 << 1)
+#define OVERLONG_3 (1 << 2)
+#define TOO_LARGE (1 << 3)
+#define SURROGATE (1 << 4)
+#define OVERLONG_2 (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4 (1 << 6)
+#define TWO_CONTS (1 << 7)
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+NOTEPAD_TARGET("avx2")
+static inline __m256i PrevBytes(__m256i input, __m256i prev, int n)
+{
+    __m256i shifted = _mm256_permute2x128_si256(prev, input, 0x21);
+    switch (n)
+    {
+    case 1:
+        return _mm256_alignr_epi8(input, shifted, 15);
+    case 2:
+        return _mm256_alignr_epi8(input, shifted, 14);
+    default:
+        return _mm256_alignr_epi8(input, shifted, 13);
+    }
+}
+
+static const uint8_t g_byte1High[16] = {
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4};
+static const uint8_t g_byte1Low[16] = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2, CARRY, CARRY,
+    CARRY | TOO_LARGE, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000};
+static const uint8_t g_byte2High[16] = {
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT};
+
+NOTEPAD_TARGET("avx2")
+static inline __m256i LoadTable(const uint8_t *table)
+{
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(table)));
+}
+
+NOTEPAD_TARGET("avx2")
+static inline __m256i Utf8BlockErrors(__m256i input, __m256i prevInput)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i byte1HighTable = LoadTable(g_byte1High);
+    const __m256i byte1LowTable = LoadTable(g_byte1Low);
+    const __m256i byte2HighTable = LoadTable(g_byte2High);
+    __m256i prev1 = PrevBytes(input, prevInput, 1);
+    __m256i byte1High = _mm256_shuffle_epi8(byte1HighTable, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i byte1Low = _mm256_shuffle_epi8(byte1LowTable, _mm256_and_si256(prev1, nibble));
+    __m256i byte2High = _mm256_shuffle_epi8(byte2HighTable, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+    __m256i prev2 = PrevBytes(input, prevInput, 2);
+    __m256i prev3 = PrevBytes(input, prevInput, 3);
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must23, special);
+}
+
+NOTEPAD_TARGET("avx2")
+static size_t Utf8ValidPrefixAvx2(const uint8_t *data, size_t size, bool &invalid)
+{
+    size_t i = 0;
+    __m256i prev = _mm256_setzero_si256();
+    while (i + 32 <= size)
+    {
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        if (_mm256_movemask_epi8(input) == 0 && _mm256_movemask_epi8(prev) == 0)
+        {
+            prev = input;
+            i += 32;
+            continue;
+        }
+        __m256i errors = Utf8BlockErrors(input, prev);
+        if (!_mm256_testz_si256(errors, errors))
+            break;
+        prev = input;
+        i += 32;
+    }
+    // Resume at the lead byte of the sequence straddling the last checked block (or the error).
+    size_t back = 0;
+    while (i > 0 && back < 3 && (data[i - 1] & 0xC0) == 0x80)
+    {
+        --i;
+        ++back;
+    }
+    if (i > 0 && data[i - 1] >= 0xC0)
+        --i;
+    return Utf8ValidPrefixScalar(data, size, i, invalid);
+}
+
+#endif
+
+DecodeResult DecodeUtf8(const uint8_t *data, size_t size, char16_t *out, bool final)
+{
+#ifdef NOTEPAD_X86
+    switch (ActiveSimdLevel())
+    {
+    case SimdLevel::AVX2:
+        return DecodeUtf8Avx2(data, size, out, final);
+    case SimdLevel::SSE2:
+    case SimdLevel::SSSE3:
+        return DecodeUtf8Sse2(data, size, out, final);
+    default:
+        break;
+    }
+#endif
+    return DecodeUtf8Scalar(data, size, out, final);
+}
+
+size_t Utf8ValidPrefix(const uint8_t *data, size_t size, bool &invalid)
+{
+    invalid = false;
+#ifdef NOTEPAD_X86
+    switch (ActiveSimdLevel())
+    {
+    case SimdLevel::AVX2:
+        return Utf8ValidPrefixAvx2(data, size, invalid);
+    case SimdLevel::SSE2:
+    case SimdLevel::SSSE3:
+        return Utf8ValidPrefixSse2(data, size, invalid);
+    default:
+        break;
+    }
+#endif
+    return Utf8ValidPrefixScalar(data, size, 0, invalid);
+}
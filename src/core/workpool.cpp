@@ -0,0 +1,88 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Work-stealing task runner on std::thread: per-worker index ranges, owners pop from the
+  front and thieves from the back.
+*/
+
+#include "workpool.h"
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkShare
+{
+    std::mutex lock;
+    size_t next = 0;
+    size_t end = 0;
+};
+
+size_t DefaultWorkerCount()
+{
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores ? cores : 1;
+}
+
+static bool TakeOwn(WorkShare &share, size_t &index)
+{
+    std::lock_guard<std::mutex> guard(share.lock);
+    if (share.next == share.end)
+        return false;
+    index = share.next++;
+    return true;
+}
+
+static bool Steal(WorkShare &share, size_t &index)
+{
+    std::lock_guard<std::mutex> guard(share.lock);
+    if (share.next == share.end)
+        return false;
+    index = --share.end;
+    return true;
+}
+
+void RunWorkStealing(size_t count, size_t threads, const std::function<void(size_t, size_t)> &task)
+{
+    if (!count)
+        return;
+    if (threads < 1)
+        threads = 1;
+    if (threads > count)
+        threads = count;
+    std::unique_ptr<WorkShare[]> shares(new WorkShare[threads]);
+    for (size_t i = 0; i < threads; ++i)
+    {
+        shares[i].next = count * i / threads;
+        shares[i].end = count * (i + 1) / threads;
+    }
+    auto work = [&](size_t worker)
+    {
+        size_t index = 0;
+        while (TakeOwn(shares[worker], index))
+            task(index, worker);
+        // Shares only shrink, so one pass that finds them all empty means the work is handed out
+        for (size_t victim = (worker + 1) % threads; victim != worker;)
+        {
+            if (Steal(shares[victim], index))
+                task(index, worker);
+            else
+                victim = (victim + 1) % threads;
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i)
+        pool.emplace_back(work, i);
+    work(0);
+    for (std::thread &thread : pool)
+        thread.join();
+}
@@ -0,0 +1,28 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  A small work-stealing pool for the portable core: indexed tasks spread over a few threads,
+  with idle threads taking work from the back of busy ones.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// One thread per core, at least one.
+size_t DefaultWorkerCount();
+
+// Runs task(index, worker) for every index in [0, count) on up to threads threads and returns
+// once all are done. The calling thread is worker 0. Each worker takes its own even share of
+// the indices front to back; once that runs out it steals from the back of another share, so
+// uneven tasks still finish together. A task only ever runs on one worker at a time.
+void RunWorkStealing(size_t count, size_t threads, const std::function<void(size_t, size_t)> &task);
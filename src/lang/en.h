@@ -66,6 +66,7 @@ inline LangStrings g_langEN = {
     L"Fill",
     L"Window &Transparency...",
     L"Always on &Top",
+    L"&Follow",
 
     // Menu - Help
     L"&Help",
@@ -91,18 +92,33 @@ inline LangStrings g_langEN = {
     L"OK",
     L"Cancel",
     L"Opacity (10-100%):",
+    L"Regular e&xpression",
+    L"Find &All",
+    L"Find Results",
+    L"Line",
+    L"Text",
 
     // Messages
     L"Cannot find \"",
     L"Do you want to save changes to ",
     L"Cannot open file.",
     L"Cannot save file.",
+    L"The file is still loading. Save it once loading has finished.",
+    L"This file is open read-only in the large file viewer.",
+    L"Follow is not available for files open in the large file viewer.",
+    L"Regular expressions are not available in the large file viewer.",
+    L"Invalid regular expression at character ",
+    L" occurrence(s) replaced.",
     L"Error",
     L"Legacy Notepad v1.1.1\n\nA fast, lightweight text editor.\n\nBuilt with C++ and Win32 API.\n", //\nModify by 0x2o.net",
 
     // Status bar
     L" Ln ",
     L", Col ",
+    L" Loading... %d%% ",
+    L" Indexing... %d%% ",
+    L" %I64u matches ",
+    L" %I64u matches... ",
 
     // Encoding names
     L"UTF-8",
@@ -66,6 +66,7 @@ inline LangStrings g_langJA = {
     L"フィル",
     L"ウィンドウの透明度(&T)...",
     L"常に最前面に表示(&T)",
+    L"末尾を追跡(&F)",
 
     // Menu - Help
     L"ヘルプ(&H)",
@@ -91,18 +92,33 @@ inline LangStrings g_langJA = {
     L"OK",
     L"キャンセル",
     L"不透明度 (10-100%):",
+    L"正規表現(&X)",
+    L"すべて検索(&A)",
+    L"検索結果",
+    L"行",
+    L"テキスト",
 
     // Messages
     L"「",
     L"次のファイルに変更を保存しますか: ",
     L"ファイルを開けません。",
     L"ファイルを保存できません。",
+    L"ファイルを読み込み中です。読み込みが終わってから保存してください。",
+    L"このファイルは大きなファイル用ビューアーで読み取り専用で開かれています。",
+    L"大きなファイル用ビューアーで開いているファイルはフォローできません。",
+    L"大きなファイル用ビューアーでは正規表現を使用できません。",
+    L"正規表現が正しくありません。位置: ",
+    L" 件を置換しました。",
     L"エラー",
     L"Legacy Notepad v1.1.1\n\n高速で軽量なテキストエディタ。\n\nC++ Win32 API で構築。\n", //\nModify by 0x2o.net",
 
     // Status bar
     L" 行 ",
     L", 列 ",
+    L" 読み込み中... %d%% ",
+    L" インデックス作成中... %d%% ",
+    L" %I64u 件 ",
+    L" %I64u 件 (検索中...) ",
 
     // Encoding names
     L"UTF-8",
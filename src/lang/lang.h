@@ -74,6 +74,7 @@ struct LangStrings
     std::wstring menuBgPosFill;
     std::wstring menuTransparency;
     std::wstring menuAlwaysOnTop;
+    std::wstring menuFollow;
 
     // Menu - Help
     std::wstring menuHelp;
@@ -99,18 +100,33 @@ struct LangStrings
     std::wstring dialogOK;
     std::wstring dialogCancel;
     std::wstring dialogOpacityLabel;
+    std::wstring dialogRegex;
+    std::wstring dialogFindAll;
+    std::wstring dialogFindResults;
+    std::wstring dialogResultLine;
+    std::wstring dialogResultText;
 
     // Messages
     std::wstring msgCannotFind;
     std::wstring msgSaveChanges;
     std::wstring msgCannotOpenFile;
     std::wstring msgCannotSaveFile;
+    std::wstring msgSaveWhileLoading;
+    std::wstring msgViewerReadOnly;
+    std::wstring msgViewerNoFollow;
+    std::wstring msgViewerNoRegex;
+    std::wstring msgInvalidRegex;
+    std::wstring msgReplacedCount;
     std::wstring msgError;
     std::wstring msgAbout;
 
     // Status bar
     std::wstring statusLn;
     std::wstring statusCol;
+    std::wstring statusLoading;
+    std::wstring statusIndexing;
+    std::wstring statusMatches;
+    std::wstring statusMatchesScanning;
 
     // Encoding names
     std::wstring encodingUTF8;
@@ -42,6 +42,14 @@
 #include "modules/theme.h"
 #include "modules/editor.h"
 #include "modules/file.h"
+#include "modules/viewer.h"
+#include "modules/follow.h"
+#include "modules/document.h"
+#include "modules/findall.h"
+#include "modules/journal.h"
+#ifdef NOTEPAD_REPLAY
+#include "modules/replay.h"
+#endif
 #include "modules/ui.h"
 #include "modules/background.h"
 #include "modules/dialog.h"
@@ -49,6 +57,18 @@
 #include "modules/menu.h"
 #include "lang/lang.h"
 
+// Runs on every keystroke, so the title is only rebuilt when the modified flag flips and the
+// status bar is left to its timer.
+static void OnEditorChange()
+{
+    bool wasModified = g_state.modified;
+    g_state.modified = true;
+    NoteDocumentChange();
+    if (!wasModified)
+        UpdateTitle();
+    ScheduleStatus(STATUS_POSITION);
+}
+
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
     switch (msg)
@@ -66,8 +86,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                                        WS_CHILD | WS_VISIBLE | SBARS_SIZEGRIP, 0, 0, 0, 0, hwnd, reinterpret_cast<HMENU>(IDC_STATUSBAR), GetModuleHandleW(nullptr), nullptr);
         g_origStatusProc = reinterpret_cast<WNDPROC>(SetWindowLongPtrW(g_hwndStatus, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(StatusSubclassProc)));
         SendMessageW(g_hwndEditor, EM_SETLIMITTEXT, 0, 0);
+        SendMessageW(g_hwndEditor, EM_EXLIMITTEXT, 0, 0x7FFFFFFE);
+        SendMessageW(g_hwndEditor, EM_SETUNDOLIMIT, 0, 0);
         LRESULT mask = SendMessageW(g_hwndEditor, EM_GETEVENTMASK, 0, 0);
-        SendMessageW(g_hwndEditor, EM_SETEVENTMASK, 0, mask | ENM_CHANGE);
+        SendMessageW(g_hwndEditor, EM_SETEVENTMASK, 0, mask | ENM_CHANGE | ENM_SELCHANGE);
         ApplyFont();
         SetupStatusBarParts();
         UpdateMenuStrings();
@@ -112,26 +134,15 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
             mii.dwTypeData = szText;
             mii.cch = 255;
             GetMenuItemInfoW(pUDMI->um.hMenu, pUDMI->umi.iPosition, TRUE, &mii);
-            COLORREF bgColor = RGB(45, 45, 45);
-            COLORREF textColor = RGB(255, 255, 255);
             bool isHot = (pUDMI->dis.itemState & ODS_HOTLIGHT) != 0;
             bool isSelected = (pUDMI->dis.itemState & ODS_SELECTED) != 0;
-            if (isHot || isSelected)
-                bgColor = RGB(65, 65, 65);
-            HBRUSH hbr = CreateSolidBrush(bgColor);
-            FillRect(pUDMI->um.hdc, &pUDMI->dis.rcItem, hbr);
-            DeleteObject(hbr);
-            NONCLIENTMETRICSW ncm{};
-            ncm.cbSize = sizeof(ncm);
-            SystemParametersInfoW(SPI_GETNONCLIENTMETRICS, sizeof(ncm), &ncm, 0);
-            HFONT hFont = CreateFontIndirectW(&ncm.lfMenuFont);
-            HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(pUDMI->um.hdc, hFont));
+            FillRect(pUDMI->um.hdc, &pUDMI->dis.rcItem, GetMenuItemBrush(isHot || isSelected));
+            HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(pUDMI->um.hdc, GetMenuFont()));
             SetBkMode(pUDMI->um.hdc, TRANSPARENT);
-            SetTextColor(pUDMI->um.hdc, textColor);
+            SetTextColor(pUDMI->um.hdc, RGB(255, 255, 255));
             RECT rcText = pUDMI->dis.rcItem;
             DrawTextW(pUDMI->um.hdc, szText, -1, &rcText, DT_CENTER | DT_SINGLELINE | DT_VCENTER);
             SelectObject(pUDMI->um.hdc, hOldFont);
-            DeleteObject(hFont);
             return TRUE;
         }
         break;
@@ -155,11 +166,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                 FillRect(hdc, &rcMenuBar, g_hbrMenuDark ? g_hbrMenuDark : reinterpret_cast<HBRUSH>(GetStockObject(BLACK_BRUSH)));
                 HMENU hMenu = GetMenu(hwnd);
                 int itemCount = GetMenuItemCount(hMenu);
-                NONCLIENTMETRICSW ncm{};
-                ncm.cbSize = sizeof(ncm);
-                SystemParametersInfoW(SPI_GETNONCLIENTMETRICS, sizeof(ncm), &ncm, 0);
-                HFONT hFont = CreateFontIndirectW(&ncm.lfMenuFont);
-                HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(hdc, hFont));
+                HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(hdc, GetMenuFont()));
                 SetBkMode(hdc, TRANSPARENT);
                 SetTextColor(hdc, RGB(255, 255, 255));
                 for (int i = 0; i < itemCount; i++)
@@ -180,7 +187,6 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                     }
                 }
                 SelectObject(hdc, hOldFont);
-                DeleteObject(hFont);
             }
             ReleaseDC(hwnd, hdc);
         }
@@ -189,9 +195,21 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     case WM_SETTINGCHANGE:
     {
         if (lParam && wcscmp(reinterpret_cast<LPCWSTR>(lParam), L"ImmersiveColorSet") == 0)
+        {
+            RefreshSystemTheme();
             ApplyTheme();
+        }
+        else if (wParam == SPI_SETNONCLIENTMETRICS)
+        {
+            ReleaseThemeFonts();
+            InvalidateRect(g_hwndStatus, nullptr, TRUE);
+            DrawMenuBar(hwnd);
+        }
         return 0;
     }
+    case WM_DPICHANGED:
+        ReleaseThemeFonts();
+        break;
     case WM_DROPFILES:
     {
         HDROP hDrop = reinterpret_cast<HDROP>(wParam);
@@ -207,10 +225,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         UpdateStatus();
         return 0;
     case WM_SETFOCUS:
-        SetFocus(g_hwndEditor);
+        SetFocus(g_hwndViewer ? g_hwndViewer : g_hwndEditor);
         return 0;
     case WM_CTLCOLOREDIT:
-        if (g_state.background.enabled && g_bgImage && reinterpret_cast<HWND>(lParam) == g_hwndEditor)
+        if (HasBackgroundImage() && reinterpret_cast<HWND>(lParam) == g_hwndEditor)
         {
             HDC hdc = reinterpret_cast<HDC>(wParam);
             SetBkMode(hdc, TRANSPARENT);
@@ -231,32 +249,37 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         LPDRAWITEMSTRUCT pDIS = reinterpret_cast<LPDRAWITEMSTRUCT>(lParam);
         if (pDIS->hwndItem == g_hwndStatus && IsDarkMode())
         {
-            HBRUSH hbr = g_hbrStatusDark ? g_hbrStatusDark : CreateSolidBrush(RGB(45, 45, 45));
-            FillRect(pDIS->hDC, &pDIS->rcItem, hbr);
-            if (!g_hbrStatusDark)
-                DeleteObject(hbr);
+            FillRect(pDIS->hDC, &pDIS->rcItem, g_hbrStatusDark ? g_hbrStatusDark : reinterpret_cast<HBRUSH>(GetStockObject(BLACK_BRUSH)));
             SetBkMode(pDIS->hDC, TRANSPARENT);
             SetTextColor(pDIS->hDC, RGB(255, 255, 255));
             int part = static_cast<int>(pDIS->itemID);
-            if (part >= 0 && part < 4)
+            if (part >= 0 && part < STATUS_PART_COUNT)
             {
                 RECT rc = pDIS->rcItem;
                 rc.left += 4;
-                DrawTextW(pDIS->hDC, g_statusTexts[part].c_str(), -1, &rc, DT_SINGLELINE | DT_VCENTER | DT_LEFT | DT_END_ELLIPSIS);
+                DrawTextW(pDIS->hDC, g_statusTexts[part], -1, &rc, DT_SINGLELINE | DT_VCENTER | DT_LEFT | DT_END_ELLIPSIS);
             }
             return TRUE;
         }
         break;
     }
+    case WM_INITMENUPOPUP:
+    {
+        // A document that is still loading cannot be saved
+        UINT enable = MF_BYCOMMAND | (IsLoading() ? MF_GRAYED : MF_ENABLED);
+        HMENU hMenu = reinterpret_cast<HMENU>(wParam);
+        EnableMenuItem(hMenu, IDM_FILE_SAVE, enable);
+        EnableMenuItem(hMenu, IDM_FILE_SAVEAS, enable);
+        break;
+    }
     case WM_COMMAND:
     {
         WORD code = HIWORD(wParam);
         HWND source = reinterpret_cast<HWND>(lParam);
         if (source == g_hwndEditor && code == EN_CHANGE)
         {
-            g_state.modified = true;
-            UpdateTitle();
-            UpdateStatus();
+            if (!IsLoading())
+                OnEditorChange();
             return 0;
         }
         WORD cmd = LOWORD(wParam);
@@ -358,6 +381,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         case IDM_VIEW_ALWAYSONTOP:
             ViewAlwaysOnTop();
             break;
+        case IDM_VIEW_FOLLOW:
+            ViewFollow();
+            break;
         case IDM_VIEW_BG_SELECT:
             ViewSelectBackground();
             break;
@@ -446,10 +472,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                 return CDRF_NOTIFYITEMDRAW;
             if (lpnmcd->dwDrawStage == CDDS_ITEMPREPAINT)
             {
-                HBRUSH hbr = g_hbrStatusDark ? g_hbrStatusDark : CreateSolidBrush(RGB(45, 45, 45));
-                FillRect(lpnmcd->hdc, &lpnmcd->rc, hbr);
-                if (!g_hbrStatusDark && hbr)
-                    DeleteObject(hbr);
+                FillRect(lpnmcd->hdc, &lpnmcd->rc, g_hbrStatusDark ? g_hbrStatusDark : reinterpret_cast<HBRUSH>(GetStockObject(BLACK_BRUSH)));
                 SetBkMode(lpnmcd->hdc, TRANSPARENT);
                 SetBkColor(lpnmcd->hdc, RGB(45, 45, 45));
                 SetTextColor(lpnmcd->hdc, RGB(255, 255, 255));
@@ -462,39 +485,68 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                 return CDRF_SKIPDEFAULT;
             }
         }
-        if (pnmh->hwndFrom == g_hwndEditor && pnmh->code == EN_CHANGE)
-        {
-            g_state.modified = true;
-            UpdateTitle();
-            UpdateStatus();
-        }
+        if (pnmh->hwndFrom == g_hwndEditor && pnmh->code == EN_CHANGE && !IsLoading())
+            OnEditorChange();
+        if (pnmh->hwndFrom == g_hwndEditor && pnmh->code == EN_SELCHANGE)
+            ScheduleStatus(STATUS_POSITION);
         return 0;
     }
     case WM_CLOSE:
         if (g_state.closing)
             return 0;
         g_state.closing = true;
-        if (ConfirmDiscard())
+        if (CanHotExit() || ConfirmDiscard())
             DestroyWindow(hwnd);
         else
             g_state.closing = false;
         return 0;
-    case WM_DESTROY:
-        if (g_state.hFont)
+    case WM_APP_LOADCHUNK:
+        OnLoadChunk(lParam);
+        return 0;
+    case WM_APP_LOADDONE:
+        OnLoadFinished(wParam, lParam);
+        return 0;
+    case WM_APP_INDEXCHUNK:
+        OnViewerIndexChunk(lParam);
+        return 0;
+    case WM_APP_FOLLOWCHECK:
+        OnFollowCheck(wParam);
+        return 0;
+    case WM_APP_BGREADY:
+        OnBackgroundReady(lParam);
+        return 0;
+    case WM_APP_FINDALL:
+        OnFindAllBatch(lParam);
+        return 0;
+    case WM_TIMER:
+        if (wParam == IDT_JOURNAL)
         {
-            DeleteObject(g_state.hFont);
-            g_state.hFont = nullptr;
+            OnJournalTimer();
+            return 0;
         }
-        if (g_bgImage)
+        if (wParam == IDT_STATUS)
         {
-            delete g_bgImage;
-            g_bgImage = nullptr;
+            OnStatusTimer();
+            return 0;
         }
-        if (g_bgBitmap)
+        if (wParam == IDT_FINDALL)
+        {
+            OnFindAllTimer();
+            return 0;
+        }
+        break;
+    case WM_DESTROY:
+        CloseFindAll();
+        CloseJournal(CanHotExit());
+        StopFollow();
+        CancelLoad();
+        CloseViewer();
+        if (g_state.hFont)
         {
-            DeleteObject(g_bgBitmap);
-            g_bgBitmap = nullptr;
+            DeleteObject(g_state.hFont);
+            g_state.hFont = nullptr;
         }
+        CloseBackground();
         PostQuitMessage(0);
         return 0;
     case WM_MOUSEWHEEL:
@@ -515,6 +567,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR lpCmdLine, int nCmdShow)
 {
     InitLanguage();
+    LoadViewerSettings();
+    LoadDocumentSettings();
+    InitJournal();
     SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
     HMODULE hUxtheme = LoadLibraryExW(L"uxtheme.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32);
     if (hUxtheme)
@@ -544,7 +599,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR lpCmdLine, int nCmdSh
     Gdiplus::GdiplusStartup(&g_gdiplusToken, &gdiplusStartupInput, nullptr);
     INITCOMMONCONTROLSEX icc{};
     icc.dwSize = sizeof(icc);
-    icc.dwICC = ICC_BAR_CLASSES;
+    icc.dwICC = ICC_BAR_CLASSES | ICC_LISTVIEW_CLASSES;
     InitCommonControlsEx(&icc);
     WNDCLASSEXW wc{};
     wc.cbSize = sizeof(wc);
@@ -567,6 +622,13 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR lpCmdLine, int nCmdSh
     SetTitleBarDark(g_hwndMain, IsDarkMode());
     ShowWindow(g_hwndMain, nCmdShow);
     UpdateWindow(g_hwndMain);
+    int exitCode = 0;
+#ifdef NOTEPAD_REPLAY
+    int replayKeys = 0;
+    if (ParseReplaySwitch(lpCmdLine, replayKeys))
+        exitCode = RunInputReplay(replayKeys) ? 0 : 1;
+    else
+#endif
     if (lpCmdLine && lpCmdLine[0])
     {
         std::wstring path = lpCmdLine;
@@ -574,6 +636,8 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR lpCmdLine, int nCmdSh
             path = path.substr(1, path.size() - 2);
         LoadFile(path);
     }
+    else
+        RecoverJournal();
     MSG msg;
     while (GetMessageW(&msg, nullptr, 0, 0))
     {
@@ -586,5 +650,5 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR lpCmdLine, int nCmdSh
         }
     }
     Gdiplus::GdiplusShutdown(g_gdiplusToken);
-    return static_cast<int>(msg.wParam);
+    return exitCode ? exitCode : static_cast<int>(msg.wParam);
 }
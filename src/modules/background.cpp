@@ -10,7 +10,7 @@
                           ███    ███ ▀
 
   Background image rendering with GDI+ support and multiple positioning modes.
-  Supports tile, stretch, fit, fill, and nine anchor point positions.
+  A worker decodes and scales the image into premultiplied layers so painting only blends.
 */
 
 #include "background.h"
@@ -20,112 +20,481 @@
 #include <commdlg.h>
 #include <algorithm>
 
-void LoadBackgroundImage(const std::wstring &path)
+// A premultiplied 32bpp top-down DIB with the opacity already applied, ready for AlphaBlend.
+struct BackgroundLayer
+{
+    HBITMAP bitmap = nullptr;
+    int width = 0;
+    int height = 0;
+    BgPosition position = BgPosition::Center;
+    BYTE opacity = 0;
+};
+
+// What the UI wants rendered next. Only the latest request is kept; a newer one replaces it.
+struct BackgroundRequest
 {
-    if (g_bgImage)
+    UINT generation = 0;
+    std::wstring path;
+    bool release = false;
+    BgPosition position = BgPosition::Center;
+    BYTE opacity = 0;
+    int width = 0;
+    int height = 0;
+};
+
+struct BackgroundResult
+{
+    UINT generation = 0;
+    bool failed = false;
+    int imageWidth = 0;
+    int imageHeight = 0;
+    BackgroundLayer preview;
+    BackgroundLayer layer;
+};
+
+// The decoded full-size image belongs to the worker alone; the UI thread only ever sees the
+// layers it renders from it.
+struct BackgroundWorker
+{
+    HANDLE hThread = nullptr;
+    HANDLE hWake = nullptr;
+    HANDLE hStop = nullptr;
+    CRITICAL_SECTION lock;
+    bool hasRequest = false;
+    BackgroundRequest request;
+};
+
+static BackgroundWorker *g_bgWorker = nullptr;
+static UINT g_bgGeneration = 0;
+static int g_bgImageW = 0;
+static int g_bgImageH = 0;
+static BackgroundLayer g_bgPreview;
+static BackgroundLayer g_bgLayer;
+static BackgroundRequest g_bgRequested;
+static HBITMAP g_bgTileBitmap = nullptr;
+static HBRUSH g_bgTileBrush = nullptr;
+static COLORREF g_bgTileColor = 0;
+static COLORREF g_bgBitmapColor = 0;
+
+static void ReleaseLayer(BackgroundLayer &layer)
+{
+    if (layer.bitmap)
+        DeleteObject(layer.bitmap);
+    layer = BackgroundLayer();
+}
+
+static void ReleaseTileBrush()
+{
+    if (g_bgTileBrush)
     {
-        delete g_bgImage;
-        g_bgImage = nullptr;
+        DeleteObject(g_bgTileBrush);
+        g_bgTileBrush = nullptr;
     }
-    g_bgImage = Gdiplus::Image::FromFile(path.c_str());
-    if (g_bgImage && g_bgImage->GetLastStatus() != Gdiplus::Ok)
+    if (g_bgTileBitmap)
     {
-        delete g_bgImage;
-        g_bgImage = nullptr;
+        DeleteObject(g_bgTileBitmap);
+        g_bgTileBitmap = nullptr;
     }
-    g_state.background.imagePath = path;
-    g_state.background.enabled = (g_bgImage != nullptr);
-    InvalidateRect(g_hwndEditor, nullptr, TRUE);
 }
 
-void PaintBackground(HDC hdc, const RECT &rc)
+static void ReleaseComposite()
 {
-    if (!g_state.background.enabled || !g_bgImage)
-        return;
-    Gdiplus::Graphics graphics(hdc);
-    graphics.SetInterpolationMode(Gdiplus::InterpolationModeHighQualityBicubic);
-    int imgW = g_bgImage->GetWidth();
-    int imgH = g_bgImage->GetHeight();
-    int winW = rc.right - rc.left;
-    int winH = rc.bottom - rc.top;
-    Gdiplus::ImageAttributes imgAttr;
-    float opacity = g_state.background.opacity / 255.0f;
-    Gdiplus::ColorMatrix colorMatrix = {
-        1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, opacity, 0.0f,
-        0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
-    imgAttr.SetColorMatrix(&colorMatrix, Gdiplus::ColorMatrixFlagsDefault, Gdiplus::ColorAdjustTypeBitmap);
-    auto drawImage = [&](int x, int y, int w, int h)
+    if (g_bgBitmap)
     {
-        graphics.DrawImage(g_bgImage, Gdiplus::Rect(x, y, w, h), 0, 0, imgW, imgH, Gdiplus::UnitPixel, &imgAttr);
-    };
-    switch (g_state.background.position)
+        DeleteObject(g_bgBitmap);
+        g_bgBitmap = nullptr;
+    }
+}
+
+// Where a single copy of the image goes in a window for every position but Tile.
+static RECT ImageRect(BgPosition pos, int winW, int winH, int imgW, int imgH)
+{
+    int w = imgW, h = imgH;
+    if (pos == BgPosition::Stretch)
+    {
+        w = winW;
+        h = winH;
+    }
+    else if (pos == BgPosition::Fit || pos == BgPosition::Fill)
+    {
+        float scaleW = static_cast<float>(winW) / imgW;
+        float scaleH = static_cast<float>(winH) / imgH;
+        float scale = pos == BgPosition::Fit ? (std::min)(scaleW, scaleH) : (std::max)(scaleW, scaleH);
+        w = static_cast<int>(imgW * scale);
+        h = static_cast<int>(imgH * scale);
+    }
+    int x = (winW - w) / 2, y = (winH - h) / 2;
+    switch (pos)
     {
     case BgPosition::TopLeft:
-        drawImage(0, 0, imgW, imgH);
-        break;
-    case BgPosition::TopCenter:
-        drawImage((winW - imgW) / 2, 0, imgW, imgH);
+    case BgPosition::CenterLeft:
+    case BgPosition::BottomLeft:
+    case BgPosition::Tile:
+    case BgPosition::Stretch:
+        x = 0;
         break;
     case BgPosition::TopRight:
-        drawImage(winW - imgW, 0, imgW, imgH);
-        break;
-    case BgPosition::CenterLeft:
-        drawImage(0, (winH - imgH) / 2, imgW, imgH);
+    case BgPosition::CenterRight:
+    case BgPosition::BottomRight:
+        x = winW - w;
         break;
-    case BgPosition::Center:
-        drawImage((winW - imgW) / 2, (winH - imgH) / 2, imgW, imgH);
+    default:
         break;
-    case BgPosition::CenterRight:
-        drawImage(winW - imgW, (winH - imgH) / 2, imgW, imgH);
+    }
+    switch (pos)
+    {
+    case BgPosition::TopLeft:
+    case BgPosition::TopCenter:
+    case BgPosition::TopRight:
+    case BgPosition::Tile:
+    case BgPosition::Stretch:
+        y = 0;
         break;
     case BgPosition::BottomLeft:
-        drawImage(0, winH - imgH, imgW, imgH);
-        break;
     case BgPosition::BottomCenter:
-        drawImage((winW - imgW) / 2, winH - imgH, imgW, imgH);
-        break;
     case BgPosition::BottomRight:
-        drawImage(winW - imgW, winH - imgH, imgW, imgH);
+        y = winH - h;
         break;
-    case BgPosition::Tile:
-        for (int y = 0; y < winH; y += imgH)
-            for (int x = 0; x < winW; x += imgW)
-                drawImage(x, y, imgW, imgH);
-        break;
-    case BgPosition::Stretch:
-        drawImage(0, 0, winW, winH);
+    default:
         break;
-    case BgPosition::Fit:
+    }
+    return {x, y, x + w, y + h};
+}
+
+// Renders the image into a new premultiplied layer of the given size with high-quality scaling
+// and the opacity applied. Runs on the worker.
+static BackgroundLayer RenderLayer(Gdiplus::Image *image, int width, int height, const RECT &dest, BYTE opacity)
+{
+    BackgroundLayer layer;
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = width;
+    bmi.bmiHeader.biHeight = -height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    void *bits = nullptr;
+    layer.bitmap = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (!layer.bitmap)
+        return layer;
+    layer.width = width;
+    layer.height = height;
+    layer.opacity = opacity;
+    Gdiplus::Bitmap target(width, height, width * 4, PixelFormat32bppPARGB, static_cast<BYTE *>(bits));
+    Gdiplus::Graphics graphics(&target);
+    graphics.SetInterpolationMode(Gdiplus::InterpolationModeHighQualityBicubic);
+    graphics.SetPixelOffsetMode(Gdiplus::PixelOffsetModeHighQuality);
+    Gdiplus::ImageAttributes imgAttr;
+    float alpha = opacity / 255.0f;
+    Gdiplus::ColorMatrix colorMatrix = {
+        1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, alpha, 0.0f,
+        0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    imgAttr.SetColorMatrix(&colorMatrix, Gdiplus::ColorMatrixFlagsDefault, Gdiplus::ColorAdjustTypeBitmap);
+    graphics.DrawImage(image, Gdiplus::Rect(dest.left, dest.top, dest.right - dest.left, dest.bottom - dest.top),
+                       0, 0, image->GetWidth(), image->GetHeight(), Gdiplus::UnitPixel, &imgAttr);
+    return layer;
+}
+
+// The whole image scaled down to fit the screen, used to draw something at once while the
+// exact layer for a new size is rendered.
+static BackgroundLayer RenderPreview(Gdiplus::Image *image, BYTE opacity)
+{
+    int imgW = static_cast<int>(image->GetWidth());
+    int imgH = static_cast<int>(image->GetHeight());
+    float scale = (std::min)({1.0f, static_cast<float>(GetSystemMetrics(SM_CXVIRTUALSCREEN)) / imgW,
+                              static_cast<float>(GetSystemMetrics(SM_CYVIRTUALSCREEN)) / imgH});
+    int w = (std::max)(1, static_cast<int>(imgW * scale));
+    int h = (std::max)(1, static_cast<int>(imgH * scale));
+    return RenderLayer(image, w, h, {0, 0, w, h}, opacity);
+}
+
+// The layer for a window of the requested size: one tile for Tile, at most screen-sized since
+// the rest is never seen, otherwise the whole client with the image placed in it.
+static BackgroundLayer RenderPlaced(Gdiplus::Image *image, const BackgroundRequest &req)
+{
+    int imgW = static_cast<int>(image->GetWidth());
+    int imgH = static_cast<int>(image->GetHeight());
+    BackgroundLayer layer;
+    if (req.position == BgPosition::Tile)
     {
-        float scale = (std::min)(static_cast<float>(winW) / imgW, static_cast<float>(winH) / imgH);
-        int newW = static_cast<int>(imgW * scale);
-        int newH = static_cast<int>(imgH * scale);
-        drawImage((winW - newW) / 2, (winH - newH) / 2, newW, newH);
-        break;
+        int w = (std::min)(imgW, GetSystemMetrics(SM_CXVIRTUALSCREEN));
+        int h = (std::min)(imgH, GetSystemMetrics(SM_CYVIRTUALSCREEN));
+        layer = RenderLayer(image, w, h, {0, 0, imgW, imgH}, req.opacity);
     }
-    case BgPosition::Fill:
+    else
+        layer = RenderLayer(image, req.width, req.height, ImageRect(req.position, req.width, req.height, imgW, imgH), req.opacity);
+    layer.position = req.position;
+    return layer;
+}
+
+static DWORD WINAPI BackgroundThreadProc(LPVOID param)
+{
+    BackgroundWorker &w = *static_cast<BackgroundWorker *>(param);
+    HANDLE handles[2] = {w.hStop, w.hWake};
+    Gdiplus::Image *image = nullptr;
+    int previewOpacity = -1;
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
     {
-        float scale = (std::max)(static_cast<float>(winW) / imgW, static_cast<float>(winH) / imgH);
-        int newW = static_cast<int>(imgW * scale);
-        int newH = static_cast<int>(imgH * scale);
-        drawImage((winW - newW) / 2, (winH - newH) / 2, newW, newH);
-        break;
+        EnterCriticalSection(&w.lock);
+        bool has = w.hasRequest;
+        BackgroundRequest req = std::move(w.request);
+        w.hasRequest = false;
+        LeaveCriticalSection(&w.lock);
+        if (!has)
+            continue;
+        if (req.release || !req.path.empty())
+        {
+            delete image;
+            image = nullptr;
+            previewOpacity = -1;
+        }
+        if (req.release)
+            continue;
+        if (!req.path.empty())
+        {
+            image = Gdiplus::Image::FromFile(req.path.c_str());
+            if (image && (image->GetLastStatus() != Gdiplus::Ok || !image->GetWidth() || !image->GetHeight()))
+            {
+                delete image;
+                image = nullptr;
+            }
+        }
+        BackgroundResult *result = new BackgroundResult();
+        result->generation = req.generation;
+        result->failed = image == nullptr;
+        if (image)
+        {
+            result->imageWidth = static_cast<int>(image->GetWidth());
+            result->imageHeight = static_cast<int>(image->GetHeight());
+            if (previewOpacity != req.opacity)
+            {
+                result->preview = RenderPreview(image, req.opacity);
+                previewOpacity = req.opacity;
+            }
+            if (req.width > 0 && req.height > 0)
+                result->layer = RenderPlaced(image, req);
+        }
+        if (!PostMessageW(g_hwndMain, WM_APP_BGREADY, 0, reinterpret_cast<LPARAM>(result)))
+        {
+            ReleaseLayer(result->preview);
+            ReleaseLayer(result->layer);
+            delete result;
+        }
     }
+    delete image;
+    return 0;
+}
+
+static void SubmitBackgroundRequest(BackgroundRequest &&req)
+{
+    if (!g_bgWorker)
+    {
+        BackgroundWorker *w = new BackgroundWorker();
+        w->hWake = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        w->hStop = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        InitializeCriticalSection(&w->lock);
+        g_bgWorker = w;
+        if (w->hWake && w->hStop)
+            w->hThread = CreateThread(nullptr, 0, BackgroundThreadProc, w, 0, nullptr);
+        if (!w->hThread)
+        {
+            CloseBackground();
+            return;
+        }
     }
+    BackgroundWorker &w = *g_bgWorker;
+    EnterCriticalSection(&w.lock);
+    // A file still waiting to be decoded must survive being replaced by a resize
+    if (w.hasRequest && req.path.empty() && !req.release)
+        req.path = std::move(w.request.path);
+    w.request = std::move(req);
+    w.hasRequest = true;
+    LeaveCriticalSection(&w.lock);
+    SetEvent(w.hWake);
 }
 
-void UpdateBackgroundBitmap(HWND hwnd)
+// Asks for the exact layer at the current position and opacity unless it is already on its way.
+static void RequestBackgroundLayer(int width, int height)
+{
+    BgPosition pos = g_state.background.position;
+    if (pos == BgPosition::Tile)
+        width = height = 1;
+    BYTE opacity = g_state.background.opacity;
+    if (g_bgRequested.generation == g_bgGeneration && g_bgRequested.position == pos &&
+        g_bgRequested.opacity == opacity && g_bgRequested.width == width && g_bgRequested.height == height)
+        return;
+    g_bgRequested.generation = g_bgGeneration;
+    g_bgRequested.position = pos;
+    g_bgRequested.opacity = opacity;
+    g_bgRequested.width = width;
+    g_bgRequested.height = height;
+    BackgroundRequest req;
+    req.generation = g_bgGeneration;
+    req.position = pos;
+    req.opacity = opacity;
+    req.width = width;
+    req.height = height;
+    SubmitBackgroundRequest(std::move(req));
+}
+
+void LoadBackgroundImage(const std::wstring &path)
 {
-    if (!g_state.background.enabled || !g_bgImage)
+    ++g_bgGeneration;
+    g_bgImageW = g_bgImageH = 0;
+    ReleaseLayer(g_bgPreview);
+    ReleaseLayer(g_bgLayer);
+    ReleaseTileBrush();
+    ReleaseComposite();
+    g_state.background.imagePath = path;
+    g_state.background.enabled = true;
+    RECT rc;
+    GetClientRect(g_hwndEditor, &rc);
+    BackgroundRequest req;
+    req.generation = g_bgGeneration;
+    req.path = path;
+    req.position = g_state.background.position;
+    req.opacity = g_state.background.opacity;
+    req.width = g_state.background.position == BgPosition::Tile ? 1 : rc.right;
+    req.height = g_state.background.position == BgPosition::Tile ? 1 : rc.bottom;
+    g_bgRequested = req;
+    SubmitBackgroundRequest(std::move(req));
+    InvalidateRect(g_hwndEditor, nullptr, TRUE);
+}
+
+void OnBackgroundReady(LPARAM lParam)
+{
+    BackgroundResult *result = reinterpret_cast<BackgroundResult *>(lParam);
+    if (result->generation != g_bgGeneration || !g_state.background.enabled)
+    {
+        ReleaseLayer(result->preview);
+        ReleaseLayer(result->layer);
+        delete result;
+        return;
+    }
+    if (result->failed)
     {
-        if (g_bgBitmap)
+        g_state.background.enabled = false;
+        g_bgImageW = g_bgImageH = 0;
+    }
+    else
+    {
+        g_bgImageW = result->imageWidth;
+        g_bgImageH = result->imageHeight;
+        if (result->preview.bitmap)
         {
-            DeleteObject(g_bgBitmap);
-            g_bgBitmap = nullptr;
+            ReleaseLayer(g_bgPreview);
+            g_bgPreview = result->preview;
         }
+        if (result->layer.bitmap)
+        {
+            ReleaseLayer(g_bgLayer);
+            ReleaseTileBrush();
+            g_bgLayer = result->layer;
+        }
+    }
+    delete result;
+    ReleaseComposite();
+    InvalidateRect(g_hwndEditor, nullptr, TRUE);
+}
+
+bool HasBackgroundImage()
+{
+    return g_state.background.enabled && g_bgImageW > 0;
+}
+
+void CloseBackground()
+{
+    if (g_bgWorker)
+    {
+        BackgroundWorker *w = g_bgWorker;
+        g_bgWorker = nullptr;
+        if (w->hThread)
+        {
+            SetEvent(w->hStop);
+            WaitForSingleObject(w->hThread, INFINITE);
+            CloseHandle(w->hThread);
+        }
+        if (w->hWake)
+            CloseHandle(w->hWake);
+        if (w->hStop)
+            CloseHandle(w->hStop);
+        DeleteCriticalSection(&w->lock);
+        delete w;
+    }
+    ReleaseLayer(g_bgPreview);
+    ReleaseLayer(g_bgLayer);
+    ReleaseTileBrush();
+    ReleaseComposite();
+}
+
+static void BlendLayer(HDC hdc, const BackgroundLayer &layer, const RECT &dest)
+{
+    HDC hdcLayer = CreateCompatibleDC(hdc);
+    HBITMAP hOld = reinterpret_cast<HBITMAP>(SelectObject(hdcLayer, layer.bitmap));
+    BLENDFUNCTION blend = {AC_SRC_OVER, 0, 255, AC_SRC_ALPHA};
+    AlphaBlend(hdc, dest.left, dest.top, dest.right - dest.left, dest.bottom - dest.top,
+               hdcLayer, 0, 0, layer.width, layer.height, blend);
+    SelectObject(hdcLayer, hOld);
+    DeleteDC(hdcLayer);
+}
+
+// Tile mode fills with a pattern brush made once from the tile over the window colour.
+static HBRUSH TileBrush(HDC hdc, COLORREF bgColor)
+{
+    if (g_bgTileBrush && g_bgTileColor == bgColor)
+        return g_bgTileBrush;
+    ReleaseTileBrush();
+    g_bgTileBitmap = CreateCompatibleBitmap(hdc, g_bgLayer.width, g_bgLayer.height);
+    if (!g_bgTileBitmap)
+        return nullptr;
+    HDC hdcTile = CreateCompatibleDC(hdc);
+    HBITMAP hOld = reinterpret_cast<HBITMAP>(SelectObject(hdcTile, g_bgTileBitmap));
+    RECT rc = {0, 0, g_bgLayer.width, g_bgLayer.height};
+    HBRUSH hBrush = CreateSolidBrush(bgColor);
+    FillRect(hdcTile, &rc, hBrush);
+    DeleteObject(hBrush);
+    BlendLayer(hdcTile, g_bgLayer, rc);
+    SelectObject(hdcTile, hOld);
+    DeleteDC(hdcTile);
+    g_bgTileBrush = CreatePatternBrush(g_bgTileBitmap);
+    g_bgTileColor = bgColor;
+    return g_bgTileBrush;
+}
+
+// Draws the exact layer when it matches the window, otherwise stretches the preview into place
+// and asks the worker for the exact one.
+static void PaintBackground(HDC hdc, const RECT &rc, COLORREF bgColor)
+{
+    BgPosition pos = g_state.background.position;
+    BYTE opacity = g_state.background.opacity;
+    bool current = g_bgLayer.bitmap && g_bgLayer.position == pos && g_bgLayer.opacity == opacity;
+    if (pos == BgPosition::Tile)
+    {
+        HBRUSH hBrush = current ? TileBrush(hdc, bgColor) : nullptr;
+        if (hBrush)
+        {
+            FillRect(hdc, &rc, hBrush);
+            return;
+        }
+    }
+    else if (current && g_bgLayer.width == rc.right && g_bgLayer.height == rc.bottom)
+    {
+        BlendLayer(hdc, g_bgLayer, rc);
+        return;
+    }
+    if (g_bgPreview.bitmap && pos != BgPosition::Tile)
+        BlendLayer(hdc, g_bgPreview, ImageRect(pos, rc.right, rc.bottom, g_bgImageW, g_bgImageH));
+    RequestBackgroundLayer(rc.right, rc.bottom);
+}
+
+void UpdateBackgroundBitmap(HWND hwnd)
+{
+    if (!HasBackgroundImage())
+    {
+        ReleaseComposite();
         return;
     }
     RECT rc;
@@ -134,24 +503,21 @@ void UpdateBackgroundBitmap(HWND hwnd)
     int h = rc.bottom - rc.top;
     if (w <= 0 || h <= 0)
         return;
-    if (g_bgBitmap && g_bgBitmapW == w && g_bgBitmapH == h)
+    COLORREF bgColor = IsDarkMode() ? RGB(30, 30, 30) : GetSysColor(COLOR_WINDOW);
+    if (g_bgBitmap && g_bgBitmapW == w && g_bgBitmapH == h && g_bgBitmapColor == bgColor)
         return;
-    if (g_bgBitmap)
-    {
-        DeleteObject(g_bgBitmap);
-        g_bgBitmap = nullptr;
-    }
+    ReleaseComposite();
     HDC hdcScreen = GetDC(hwnd);
     HDC hdcMem = CreateCompatibleDC(hdcScreen);
     g_bgBitmap = CreateCompatibleBitmap(hdcScreen, w, h);
     g_bgBitmapW = w;
     g_bgBitmapH = h;
+    g_bgBitmapColor = bgColor;
     HBITMAP hOldBmp = reinterpret_cast<HBITMAP>(SelectObject(hdcMem, g_bgBitmap));
-    COLORREF bgColor = IsDarkMode() ? RGB(30, 30, 30) : GetSysColor(COLOR_WINDOW);
     HBRUSH hBrush = CreateSolidBrush(bgColor);
     FillRect(hdcMem, &rc, hBrush);
     DeleteObject(hBrush);
-    PaintBackground(hdcMem, rc);
+    PaintBackground(hdcMem, rc, bgColor);
     SelectObject(hdcMem, hOldBmp);
     DeleteDC(hdcMem);
     ReleaseDC(hwnd, hdcScreen);
@@ -233,15 +599,17 @@ void ViewSelectBackground()
 
 void ViewClearBackground()
 {
-    if (g_bgImage)
+    ++g_bgGeneration;
+    g_bgImageW = g_bgImageH = 0;
+    ReleaseLayer(g_bgPreview);
+    ReleaseLayer(g_bgLayer);
+    ReleaseTileBrush();
+    ReleaseComposite();
+    if (g_bgWorker)
     {
-        delete g_bgImage;
-        g_bgImage = nullptr;
-    }
-    if (g_bgBitmap)
-    {
-        DeleteObject(g_bgBitmap);
-        g_bgBitmap = nullptr;
+        BackgroundRequest req;
+        req.release = true;
+        SubmitBackgroundRequest(std::move(req));
     }
     g_state.background.enabled = false;
     g_state.background.imagePath.clear();
@@ -19,13 +19,15 @@
 #include <string>
 #include "core/types.h"
 
-extern Gdiplus::Image *g_bgImage;
 extern HBITMAP g_bgBitmap;
 extern int g_bgBitmapW;
 extern int g_bgBitmapH;
 
+// Starts decoding path on the background worker; the image shows once it is ready.
 void LoadBackgroundImage(const std::wstring &path);
-void PaintBackground(HDC hdc, const RECT &rc);
+void OnBackgroundReady(LPARAM lParam);
+bool HasBackgroundImage();
+void CloseBackground();
 void UpdateBackgroundBitmap(HWND hwnd);
 void SetBackgroundPosition(BgPosition pos);
 void ViewSelectBackground();
@@ -18,6 +18,10 @@
 #include "editor.h"
 #include "file.h"
 #include "ui.h"
+#include "viewer.h"
+#include "follow.h"
+#include "document.h"
+#include "journal.h"
 #include "resource.h"
 #include "lang/lang.h"
 #include <commdlg.h>
@@ -29,12 +33,8 @@ bool ConfirmDiscard()
     if (!g_state.modified)
         return true;
     //  untitled and empty, don't ask to save
-    if (g_state.filePath.empty())
-    {
-        std::wstring text = GetEditorText();
-        if (text.empty())
-            return true;
-    }
+    if (g_state.filePath.empty() && GetDocumentLength() == 0)
+        return true;
     const auto &lang = GetLangStrings();
     std::wstring filename = g_state.filePath.empty() ? lang.untitled : PathFindFileNameW(g_state.filePath.c_str());
     std::wstring msg;
@@ -43,11 +43,9 @@ bool ConfirmDiscard()
     msg += filename;
     msg += L"?";
     int result = MessageBoxW(g_hwndMain, msg.c_str(), lang.appName.c_str(), MB_YESNOCANCEL | MB_ICONWARNING);
+    // The document is only discarded once the save went through
     if (result == IDYES)
-    {
-        FileSave();
-        return true;
-    }
+        return FileSave();
     return result == IDNO;
 }
 
@@ -55,11 +53,15 @@ void FileNew()
 {
     if (!ConfirmDiscard())
         return;
+    CancelLoad();
+    CloseViewer();
+    StopFollow();
     SetEditorText(L"");
     g_state.filePath.clear();
     g_state.modified = false;
     g_state.encoding = Encoding::UTF8;
     g_state.lineEnding = LineEnding::CRLF;
+    ResetJournal();
     UpdateTitle();
     UpdateStatus();
 }
@@ -79,15 +81,14 @@ void FileOpen()
         LoadFile(path);
 }
 
-void FileSave()
+bool FileSave()
 {
     if (g_state.filePath.empty())
-        FileSaveAs();
-    else
-        SaveToPath(g_state.filePath);
+        return FileSaveAs();
+    return SaveToPath(g_state.filePath);
 }
 
-void FileSaveAs()
+bool FileSaveAs()
 {
     wchar_t path[MAX_PATH] = {0};
     OPENFILENAMEW ofn = {sizeof(ofn)};
@@ -97,13 +98,11 @@ void FileSaveAs()
     ofn.nMaxFile = MAX_PATH;
     ofn.lpstrDefExt = L"txt";
     ofn.Flags = OFN_OVERWRITEPROMPT;
-    if (GetSaveFileNameW(&ofn))
-        SaveToPath(path);
+    return GetSaveFileNameW(&ofn) && SaveToPath(path);
 }
 
 void FilePrint()
 {
-    std::wstring text = GetEditorText();
     PRINTDLGW pd = {sizeof(pd)};
     pd.hwndOwner = g_hwndMain;
     pd.Flags = PD_RETURNDC | PD_NOPAGENUMS | PD_NOSELECTION;
@@ -130,31 +129,21 @@ void FilePrint()
         GetTextMetricsW(hDC, &tm);
         int lineHeight = tm.tmHeight + tm.tmExternalLeading;
         int linesPerPage = printHeight / lineHeight;
-        std::vector<std::wstring> lines;
-        std::wstring line;
-        for (size_t i = 0; i <= text.size(); ++i)
-        {
-            if (i == text.size() || text[i] == L'\n' || text[i] == L'\r')
-            {
-                lines.push_back(line);
-                line.clear();
-                if (i < text.size() && text[i] == L'\r' && i + 1 < text.size() && text[i + 1] == L'\n')
-                    ++i;
-            }
-            else
-                line += text[i];
-        }
-        int totalLines = static_cast<int>(lines.size());
-        int lineIndex = 0;
-        while (lineIndex < totalLines)
+        const PieceTable &doc = GetDocument();
+        PieceLineReader reader;
+        const char16_t *line = nullptr;
+        size_t lineLength = 0;
+        bool more = NextPieceLine(doc, reader, line, lineLength);
+        while (more)
         {
             StartPage(hDC);
             int y = marginY;
-            for (int i = 0; i < linesPerPage && lineIndex < totalLines; ++i, ++lineIndex)
+            for (int i = 0; i < linesPerPage && more; ++i)
             {
                 RECT rc = {marginX, y, marginX + printWidth, y + lineHeight};
-                DrawTextW(hDC, lines[lineIndex].c_str(), -1, &rc, DT_LEFT | DT_NOPREFIX | DT_SINGLELINE);
+                DrawTextW(hDC, reinterpret_cast<const wchar_t *>(line), static_cast<int>(lineLength), &rc, DT_LEFT | DT_NOPREFIX | DT_SINGLELINE);
                 y += lineHeight;
+                more = NextPieceLine(doc, reader, line, lineLength);
             }
             EndPage(hDC);
         }
@@ -172,8 +161,8 @@ void FilePageSetup()
     PageSetupDlgW(&g_pageSetup);
 }
 
-void EditUndo() { SendMessageW(g_hwndEditor, EM_UNDO, 0, 0); }
-void EditRedo() { SendMessageW(g_hwndEditor, EM_UNDO, 0, 0); }
+void EditUndo() { UndoDocument(); }
+void EditRedo() { RedoDocument(); }
 void EditCut() { SendMessageW(g_hwndEditor, WM_CUT, 0, 0); }
 void EditCopy() { SendMessageW(g_hwndEditor, WM_COPY, 0, 0); }
 void EditPaste() { SendMessageW(g_hwndEditor, WM_PASTE, 0, 0); }
@@ -249,3 +238,33 @@ void ViewAlwaysOnTop()
     CheckMenuItem(GetMenu(g_hwndMain), IDM_VIEW_ALWAYSONTOP, g_state.alwaysOnTop ? MF_CHECKED : MF_UNCHECKED);
     SetWindowPos(g_hwndMain, g_state.alwaysOnTop ? HWND_TOPMOST : HWND_NOTOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE);
 }
+
+// A clean document is reloaded so the followed offset matches the text exactly; with unsaved
+// edits, following picks up from the current end of the file. The viewer cannot follow, so
+// there the item stays unchecked.
+void ViewFollow()
+{
+    if (!g_state.followMode && IsViewerActive())
+    {
+        const auto &lang = GetLangStrings();
+        MessageBoxW(g_hwndMain, lang.msgViewerNoFollow.c_str(), lang.appName.c_str(), MB_ICONINFORMATION);
+        return;
+    }
+    g_state.followMode = !g_state.followMode;
+    CheckMenuItem(GetMenu(g_hwndMain), IDM_VIEW_FOLLOW, g_state.followMode ? MF_CHECKED : MF_UNCHECKED);
+    if (!g_state.followMode)
+    {
+        StopFollow();
+        return;
+    }
+    if (g_state.filePath.empty() || IsLoading())
+        return;
+    if (!g_state.modified)
+    {
+        LoadFile(g_state.filePath);
+        return;
+    }
+    WIN32_FILE_ATTRIBUTE_DATA data{};
+    if (GetFileAttributesExW(g_state.filePath.c_str(), GetFileExInfoStandard, &data))
+        StartFollow(g_state.filePath, (static_cast<ULONGLONG>(data.nFileSizeHigh) << 32) | data.nFileSizeLow, g_state.encoding);
+}
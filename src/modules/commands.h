@@ -21,8 +21,8 @@ extern PAGESETUPDLGW g_pageSetup;
 bool ConfirmDiscard();
 void FileNew();
 void FileOpen();
-void FileSave();
-void FileSaveAs();
+bool FileSave();
+bool FileSaveAs();
 void FilePrint();
 void FilePageSetup();
 void EditUndo();
@@ -39,3 +39,4 @@ void ViewZoomOut();
 void ViewZoomDefault();
 void ViewStatusBar();
 void ViewAlwaysOnTop();
+void ViewFollow();
@@ -16,40 +16,110 @@
 #include "dialog.h"
 #include "core/globals.h"
 #include "editor.h"
+#include "document.h"
+#include "findall.h"
 #include "ui.h"
+#include "viewer.h"
 #include "lang/lang.h"
+#include "core/textregex.h"
 #include <commdlg.h>
 #include <algorithm>
-#include <cwctype>
+
+#define IDC_FIND_REGEX 1003
+
+static Regex g_findRegex;
+static std::wstring g_findRegexSource;
+
+// The find text compiled as a regular expression. It is kept until the text changes, so
+// repeated Find Next presses reuse the program and the DFA states already built.
+static Regex *GetFindRegex()
+{
+    if (!g_findRegex.compiled || g_findRegexSource != g_state.findText)
+    {
+        g_findRegexSource = g_state.findText;
+        if (!CompileRegex(g_findRegex, reinterpret_cast<const char16_t *>(g_state.findText.c_str()), g_state.findText.size(), true))
+        {
+            const auto &lang = GetLangStrings();
+            MessageBoxW(g_hwndMain, (lang.msgInvalidRegex + std::to_wstring(g_findRegex.errorAt + 1)).c_str(), lang.appName.c_str(), MB_ICONWARNING);
+            return nullptr;
+        }
+    }
+    return &g_findRegex;
+}
+
+// Find Next/Previous from the selection, wrapping around like FindPiecesWrapped. An empty
+// match at an empty selection would be found again, so the search steps past it.
+static bool FindRegexWrapped(Regex &regex, size_t selStart, size_t selEnd, bool forward, RegexMatch &match)
+{
+    const PieceTable &doc = GetDocument();
+    if (forward)
+    {
+        bool found = FindPiecesRegex(regex, doc, selEnd, TEXT_NPOS, match);
+        if (found && match.start == match.end && match.start == selStart && selStart == selEnd)
+            found = FindPiecesRegex(regex, doc, selEnd + 1, TEXT_NPOS, match);
+        return found || FindPiecesRegex(regex, doc, 0, TEXT_NPOS, match);
+    }
+    return (selStart > 0 && FindPiecesRegexBackward(regex, doc, selStart - 1, match)) ||
+           FindPiecesRegexBackward(regex, doc, TEXT_NPOS, match);
+}
+
+static void ReadFindFields(HWND hDlg, bool replace)
+{
+    wchar_t buf[256] = {0};
+    GetWindowTextW(GetDlgItem(hDlg, 1001), buf, 256);
+    g_state.findText = buf;
+    if (replace)
+    {
+        GetWindowTextW(GetDlgItem(hDlg, 1002), buf, 256);
+        g_state.replaceText = buf;
+    }
+    g_state.findRegex = IsDlgButtonChecked(hDlg, IDC_FIND_REGEX) == BST_CHECKED;
+}
 
 void DoFind(bool forward)
 {
     if (g_state.findText.empty())
         return;
-    std::wstring text = GetEditorText();
-    DWORD start = 0, end = 0;
-    SendMessageW(g_hwndEditor, EM_GETSEL, reinterpret_cast<WPARAM>(&start), reinterpret_cast<LPARAM>(&end));
-    std::wstring textLower = text;
-    std::transform(textLower.begin(), textLower.end(), textLower.begin(), towlower);
-    std::wstring findLower = g_state.findText;
-    std::transform(findLower.begin(), findLower.end(), findLower.begin(), towlower);
-    size_t pos = std::wstring::npos;
-    if (forward)
+    // The viewer only searches for plain text
+    if (IsViewerActive())
     {
-        pos = textLower.find(findLower, end);
-        if (pos == std::wstring::npos)
-            pos = textLower.find(findLower);
+        if (g_state.findRegex)
+        {
+            const auto &lang = GetLangStrings();
+            MessageBoxW(g_hwndMain, lang.msgViewerNoRegex.c_str(), lang.appName.c_str(), MB_ICONINFORMATION);
+            return;
+        }
+        if (!ViewerFind(g_state.findText, forward))
+        {
+            const auto &lang = GetLangStrings();
+            MessageBoxW(g_hwndMain, (lang.msgCannotFind + g_state.findText + L"\"").c_str(), lang.appName.c_str(), MB_ICONINFORMATION);
+        }
+        return;
     }
-    else
+    DWORD start = 0, end = 0;
+    SendMessageW(g_hwndEditor, EM_GETSEL, reinterpret_cast<WPARAM>(&start), reinterpret_cast<LPARAM>(&end));
+    size_t pos = TEXT_NPOS;
+    size_t length = g_state.findText.size();
+    // A complete Find All list for the same search answers without searching the document
+    bool listed = FindAllNext(g_state.findText, g_state.findRegex, start, end, forward, pos, length);
+    if (!listed && g_state.findRegex)
     {
-        if (start > 0)
-            pos = textLower.rfind(findLower, start - 1);
-        if (pos == std::wstring::npos)
-            pos = textLower.rfind(findLower);
+        Regex *regex = GetFindRegex();
+        if (!regex)
+            return;
+        RegexMatch match;
+        if (FindRegexWrapped(*regex, start, end, forward, match))
+        {
+            pos = match.start;
+            length = match.end - match.start;
+        }
     }
-    if (pos != std::wstring::npos)
+    else if (!listed)
+        pos = FindPiecesWrapped(GetDocument(), reinterpret_cast<const char16_t *>(g_state.findText.c_str()), g_state.findText.size(),
+                                start, end, forward);
+    if (pos != TEXT_NPOS)
     {
-        SendMessageW(g_hwndEditor, EM_SETSEL, pos, pos + g_state.findText.size());
+        SendMessageW(g_hwndEditor, EM_SETSEL, pos, pos + length);
         SendMessageW(g_hwndEditor, EM_SCROLLCARET, 0, 0);
     }
     else
@@ -73,72 +143,87 @@ INT_PTR CALLBACK FindDlgProc(HWND hDlg, UINT msg, WPARAM wParam, LPARAM lParam)
         switch (LOWORD(wParam))
         {
         case 1:
-        {
-            wchar_t buf[256] = {0};
-            GetWindowTextW(GetDlgItem(hDlg, 1001), buf, 256);
-            g_state.findText = buf;
+            ReadFindFields(hDlg, false);
             DoFind(true);
             return TRUE;
-        }
         case 2:
             DestroyWindow(hDlg);
             g_hwndFindDlg = nullptr;
-            SetFocus(g_hwndEditor);
+            SetFocus(g_hwndViewer ? g_hwndViewer : g_hwndEditor);
             return TRUE;
         case 3:
         {
-            wchar_t buf[256] = {0};
-            GetWindowTextW(GetDlgItem(hDlg, 1001), buf, 256);
-            g_state.findText = buf;
-            GetWindowTextW(GetDlgItem(hDlg, 1002), buf, 256);
-            g_state.replaceText = buf;
+            ReadFindFields(hDlg, true);
             if (g_state.findText.empty())
                 return TRUE;
             DWORD start = 0, end = 0;
             SendMessageW(g_hwndEditor, EM_GETSEL, reinterpret_cast<WPARAM>(&start), reinterpret_cast<LPARAM>(&end));
-            if (start != end)
+            if (g_state.findRegex)
             {
-                std::wstring text = GetEditorText();
-                std::wstring sel = text.substr(start, end - start);
-                std::transform(sel.begin(), sel.end(), sel.begin(), towlower);
-                std::wstring findLower = g_state.findText;
-                std::transform(findLower.begin(), findLower.end(), findLower.begin(), towlower);
-                if (sel == findLower)
-                    SendMessageW(g_hwndEditor, EM_REPLACESEL, TRUE, reinterpret_cast<LPARAM>(g_state.replaceText.c_str()));
+                // Replace only when the selection is exactly a match, expanding its groups
+                Regex *regex = GetFindRegex();
+                if (!regex)
+                    return TRUE;
+                RegexMatch match;
+                if (FindPiecesRegex(*regex, GetDocument(), start, start, match) && match.end == end)
+                {
+                    std::u16string text;
+                    AppendRegexReplacement(text, reinterpret_cast<const char16_t *>(g_state.replaceText.c_str()), g_state.replaceText.size(),
+                                           match, GetDocument());
+                    SendMessageW(g_hwndEditor, EM_REPLACESEL, TRUE, reinterpret_cast<LPARAM>(text.c_str()));
+                }
             }
+            else if (start != end && end - start == g_state.findText.size() &&
+                     PiecesEqualNoCase(GetDocument(), start, reinterpret_cast<const char16_t *>(g_state.findText.c_str()), g_state.findText.size()))
+                SendMessageW(g_hwndEditor, EM_REPLACESEL, TRUE, reinterpret_cast<LPARAM>(g_state.replaceText.c_str()));
             DoFind(true);
             return TRUE;
         }
         case 4:
         {
-            wchar_t buf[256] = {0};
-            GetWindowTextW(GetDlgItem(hDlg, 1001), buf, 256);
-            g_state.findText = buf;
-            GetWindowTextW(GetDlgItem(hDlg, 1002), buf, 256);
-            g_state.replaceText = buf;
+            ReadFindFields(hDlg, true);
+            if (g_state.findText.empty())
+                return TRUE;
+            size_t count = 0;
+            if (g_state.findRegex)
+            {
+                Regex *regex = GetFindRegex();
+                if (!regex)
+                    return TRUE;
+                count = ReplaceAllRegexInDocument(*regex, g_state.replaceText.c_str(), g_state.replaceText.size());
+            }
+            else
+                count = ReplaceAllInDocument(g_state.findText.c_str(), g_state.findText.size(), g_state.replaceText.c_str(), g_state.replaceText.size());
+            const auto &lang = GetLangStrings();
+            if (!count)
+            {
+                MessageBoxW(g_hwndMain, (lang.msgCannotFind + g_state.findText + L"\"").c_str(), lang.appName.c_str(), MB_ICONINFORMATION);
+                return TRUE;
+            }
+            g_state.modified = true;
+            UpdateTitle();
+            MessageBoxW(g_hwndMain, (std::to_wstring(count) + lang.msgReplacedCount).c_str(), lang.appName.c_str(), MB_ICONINFORMATION);
+            return TRUE;
+        }
+        case 5:
+        {
+            ReadFindFields(hDlg, GetDlgItem(hDlg, 1002) != nullptr);
             if (g_state.findText.empty())
                 return TRUE;
-            std::wstring text = GetEditorText();
-            std::wstring findLower = g_state.findText;
-            std::transform(findLower.begin(), findLower.end(), findLower.begin(), towlower);
-            std::wstring lower = text;
-            std::transform(lower.begin(), lower.end(), lower.begin(), towlower);
-            std::wstring newText;
-            newText.reserve(text.size() + (g_state.replaceText.size() - g_state.findText.size()) * 10);
-            size_t lastPos = 0, pos = 0;
-            while ((pos = lower.find(findLower, lastPos)) != std::wstring::npos)
+            // The viewer has no list to show; it finds the next match as before
+            if (IsViewerActive())
             {
-                newText += text.substr(lastPos, pos - lastPos);
-                newText += g_state.replaceText;
-                lastPos = pos + g_state.findText.size();
+                DoFind(true);
+                return TRUE;
             }
-            newText += text.substr(lastPos);
-            if (newText != text)
+            if (g_state.findRegex)
             {
-                SetEditorText(newText);
-                g_state.modified = true;
-                UpdateTitle();
+                Regex *regex = GetFindRegex();
+                if (regex)
+                    FindAll(g_state.findText, regex);
             }
+            else
+                FindAll(g_state.findText, nullptr);
             return TRUE;
         }
         }
@@ -160,7 +245,7 @@ INT_PTR CALLBACK FindDlgProc(HWND hDlg, UINT msg, WPARAM wParam, LPARAM lParam)
     case WM_CLOSE:
         DestroyWindow(hDlg);
         g_hwndFindDlg = nullptr;
-        SetFocus(g_hwndEditor);
+        SetFocus(g_hwndViewer ? g_hwndViewer : g_hwndEditor);
         return TRUE;
     case WM_DESTROY:
         g_hwndFindDlg = nullptr;
@@ -178,7 +263,7 @@ void EditFind()
     }
     const auto &lang = GetLangStrings();
     g_hwndFindDlg = CreateWindowExW(WS_EX_DLGMODALFRAME, L"#32770", lang.dialogFind.c_str(),
-                                    WS_POPUP | WS_CAPTION | WS_SYSMENU | WS_VISIBLE, 100, 100, 420, 120,
+                                    WS_POPUP | WS_CAPTION | WS_SYSMENU | WS_VISIBLE, 100, 100, 420, 150,
                                     g_hwndMain, nullptr, GetModuleHandleW(nullptr), nullptr);
     if (g_hwndFindDlg)
     {
@@ -186,7 +271,12 @@ void EditFind()
         CreateWindowExW(0, L"STATIC", lang.dialogFindLabel.c_str(), WS_CHILD | WS_VISIBLE, 10, 12, 45, 16, g_hwndFindDlg, nullptr, nullptr, nullptr);
         CreateWindowExW(WS_EX_CLIENTEDGE, L"EDIT", g_state.findText.c_str(), WS_CHILD | WS_VISIBLE | ES_AUTOHSCROLL, 60, 10, 230, 20, g_hwndFindDlg, reinterpret_cast<HMENU>(1001), nullptr, nullptr);
         CreateWindowExW(0, L"BUTTON", lang.dialogFindNext.c_str(), WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON, 300, 10, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(1), nullptr, nullptr);
-        CreateWindowExW(0, L"BUTTON", lang.dialogClose.c_str(), WS_CHILD | WS_VISIBLE, 300, 38, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(2), nullptr, nullptr);
+        bool viewer = IsViewerActive();
+        CreateWindowExW(0, L"BUTTON", lang.dialogRegex.c_str(), WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX | (viewer ? WS_DISABLED : 0), 60, 38, 230, 20,
+                        g_hwndFindDlg, reinterpret_cast<HMENU>(IDC_FIND_REGEX), nullptr, nullptr);
+        CheckDlgButton(g_hwndFindDlg, IDC_FIND_REGEX, g_state.findRegex && !viewer ? BST_CHECKED : BST_UNCHECKED);
+        CreateWindowExW(0, L"BUTTON", lang.dialogFindAll.c_str(), WS_CHILD | WS_VISIBLE, 300, 38, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(5), nullptr, nullptr);
+        CreateWindowExW(0, L"BUTTON", lang.dialogClose.c_str(), WS_CHILD | WS_VISIBLE, 300, 66, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(2), nullptr, nullptr);
         for (HWND h = GetWindow(g_hwndFindDlg, GW_CHILD); h; h = GetWindow(h, GW_HWNDNEXT))
             SendMessageW(h, WM_SETFONT, reinterpret_cast<WPARAM>(hFont), TRUE);
         SetWindowLongPtrW(g_hwndFindDlg, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(FindDlgProc));
@@ -215,8 +305,13 @@ void EditReplace()
         return;
     }
     const auto &lang = GetLangStrings();
+    if (IsViewerActive())
+    {
+        MessageBoxW(g_hwndMain, lang.msgViewerReadOnly.c_str(), lang.appName.c_str(), MB_ICONINFORMATION);
+        return;
+    }
     g_hwndFindDlg = CreateWindowExW(WS_EX_DLGMODALFRAME, L"#32770", lang.dialogFindReplace.c_str(),
-                                    WS_POPUP | WS_CAPTION | WS_SYSMENU | WS_VISIBLE, 100, 100, 420, 175,
+                                    WS_POPUP | WS_CAPTION | WS_SYSMENU | WS_VISIBLE, 100, 100, 420, 205,
                                     g_hwndMain, nullptr, GetModuleHandleW(nullptr), nullptr);
     if (g_hwndFindDlg)
     {
@@ -228,7 +323,10 @@ void EditReplace()
         CreateWindowExW(0, L"BUTTON", lang.dialogFindNext.c_str(), WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON, 300, 10, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(1), nullptr, nullptr);
         CreateWindowExW(0, L"BUTTON", lang.dialogReplace.c_str(), WS_CHILD | WS_VISIBLE, 300, 38, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(3), nullptr, nullptr);
         CreateWindowExW(0, L"BUTTON", lang.dialogReplaceAll.c_str(), WS_CHILD | WS_VISIBLE, 300, 66, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(4), nullptr, nullptr);
-        CreateWindowExW(0, L"BUTTON", lang.dialogClose.c_str(), WS_CHILD | WS_VISIBLE, 300, 94, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(2), nullptr, nullptr);
+        CreateWindowExW(0, L"BUTTON", lang.dialogRegex.c_str(), WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX, 60, 66, 230, 20, g_hwndFindDlg, reinterpret_cast<HMENU>(IDC_FIND_REGEX), nullptr, nullptr);
+        CheckDlgButton(g_hwndFindDlg, IDC_FIND_REGEX, g_state.findRegex ? BST_CHECKED : BST_UNCHECKED);
+        CreateWindowExW(0, L"BUTTON", lang.dialogFindAll.c_str(), WS_CHILD | WS_VISIBLE, 300, 94, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(5), nullptr, nullptr);
+        CreateWindowExW(0, L"BUTTON", lang.dialogClose.c_str(), WS_CHILD | WS_VISIBLE, 300, 122, 100, 22, g_hwndFindDlg, reinterpret_cast<HMENU>(2), nullptr, nullptr);
         for (HWND h = GetWindow(g_hwndFindDlg, GW_CHILD); h; h = GetWindow(h, GW_HWNDNEXT))
             SendMessageW(h, WM_SETFONT, reinterpret_cast<WPARAM>(hFont), TRUE);
         SetWindowLongPtrW(g_hwndFindDlg, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(FindDlgProc));
@@ -263,15 +361,16 @@ INT_PTR CALLBACK GotoDlgProc(HWND hDlg, UINT msg, WPARAM wParam, LPARAM)
             {
                 wchar_t buf[32];
                 GetWindowTextW(hEdit, buf, 32);
+                if (IsViewerActive())
+                {
+                    ViewerGotoLine(static_cast<ULONGLONG>(_wtoi64(buf)));
+                    EndDialog(hDlg, IDOK);
+                    return TRUE;
+                }
                 int line = _wtoi(buf);
                 if (line > 0)
                 {
-                    std::wstring text = GetEditorText();
-                    int current = 1;
-                    size_t pos = 0;
-                    for (size_t i = 0; i < text.size() && current < line; ++i)
-                        if (text[i] == L'\n') { ++current; pos = i + 1; }
-                    if (current < line) pos = text.size();
+                    size_t pos = PieceLineStart(GetDocument(), static_cast<size_t>(line));
                     SendMessageW(g_hwndEditor, EM_SETSEL, pos, pos);
                     SendMessageW(g_hwndEditor, EM_SCROLLCARET, 0, 0);
                     SetFocus(g_hwndEditor);
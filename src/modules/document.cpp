@@ -0,0 +1,361 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Document text owned by the application as a piece table. Every edit the control makes is
+  captured around the message that caused it and applied to the table as one replace.
+*/
+
+#include "document.h"
+#include "core/globals.h"
+#include "core/textreplace.h"
+#include "core/textscan.h"
+#include "core/undohistory.h"
+#include "editor.h"
+#include "file.h"
+#include "findall.h"
+#include "journal.h"
+#include "viewer.h"
+#include <richedit.h>
+#include <algorithm>
+
+#define DOCUMENT_JOURNAL_MAX_UNITS (64u << 10)
+
+static PieceTable g_document;
+static UndoHistory g_history;
+static int g_editDepth = 0;
+static bool g_editCapture = false;
+static bool g_editChanged = false;
+static bool g_editTyping = false;
+static bool g_syncing = false;
+static bool g_stale = false;
+static CHARRANGE g_editSel{};
+static LONG g_editLength = 0;
+static std::wstring g_editText;
+
+static LONG EditorTextLength()
+{
+    GETTEXTLENGTHEX gtl = {GTL_NUMCHARS | GTL_PRECISE, 1200};
+    return static_cast<LONG>(SendMessageW(g_hwndEditor, EM_GETTEXTLENGTHEX, reinterpret_cast<WPARAM>(&gtl), 0));
+}
+
+static std::wstring GetEditorRange(LONG start, LONG end)
+{
+    std::wstring text(static_cast<size_t>(end - start) + 1, L'\0');
+    TEXTRANGEW tr = {{start, end}, &text[0]};
+    LRESULT n = SendMessageW(g_hwndEditor, EM_GETTEXTRANGE, 0, reinterpret_cast<LPARAM>(&tr));
+    text.resize(n > 0 ? static_cast<size_t>(n) : 0);
+    return text;
+}
+
+// RichEdit hands out its text with CR paragraph ends, matching its offsets.
+static std::wstring ReadEditorControl()
+{
+    std::wstring text;
+    LONG length = EditorTextLength();
+    if (length <= 0)
+        return text;
+    text.resize(static_cast<size_t>(length) + 1);
+    GETTEXTEX gt = {static_cast<DWORD>(text.size() * sizeof(wchar_t)), GT_DEFAULT, 1200, nullptr, nullptr};
+    LRESULT n = SendMessageW(g_hwndEditor, EM_GETTEXTEX, reinterpret_cast<WPARAM>(&gt), reinterpret_cast<LPARAM>(&text[0]));
+    text.resize(n > 0 ? static_cast<size_t>(n) : 0);
+    return text;
+}
+
+// Rebuilds the table from the control after a change no edit message accounted for.
+static void ResyncDocument()
+{
+    g_stale = false;
+    std::wstring text = ReadEditorControl();
+    ClearUndo(g_history);
+    ClearPieces(g_document);
+    AppendPieceBuffer(g_document, std::u16string(reinterpret_cast<const char16_t *>(text.c_str()), text.size()));
+}
+
+const PieceTable &GetDocument()
+{
+    if (g_stale)
+        ResyncDocument();
+    return g_document;
+}
+
+size_t GetDocumentLength()
+{
+    return GetDocument().length;
+}
+
+// The editor wraps its own text updates in Begin/EndDocumentSync and mirrors them into the
+// table, so the EN_CHANGE they raise is known to be accounted for.
+void BeginDocumentSync()
+{
+    g_syncing = true;
+}
+
+void EndDocumentSync()
+{
+    g_syncing = false;
+}
+
+void LoadDocumentSettings()
+{
+    HKEY hKey;
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\LegacyNotepad", 0, KEY_READ, &hKey) == ERROR_SUCCESS)
+    {
+        DWORD value = 0, size = sizeof(value);
+        if (RegQueryValueExW(hKey, L"UndoLimitMB", nullptr, nullptr, reinterpret_cast<LPBYTE>(&value), &size) == ERROR_SUCCESS && value)
+            g_history.limit = static_cast<size_t>(value) << 20;
+        RegCloseKey(hKey);
+    }
+}
+
+// A new text starts a new history; the old steps point into buffers that are gone.
+void SetDocumentText(const wchar_t *text, size_t length)
+{
+    g_stale = false;
+    ClearUndo(g_history);
+    ClearPieces(g_document);
+    std::u16string copy(reinterpret_cast<const char16_t *>(text), length);
+    copy.resize(CollapseLineBreaks(&copy[0], copy.size()));
+    AppendPieceBuffer(g_document, std::move(copy));
+    RequestJournalSnapshot();
+    ResetFindAll();
+}
+
+// Text streamed into the control, already with CR line breaks.
+void AppendDocumentText(std::u16string &&text)
+{
+    AppendPieceBuffer(g_document, std::move(text));
+    RequestJournalSnapshot();
+    ResetFindAll();
+}
+
+// Applies a splice to the table and the control alike. Short edits go to the journal as they
+// are; long ones are left to the next snapshot.
+static void SpliceDocument(size_t offset, size_t removed, const std::vector<Piece> &pieces, size_t length)
+{
+    SplicePieces(g_document, offset, removed, pieces.data(), pieces.size());
+    BeginDocumentSync();
+    ReplaceEditorRange(offset, offset + removed, g_document, length);
+    EndDocumentSync();
+    NoteFindAllEdit(offset, removed, length);
+    if (length > DOCUMENT_JOURNAL_MAX_UNITS)
+    {
+        RequestJournalSnapshot();
+        return;
+    }
+    std::wstring text(length, L'\0');
+    CopyPieces(g_document, offset, length, reinterpret_cast<char16_t *>(&text[0]));
+    RecordJournalEdit(offset, removed, text.c_str(), text.size());
+}
+
+// Undo selects the text it brought back, redo puts the caret after what it applied.
+void UndoDocument()
+{
+    if (g_stale || IsLoading() || IsViewerActive())
+        return;
+    const UndoStep *step = TakeUndo(g_history);
+    if (!step)
+        return;
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, FALSE, 0);
+    for (size_t i = step->edits.size(); i-- > 0;)
+    {
+        const UndoEdit &edit = step->edits[i];
+        SpliceDocument(edit.offset, edit.insertedLength, edit.removed, edit.removedLength);
+    }
+    const UndoEdit &first = step->edits.front();
+    SendMessageW(g_hwndEditor, EM_SETSEL, first.offset, first.offset + first.removedLength);
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(g_hwndEditor, nullptr, TRUE);
+    SendMessageW(g_hwndEditor, EM_SCROLLCARET, 0, 0);
+}
+
+void RedoDocument()
+{
+    if (g_stale || IsLoading() || IsViewerActive())
+        return;
+    const UndoStep *step = TakeRedo(g_history);
+    if (!step)
+        return;
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, FALSE, 0);
+    for (const UndoEdit &edit : step->edits)
+        SpliceDocument(edit.offset, edit.removedLength, edit.inserted, edit.insertedLength);
+    const UndoEdit &last = step->edits.back();
+    SendMessageW(g_hwndEditor, EM_SETSEL, last.offset + last.insertedLength, last.offset + last.insertedLength);
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(g_hwndEditor, nullptr, TRUE);
+    SendMessageW(g_hwndEditor, EM_SCROLLCARET, 0, 0);
+}
+
+// Once evicted steps have let go of half the limit's worth of text, the buffers are rebuilt
+// without it so the memory is given back.
+static void RecordDocumentUndo(UndoEdit &&edit, bool typing)
+{
+    RecordDocumentUndo(std::move(edit), typing);
+    if (g_history.released > g_history.limit / 2)
+        CompactUndoBuffers(g_history, g_document);
+}
+
+// Applies a Replace All as one undo step. The selection follows the text it was on and the
+// view stays where it was.
+static size_t CommitReplaceAll(ReplaceAllEdit &replace)
+{
+    if (!replace.count)
+        return 0;
+    UndoEdit &edit = replace.edit;
+    POINT scroll{};
+    SendMessageW(g_hwndEditor, EM_GETSCROLLPOS, 0, reinterpret_cast<LPARAM>(&scroll));
+    CollectPieces(g_document, edit.offset, edit.removedLength, edit.removed);
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, FALSE, 0);
+    SpliceDocument(edit.offset, edit.removedLength, edit.inserted, edit.insertedLength);
+    SendMessageW(g_hwndEditor, EM_SETSEL, replace.newSelStart, replace.newSelEnd);
+    SendMessageW(g_hwndEditor, EM_SETSCROLLPOS, 0, reinterpret_cast<LPARAM>(&scroll));
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(g_hwndEditor, nullptr, TRUE);
+    RecordDocumentUndo(std::move(edit), false);
+    return replace.count;
+}
+
+static void BeginReplaceAllInDocument(ReplaceAllEdit &replace)
+{
+    if (g_stale)
+        ResyncDocument();
+    DWORD start = 0, end = 0;
+    SendMessageW(g_hwndEditor, EM_GETSEL, reinterpret_cast<WPARAM>(&start), reinterpret_cast<LPARAM>(&end));
+    replace.selStart = start;
+    replace.selEnd = end;
+}
+
+// Every match becomes a splice of one shared copy of the replacement between the pieces of
+// the text around it, all in one edit, so the old text is never copied and one undo brings it
+// back. Large documents are searched on every core.
+size_t ReplaceAllInDocument(const wchar_t *find, size_t findLength, const wchar_t *replacement, size_t replacementLength)
+{
+    NoCasePattern pattern;
+    PrepareNoCase(pattern, reinterpret_cast<const char16_t *>(find), findLength);
+    ReplaceAllEdit replace;
+    BeginReplaceAllInDocument(replace);
+    const char16_t *text = reinterpret_cast<const char16_t *>(replacement);
+    if (g_document.length >= REPLACE_PARALLEL_MIN_UNITS)
+        BuildReplaceAllParallel(g_document, pattern, text, replacementLength, replace, 0);
+    else
+        BuildReplaceAll(g_document, pattern, text, replacementLength, replace);
+    return CommitReplaceAll(replace);
+}
+
+size_t ReplaceAllRegexInDocument(Regex &regex, const wchar_t *replacement, size_t replacementLength)
+{
+    ReplaceAllEdit replace;
+    BeginReplaceAllInDocument(replace);
+    const char16_t *text = reinterpret_cast<const char16_t *>(replacement);
+    if (g_document.length >= REPLACE_PARALLEL_MIN_UNITS)
+        BuildReplaceAllRegexParallel(g_document, regex, text, replacementLength, replace, 0);
+    else
+        BuildReplaceAllRegex(g_document, regex, text, replacementLength, replace);
+    return CommitReplaceAll(replace);
+}
+
+bool IsDocumentEditMessage(UINT msg)
+{
+    switch (msg)
+    {
+    case WM_CHAR:
+    case WM_KEYDOWN:
+    case WM_SYSCHAR:
+    case WM_SYSKEYDOWN:
+    case WM_PASTE:
+    case WM_CUT:
+    case WM_CLEAR:
+    case EM_REPLACESEL:
+    case WM_IME_CHAR:
+    case WM_IME_COMPOSITION:
+    case WM_IME_ENDCOMPOSITION:
+    case WM_LBUTTONDOWN:
+        return true;
+    }
+    return false;
+}
+
+// Keystrokes that type or delete a character may join the undo step before them.
+void BeginDocumentEdit(UINT msg, WPARAM wParam)
+{
+    if (g_editDepth++ > 0)
+        return;
+    g_editChanged = false;
+    g_editTyping = msg == WM_CHAR || msg == WM_IME_CHAR || (msg == WM_KEYDOWN && (wParam == VK_BACK || wParam == VK_DELETE));
+    g_editCapture = !g_syncing && !IsLoading() && !IsViewerActive();
+    if (!g_editCapture)
+        return;
+    SendMessageW(g_hwndEditor, EM_EXGETSEL, 0, reinterpret_cast<LPARAM>(&g_editSel));
+    g_editLength = EditorTextLength();
+}
+
+// RichEdit does not say what an edit changed, so it is bounded from the selection before and
+// after: every edit it makes from input or drag and drop starts at or after the
+// smaller selection start and ends by the larger end. The span may be wider than the real
+// change but always yields the same text.
+void EndDocumentEdit()
+{
+    if (--g_editDepth > 0 || !g_editCapture || !g_editChanged)
+        return;
+    CHARRANGE sel{};
+    SendMessageW(g_hwndEditor, EM_EXGETSEL, 0, reinterpret_cast<LPARAM>(&sel));
+    LONG length = EditorTextLength();
+    LONG delta = length - g_editLength;
+    LONG start = (std::min)(g_editSel.cpMin, sel.cpMin);
+    LONG end = (std::min)((std::max)(sel.cpMax, g_editSel.cpMax + delta), length);
+    LONG removed = end - start - delta;
+    bool valid = !g_stale && g_document.length == static_cast<size_t>(g_editLength) && start >= 0 && end >= start && removed >= 0 &&
+                 start + removed <= g_editLength;
+    if (valid)
+    {
+        g_editText = GetEditorRange(start, end);
+        valid = g_editText.size() == static_cast<size_t>(end - start);
+    }
+    if (!valid)
+    {
+        g_stale = true;
+        RequestJournalSnapshot();
+        ResetFindAll();
+        return;
+    }
+    UndoEdit edit;
+    edit.offset = static_cast<size_t>(start);
+    edit.removedLength = static_cast<size_t>(removed);
+    edit.insertedLength = g_editText.size();
+    CollectPieces(g_document, edit.offset, edit.removedLength, edit.removed);
+    Piece piece = AddPieceText(g_document, reinterpret_cast<const char16_t *>(g_editText.c_str()), g_editText.size());
+    if (piece.length)
+        edit.inserted.push_back(piece);
+    SplicePieces(g_document, edit.offset, edit.removedLength, edit.inserted.data(), edit.inserted.size());
+    // A line break ends the typing run it belongs to
+    bool typing = g_editTyping && edit.insertedLength <= 2 && (edit.insertedLength || edit.removedLength <= 2) &&
+                  g_editText.find(L'\r') == std::wstring::npos;
+    RecordDocumentUndo(std::move(edit), typing);
+    RecordJournalEdit(static_cast<size_t>(start), static_cast<size_t>(removed), g_editText.c_str(), g_editText.size());
+    NoteFindAllEdit(static_cast<size_t>(start), static_cast<size_t>(removed), g_editText.size());
+}
+
+// EN_CHANGE: inside an edit message the change is picked up when it returns and during a
+// sync the table already has it; anything else has the table rebuilt on its next read, and
+// the undo history with it.
+void NoteDocumentChange()
+{
+    if (g_editDepth > 0)
+    {
+        g_editChanged = true;
+        return;
+    }
+    if (g_syncing)
+        return;
+    g_stale = true;
+    ClearUndo(g_history);
+    RequestJournalSnapshot();
+    ResetFindAll();
+}
@@ -0,0 +1,36 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Document text owned by the application as a piece table, kept in step with the editor
+  control so find, save, print and go-to read it without copying the control's text.
+*/
+
+#pragma once
+#include <windows.h>
+#include <string>
+#include "core/piecetable.h"
+#include "core/textregex.h"
+
+const PieceTable &GetDocument();
+size_t GetDocumentLength();
+void BeginDocumentSync();
+void EndDocumentSync();
+void LoadDocumentSettings();
+void SetDocumentText(const wchar_t *text, size_t length);
+void AppendDocumentText(std::u16string &&text);
+void UndoDocument();
+void RedoDocument();
+size_t ReplaceAllInDocument(const wchar_t *find, size_t findLength, const wchar_t *replacement, size_t replacementLength);
+size_t ReplaceAllRegexInDocument(Regex &regex, const wchar_t *replacement, size_t replacementLength);
+bool IsDocumentEditMessage(UINT msg);
+void BeginDocumentEdit(UINT msg, WPARAM wParam);
+void EndDocumentEdit();
+void NoteDocumentChange();
@@ -18,33 +18,125 @@
 #include "core/globals.h"
 #include "theme.h"
 #include "background.h"
+#include "file.h"
+#include "viewer.h"
+#include "document.h"
+#include "findall.h"
 #include "resource.h"
+#include "core/textscan.h"
+#include <richedit.h>
+#include <algorithm>
+#include <cstring>
 
-std::wstring GetEditorText()
+void SetEditorText(const std::wstring &text)
 {
-    int len = GetWindowTextLengthW(g_hwndEditor);
-    if (len <= 0)
-        return L"";
-    std::wstring text(len + 1, 0);
-    GetWindowTextW(g_hwndEditor, &text[0], len + 1);
-    text.resize(len);
-    return text;
+    BeginDocumentSync();
+    SetWindowTextW(g_hwndEditor, text.c_str());
+    SetDocumentText(text.c_str(), text.size());
+    EndDocumentSync();
 }
 
-void SetEditorText(const std::wstring &text)
+struct TextSource
 {
-    SetWindowTextW(g_hwndEditor, text.c_str());
+    const wchar_t *text = nullptr;
+    size_t remaining = 0;
+};
+
+static DWORD CALLBACK TextSourceCallback(DWORD_PTR cookie, LPBYTE buf, LONG cb, LONG *pcb)
+{
+    TextSource &src = *reinterpret_cast<TextSource *>(cookie);
+    size_t n = (std::min)(src.remaining, static_cast<size_t>(cb) / sizeof(wchar_t));
+    memcpy(buf, src.text, n * sizeof(wchar_t));
+    src.text += n;
+    src.remaining -= n;
+    *pcb = static_cast<LONG>(n * sizeof(wchar_t));
+    return 0;
+}
+
+struct PieceSource
+{
+    const PieceTable *table = nullptr;
+    size_t pos = 0;
+    size_t end = 0;
+};
+
+static DWORD CALLBACK PieceSourceCallback(DWORD_PTR cookie, LPBYTE buf, LONG cb, LONG *pcb)
+{
+    PieceSource &src = *reinterpret_cast<PieceSource *>(cookie);
+    size_t n = (std::min)(src.end - src.pos, static_cast<size_t>(cb) / sizeof(wchar_t));
+    n = CopyPieces(*src.table, src.pos, n, reinterpret_cast<char16_t *>(buf));
+    src.pos += n;
+    *pcb = static_cast<LONG>(n * sizeof(wchar_t));
+    return 0;
+}
+
+// Replaces [start, end) of the control with the length units the table holds at start, streamed
+// straight out of its pieces. The caret ends up behind the new text.
+void ReplaceEditorRange(size_t start, size_t end, const PieceTable &doc, size_t length)
+{
+    CHARRANGE range = {static_cast<LONG>(start), static_cast<LONG>(end)};
+    SendMessageW(g_hwndEditor, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&range));
+    if (!length)
+    {
+        SendMessageW(g_hwndEditor, EM_REPLACESEL, FALSE, reinterpret_cast<LPARAM>(L""));
+        return;
+    }
+    PieceSource src;
+    src.table = &doc;
+    src.pos = start;
+    src.end = start + length;
+    EDITSTREAM es{};
+    es.dwCookie = reinterpret_cast<DWORD_PTR>(&src);
+    es.pfnCallback = PieceSourceCallback;
+    SendMessageW(g_hwndEditor, EM_STREAMIN, SF_TEXT | SF_UNICODE | SFF_SELECTION, reinterpret_cast<LPARAM>(&es));
+}
+
+// Streams text in at the end of the document without moving the caret or the view, then
+// hands the buffer to the document as a piece of its own.
+void AppendEditorText(std::u16string &&text)
+{
+    text.resize(CollapseLineBreaks(&text[0], text.size()));
+    if (text.empty())
+        return;
+    CHARRANGE sel{};
+    POINT scroll{};
+    SendMessageW(g_hwndEditor, EM_EXGETSEL, 0, reinterpret_cast<LPARAM>(&sel));
+    SendMessageW(g_hwndEditor, EM_GETSCROLLPOS, 0, reinterpret_cast<LPARAM>(&scroll));
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, FALSE, 0);
+    CHARRANGE end = {-1, -1};
+    SendMessageW(g_hwndEditor, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&end));
+    TextSource src;
+    src.text = reinterpret_cast<const wchar_t *>(text.c_str());
+    src.remaining = text.size();
+    EDITSTREAM es{};
+    es.dwCookie = reinterpret_cast<DWORD_PTR>(&src);
+    es.pfnCallback = TextSourceCallback;
+    BeginDocumentSync();
+    SendMessageW(g_hwndEditor, EM_STREAMIN, SF_TEXT | SF_UNICODE | SFF_SELECTION, reinterpret_cast<LPARAM>(&es));
+    AppendDocumentText(std::move(text));
+    EndDocumentSync();
+    SendMessageW(g_hwndEditor, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&sel));
+    SendMessageW(g_hwndEditor, EM_SETSCROLLPOS, 0, reinterpret_cast<LPARAM>(&scroll));
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(g_hwndEditor, nullptr, FALSE);
+}
+
+void ScrollEditorToEnd()
+{
+    CHARRANGE end = {-1, -1};
+    SendMessageW(g_hwndEditor, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&end));
+    SendMessageW(g_hwndEditor, EM_SCROLLCARET, 0, 0);
 }
 
 std::pair<int, int> GetCursorPos()
 {
     DWORD start = 0, end = 0;
     SendMessageW(g_hwndEditor, EM_GETSEL, reinterpret_cast<WPARAM>(&start), reinterpret_cast<LPARAM>(&end));
-    int pos = static_cast<int>(start);
-    int line = static_cast<int>(SendMessageW(g_hwndEditor, EM_LINEFROMCHAR, pos, 0)) + 1;
-    int lineStart = static_cast<int>(SendMessageW(g_hwndEditor, EM_LINEINDEX, line - 1, 0));
-    int col = pos - lineStart + 1;
-    return {line, col};
+    const PieceTable &doc = GetDocument();
+    size_t pos = (std::min)(static_cast<size_t>(start), doc.length);
+    size_t line = PieceLineAt(doc, pos) + 1;
+    size_t col = pos - PieceLineStart(doc, line) + 1;
+    return {static_cast<int>(line), static_cast<int>(col)};
 }
 
 void ApplyFont()
@@ -64,6 +156,8 @@ void ApplyFont()
                                 DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY,
                                 FIXED_PITCH | FF_MODERN, g_state.fontName.c_str());
     SendMessageW(g_hwndEditor, WM_SETFONT, reinterpret_cast<WPARAM>(g_state.hFont), TRUE);
+    if (g_hwndViewer)
+        SendMessageW(g_hwndViewer, WM_SETFONT, reinterpret_cast<WPARAM>(g_state.hFont), TRUE);
 }
 
 void ApplyZoom()
@@ -71,31 +165,22 @@ void ApplyZoom()
     ApplyFont();
 }
 
+// RichEdit wraps at the window edge for a zero line width and practically never for a width
+// of one twip, so the same control keeps its text, undo stack and selection. Only the view is
+// reflowed; the first visible character is kept at the top.
 void ApplyWordWrap()
 {
-    std::wstring text = GetEditorText();
-    DWORD start = 0, end = 0;
-    SendMessageW(g_hwndEditor, EM_GETSEL, reinterpret_cast<WPARAM>(&start), reinterpret_cast<LPARAM>(&end));
-    DestroyWindow(g_hwndEditor);
-    DWORD style = WS_CHILD | WS_VISIBLE | WS_VSCROLL | ES_MULTILINE | ES_WANTRETURN | ES_NOHIDESEL;
-    if (!g_state.wordWrap)
-        style |= WS_HSCROLL | ES_AUTOHSCROLL;
-    g_hwndEditor = CreateWindowExW(0, L"EDIT", nullptr, style,
-                                   0, 0, 100, 100, g_hwndMain, reinterpret_cast<HMENU>(IDC_EDITOR), GetModuleHandleW(nullptr), nullptr);
-    ApplyFont();
-    SetEditorText(text);
-    SendMessageW(g_hwndEditor, EM_SETSEL, start, end);
-    RECT rc;
-    GetClientRect(g_hwndMain, &rc);
-    int statusH = 0;
-    if (g_state.showStatusBar)
-    {
-        RECT rs;
-        GetWindowRect(g_hwndStatus, &rs);
-        statusH = rs.bottom - rs.top;
-    }
-    MoveWindow(g_hwndEditor, 0, 0, rc.right, rc.bottom - statusH, TRUE);
-    SetFocus(g_hwndEditor);
+    LRESULT topLine = SendMessageW(g_hwndEditor, EM_GETFIRSTVISIBLELINE, 0, 0);
+    LRESULT topChar = SendMessageW(g_hwndEditor, EM_LINEINDEX, topLine, 0);
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, FALSE, 0);
+    SendMessageW(g_hwndEditor, EM_SETTARGETDEVICE, 0, g_state.wordWrap ? 0 : 1);
+    LRESULT line = SendMessageW(g_hwndEditor, EM_EXLINEFROMCHAR, 0, topChar);
+    LRESULT first = SendMessageW(g_hwndEditor, EM_GETFIRSTVISIBLELINE, 0, 0);
+    SendMessageW(g_hwndEditor, EM_LINESCROLL, 0, line - first);
+    SendMessageW(g_hwndEditor, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(g_hwndEditor, nullptr, TRUE);
+    if (!IsViewerActive())
+        SetFocus(g_hwndEditor);
 }
 
 void DeleteWordBackward()
@@ -109,12 +194,7 @@ void DeleteWordBackward()
     }
     if (start == 0)
         return;
-    std::wstring text = GetEditorText();
-    size_t pos = start;
-    while (pos > 0 && iswspace(text[pos - 1]))
-        --pos;
-    while (pos > 0 && !iswspace(text[pos - 1]))
-        --pos;
+    size_t pos = PieceWordStart(GetDocument(), start);
     SendMessageW(g_hwndEditor, EM_SETSEL, pos, start);
     SendMessageW(g_hwndEditor, EM_REPLACESEL, TRUE, reinterpret_cast<LPARAM>(L""));
 }
@@ -128,33 +208,32 @@ void DeleteWordForward()
         SendMessageW(g_hwndEditor, EM_REPLACESEL, TRUE, reinterpret_cast<LPARAM>(L""));
         return;
     }
-    std::wstring text = GetEditorText();
-    size_t len = text.size();
-    size_t pos = start;
-    while (pos < len && !iswspace(text[pos]))
-        ++pos;
-    while (pos < len && iswspace(text[pos]))
-        ++pos;
+    size_t pos = PieceWordEnd(GetDocument(), start);
     SendMessageW(g_hwndEditor, EM_SETSEL, start, pos);
     SendMessageW(g_hwndEditor, EM_REPLACESEL, TRUE, reinterpret_cast<LPARAM>(L""));
 }
 
-LRESULT CALLBACK EditorSubclassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+static LRESULT EditorDispatch(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
     switch (msg)
     {
     case WM_ERASEBKGND:
-        if (g_state.background.enabled && g_bgImage)
+        if (HasBackgroundImage())
         {
             UpdateBackgroundBitmap(hwnd);
             if (g_bgBitmap)
             {
                 HDC hdc = reinterpret_cast<HDC>(wParam);
+                // Only the invalidated part is blitted; typing invalidates just the edited lines
                 RECT rc;
-                GetClientRect(hwnd, &rc);
+                int region = GetClipBox(hdc, &rc);
+                if (region == NULLREGION)
+                    return 1;
+                if (region == ERROR)
+                    GetClientRect(hwnd, &rc);
                 HDC hdcMem = CreateCompatibleDC(hdc);
                 HBITMAP hOldBmp = reinterpret_cast<HBITMAP>(SelectObject(hdcMem, g_bgBitmap));
-                BitBlt(hdc, 0, 0, rc.right, rc.bottom, hdcMem, 0, 0, SRCCOPY);
+                BitBlt(hdc, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, hdcMem, rc.left, rc.top, SRCCOPY);
                 SelectObject(hdcMem, hOldBmp);
                 DeleteDC(hdcMem);
                 return 1;
@@ -162,26 +241,45 @@ LRESULT CALLBACK EditorSubclassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
         }
         break;
     case WM_SIZE:
-        if (g_state.background.enabled && g_bgImage && g_bgBitmap)
+        if (HasBackgroundImage() && g_bgBitmap)
         {
             DeleteObject(g_bgBitmap);
             g_bgBitmap = nullptr;
         }
         break;
+    // Find All highlights go over what the control has just drawn, in the part it drew
+    case WM_PAINT:
+        if (IsFindAllActive())
+        {
+            HRGN updated = CreateRectRgn(0, 0, 0, 0);
+            GetUpdateRgn(hwnd, updated, FALSE);
+            LRESULT result = CallWindowProcW(g_origEditorProc, hwnd, msg, wParam, lParam);
+            PaintFindAllMatches(hwnd, updated);
+            DeleteObject(updated);
+            return result;
+        }
+        break;
     case WM_CHAR:
         if (wParam == 127)
         {
             DeleteWordBackward();
             return 0;
         }
-        if (g_state.background.enabled && g_bgImage)
-        {
-            LRESULT result = CallWindowProcW(g_origEditorProc, hwnd, msg, wParam, lParam);
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return result;
-        }
         break;
+    // The control keeps no undo of its own; the document's history answers instead
+    case WM_UNDO:
+    case EM_UNDO:
+        UndoDocument();
+        return TRUE;
+    case EM_REDO:
+        RedoDocument();
+        return TRUE;
     case WM_KEYDOWN:
+        if (wParam == VK_ESCAPE && IsLoading())
+        {
+            CancelLoad();
+            return 0;
+        }
         if (GetKeyState(VK_CONTROL) & 0x8000)
         {
             if (wParam == VK_BACK)
@@ -195,13 +293,100 @@ LRESULT CALLBACK EditorSubclassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
                 return 0;
             }
         }
-        if (g_state.background.enabled && g_bgImage && (wParam == VK_BACK || wParam == VK_DELETE))
-        {
-            LRESULT result = CallWindowProcW(g_origEditorProc, hwnd, msg, wParam, lParam);
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return result;
-        }
         break;
     }
     return CallWindowProcW(g_origEditorProc, hwnd, msg, wParam, lParam);
 }
+
+// Where a keystroke's edit sits on screen, taken before and after it so only the lines it
+// touched are repainted over the background image.
+struct EditSpan
+{
+    POINT scroll = {};
+    LONG caret = 0;
+    LONG firstLine = 0;
+    LONG lastLine = 0;
+    LONG lineCount = 0;
+};
+
+static bool NeedsLineRepaint(UINT msg, WPARAM wParam)
+{
+    if (!HasBackgroundImage())
+        return false;
+    return msg == WM_CHAR || (msg == WM_KEYDOWN && (wParam == VK_BACK || wParam == VK_DELETE));
+}
+
+static LONG EditorLineOf(HWND hwnd, LONG pos)
+{
+    return static_cast<LONG>(SendMessageW(hwnd, EM_EXLINEFROMCHAR, 0, pos));
+}
+
+static void MarkEditSpan(HWND hwnd, EditSpan &span)
+{
+    CHARRANGE cr = {};
+    SendMessageW(hwnd, EM_EXGETSEL, 0, reinterpret_cast<LPARAM>(&cr));
+    SendMessageW(hwnd, EM_GETSCROLLPOS, 0, reinterpret_cast<LPARAM>(&span.scroll));
+    span.caret = cr.cpMin;
+    span.firstLine = EditorLineOf(hwnd, cr.cpMin);
+    span.lastLine = EditorLineOf(hwnd, cr.cpMax);
+    span.lineCount = static_cast<LONG>(SendMessageW(hwnd, EM_GETLINECOUNT, 0, 0));
+}
+
+// Top of a display line, or bottom when the line does not exist.
+static LONG EditorLineTop(HWND hwnd, LONG line, LONG bottom)
+{
+    LONG index = static_cast<LONG>(SendMessageW(hwnd, EM_LINEINDEX, line, 0));
+    if (index < 0)
+        return bottom;
+    POINTL pt = {};
+    SendMessageW(hwnd, EM_POSFROMCHAR, reinterpret_cast<WPARAM>(&pt), index);
+    return pt.y;
+}
+
+// Last display line of the paragraph holding pos, which rewrapping may have changed.
+static LONG ParagraphEndLine(HWND hwnd, LONG pos)
+{
+    const PieceTable &doc = GetDocument();
+    size_t at = (std::min)(static_cast<size_t>(pos), doc.length);
+    size_t next = PieceLineStart(doc, PieceLineAt(doc, at) + 2);
+    return EditorLineOf(hwnd, static_cast<LONG>(next > at ? next - 1 : at));
+}
+
+static void InvalidateEditSpan(HWND hwnd, const EditSpan &before)
+{
+    EditSpan after;
+    MarkEditSpan(hwnd, after);
+    if (after.scroll.x != before.scroll.x || after.scroll.y != before.scroll.y)
+    {
+        InvalidateRect(hwnd, nullptr, TRUE);
+        return;
+    }
+    RECT dirty;
+    GetClientRect(hwnd, &dirty);
+    LONG bottom = dirty.bottom;
+    dirty.top = (std::max)(dirty.top, EditorLineTop(hwnd, (std::min)(before.firstLine, after.firstLine), bottom));
+    // A line added or removed moves everything below it
+    if (after.lineCount == before.lineCount)
+    {
+        LONG last = (std::max)(before.lastLine, ParagraphEndLine(hwnd, after.caret));
+        dirty.bottom = (std::min)(bottom, EditorLineTop(hwnd, last + 1, bottom));
+    }
+    if (dirty.top < dirty.bottom)
+        InvalidateRect(hwnd, &dirty, TRUE);
+}
+
+LRESULT CALLBACK EditorSubclassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    if (!IsDocumentEditMessage(msg))
+        return EditorDispatch(hwnd, msg, wParam, lParam);
+    bool repaint = NeedsLineRepaint(msg, wParam);
+    EditSpan span;
+    if (repaint)
+        MarkEditSpan(hwnd, span);
+    BeginDocumentEdit(msg, wParam);
+    LRESULT result = EditorDispatch(hwnd, msg, wParam, lParam);
+    EndDocumentEdit();
+    if (repaint)
+        InvalidateEditSpan(hwnd, span);
+    return result;
+}
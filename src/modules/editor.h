@@ -17,9 +17,12 @@
 #include <windows.h>
 #include <string>
 #include <utility>
+#include "core/piecetable.h"
 
-std::wstring GetEditorText();
 void SetEditorText(const std::wstring &text);
+void AppendEditorText(std::u16string &&text);
+void ReplaceEditorRange(size_t start, size_t end, const PieceTable &doc, size_t length);
+void ScrollEditorToEnd();
 std::pair<int, int> GetCursorPos();
 void ApplyFont();
 void ApplyZoom();
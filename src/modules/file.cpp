@@ -15,11 +15,26 @@
 #include "file.h"
 #include "core/globals.h"
 #include "editor.h"
+#include "document.h"
 #include "ui.h"
+#include "viewer.h"
+#include "follow.h"
+#include "journal.h"
 #include "resource.h"
 #include "lang/lang.h"
+#include <richedit.h>
 #include <shlwapi.h>
 #include <algorithm>
+#include <cstring>
+
+#define MAP_VIEW_SIZE (64u << 20)
+#define LOAD_CHUNK_SIZE (1u << 20)
+#define LOAD_FIRST_CHUNK_SIZE (64u << 10)
+#define LOAD_MAX_PENDING 4
+#define SAVE_CHUNK_UNITS (32u << 10)
+#define SAVE_MIN_SPAN_UNITS 256
+
+static_assert(sizeof(wchar_t) == sizeof(char16_t), "UTF-16 wchar_t required");
 
 const wchar_t *GetEncodingName(Encoding e)
 {
@@ -55,209 +70,506 @@ const wchar_t *GetLineEndingName(LineEnding le)
     return L"";
 }
 
-std::pair<Encoding, LineEnding> DetectEncoding(const std::vector<BYTE> &data)
+bool OpenMappedFile(const std::wstring &path, MappedFile &file)
 {
-    Encoding enc = Encoding::UTF8;
-    if (data.size() >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
-        enc = Encoding::UTF8BOM;
-    else if (data.size() >= 2 && data[0] == 0xFF && data[1] == 0xFE)
-        enc = Encoding::UTF16LE;
-    else if (data.size() >= 2 && data[0] == 0xFE && data[1] == 0xFF)
-        enc = Encoding::UTF16BE;
-    else
+    file.hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file.hFile == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file.hFile, &size))
     {
-        int result = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS,
-                                         reinterpret_cast<const char *>(data.data()), static_cast<int>(data.size()), nullptr, 0);
-        if (result == 0 && GetLastError() == ERROR_NO_UNICODE_TRANSLATION)
-            enc = Encoding::ANSI;
+        CloseMappedFile(file);
+        return false;
     }
-    LineEnding le = LineEnding::CRLF;
-    for (size_t i = 0; i < data.size(); ++i)
+    file.size = static_cast<ULONGLONG>(size.QuadPart);
+    if (file.size == 0)
+        return true;
+    file.hMapping = CreateFileMappingW(file.hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!file.hMapping)
     {
-        if (data[i] == '\r')
+        CloseMappedFile(file);
+        return false;
+    }
+    return true;
+}
+
+const BYTE *MapFileRange(MappedFile &file, ULONGLONG offset, size_t &length)
+{
+    if (!file.hMapping || offset >= file.size || length == 0)
+    {
+        length = 0;
+        return nullptr;
+    }
+    ULONGLONG want = (std::min)(static_cast<ULONGLONG>(length), file.size - offset);
+    if (!file.view || offset < file.viewOffset || offset + want > file.viewOffset + file.viewSize)
+    {
+        static DWORD granularity = 0;
+        if (!granularity)
         {
-            le = (i + 1 < data.size() && data[i + 1] == '\n') ? LineEnding::CRLF : LineEnding::CR;
-            break;
+            SYSTEM_INFO si;
+            GetSystemInfo(&si);
+            granularity = si.dwAllocationGranularity;
         }
-        if (data[i] == '\n')
+        if (file.view)
+            UnmapViewOfFile(file.view);
+        ULONGLONG start = offset - offset % granularity;
+        ULONGLONG span = (std::min)(static_cast<ULONGLONG>(MAP_VIEW_SIZE), file.size - start);
+        file.view = static_cast<const BYTE *>(MapViewOfFile(file.hMapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32),
+                                                            static_cast<DWORD>(start & 0xFFFFFFFF), static_cast<SIZE_T>(span)));
+        file.viewOffset = start;
+        file.viewSize = file.view ? static_cast<size_t>(span) : 0;
+        if (!file.view)
         {
-            le = LineEnding::LF;
-            break;
+            length = 0;
+            return nullptr;
         }
     }
-    return {enc, le};
+    want = (std::min)(want, file.viewOffset + file.viewSize - offset);
+    length = static_cast<size_t>(want);
+    return file.view + (offset - file.viewOffset);
 }
 
-std::wstring DecodeText(const std::vector<BYTE> &data, Encoding enc)
+void CloseMappedFile(MappedFile &file)
 {
-    size_t skip = 0;
-    UINT codepage = CP_UTF8;
-    switch (enc)
-    {
-    case Encoding::UTF8BOM:
-        skip = 3;
-        break;
-    case Encoding::UTF16LE:
-    {
-        skip = 2;
-        const wchar_t *wptr = reinterpret_cast<const wchar_t *>(data.data() + skip);
-        return std::wstring(wptr, (data.size() - skip) / 2);
-    }
-    case Encoding::UTF16BE:
+    if (file.view)
+        UnmapViewOfFile(file.view);
+    if (file.hMapping)
+        CloseHandle(file.hMapping);
+    if (file.hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(file.hFile);
+    file = MappedFile();
+}
+
+size_t DecodeAnsiChunk(const BYTE *data, size_t size, wchar_t *out, bool final, size_t &consumed)
+{
+    size_t n = size;
+    CPINFO info{};
+    if (!final && GetCPInfo(CP_ACP, &info) && info.MaxCharSize > 1)
     {
-        skip = 2;
-        std::wstring result;
-        result.reserve((data.size() - skip) / 2);
-        for (size_t i = skip; i + 1 < data.size(); i += 2)
-            result += static_cast<wchar_t>((data[i] << 8) | data[i + 1]);
-        return result;
-    }
-    case Encoding::ANSI:
-        codepage = CP_ACP;
-        break;
-    default:
-        break;
+        size_t i = 0, last = 0;
+        while (i < size)
+        {
+            last = i;
+            i += IsDBCSLeadByte(data[i]) ? 2 : 1;
+        }
+        if (i > size)
+            n = last;
     }
-    const char *ptr = reinterpret_cast<const char *>(data.data() + skip);
-    int len = static_cast<int>(data.size() - skip);
-    if (len <= 0)
-        return L"";
-    int wlen = MultiByteToWideChar(codepage, 0, ptr, len, nullptr, 0);
-    if (wlen <= 0)
-        return L"";
-    std::wstring result(wlen, 0);
-    MultiByteToWideChar(codepage, 0, ptr, len, &result[0], wlen);
+    consumed = n;
+    if (n == 0)
+        return 0;
+    int written = MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<const char *>(data), static_cast<int>(n), out, static_cast<int>(n));
+    return written > 0 ? static_cast<size_t>(written) : 0;
+}
+
+size_t DecodeAnyChunk(Encoding enc, const BYTE *data, size_t size, wchar_t *out, bool final, size_t &consumed, bool &invalid)
+{
+    if (enc == Encoding::ANSI)
+        return DecodeAnsiChunk(data, size, out, final, consumed);
+    DecodeResult r = DecodeChunk(enc, data, size, reinterpret_cast<char16_t *>(out), final);
+    consumed = r.consumed;
+    invalid = r.invalid;
+    return r.written;
+}
+
+std::wstring DecodeText(const BYTE *data, size_t size, Encoding enc)
+{
+    size_t skip = (std::min)(BomLength(enc), size);
+    std::wstring result(MaxDecodedLength(size - skip), L'\0');
+    size_t consumed = 0;
+    bool invalid = false;
+    size_t written = result.empty() ? 0 : DecodeAnyChunk(enc, data + skip, size - skip, &result[0], true, consumed, invalid);
+    result.resize(written);
     return result;
 }
 
-std::vector<BYTE> EncodeText(const std::wstring &text, Encoding enc, LineEnding le)
+// Runs the fused encoder over text in SAVE_CHUNK_UNITS slices and hands every encoded
+// block to sink, so no document-sized temporary is built. source(pos, length) returns the
+// contiguous text at pos and trims length to what it holds; it must hold at least two units
+// before the end so a trailing CR or high surrogate can always be resolved.
+template <typename Source, typename Sink>
+static bool EncodeChunks(Source source, size_t size, Encoding enc, LineEnding le, Sink sink)
 {
-    std::wstring converted;
-    converted.reserve(text.size() + text.size() / 10);
-    for (size_t i = 0; i < text.size(); ++i)
+    BYTE bom[3];
+    size_t bomLen = EncodeBom(enc, bom);
+    if (bomLen && !sink(bom, bomLen))
+        return false;
+    Encoding unitEnc = enc == Encoding::ANSI ? Encoding::UTF16LE : enc;
+    std::vector<BYTE> out(MaxEncodedLength(unitEnc, SAVE_CHUNK_UNITS));
+    std::vector<char> ansi(enc == Encoding::ANSI ? out.size() * 2 : 0);
+    size_t pos = 0;
+    while (pos < size)
     {
-        wchar_t c = text[i];
-        if (c == L'\r' || c == L'\n')
+        size_t len = (std::min)(static_cast<size_t>(SAVE_CHUNK_UNITS), size - pos);
+        const char16_t *src = source(pos, len);
+        EncodeResult r = EncodeChunk(unitEnc, le, src, len, out.data(), pos + len == size);
+        pos += r.consumed;
+        if (enc != Encoding::ANSI)
         {
-            if (c == L'\r' && i + 1 < text.size() && text[i + 1] == L'\n')
-                ++i;
-            switch (le)
-            {
-            case LineEnding::CRLF:
-                converted += L"\r\n";
-                break;
-            case LineEnding::LF:
-                converted += L'\n';
-                break;
-            case LineEnding::CR:
-                converted += L'\r';
-                break;
-            }
+            if (!sink(out.data(), r.written))
+                return false;
+            continue;
         }
-        else
-            converted += c;
+        int n = r.written ? WideCharToMultiByte(CP_ACP, 0, reinterpret_cast<const wchar_t *>(out.data()), static_cast<int>(r.written / 2),
+                                                ansi.data(), static_cast<int>(ansi.size()), nullptr, nullptr)
+                          : 0;
+        if (n > 0 && !sink(reinterpret_cast<const BYTE *>(ansi.data()), static_cast<size_t>(n)))
+            return false;
     }
+    return true;
+}
+
+std::vector<BYTE> EncodeText(const std::wstring &text, Encoding enc, LineEnding le)
+{
     std::vector<BYTE> result;
-    switch (enc)
+    if (enc != Encoding::ANSI)
+        result.reserve(3 + MaxEncodedLength(enc, text.size()));
+    auto append = [&](const BYTE *data, size_t len)
     {
-    case Encoding::UTF8BOM:
-        result.push_back(0xEF);
-        result.push_back(0xBB);
-        result.push_back(0xBF);
-        [[fallthrough]];
-    case Encoding::UTF8:
+        result.insert(result.end(), data, data + len);
+        return true;
+    };
+    auto source = [&](size_t pos, size_t &)
+    {
+        return reinterpret_cast<const char16_t *>(text.c_str()) + pos;
+    };
+    EncodeChunks(source, text.size(), enc, le, append);
+    return result;
+}
+
+// Pieces are encoded where they lie; runs of short pieces, as typing leaves behind, are
+// gathered into one slice first.
+bool WriteEncodedDocument(HANDLE hFile, const PieceTable &doc, Encoding enc, LineEnding le)
+{
+    auto write = [&](const BYTE *data, size_t len)
     {
-        int len = WideCharToMultiByte(CP_UTF8, 0, converted.c_str(), -1, nullptr, 0, nullptr, nullptr);
-        if (len > 1)
+        DWORD written = 0;
+        return len == 0 || (WriteFile(hFile, data, static_cast<DWORD>(len), &written, nullptr) && written == len);
+    };
+    std::vector<char16_t> scratch(SAVE_CHUNK_UNITS);
+    auto source = [&](size_t pos, size_t &len)
+    {
+        size_t n = 0;
+        const char16_t *span = PieceSpanAt(doc, pos, n);
+        if (n >= len || n >= SAVE_MIN_SPAN_UNITS)
         {
-            size_t offset = result.size();
-            result.resize(offset + len - 1);
-            WideCharToMultiByte(CP_UTF8, 0, converted.c_str(), -1,
-                                reinterpret_cast<char *>(result.data() + offset), len, nullptr, nullptr);
+            len = (std::min)(len, n);
+            return span;
         }
-        break;
-    }
-    case Encoding::UTF16LE:
-        result.push_back(0xFF);
-        result.push_back(0xFE);
-        result.reserve(result.size() + converted.size() * 2);
-        for (wchar_t c : converted)
+        len = CopyPieces(doc, pos, len, scratch.data());
+        return static_cast<const char16_t *>(scratch.data());
+    };
+    return EncodeChunks(source, doc.length, enc, le, write);
+}
+
+struct LoadChunk
+{
+    UINT generation = 0;
+    std::u16string text;
+    ULONGLONG bytesDone = 0;
+    Encoding encoding = Encoding::UTF8;
+    LineEnding lineEnding = LineEnding::CRLF;
+    bool reset = false;
+};
+
+struct LoadJob
+{
+    UINT generation = 0;
+    HWND hwndNotify = nullptr;
+    std::wstring path;
+    MappedFile file;
+    HANDLE hThread = nullptr;
+    HANDLE hCancel = nullptr;
+    HANDLE hSlots = nullptr;
+    Encoding encoding = Encoding::UTF8;
+    LineEnding lineEnding = LineEnding::CRLF;
+    ULONGLONG bytesDone = 0;
+};
+
+static LoadJob *g_loadJob = nullptr;
+static UINT g_loadGeneration = 0;
+
+// Blocks until the UI has room for another chunk; false once the load is cancelled.
+static bool AcquireLoadSlot(LoadJob &job)
+{
+    HANDLE handles[2] = {job.hCancel, job.hSlots};
+    return WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1;
+}
+
+static bool PostLoadChunk(LoadJob &job, LoadChunk *chunk)
+{
+    chunk->generation = job.generation;
+    if (PostMessageW(job.hwndNotify, WM_APP_LOADCHUNK, 0, reinterpret_cast<LPARAM>(chunk)))
+        return true;
+    delete chunk;
+    return false;
+}
+
+// Decodes the mapped file chunk by chunk and posts each chunk to the UI thread. The encoding
+// is picked from a bounded prefix and the first chunk is small, so the first screen shows up
+// at once whatever the file size; at most LOAD_MAX_PENDING chunks are queued so decoded text
+// does not pile up in the message queue.
+static DWORD WINAPI LoadThreadProc(LPVOID param)
+{
+    LoadJob &job = *static_cast<LoadJob *>(param);
+    MappedFile &file = job.file;
+    size_t len = DETECT_PREFIX_SIZE;
+    const BYTE *head = MapFileRange(file, 0, len);
+    auto [enc, le] = DetectPrefixEncoding(head, len, len == file.size);
+    job.lineEnding = le;
+    ULONGLONG pos = (std::min)(static_cast<ULONGLONG>(BomLength(enc)), file.size);
+    size_t chunkSize = LOAD_FIRST_CHUNK_SIZE;
+    std::u16string carry;
+    bool reset = false;
+    bool ok = true;
+    while (ok && pos < file.size)
+    {
+        if (!AcquireLoadSlot(job))
         {
-            result.push_back(static_cast<BYTE>(c & 0xFF));
-            result.push_back(static_cast<BYTE>((c >> 8) & 0xFF));
+            ok = false;
+            break;
         }
-        break;
-    case Encoding::UTF16BE:
-        result.push_back(0xFE);
-        result.push_back(0xFF);
-        result.reserve(result.size() + converted.size() * 2);
-        for (wchar_t c : converted)
+        len = chunkSize;
+        const BYTE *data = MapFileRange(file, pos, len);
+        if (!data)
         {
-            result.push_back(static_cast<BYTE>((c >> 8) & 0xFF));
-            result.push_back(static_cast<BYTE>(c & 0xFF));
+            ok = false;
+            break;
         }
-        break;
-    case Encoding::ANSI:
-    {
-        int len = WideCharToMultiByte(CP_ACP, 0, converted.c_str(), -1, nullptr, 0, nullptr, nullptr);
-        if (len > 1)
+        bool final = pos + len >= file.size;
+        LoadChunk *chunk = new LoadChunk();
+        chunk->text.swap(carry);
+        size_t base = chunk->text.size();
+        chunk->text.resize(base + MaxDecodedLength(len));
+        size_t consumed = 0;
+        bool invalid = false;
+        size_t written = DecodeAnyChunk(enc, data, len, reinterpret_cast<wchar_t *>(&chunk->text[base]), final, consumed, invalid);
+        // BOM-less UTF-8 is only a guess; start over as ANSI and have the UI drop what it has
+        if (invalid && enc == Encoding::UTF8)
         {
-            result.resize(len - 1);
-            WideCharToMultiByte(CP_ACP, 0, converted.c_str(), -1,
-                                reinterpret_cast<char *>(result.data()), len, nullptr, nullptr);
+            delete chunk;
+            ReleaseSemaphore(job.hSlots, 1, nullptr);
+            enc = Encoding::ANSI;
+            pos = 0;
+            chunkSize = LOAD_FIRST_CHUNK_SIZE;
+            reset = true;
+            continue;
+        }
+        chunk->text.resize(base + written);
+        pos += consumed;
+        // Keep CRLF pairs in one chunk so RichEdit sees a single line break
+        if (!final && !chunk->text.empty() && chunk->text.back() == u'\r')
+        {
+            chunk->text.pop_back();
+            carry = u"\r";
         }
-        break;
+        chunk->bytesDone = pos;
+        chunk->encoding = enc;
+        chunk->lineEnding = le;
+        chunk->reset = reset;
+        reset = false;
+        ok = PostLoadChunk(job, chunk);
+        chunkSize = LOAD_CHUNK_SIZE;
     }
+    job.encoding = enc;
+    PostMessageW(job.hwndNotify, WM_APP_LOADDONE, job.generation, ok ? 1 : 0);
+    return 0;
+}
+
+static void ReleaseLoadJob()
+{
+    LoadJob *job = g_loadJob;
+    g_loadJob = nullptr;
+    if (job->hThread)
+    {
+        WaitForSingleObject(job->hThread, INFINITE);
+        CloseHandle(job->hThread);
     }
-    return result;
+    CloseMappedFile(job->file);
+    if (job->hCancel)
+        CloseHandle(job->hCancel);
+    if (job->hSlots)
+        CloseHandle(job->hSlots);
+    delete job;
+    SendMessageW(g_hwndEditor, EM_SETREADONLY, FALSE, 0);
+}
+
+static void ResetDocument()
+{
+    SetEditorText(L"");
+    g_state.filePath.clear();
+    g_state.modified = false;
+    g_state.encoding = Encoding::UTF8;
+    g_state.lineEnding = LineEnding::CRLF;
+    ResetJournal();
+    UpdateTitle();
+    UpdateStatus();
+}
+
+static void StopLoad()
+{
+    if (!g_loadJob)
+        return;
+    SetEvent(g_loadJob->hCancel);
+    ReleaseLoadJob();
+}
+
+bool IsLoading()
+{
+    return g_loadJob != nullptr;
+}
+
+int GetLoadProgress()
+{
+    if (!g_loadJob || g_loadJob->file.size == 0)
+        return 0;
+    return static_cast<int>(g_loadJob->bytesDone * 100 / g_loadJob->file.size);
+}
+
+// A partially loaded document must never be saved over the file, so cancelling starts a new one.
+void CancelLoad()
+{
+    if (!g_loadJob)
+        return;
+    StopLoad();
+    ResetDocument();
 }
 
 void LoadFile(const std::wstring &path)
 {
-    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
-                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (hFile == INVALID_HANDLE_VALUE)
+    StopFollow();
+    StopLoad();
+    LoadJob *job = new LoadJob();
+    if (!OpenMappedFile(path, job->file))
     {
+        delete job;
         const auto &lang = GetLangStrings();
         MessageBoxW(g_hwndMain, lang.msgCannotOpenFile.c_str(), lang.msgError.c_str(), MB_ICONERROR);
         return;
     }
-    DWORD size = GetFileSize(hFile, nullptr);
-    std::vector<BYTE> data(size);
-    DWORD read = 0;
-    ReadFile(hFile, data.data(), size, &read, nullptr);
-    CloseHandle(hFile);
-    auto [enc, le] = DetectEncoding(data);
-    std::wstring text = DecodeText(data, enc);
-    SetEditorText(text);
+    ResetJournal();
+    if (job->file.size >= g_state.viewerThreshold)
+    {
+        CloseMappedFile(job->file);
+        delete job;
+        if (g_state.followMode)
+        {
+            g_state.followMode = false;
+            CheckMenuItem(GetMenu(g_hwndMain), IDM_VIEW_FOLLOW, MF_UNCHECKED);
+            const auto &lang = GetLangStrings();
+            MessageBoxW(g_hwndMain, lang.msgViewerNoFollow.c_str(), lang.appName.c_str(), MB_ICONINFORMATION);
+        }
+        OpenViewer(path);
+        return;
+    }
+    CloseViewer();
+    job->generation = ++g_loadGeneration;
+    job->hwndNotify = g_hwndMain;
+    job->path = path;
+    job->hCancel = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    job->hSlots = CreateSemaphoreW(nullptr, LOAD_MAX_PENDING, LOAD_MAX_PENDING, nullptr);
+    g_loadJob = job;
+    SetEditorText(L"");
+    SendMessageW(g_hwndEditor, EM_SETREADONLY, TRUE, 0);
     g_state.filePath = path;
+    g_state.modified = false;
+    UpdateTitle();
+    UpdateStatus();
+    if (job->hCancel && job->hSlots)
+        job->hThread = CreateThread(nullptr, 0, LoadThreadProc, job, 0, nullptr);
+    if (!job->hThread)
+    {
+        ReleaseLoadJob();
+        ResetDocument();
+        const auto &lang = GetLangStrings();
+        MessageBoxW(g_hwndMain, lang.msgCannotOpenFile.c_str(), lang.msgError.c_str(), MB_ICONERROR);
+    }
+}
+
+void OnLoadChunk(LPARAM lParam)
+{
+    LoadChunk *chunk = reinterpret_cast<LoadChunk *>(lParam);
+    if (g_loadJob && chunk->generation == g_loadJob->generation)
+    {
+        if (chunk->reset)
+            SetEditorText(L"");
+        AppendEditorText(std::move(chunk->text));
+        g_loadJob->bytesDone = chunk->bytesDone;
+        g_state.encoding = chunk->encoding;
+        g_state.lineEnding = chunk->lineEnding;
+        ReleaseSemaphore(g_loadJob->hSlots, 1, nullptr);
+        UpdateStatus();
+    }
+    delete chunk;
+}
+
+void OnLoadFinished(WPARAM wParam, LPARAM lParam)
+{
+    if (!g_loadJob || static_cast<UINT>(wParam) != g_loadJob->generation)
+        return;
+    WaitForSingleObject(g_loadJob->hThread, INFINITE);
+    Encoding enc = g_loadJob->encoding;
+    LineEnding le = g_loadJob->lineEnding;
+    ULONGLONG size = g_loadJob->file.size;
+    std::wstring path = g_loadJob->path;
+    ReleaseLoadJob();
+    if (!lParam)
+    {
+        ResetDocument();
+        const auto &lang = GetLangStrings();
+        MessageBoxW(g_hwndMain, lang.msgCannotOpenFile.c_str(), lang.msgError.c_str(), MB_ICONERROR);
+        return;
+    }
+    SendMessageW(g_hwndEditor, EM_EMPTYUNDOBUFFER, 0, 0);
     g_state.encoding = enc;
     g_state.lineEnding = le;
     g_state.modified = false;
+    ResetJournal();
     UpdateTitle();
     UpdateStatus();
     AddRecentFile(path);
+    if (g_state.followMode)
+        StartFollow(path, size, enc);
 }
 
-void SaveToPath(const std::wstring &path)
+bool SaveToPath(const std::wstring &path)
 {
-    std::wstring text = GetEditorText();
-    std::vector<BYTE> data = EncodeText(text, g_state.encoding, g_state.lineEnding);
+    if (IsViewerActive())
+    {
+        const auto &lang = GetLangStrings();
+        MessageBoxW(g_hwndMain, lang.msgViewerReadOnly.c_str(), lang.appName.c_str(), MB_ICONINFORMATION);
+        return false;
+    }
+    // Saving a partly loaded document would cut the file short
+    if (IsLoading())
+    {
+        const auto &lang = GetLangStrings();
+        MessageBoxW(g_hwndMain, lang.msgSaveWhileLoading.c_str(), lang.appName.c_str(), MB_ICONINFORMATION);
+        return false;
+    }
+    StopFollow();
     HANDLE hFile = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr,
-                               CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (hFile == INVALID_HANDLE_VALUE)
+                               CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size{};
+    bool ok = hFile != INVALID_HANDLE_VALUE && WriteEncodedDocument(hFile, GetDocument(), g_state.encoding, g_state.lineEnding) &&
+              GetFileSizeEx(hFile, &size);
+    if (hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(hFile);
+    if (!ok)
     {
         const auto &lang = GetLangStrings();
         MessageBoxW(g_hwndMain, lang.msgCannotSaveFile.c_str(), lang.msgError.c_str(), MB_ICONERROR);
-        return;
+        return false;
     }
-    DWORD written = 0;
-    WriteFile(hFile, data.data(), static_cast<DWORD>(data.size()), &written, nullptr);
-    CloseHandle(hFile);
     g_state.filePath = path;
     g_state.modified = false;
+    ResetJournal();
     UpdateTitle();
     AddRecentFile(path);
+    if (g_state.followMode)
+        StartFollow(path, static_cast<ULONGLONG>(size.QuadPart), g_state.encoding);
+    return true;
 }
 
 void AddRecentFile(const std::wstring &path)
@@ -19,13 +19,35 @@
 #include <vector>
 #include <utility>
 #include "core/types.h"
+#include "core/piecetable.h"
+
+struct MappedFile
+{
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapping = nullptr;
+    ULONGLONG size = 0;
+    const BYTE *view = nullptr;
+    ULONGLONG viewOffset = 0;
+    size_t viewSize = 0;
+};
 
 const wchar_t *GetEncodingName(Encoding e);
 const wchar_t *GetLineEndingName(LineEnding le);
-std::pair<Encoding, LineEnding> DetectEncoding(const std::vector<BYTE> &data);
-std::wstring DecodeText(const std::vector<BYTE> &data, Encoding enc);
+bool OpenMappedFile(const std::wstring &path, MappedFile &file);
+const BYTE *MapFileRange(MappedFile &file, ULONGLONG offset, size_t &length);
+void CloseMappedFile(MappedFile &file);
+size_t DecodeAnsiChunk(const BYTE *data, size_t size, wchar_t *out, bool final, size_t &consumed);
+size_t DecodeAnyChunk(Encoding enc, const BYTE *data, size_t size, wchar_t *out, bool final, size_t &consumed, bool &invalid);
+std::wstring DecodeText(const BYTE *data, size_t size, Encoding enc);
 std::vector<BYTE> EncodeText(const std::wstring &text, Encoding enc, LineEnding le);
+bool WriteEncodedDocument(HANDLE hFile, const PieceTable &doc, Encoding enc, LineEnding le);
 void LoadFile(const std::wstring &path);
-void SaveToPath(const std::wstring &path);
+void CancelLoad();
+bool IsLoading();
+int GetLoadProgress();
+void OnLoadChunk(LPARAM lParam);
+void OnLoadFinished(WPARAM wParam, LPARAM lParam);
+// Returns whether the document was written.
+bool SaveToPath(const std::wstring &path);
 void AddRecentFile(const std::wstring &path);
 void UpdateRecentFilesMenu();
@@ -0,0 +1,691 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Find All. A worker thread searches a copy of the document and posts the matches back in
+  batches; the UI thread keeps them in a MatchSet that edits update in place, shows them in a
+  virtual list and highlights the ones on screen after the editor has painted.
+*/
+
+#include "findall.h"
+#include "core/types.h"
+#include "core/globals.h"
+#include "core/matchset.h"
+#include "document.h"
+#include "file.h"
+#include "theme.h"
+#include "ui.h"
+#include "viewer.h"
+#include "lang/lang.h"
+#include <richedit.h>
+#include <commctrl.h>
+#include <uxtheme.h>
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#define FINDALL_CLASS L"NotepadFindAllClass"
+// Units the worker searches between looks at its cancel event, posting what it found each time
+#define FINDALL_SLICE_UNITS (4u << 20)
+// Edits longer than this, and every edit while the worker runs, have the document searched again
+#define FINDALL_EDIT_MAX_UNITS (1u << 20)
+// Quiet time after such an edit before the search starts again
+#define FINDALL_RESTART_MS 300
+// Highlights drawn per paint; a screen cannot show more than this apart
+#define FINDALL_PAINT_MAX 8192
+// Units of the line shown before a match in the results list
+#define FINDALL_CONTEXT_UNITS 40
+#define FINDALL_HIGHLIGHT RGB(255, 200, 0)
+#define FINDALL_HIGHLIGHT_ALPHA 96
+
+struct FindAllBatch
+{
+    UINT generation = 0;
+    std::vector<TextSpan> matches;
+    bool complete = false;
+};
+
+// The worker reads only its own copies of the text and the pattern.
+struct FindAllScan
+{
+    UINT generation = 0;
+    std::u16string text;
+    std::u16string pattern;
+    bool regex = false;
+    Regex compiled;
+    HANDLE hCancel = nullptr;
+};
+
+struct FindAllState
+{
+    bool active = false;
+    // Every match of the document is in the set; until then the worker is still adding them
+    bool complete = false;
+    UINT generation = 0;
+    std::wstring pattern;
+    bool regex = false;
+    NoCasePattern literal;
+    Regex compiled;
+    MatchSet matches;
+    FindAllScan *scan = nullptr;
+    HANDLE hThread = nullptr;
+    HWND hwnd = nullptr;
+    HWND hwndList = nullptr;
+    HBITMAP highlight = nullptr;
+    // Display lines at the last paint; when an edit changes them the lines below have moved
+    LONG displayLines = 0;
+};
+
+static FindAllState g_findAll;
+
+static bool FindInSnapshot(FindAllScan &scan, const NoCasePattern &literal, size_t from, size_t lastStart, TextSpan &match)
+{
+    const char16_t *text = scan.text.data();
+    size_t size = scan.text.size();
+    if (scan.regex)
+    {
+        RegexMatch found;
+        if (!FindRegex(scan.compiled, text, size, from, lastStart, found))
+            return false;
+        match.start = found.start;
+        match.length = found.end - found.start;
+        return true;
+    }
+    // The text is cut short so that no match starts after lastStart
+    size_t end = lastStart >= size ? size : (std::min)(size, lastStart + literal.length);
+    size_t pos = FindPrepared(literal, text, end, from);
+    if (pos == TEXT_NPOS)
+        return false;
+    match.start = pos;
+    match.length = literal.length;
+    return true;
+}
+
+// Follows the match chain through the copy a slice at a time and posts each slice's matches,
+// so the UI thread owns the set and never shares it with this thread.
+static DWORD WINAPI FindAllThreadProc(LPVOID param)
+{
+    FindAllScan &scan = *static_cast<FindAllScan *>(param);
+    NoCasePattern literal;
+    if (!scan.regex)
+        PrepareNoCase(literal, scan.pattern.data(), scan.pattern.size());
+    size_t size = scan.text.size();
+    size_t from = 0;
+    bool complete = false;
+    while (!complete && WaitForSingleObject(scan.hCancel, 0) == WAIT_TIMEOUT)
+    {
+        size_t sliceEnd = from + FINDALL_SLICE_UNITS;
+        complete = sliceEnd >= size;
+        // Only the last slice takes a match at the very end, which can only be an empty one
+        size_t lastStart = complete ? size : sliceEnd - 1;
+        FindAllBatch *batch = new FindAllBatch();
+        batch->generation = scan.generation;
+        batch->complete = complete;
+        TextSpan match;
+        while (from <= lastStart && FindInSnapshot(scan, literal, from, lastStart, match))
+        {
+            batch->matches.push_back(match);
+            from = NextMatchFrom(match);
+        }
+        from = (std::max)(from, sliceEnd);
+        if (!PostMessageW(g_hwndMain, WM_APP_FINDALL, 0, reinterpret_cast<LPARAM>(batch)))
+        {
+            delete batch;
+            break;
+        }
+    }
+    return 0;
+}
+
+static bool FindInDocument(size_t from, TextSpan &match)
+{
+    const PieceTable &doc = GetDocument();
+    if (from > doc.length)
+        return false;
+    if (g_findAll.regex)
+    {
+        RegexMatch found;
+        if (!FindPiecesRegex(g_findAll.compiled, doc, from, TEXT_NPOS, found))
+            return false;
+        match.start = found.start;
+        match.length = found.end - found.start;
+        return true;
+    }
+    size_t pos = FindPiecesPrepared(doc, g_findAll.literal, from);
+    if (pos == TEXT_NPOS)
+        return false;
+    match.start = pos;
+    match.length = g_findAll.literal.length;
+    return true;
+}
+
+static void StopScan()
+{
+    if (!g_findAll.hThread)
+        return;
+    SetEvent(g_findAll.scan->hCancel);
+    WaitForSingleObject(g_findAll.hThread, INFINITE);
+    CloseHandle(g_findAll.hThread);
+    CloseHandle(g_findAll.scan->hCancel);
+    delete g_findAll.scan;
+    g_findAll.hThread = nullptr;
+    g_findAll.scan = nullptr;
+}
+
+static POINTL EditorCharPos(HWND hwnd, size_t pos)
+{
+    POINTL pt = {};
+    SendMessageW(hwnd, EM_POSFROMCHAR, reinterpret_cast<WPARAM>(&pt), static_cast<LPARAM>(pos));
+    return pt;
+}
+
+static LONG EditorLineOf(HWND hwnd, size_t pos)
+{
+    return static_cast<LONG>(SendMessageW(hwnd, EM_EXLINEFROMCHAR, 0, static_cast<LPARAM>(pos)));
+}
+
+// Start of the display line after line, or TEXT_NPOS for the last one.
+static size_t NextLineStart(HWND hwnd, LONG line)
+{
+    LONG next = static_cast<LONG>(SendMessageW(hwnd, EM_LINEINDEX, line + 1, 0));
+    return next < 0 ? TEXT_NPOS : static_cast<size_t>(next);
+}
+
+// From the start of the first visible line to the start of the line after the last.
+static void VisibleRange(HWND hwnd, size_t &first, size_t &last)
+{
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    LONG top = static_cast<LONG>(SendMessageW(hwnd, EM_GETFIRSTVISIBLELINE, 0, 0));
+    first = static_cast<size_t>(SendMessageW(hwnd, EM_LINEINDEX, top, 0));
+    POINTL pt = {0, rc.bottom - 1};
+    size_t bottom = static_cast<size_t>(SendMessageW(hwnd, EM_CHARFROMPOS, 0, reinterpret_cast<LPARAM>(&pt)));
+    last = (std::min)(NextLineStart(hwnd, EditorLineOf(hwnd, bottom)), GetDocumentLength());
+}
+
+// Repaints the visible lines holding [start, end], or everything from start down when the
+// lines below have moved.
+static void InvalidateDocumentSpan(size_t start, size_t end, bool toBottom)
+{
+    HWND hwnd = g_hwndEditor;
+    size_t first, last;
+    VisibleRange(hwnd, first, last);
+    if (start > last || (end < first && !toBottom))
+        return;
+    RECT dirty;
+    GetClientRect(hwnd, &dirty);
+    LONG bottom = dirty.bottom;
+    dirty.top = (std::max)(dirty.top, EditorCharPos(hwnd, (std::max)(start, first)).y);
+    if (!toBottom)
+    {
+        size_t next = NextLineStart(hwnd, EditorLineOf(hwnd, (std::min)(end, last)));
+        if (next != TEXT_NPOS)
+            dirty.bottom = (std::min)(bottom, EditorCharPos(hwnd, next).y);
+    }
+    if (dirty.top < dirty.bottom)
+        InvalidateRect(hwnd, &dirty, TRUE);
+}
+
+// Brings the list and the status bar up to the set. moved says matches already listed may
+// have changed, not just new ones come in at the end.
+static void UpdateResults(bool moved)
+{
+    if (g_findAll.hwndList)
+    {
+        int count = static_cast<int>((std::min)(g_findAll.matches.count, static_cast<size_t>(INT_MAX)));
+        ListView_SetItemCountEx(g_findAll.hwndList, count, LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+        if (moved)
+            InvalidateRect(g_findAll.hwndList, nullptr, FALSE);
+    }
+    ScheduleStatus(STATUS_MATCHES);
+}
+
+// Drops the matches and has the search start again once edits pause.
+static void ScheduleRescan()
+{
+    StopScan();
+    ++g_findAll.generation;
+    bool shown = g_findAll.matches.count > 0;
+    ClearMatches(g_findAll.matches);
+    g_findAll.complete = false;
+    UpdateResults(true);
+    if (shown)
+        InvalidateRect(g_hwndEditor, nullptr, TRUE);
+    SetTimer(g_hwndMain, IDT_FINDALL, FINDALL_RESTART_MS, nullptr);
+}
+
+// Copies the document for the worker; without a thread the search runs here instead.
+static void StartScan()
+{
+    StopScan();
+    KillTimer(g_hwndMain, IDT_FINDALL);
+    ++g_findAll.generation;
+    ClearMatches(g_findAll.matches);
+    g_findAll.complete = false;
+    const PieceTable &doc = GetDocument();
+    FindAllScan *scan = new FindAllScan();
+    scan->generation = g_findAll.generation;
+    scan->text.resize(doc.length);
+    CopyPieces(doc, 0, doc.length, &scan->text[0]);
+    scan->pattern.assign(reinterpret_cast<const char16_t *>(g_findAll.pattern.c_str()), g_findAll.pattern.size());
+    scan->regex = g_findAll.regex;
+    if (scan->regex)
+        scan->compiled = g_findAll.compiled;
+    scan->hCancel = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (scan->hCancel)
+        g_findAll.hThread = CreateThread(nullptr, 0, FindAllThreadProc, scan, 0, nullptr);
+    if (g_findAll.hThread)
+    {
+        g_findAll.scan = scan;
+        UpdateResults(true);
+        return;
+    }
+    if (scan->hCancel)
+        CloseHandle(scan->hCancel);
+    delete scan;
+    std::vector<TextSpan> matches;
+    TextSpan match;
+    for (size_t from = 0; FindInDocument(from, match); from = NextMatchFrom(match))
+        matches.push_back(match);
+    AppendMatches(g_findAll.matches, matches.data(), matches.size());
+    g_findAll.complete = true;
+    UpdateResults(true);
+    InvalidateRect(g_hwndEditor, nullptr, TRUE);
+}
+
+static void FillResultItem(LVITEMW &item)
+{
+    const MatchSet &set = g_findAll.matches;
+    if (!(item.mask & LVIF_TEXT) || item.iItem < 0 || static_cast<size_t>(item.iItem) >= set.count || item.cchTextMax <= 1)
+        return;
+    const PieceTable &doc = GetDocument();
+    size_t start = (std::min)(MatchAt(set, static_cast<size_t>(item.iItem)).start, doc.length);
+    size_t line = PieceLineAt(doc, start);
+    if (item.iSubItem == 0)
+    {
+        wchar_t number[32];
+        wsprintfW(number, L"%I64u", static_cast<ULONGLONG>(line + 1));
+        wcsncpy_s(item.pszText, static_cast<size_t>(item.cchTextMax), number, _TRUNCATE);
+        return;
+    }
+    // A long line is shown from a little before the match
+    size_t lineStart = PieceLineStart(doc, line + 1);
+    size_t from = start - lineStart > FINDALL_CONTEXT_UNITS ? start - FINDALL_CONTEXT_UNITS : lineStart;
+    size_t count = (std::min)(doc.length - from, static_cast<size_t>(item.cchTextMax - 1));
+    CopyPieces(doc, from, count, reinterpret_cast<char16_t *>(item.pszText));
+    size_t n = 0;
+    for (; n < count && item.pszText[n] != L'\r'; ++n)
+    {
+        if (item.pszText[n] == L'\t')
+            item.pszText[n] = L' ';
+    }
+    item.pszText[n] = L'\0';
+}
+
+static void GoToResult(int item)
+{
+    if (item < 0 || static_cast<size_t>(item) >= g_findAll.matches.count)
+        return;
+    TextSpan match = MatchAt(g_findAll.matches, static_cast<size_t>(item));
+    SendMessageW(g_hwndEditor, EM_SETSEL, match.start, match.start + match.length);
+    SendMessageW(g_hwndEditor, EM_SCROLLCARET, 0, 0);
+}
+
+static LRESULT CALLBACK FindAllProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    switch (msg)
+    {
+    case WM_CREATE:
+    {
+        const auto &lang = GetLangStrings();
+        HWND list = CreateWindowExW(0, WC_LISTVIEWW, nullptr, WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_OWNERDATA | LVS_SINGLESEL | LVS_SHOWSELALWAYS,
+                                    0, 0, 0, 0, hwnd, nullptr, GetModuleHandleW(nullptr), nullptr);
+        SendMessageW(list, WM_SETFONT, reinterpret_cast<WPARAM>(GetStockObject(DEFAULT_GUI_FONT)), FALSE);
+        ListView_SetExtendedListViewStyle(list, LVS_EX_FULLROWSELECT | LVS_EX_DOUBLEBUFFER);
+        LVCOLUMNW column{};
+        column.mask = LVCF_TEXT | LVCF_WIDTH;
+        column.cx = 70;
+        column.pszText = const_cast<LPWSTR>(lang.dialogResultLine.c_str());
+        ListView_InsertColumn(list, 0, &column);
+        column.cx = 430;
+        column.pszText = const_cast<LPWSTR>(lang.dialogResultText.c_str());
+        ListView_InsertColumn(list, 1, &column);
+        if (IsDarkMode())
+        {
+            SetTitleBarDark(hwnd, TRUE);
+            SetWindowTheme(list, L"DarkMode_Explorer", nullptr);
+            ListView_SetBkColor(list, RGB(32, 32, 32));
+            ListView_SetTextBkColor(list, RGB(32, 32, 32));
+            ListView_SetTextColor(list, RGB(255, 255, 255));
+        }
+        g_findAll.hwnd = hwnd;
+        g_findAll.hwndList = list;
+        return 0;
+    }
+    case WM_SIZE:
+        if (g_findAll.hwndList)
+            MoveWindow(g_findAll.hwndList, 0, 0, LOWORD(lParam), HIWORD(lParam), TRUE);
+        return 0;
+    case WM_SETFOCUS:
+        if (g_findAll.hwndList)
+            SetFocus(g_findAll.hwndList);
+        return 0;
+    case WM_NOTIFY:
+    {
+        NMHDR *pnmh = reinterpret_cast<NMHDR *>(lParam);
+        if (pnmh->hwndFrom != g_findAll.hwndList)
+            break;
+        if (pnmh->code == LVN_GETDISPINFOW)
+        {
+            FillResultItem(reinterpret_cast<NMLVDISPINFOW *>(lParam)->item);
+            return 0;
+        }
+        if (pnmh->code == LVN_ITEMACTIVATE)
+        {
+            GoToResult(reinterpret_cast<NMITEMACTIVATE *>(lParam)->iItem);
+            return 0;
+        }
+        // Not closed from inside the list's own notification
+        if (pnmh->code == LVN_KEYDOWN && reinterpret_cast<NMLVKEYDOWN *>(lParam)->wVKey == VK_ESCAPE)
+        {
+            PostMessageW(hwnd, WM_CLOSE, 0, 0);
+            return 0;
+        }
+        break;
+    }
+    case WM_CLOSE:
+        CloseFindAll();
+        return 0;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+static void OpenResultsWindow()
+{
+    std::wstring title = GetLangStrings().dialogFindResults + L" - \"" + g_findAll.pattern + L"\"";
+    if (g_findAll.hwnd)
+    {
+        SetWindowTextW(g_findAll.hwnd, title.c_str());
+        return;
+    }
+    static bool registered = false;
+    if (!registered)
+    {
+        WNDCLASSEXW wc{};
+        wc.cbSize = sizeof(wc);
+        wc.lpfnWndProc = FindAllProc;
+        wc.hInstance = GetModuleHandleW(nullptr);
+        wc.hCursor = LoadCursorW(nullptr, IDC_ARROW);
+        wc.lpszClassName = FINDALL_CLASS;
+        registered = RegisterClassExW(&wc) != 0;
+    }
+    RECT rc;
+    GetWindowRect(g_hwndMain, &rc);
+    CreateWindowExW(WS_EX_TOOLWINDOW, FINDALL_CLASS, title.c_str(), WS_POPUP | WS_CAPTION | WS_SYSMENU | WS_THICKFRAME | WS_VISIBLE,
+                    rc.left + 40, (std::max)(rc.top, rc.bottom - 320), 540, 280, g_hwndMain, nullptr, GetModuleHandleW(nullptr), nullptr);
+}
+
+void FindAll(const std::wstring &pattern, const Regex *regex)
+{
+    if (pattern.empty() || IsViewerActive() || IsLoading())
+        return;
+    bool wasActive = g_findAll.active;
+    g_findAll.pattern = pattern;
+    g_findAll.regex = regex != nullptr;
+    if (regex)
+        g_findAll.compiled = *regex;
+    else
+        PrepareNoCase(g_findAll.literal, reinterpret_cast<const char16_t *>(pattern.c_str()), pattern.size());
+    g_findAll.active = true;
+    OpenResultsWindow();
+    if (!wasActive)
+        SetupStatusBarParts();
+    bool shown = g_findAll.matches.count > 0;
+    StartScan();
+    if (shown)
+        InvalidateRect(g_hwndEditor, nullptr, TRUE);
+}
+
+void CloseFindAll()
+{
+    if (!g_findAll.active)
+        return;
+    g_findAll.active = false;
+    StopScan();
+    KillTimer(g_hwndMain, IDT_FINDALL);
+    ++g_findAll.generation;
+    bool shown = g_findAll.matches.count > 0;
+    ClearMatches(g_findAll.matches);
+    g_findAll.complete = false;
+    if (g_findAll.hwnd)
+    {
+        HWND hwnd = g_findAll.hwnd;
+        g_findAll.hwnd = nullptr;
+        g_findAll.hwndList = nullptr;
+        DestroyWindow(hwnd);
+    }
+    if (g_findAll.highlight)
+    {
+        DeleteObject(g_findAll.highlight);
+        g_findAll.highlight = nullptr;
+    }
+    SetupStatusBarParts();
+    ScheduleStatus(STATUS_MATCHES);
+    if (shown)
+        InvalidateRect(g_hwndEditor, nullptr, TRUE);
+}
+
+bool IsFindAllActive()
+{
+    return g_findAll.active;
+}
+
+bool IsFindAllScanning()
+{
+    return g_findAll.active && !g_findAll.complete;
+}
+
+size_t GetFindAllCount()
+{
+    return g_findAll.matches.count;
+}
+
+// Forward takes the first match at or after the selection end, past an empty match at an
+// empty selection; backward the last match starting before the selection. Both wrap.
+bool FindAllNext(const std::wstring &pattern, bool regex, size_t selStart, size_t selEnd, bool forward, size_t &start, size_t &length)
+{
+    const MatchSet &set = g_findAll.matches;
+    if (!g_findAll.complete || !set.count || g_findAll.regex != regex || g_findAll.pattern != pattern)
+        return false;
+    size_t index;
+    if (forward)
+    {
+        index = MatchIndexAt(set, selEnd);
+        if (index < set.count && selStart == selEnd)
+        {
+            TextSpan match = MatchAt(set, index);
+            if (match.start == selStart && match.length == 0)
+                ++index;
+        }
+        if (index == set.count)
+            index = 0;
+    }
+    else
+    {
+        index = MatchIndexAt(set, selStart);
+        index = index ? index - 1 : set.count - 1;
+    }
+    TextSpan match = MatchAt(set, index);
+    start = match.start;
+    length = match.length;
+    return true;
+}
+
+// A literal match can only have changed if it reaches the edit, and a regex match that
+// cannot cross a line break only if it is on the edit's line. Any other regex is searched
+// again from the start.
+void NoteFindAllEdit(size_t offset, size_t removed, size_t inserted)
+{
+    if (!g_findAll.active)
+        return;
+    size_t settled = MatchSettledOffset(GetDocument(), offset, g_findAll.literal.length, g_findAll.regex ? &g_findAll.compiled : nullptr);
+    if (!g_findAll.complete || removed + inserted > FINDALL_EDIT_MAX_UNITS || settled == TEXT_NPOS)
+    {
+        ScheduleRescan();
+        return;
+    }
+    TextSpan changed = EditMatches(g_findAll.matches, offset, removed, inserted, settled, FindInDocument);
+    // The control painted the edit before the set caught up with it
+    size_t start = offset, end = offset + inserted;
+    if (changed.start != TEXT_NPOS)
+    {
+        start = (std::min)(start, changed.start);
+        end = (std::max)(end, changed.start + changed.length);
+    }
+    LONG lines = static_cast<LONG>(SendMessageW(g_hwndEditor, EM_GETLINECOUNT, 0, 0));
+    bool moved = lines != g_findAll.displayLines;
+    g_findAll.displayLines = lines;
+    if (g_findAll.matches.count || changed.start != TEXT_NPOS)
+        InvalidateDocumentSpan(start, end, moved);
+    UpdateResults(true);
+}
+
+// The document was replaced or changed without saying where.
+void ResetFindAll()
+{
+    if (g_findAll.active)
+        ScheduleRescan();
+}
+
+void OnFindAllBatch(LPARAM lParam)
+{
+    FindAllBatch *batch = reinterpret_cast<FindAllBatch *>(lParam);
+    if (g_findAll.active && batch->generation == g_findAll.generation)
+    {
+        AppendMatches(g_findAll.matches, batch->matches.data(), batch->matches.size());
+        if (batch->complete)
+        {
+            g_findAll.complete = true;
+            StopScan();
+        }
+        UpdateResults(false);
+        if (!batch->matches.empty())
+        {
+            const TextSpan &back = batch->matches.back();
+            InvalidateDocumentSpan(batch->matches.front().start, back.start + back.length, false);
+        }
+    }
+    delete batch;
+}
+
+// Runs on until a load in progress is done.
+void OnFindAllTimer()
+{
+    if (IsLoading())
+        return;
+    KillTimer(g_hwndMain, IDT_FINDALL);
+    if (!g_findAll.active)
+        return;
+    if (IsViewerActive())
+    {
+        CloseFindAll();
+        return;
+    }
+    StartScan();
+}
+
+// One pixel of the highlight colour, stretched over each match at a constant alpha.
+static HBITMAP HighlightBitmap(HDC hdc)
+{
+    if (!g_findAll.highlight)
+    {
+        g_findAll.highlight = CreateCompatibleBitmap(hdc, 1, 1);
+        HDC hdcMem = CreateCompatibleDC(hdc);
+        HGDIOBJ old = SelectObject(hdcMem, g_findAll.highlight);
+        SetPixel(hdcMem, 0, 0, FINDALL_HIGHLIGHT);
+        SelectObject(hdcMem, old);
+        DeleteDC(hdcMem);
+    }
+    return g_findAll.highlight;
+}
+
+// The editor uses one font, so the distance between the first two lines holds for all.
+static LONG EditorLineHeight(HWND hwnd)
+{
+    LONG second = static_cast<LONG>(SendMessageW(hwnd, EM_LINEINDEX, 1, 0));
+    if (second > 0)
+    {
+        LONG height = EditorCharPos(hwnd, static_cast<size_t>(second)).y - EditorCharPos(hwnd, 0).y;
+        if (height > 0)
+            return height;
+    }
+    HDC hdc = GetDC(hwnd);
+    HGDIOBJ old = SelectObject(hdc, g_state.hFont ? static_cast<HGDIOBJ>(g_state.hFont) : GetStockObject(DEFAULT_GUI_FONT));
+    TEXTMETRICW tm{};
+    GetTextMetricsW(hdc, &tm);
+    SelectObject(hdc, old);
+    ReleaseDC(hwnd, hdc);
+    return MulDiv(tm.tmHeight, g_state.zoomLevel, 100);
+}
+
+// One band per display line of the match from first on. A band that runs to the end of its
+// line goes half a line height past its last unit, an empty match gets a caret-wide one.
+static void HighlightMatch(HWND hwnd, HDC hdc, HDC hdcFill, const TextSpan &match, size_t first, LONG lineHeight, LONG bottom)
+{
+    BLENDFUNCTION blend = {AC_SRC_OVER, 0, FINDALL_HIGHLIGHT_ALPHA, 0};
+    size_t end = match.start + match.length;
+    size_t start = (std::min)((std::max)(match.start, first), end);
+    do
+    {
+        size_t lineEnd = NextLineStart(hwnd, EditorLineOf(hwnd, start));
+        size_t segmentEnd = (std::min)(end, lineEnd);
+        POINTL from = EditorCharPos(hwnd, start);
+        if (from.y >= bottom)
+            return;
+        LONG right = from.x + 2;
+        if (segmentEnd < lineEnd && segmentEnd > start)
+            right = EditorCharPos(hwnd, segmentEnd).x;
+        else if (segmentEnd > start)
+            right = EditorCharPos(hwnd, segmentEnd - 1).x + lineHeight / 2;
+        if (right > from.x)
+            AlphaBlend(hdc, from.x, from.y, right - from.x, lineHeight, hdcFill, 0, 0, 1, 1, blend);
+        start = segmentEnd;
+    } while (start < end);
+}
+
+void PaintFindAllMatches(HWND hwnd, HRGN updated)
+{
+    const MatchSet &set = g_findAll.matches;
+    g_findAll.displayLines = static_cast<LONG>(SendMessageW(hwnd, EM_GETLINECOUNT, 0, 0));
+    if (!g_findAll.active || !set.count)
+        return;
+    size_t first, last;
+    VisibleRange(hwnd, first, last);
+    size_t index = MatchIndexEndingAfter(set, first ? first - 1 : 0);
+    if (index == set.count || MatchAt(set, index).start > last)
+        return;
+    RECT client;
+    GetClientRect(hwnd, &client);
+    HDC hdc = GetDC(hwnd);
+    SelectClipRgn(hdc, updated);
+    HDC hdcFill = CreateCompatibleDC(hdc);
+    HGDIOBJ old = SelectObject(hdcFill, HighlightBitmap(hdc));
+    LONG lineHeight = EditorLineHeight(hwnd);
+    for (size_t drawn = 0; index < set.count && drawn < FINDALL_PAINT_MAX; ++index, ++drawn)
+    {
+        TextSpan match = MatchAt(set, index);
+        if (match.start > last)
+            break;
+        HighlightMatch(hwnd, hdc, hdcFill, match, first, lineHeight, client.bottom);
+    }
+    SelectObject(hdcFill, old);
+    DeleteDC(hdcFill);
+    ReleaseDC(hwnd, hdc);
+}
@@ -0,0 +1,35 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Find All: every match of the find text counted on a worker thread, listed with its line in a
+  results window and highlighted where it shows in the editor.
+*/
+
+#pragma once
+#include <windows.h>
+#include <string>
+#include "core/textregex.h"
+
+// regex is the compiled find text, or null for a literal search.
+void FindAll(const std::wstring &pattern, const Regex *regex);
+void CloseFindAll();
+bool IsFindAllActive();
+bool IsFindAllScanning();
+size_t GetFindAllCount();
+// Find Next/Previous from the selection through the match list, when it is complete and for
+// this search; false when the list cannot answer.
+bool FindAllNext(const std::wstring &pattern, bool regex, size_t selStart, size_t selEnd, bool forward, size_t &start, size_t &length);
+void NoteFindAllEdit(size_t offset, size_t removed, size_t inserted);
+void ResetFindAll();
+void OnFindAllBatch(LPARAM lParam);
+void OnFindAllTimer();
+// Draws the highlights over the part of the editor its last paint updated.
+void PaintFindAllMatches(HWND hwnd, HRGN updated);
@@ -0,0 +1,267 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Follow mode for growing files such as service logs.
+  A watcher thread wakes the UI thread, which reads and decodes only the appended bytes.
+*/
+
+#include "follow.h"
+#include "core/globals.h"
+#include "editor.h"
+#include "file.h"
+#include "journal.h"
+#include "ui.h"
+#include "resource.h"
+#include <richedit.h>
+#include <algorithm>
+#include <vector>
+
+#define FOLLOW_POLL_MS 1000
+#define FOLLOW_READ_SIZE (4u << 20)
+
+struct FollowJob
+{
+    UINT generation = 0;
+    std::wstring path;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hThread = nullptr;
+    HANDLE hCancel = nullptr;
+    DWORD volume = 0;
+    DWORD indexHigh = 0;
+    DWORD indexLow = 0;
+    ULONGLONG offset = 0;
+    Encoding encoding = Encoding::UTF8;
+    std::vector<BYTE> pending;
+    std::wstring text;
+    bool lastCR = false;
+    volatile LONG posted = 0;
+};
+
+static FollowJob *g_follow = nullptr;
+static UINT g_followGeneration = 0;
+
+static HANDLE OpenShared(const std::wstring &path)
+{
+    return CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+}
+
+static bool ReadAt(HANDLE hFile, ULONGLONG offset, BYTE *out, DWORD size, DWORD &read)
+{
+    OVERLAPPED ov{};
+    ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    read = 0;
+    return ReadFile(hFile, out, size, &read, &ov) != FALSE;
+}
+
+// One check in flight is enough; the UI thread reads everything new when it runs.
+static void PostFollowCheck(FollowJob &job)
+{
+    if (InterlockedExchange(&job.posted, 1) == 0 && !PostMessageW(g_hwndMain, WM_APP_FOLLOWCHECK, job.generation, 0))
+        InterlockedExchange(&job.posted, 0);
+}
+
+// Directory notifications wake us as soon as the file is written or renamed. NTFS may defer
+// size updates while the writer keeps its handle open, so the timeout doubles as a size poll.
+static DWORD WINAPI FollowThreadProc(LPVOID param)
+{
+    FollowJob &job = *static_cast<FollowJob *>(param);
+    size_t slash = job.path.find_last_of(L"\\/");
+    std::wstring dir = slash == std::wstring::npos ? L"." : job.path.substr(0, slash + 1);
+    HANDLE hChange = FindFirstChangeNotificationW(dir.c_str(), FALSE,
+                                                  FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    HANDLE handles[2] = {job.hCancel, hChange};
+    DWORD count = hChange != INVALID_HANDLE_VALUE ? 2 : 1;
+    for (;;)
+    {
+        DWORD wait = WaitForMultipleObjects(count, handles, FALSE, FOLLOW_POLL_MS);
+        if (wait == WAIT_OBJECT_0 || wait == WAIT_FAILED)
+            break;
+        if (wait == WAIT_OBJECT_0 + 1)
+            FindNextChangeNotification(hChange);
+        PostFollowCheck(job);
+    }
+    if (hChange != INVALID_HANDLE_VALUE)
+        FindCloseChangeNotification(hChange);
+    return 0;
+}
+
+// Rotation renames or deletes the file we hold and creates a new one under the same name,
+// so compare the identity of whatever the path opens now with ours.
+static bool IsFileReplaced(const FollowJob &job)
+{
+    HANDLE hFile = OpenShared(job.path);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    BY_HANDLE_FILE_INFORMATION info{};
+    bool replaced = GetFileInformationByHandle(hFile, &info) &&
+                    (info.dwVolumeSerialNumber != job.volume || info.nFileIndexHigh != job.indexHigh || info.nFileIndexLow != job.indexLow);
+    CloseHandle(hFile);
+    return replaced;
+}
+
+// A CR at the end of what is shown may be the first half of a CRLF that is still being written.
+static bool EndsWithCR(const FollowJob &job)
+{
+    bool wide = job.encoding == Encoding::UTF16LE || job.encoding == Encoding::UTF16BE;
+    DWORD unit = wide ? 2 : 1;
+    if (job.offset < BomLength(job.encoding) + unit)
+        return false;
+    BYTE last[2] = {0, 0};
+    DWORD read = 0;
+    if (!ReadAt(job.hFile, job.offset - unit, last, unit, read) || read != unit)
+        return false;
+    if (!wide)
+        return last[0] == '\r';
+    return job.encoding == Encoding::UTF16LE ? (last[0] == '\r' && last[1] == 0) : (last[0] == 0 && last[1] == '\r');
+}
+
+void StartFollow(const std::wstring &path, ULONGLONG offset, Encoding encoding)
+{
+    StopFollow();
+    FollowJob *job = new FollowJob();
+    g_follow = job;
+    job->generation = ++g_followGeneration;
+    job->path = path;
+    job->offset = offset;
+    job->encoding = encoding;
+    job->hFile = OpenShared(path);
+    BY_HANDLE_FILE_INFORMATION info{};
+    if (job->hFile == INVALID_HANDLE_VALUE || !GetFileInformationByHandle(job->hFile, &info))
+    {
+        StopFollow();
+        return;
+    }
+    job->volume = info.dwVolumeSerialNumber;
+    job->indexHigh = info.nFileIndexHigh;
+    job->indexLow = info.nFileIndexLow;
+    job->lastCR = EndsWithCR(*job);
+    job->hCancel = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (job->hCancel)
+        job->hThread = CreateThread(nullptr, 0, FollowThreadProc, job, 0, nullptr);
+    if (!job->hThread)
+    {
+        StopFollow();
+        return;
+    }
+    ScrollEditorToEnd();
+    PostFollowCheck(*job);
+}
+
+void StopFollow()
+{
+    if (!g_follow)
+        return;
+    FollowJob *job = g_follow;
+    g_follow = nullptr;
+    if (job->hThread)
+    {
+        SetEvent(job->hCancel);
+        WaitForSingleObject(job->hThread, INFINITE);
+        CloseHandle(job->hThread);
+    }
+    if (job->hCancel)
+        CloseHandle(job->hCancel);
+    if (job->hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(job->hFile);
+    delete job;
+}
+
+bool IsFollowing()
+{
+    return g_follow != nullptr;
+}
+
+// The text no longer matches the file, so start over from disk unless that would discard edits.
+static void ReloadFollowed()
+{
+    std::wstring path = g_follow->path;
+    StopFollow();
+    if (g_state.modified)
+    {
+        g_state.followMode = false;
+        CheckMenuItem(GetMenu(g_hwndMain), IDM_VIEW_FOLLOW, MF_UNCHECKED);
+        return;
+    }
+    LoadFile(path);
+}
+
+static void AppendFollowed(FollowJob &job, size_t length)
+{
+    const wchar_t *text = job.text.c_str();
+    if (job.lastCR && length && text[0] == L'\n')
+    {
+        ++text;
+        --length;
+        job.lastCR = false;
+    }
+    if (!length)
+        return;
+    job.lastCR = text[length - 1] == L'\r';
+    bool modified = g_state.modified;
+    AppendEditorText(std::u16string(reinterpret_cast<const char16_t *>(text), length));
+    // Appended text is part of the file, not an edit the user could undo or recover
+    g_state.modified = modified;
+    if (!modified)
+    {
+        SendMessageW(g_hwndEditor, EM_EMPTYUNDOBUFFER, 0, 0);
+        ResetJournal();
+    }
+    ScrollEditorToEnd();
+    UpdateTitle();
+    UpdateStatus();
+}
+
+void OnFollowCheck(WPARAM wParam)
+{
+    FollowJob *job = g_follow;
+    if (!job || static_cast<UINT>(wParam) != job->generation)
+        return;
+    InterlockedExchange(&job->posted, 0);
+    LARGE_INTEGER size{};
+    if (IsLoading() || !GetFileSizeEx(job->hFile, &size))
+        return;
+    ULONGLONG fileSize = static_cast<ULONGLONG>(size.QuadPart);
+    if (fileSize < job->offset || (fileSize == job->offset && IsFileReplaced(*job)))
+    {
+        ReloadFollowed();
+        return;
+    }
+    if (fileSize == job->offset)
+        return;
+    DWORD want = static_cast<DWORD>((std::min)(fileSize - job->offset, static_cast<ULONGLONG>(FOLLOW_READ_SIZE)));
+    std::vector<BYTE> &data = job->pending;
+    size_t base = data.size();
+    data.resize(base + want);
+    DWORD read = 0;
+    if (!ReadAt(job->hFile, job->offset, data.data() + base, want, read))
+    {
+        data.resize(base);
+        return;
+    }
+    data.resize(base + read);
+    job->offset += read;
+    job->text.resize(MaxDecodedLength(data.size()));
+    size_t consumed = 0;
+    bool invalid = false;
+    size_t written = data.empty() ? 0 : DecodeAnyChunk(job->encoding, data.data(), data.size(), &job->text[0], false, consumed, invalid);
+    // BOM-less UTF-8 was only guessed at load; let the loader pick again
+    if (invalid && job->encoding == Encoding::UTF8)
+    {
+        ReloadFollowed();
+        return;
+    }
+    data.erase(data.begin(), data.begin() + consumed);
+    AppendFollowed(*job, written);
+    if (job->offset < fileSize)
+        PostFollowCheck(*job);
+}
@@ -0,0 +1,24 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Follow mode for growing files such as service logs.
+  Appends only the bytes written since the last check and reloads on truncation or rotation.
+*/
+
+#pragma once
+#include <windows.h>
+#include <string>
+#include "core/types.h"
+
+void StartFollow(const std::wstring &path, ULONGLONG offset, Encoding encoding);
+void StopFollow();
+bool IsFollowing();
+void OnFollowCheck(WPARAM wParam);
@@ -0,0 +1,512 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Edit journal for crash recovery and hot exit.
+  The UI thread turns each edit into a record; a writer thread batches them to disk.
+*/
+
+#include "journal.h"
+#include "core/globals.h"
+#include "core/editjournal.h"
+#include "core/textscan.h"
+#include "document.h"
+#include "editor.h"
+#include "file.h"
+#include "ui.h"
+#include "viewer.h"
+#include <richedit.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define JOURNAL_BATCH_MS 250
+#define JOURNAL_SNAPSHOT_MS 1000
+#define JOURNAL_COMPACT_BYTES (4u << 20)
+#define JOURNAL_MUTEX_PREFIX L"Local\\LegacyNotepadJournal-"
+
+// Pending work for the writer. Later requests supersede earlier ones: a rewrite replaces the
+// file with head + snapshot + tail, a remove deletes it, and otherwise tail is appended.
+struct JournalQueue
+{
+    bool rewrite = false;
+    bool remove = false;
+    std::vector<uint8_t> head;
+    bool hasSnapshot = false;
+    std::wstring snapshot;
+    std::vector<uint8_t> tail;
+    std::wstring orphan;
+};
+
+struct JournalWriter
+{
+    std::wstring path;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hThread = nullptr;
+    HANDLE hWake = nullptr;
+    HANDLE hStop = nullptr;
+    HANDLE hMutex = nullptr;
+    CRITICAL_SECTION lock;
+    JournalQueue queue;
+    // A write failed, so the file no longer holds every edit. Until a rewrite succeeds, tails
+    // are dropped instead of appended after the gap. Only the writer thread uses this.
+    bool stale = false;
+    // Raised with stale under the lock, so the UI thread sends a snapshot to replace the file
+    bool failed = false;
+};
+
+static JournalWriter *g_journal = nullptr;
+static std::wstring g_journalDir;
+static bool g_journalActive = false;
+static bool g_snapshotPending = false;
+static size_t g_journalBytes = 0;
+static ULONGLONG g_baseSize = 0;
+static ULONGLONG g_baseTime = 0;
+
+static bool WriteAll(HANDLE hFile, const uint8_t *data, size_t size)
+{
+    while (size)
+    {
+        DWORD n = static_cast<DWORD>((std::min)(size, static_cast<size_t>(1u << 30)));
+        DWORD written = 0;
+        if (!WriteFile(hFile, data, n, &written, nullptr) || written != n)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void CloseJournalFile(JournalWriter &w)
+{
+    if (w.hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(w.hFile);
+    w.hFile = INVALID_HANDLE_VALUE;
+}
+
+// Writes the new journal next to the old one and swaps it in, so a crash in the middle of a
+// compaction leaves one complete journal or the other.
+static bool RewriteJournalFile(JournalWriter &w, JournalQueue &q)
+{
+    std::vector<uint8_t> data;
+    data.swap(q.head);
+    if (q.hasSnapshot)
+    {
+        AppendJournalSnapshot(data, reinterpret_cast<const char16_t *>(q.snapshot.c_str()), q.snapshot.size());
+        std::wstring().swap(q.snapshot);
+    }
+    data.insert(data.end(), q.tail.begin(), q.tail.end());
+    std::wstring tmp = w.path + L".tmp";
+    HANDLE hFile = CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    bool ok = WriteAll(hFile, data.data(), data.size()) && FlushFileBuffers(hFile);
+    CloseHandle(hFile);
+    // The old journal stays open until the new one is complete; the swap needs it closed
+    if (ok)
+    {
+        CloseJournalFile(w);
+        ok = MoveFileExW(tmp.c_str(), w.path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+    }
+    if (!ok)
+        DeleteFileW(tmp.c_str());
+    // The new journal after a swap, the old one again after a failed one
+    if (w.hFile == INVALID_HANDLE_VALUE)
+        w.hFile = CreateFileW(w.path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return ok && w.hFile != INVALID_HANDLE_VALUE;
+}
+
+static void FlushJournalQueue(JournalWriter &w)
+{
+    JournalQueue q;
+    EnterCriticalSection(&w.lock);
+    std::swap(q, w.queue);
+    LeaveCriticalSection(&w.lock);
+    if (q.remove && !q.rewrite)
+    {
+        CloseJournalFile(w);
+        DeleteFileW(w.path.c_str());
+    }
+    bool ok = true;
+    if (q.rewrite)
+    {
+        ok = RewriteJournalFile(w, q);
+        w.stale = !ok;
+    }
+    else if (!q.tail.empty())
+    {
+        ok = !w.stale && w.hFile != INVALID_HANDLE_VALUE && WriteAll(w.hFile, q.tail.data(), q.tail.size()) && FlushFileBuffers(w.hFile);
+        w.stale = !ok;
+    }
+    if (!ok)
+    {
+        EnterCriticalSection(&w.lock);
+        w.failed = true;
+        LeaveCriticalSection(&w.lock);
+    }
+    // A recovered journal is only dropped once its text is safe in ours, or was discarded
+    if (!q.orphan.empty() && ok)
+        DeleteFileW(q.orphan.c_str());
+}
+
+// Waits a little after the first record of a burst so fast typing shares one write and flush.
+static DWORD WINAPI JournalThreadProc(LPVOID param)
+{
+    JournalWriter &w = *static_cast<JournalWriter *>(param);
+    HANDLE handles[2] = {w.hStop, w.hWake};
+    bool stop = false;
+    while (!stop)
+    {
+        stop = WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1;
+        if (!stop)
+            stop = WaitForSingleObject(w.hStop, JOURNAL_BATCH_MS) == WAIT_OBJECT_0;
+        FlushJournalQueue(w);
+    }
+    CloseJournalFile(w);
+    return 0;
+}
+
+static void WakeWriter()
+{
+    SetEvent(g_journal->hWake);
+}
+
+// Whether the writer failed since the last call; the journal then needs a fresh snapshot.
+static bool TakeWriterFailure()
+{
+    EnterCriticalSection(&g_journal->lock);
+    bool failed = g_journal->failed;
+    g_journal->failed = false;
+    LeaveCriticalSection(&g_journal->lock);
+    return failed;
+}
+
+static bool GetFileIdentity(const std::wstring &path, ULONGLONG &size, ULONGLONG &time)
+{
+    size = time = 0;
+    WIN32_FILE_ATTRIBUTE_DATA data{};
+    if (path.empty() || !GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+        return false;
+    size = (static_cast<ULONGLONG>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    time = (static_cast<ULONGLONG>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+static std::vector<uint8_t> JournalHead()
+{
+    std::vector<uint8_t> head;
+    AppendJournalHeader(head);
+    AppendJournalDocument(head, reinterpret_cast<const char16_t *>(g_state.filePath.c_str()), g_state.filePath.size(),
+                          g_state.encoding, g_state.lineEnding, g_baseSize, g_baseTime);
+    return head;
+}
+
+void InitJournal()
+{
+    HKEY hKey;
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\LegacyNotepad", 0, KEY_READ, &hKey) == ERROR_SUCCESS)
+    {
+        DWORD value = 0, size = sizeof(value);
+        if (RegQueryValueExW(hKey, L"HotExit", nullptr, nullptr, reinterpret_cast<LPBYTE>(&value), &size) == ERROR_SUCCESS)
+            g_state.hotExit = value != 0;
+        RegCloseKey(hKey);
+    }
+    wchar_t base[MAX_PATH];
+    DWORD len = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+    if (len == 0 || len >= MAX_PATH)
+        return;
+    g_journalDir = std::wstring(base) + L"\\LegacyNotepad";
+    CreateDirectoryW(g_journalDir.c_str(), nullptr);
+    g_journalDir += L"\\Journal";
+    CreateDirectoryW(g_journalDir.c_str(), nullptr);
+    // The named mutex lives as long as this process, which is how other instances tell a
+    // live journal from one left behind by a crash or a hot exit
+    std::wstring name = std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(GetTickCount64());
+    JournalWriter *w = new JournalWriter();
+    w->path = g_journalDir + L"\\" + name + L".jnl";
+    w->hMutex = CreateMutexW(nullptr, FALSE, (JOURNAL_MUTEX_PREFIX + name).c_str());
+    w->hWake = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    w->hStop = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    InitializeCriticalSection(&w->lock);
+    if (w->hMutex && w->hWake && w->hStop)
+        w->hThread = CreateThread(nullptr, 0, JournalThreadProc, w, 0, nullptr);
+    g_journal = w;
+    if (!w->hThread)
+        CloseJournal(false);
+}
+
+void CloseJournal(bool keep)
+{
+    if (!g_journal)
+        return;
+    if (keep && TakeWriterFailure())
+        g_snapshotPending = true;
+    if (keep && (g_snapshotPending || !g_journalActive))
+        OnJournalTimer();
+    if (!keep)
+        ResetJournal();
+    JournalWriter *w = g_journal;
+    g_journal = nullptr;
+    if (w->hThread)
+    {
+        SetEvent(w->hStop);
+        WaitForSingleObject(w->hThread, INFINITE);
+        CloseHandle(w->hThread);
+    }
+    if (w->hWake)
+        CloseHandle(w->hWake);
+    if (w->hStop)
+        CloseHandle(w->hStop);
+    if (w->hMutex)
+        CloseHandle(w->hMutex);
+    DeleteCriticalSection(&w->lock);
+    delete w;
+}
+
+// The document now matches g_state.filePath on disk (or is a new empty one), so there is
+// nothing to recover; later edits start a new journal on top of this file.
+void ResetJournal()
+{
+    g_snapshotPending = false;
+    g_journalBytes = 0;
+    GetFileIdentity(g_state.filePath, g_baseSize, g_baseTime);
+    if (!g_journal || !g_journalActive)
+        return;
+    g_journalActive = false;
+    EnterCriticalSection(&g_journal->lock);
+    std::wstring orphan;
+    orphan.swap(g_journal->queue.orphan);
+    g_journal->queue = JournalQueue();
+    g_journal->queue.remove = true;
+    g_journal->queue.orphan.swap(orphan);
+    // The next edit starts a new journal anyway
+    g_journal->failed = false;
+    LeaveCriticalSection(&g_journal->lock);
+    WakeWriter();
+}
+
+bool CanHotExit()
+{
+    if (!g_journal || !g_state.hotExit || !g_state.modified || IsLoading() || IsViewerActive())
+        return false;
+    return !g_state.filePath.empty() || GetDocumentLength() > 0;
+}
+
+// Copies the whole text once and hands it to the writer, which encodes and writes it as the
+// start of a fresh journal. Used for compaction and after changes no edit record describes.
+static void TakeSnapshot()
+{
+    g_snapshotPending = false;
+    if (!g_journal || IsLoading() || IsViewerActive() || !g_state.modified)
+        return;
+    const PieceTable &doc = GetDocument();
+    std::wstring text(doc.length, L'\0');
+    CopyPieces(doc, 0, doc.length, reinterpret_cast<char16_t *>(&text[0]));
+    std::vector<uint8_t> head = JournalHead();
+    EnterCriticalSection(&g_journal->lock);
+    JournalQueue &q = g_journal->queue;
+    q.rewrite = true;
+    q.remove = false;
+    q.head.swap(head);
+    q.hasSnapshot = true;
+    q.snapshot.swap(text);
+    q.tail.clear();
+    LeaveCriticalSection(&g_journal->lock);
+    WakeWriter();
+    g_journalActive = true;
+    g_journalBytes = 0;
+}
+
+void RequestJournalSnapshot()
+{
+    if (!g_journal || g_snapshotPending)
+        return;
+    g_snapshotPending = true;
+    SetTimer(g_hwndMain, IDT_JOURNAL, JOURNAL_SNAPSHOT_MS, nullptr);
+}
+
+void OnJournalTimer()
+{
+    KillTimer(g_hwndMain, IDT_JOURNAL);
+    if (g_snapshotPending || g_journalBytes >= JOURNAL_COMPACT_BYTES || (g_state.modified && !g_journalActive))
+        TakeSnapshot();
+}
+
+void RecordJournalEdit(size_t offset, size_t removed, const wchar_t *text, size_t length)
+{
+    if (!g_journal || g_snapshotPending)
+        return;
+    // The snapshot will hold this edit too
+    if (TakeWriterFailure())
+    {
+        RequestJournalSnapshot();
+        return;
+    }
+    std::vector<uint8_t> head;
+    if (!g_journalActive)
+        head = JournalHead();
+    EnterCriticalSection(&g_journal->lock);
+    JournalQueue &q = g_journal->queue;
+    if (!g_journalActive)
+    {
+        q.rewrite = true;
+        q.remove = false;
+        q.head.swap(head);
+        q.hasSnapshot = false;
+        q.snapshot.clear();
+        q.tail.clear();
+    }
+    size_t before = q.tail.size();
+    AppendJournalEdit(q.tail, static_cast<uint64_t>(offset), static_cast<uint64_t>(removed), reinterpret_cast<const char16_t *>(text), length);
+    g_journalBytes += q.tail.size() - before;
+    LeaveCriticalSection(&g_journal->lock);
+    WakeWriter();
+    g_journalActive = true;
+    // Compact once typing pauses
+    if (g_journalBytes >= JOURNAL_COMPACT_BYTES)
+        SetTimer(g_hwndMain, IDT_JOURNAL, JOURNAL_SNAPSHOT_MS, nullptr);
+}
+
+static bool ReadWholeFile(const std::wstring &path, std::vector<uint8_t> &data)
+{
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size{};
+    bool ok = GetFileSizeEx(hFile, &size) && static_cast<ULONGLONG>(size.QuadPart) < (1ull << 32);
+    if (ok)
+    {
+        data.resize(static_cast<size_t>(size.QuadPart));
+        DWORD read = 0;
+        ok = data.empty() || (ReadFile(hFile, data.data(), static_cast<DWORD>(data.size()), &read, nullptr) && read == data.size());
+    }
+    CloseHandle(hFile);
+    return ok;
+}
+
+// Newest journal whose owner is gone: crashed, or closed with hot exit.
+static std::wstring FindOrphanJournal()
+{
+    std::wstring found;
+    FILETIME newest{};
+    WIN32_FIND_DATAW fd;
+    HANDLE hFind = FindFirstFileW((g_journalDir + L"\\*.jnl").c_str(), &fd);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return found;
+    do
+    {
+        std::wstring name = fd.cFileName;
+        std::wstring path = g_journalDir + L"\\" + name;
+        if (name.size() <= 4 || lstrcmpiW(name.c_str() + name.size() - 4, L".jnl") != 0 || path == g_journal->path)
+            continue;
+        HANDLE hMutex = OpenMutexW(SYNCHRONIZE, FALSE, (JOURNAL_MUTEX_PREFIX + name.substr(0, name.size() - 4)).c_str());
+        if (hMutex)
+        {
+            CloseHandle(hMutex);
+            continue;
+        }
+        if (found.empty() || CompareFileTime(&fd.ftLastWriteTime, &newest) > 0)
+        {
+            found = path;
+            newest = fd.ftLastWriteTime;
+        }
+    } while (FindNextFileW(hFind, &fd));
+    FindClose(hFind);
+    return found;
+}
+
+// Without a snapshot the edits apply to the file the journal names, and only if that file
+// is unchanged since; otherwise there is nothing safe to restore.
+static bool LoadJournalBase(const JournalRecord &doc, std::wstring &text)
+{
+    if (doc.text.empty())
+        return true;
+    std::wstring path(doc.text.begin(), doc.text.end());
+    ULONGLONG size = 0, time = 0;
+    std::vector<uint8_t> data;
+    if (!GetFileIdentity(path, size, time) || size != doc.fileSize || time != doc.fileTime || !ReadWholeFile(path, data))
+        return false;
+    text = DecodeText(data.data(), data.size(), doc.encoding);
+    return true;
+}
+
+bool RecoverJournal()
+{
+    if (!g_journal)
+        return false;
+    std::wstring orphan = FindOrphanJournal();
+    std::vector<uint8_t> data;
+    if (orphan.empty() || !ReadWholeFile(orphan, data))
+        return false;
+    JournalRecord doc;
+    bool hasDoc = false, hasText = false;
+    std::wstring text;
+    std::vector<JournalRecord> edits;
+    JournalRecord record;
+    size_t pos = JOURNAL_HEADER_SIZE;
+    while (CheckJournalHeader(data.data(), data.size()) && pos < data.size())
+    {
+        size_t n = ReadJournalRecord(data.data() + pos, data.size() - pos, record);
+        if (!n)
+            break;
+        pos += n;
+        if (record.type == JournalRecordType::Document)
+        {
+            doc = std::move(record);
+            hasDoc = true;
+        }
+        else if (record.type == JournalRecordType::Snapshot)
+        {
+            text.assign(record.text.begin(), record.text.end());
+            hasText = true;
+            edits.clear();
+        }
+        else
+            edits.push_back(std::move(record));
+        record = JournalRecord();
+    }
+    if (!hasDoc || (!hasText && !LoadJournalBase(doc, text)))
+    {
+        DeleteFileW(orphan.c_str());
+        return false;
+    }
+    // Offsets were recorded against RichEdit's text, which keeps CR alone as the line break
+    PieceTable replay;
+    std::u16string base(text.begin(), text.end());
+    base.resize(CollapseLineBreaks(&base[0], base.size()));
+    AppendPieceBuffer(replay, std::move(base));
+    for (const JournalRecord &edit : edits)
+    {
+        if (edit.offset > replay.length || edit.removed > replay.length - edit.offset)
+            break;
+        ReplacePieces(replay, static_cast<size_t>(edit.offset), static_cast<size_t>(edit.removed), edit.text.data(), edit.text.size());
+    }
+    text.assign(replay.length, L'\0');
+    CopyPieces(replay, 0, replay.length, reinterpret_cast<char16_t *>(&text[0]));
+    ClearPieces(replay);
+    SetEditorText(text);
+    SendMessageW(g_hwndEditor, EM_EMPTYUNDOBUFFER, 0, 0);
+    CHARRANGE home = {0, 0};
+    SendMessageW(g_hwndEditor, EM_EXSETSEL, 0, reinterpret_cast<LPARAM>(&home));
+    g_state.filePath.assign(doc.text.begin(), doc.text.end());
+    g_state.encoding = doc.encoding;
+    g_state.lineEnding = doc.lineEnding;
+    g_state.modified = true;
+    g_baseSize = doc.fileSize;
+    g_baseTime = doc.fileTime;
+    UpdateTitle();
+    UpdateStatus();
+    TakeSnapshot();
+    EnterCriticalSection(&g_journal->lock);
+    g_journal->queue.orphan = orphan;
+    LeaveCriticalSection(&g_journal->lock);
+    WakeWriter();
+    return true;
+}
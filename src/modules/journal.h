@@ -0,0 +1,26 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Edit journal for crash recovery and hot exit.
+  Records each edit in a sidecar file off the UI thread and replays orphaned journals on start.
+*/
+
+#pragma once
+#include <windows.h>
+
+void InitJournal();
+bool RecoverJournal();
+void CloseJournal(bool keep);
+void ResetJournal();
+bool CanHotExit();
+void RecordJournalEdit(size_t offset, size_t removed, const wchar_t *text, size_t length);
+void RequestJournalSnapshot();
+void OnJournalTimer();
@@ -93,11 +93,12 @@ void UpdateMenuStrings()
 
         ModifyMenuW(hViewMenu, 9, MF_BYPOSITION | MF_STRING, IDM_VIEW_TRANSPARENCY, lang.menuTransparency.c_str());
         ModifyMenuW(hViewMenu, 10, MF_BYPOSITION | MF_STRING, IDM_VIEW_ALWAYSONTOP, lang.menuAlwaysOnTop.c_str());
-        
-        HMENU hLangMenu = GetSubMenu(hViewMenu, 12);
+        ModifyMenuW(hViewMenu, 11, MF_BYPOSITION | MF_STRING | (g_state.followMode ? MF_CHECKED : 0), IDM_VIEW_FOLLOW, lang.menuFollow.c_str());
+
+        HMENU hLangMenu = GetSubMenu(hViewMenu, 13);
         if (hLangMenu)
         {
-            ModifyMenuW(hViewMenu, 12, MF_BYPOSITION | MF_STRING | MF_POPUP, reinterpret_cast<UINT_PTR>(hLangMenu), lang.menuLanguage.c_str());
+            ModifyMenuW(hViewMenu, 13, MF_BYPOSITION | MF_STRING | MF_POPUP, reinterpret_cast<UINT_PTR>(hLangMenu), lang.menuLanguage.c_str());
             ModifyMenuW(hLangMenu, 0, MF_BYPOSITION | MF_STRING, IDM_VIEW_LANG_EN, lang.menuLangEnglish.c_str());
             ModifyMenuW(hLangMenu, 1, MF_BYPOSITION | MF_STRING, IDM_VIEW_LANG_JA, lang.menuLangJapanese.c_str());
         }
@@ -122,7 +123,7 @@ void UpdateLanguageMenu()
     if (!hViewMenu)
         return;
 
-    HMENU hLangMenu = GetSubMenu(hViewMenu, 12);
+    HMENU hLangMenu = GetSubMenu(hViewMenu, 13);
     if (!hLangMenu)
         return;
 
@@ -0,0 +1,221 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Input replay test, built only into legacy-notepad-replay: types a sample text into the editor
+  through its window procedure, counts heap allocations made while the main window handles
+  the EN_CHANGE, EN_SELCHANGE and status timer that follow, and writes per-key latency to the
+  standard output when there is one. The result is the exit code.
+*/
+
+#include "replay.h"
+#include "core/globals.h"
+#include "theme.h"
+#include <richedit.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <new>
+#include <vector>
+
+#define REPLAY_SWITCH L"--replay-input"
+#define REPLAY_DEFAULT_KEYS 2000
+#define REPLAY_WARMUP_KEYS 100
+// Every this many keys the replay idles long enough for the status timer to fire
+#define REPLAY_IDLE_EVERY 50
+#define REPLAY_IDLE_MS 120
+
+static const wchar_t g_replayText[] = L"The quick brown fox jumps over the lazy dog.\r";
+
+// Counts operator new calls made on the UI thread while g_countThread names it. Only this
+// executable replaces the global allocator; legacy-notepad keeps the runtime's.
+static std::atomic<DWORD> g_countThread{0};
+static size_t g_allocations = 0;
+static WNDPROC g_origMainProc = nullptr;
+static bool g_counting = false;
+static size_t g_changes = 0;
+static size_t g_refreshes = 0;
+
+void *operator new(size_t size)
+{
+    if (g_countThread.load(std::memory_order_relaxed) == GetCurrentThreadId())
+        ++g_allocations;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+bool ParseReplaySwitch(const wchar_t *cmdLine, int &keys)
+{
+    size_t len = wcslen(REPLAY_SWITCH);
+    if (!cmdLine || wcsncmp(cmdLine, REPLAY_SWITCH, len) != 0)
+        return false;
+    keys = REPLAY_DEFAULT_KEYS;
+    if (cmdLine[len] == L'=')
+        keys = _wtoi(cmdLine + len + 1);
+    return keys > 0;
+}
+
+// The messages the main window gets from a keystroke on the way to the title and status bar.
+static bool IsRefreshMessage(UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    if (msg == WM_COMMAND)
+        return HIWORD(wParam) == EN_CHANGE && reinterpret_cast<HWND>(lParam) == g_hwndEditor;
+    if (msg == WM_NOTIFY)
+    {
+        const NMHDR *pnmh = reinterpret_cast<const NMHDR *>(lParam);
+        return pnmh->hwndFrom == g_hwndEditor && (pnmh->code == EN_CHANGE || pnmh->code == EN_SELCHANGE);
+    }
+    return msg == WM_TIMER && wParam == IDT_STATUS;
+}
+
+// Sits in front of WndProc for the replay and counts allocations while it handles those.
+static LRESULT CALLBACK ReplayMainProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    if (!g_counting || !IsRefreshMessage(msg, wParam, lParam))
+        return CallWindowProcW(g_origMainProc, hwnd, msg, wParam, lParam);
+    if (msg == WM_TIMER)
+        ++g_refreshes;
+    else if (msg == WM_COMMAND || reinterpret_cast<const NMHDR *>(lParam)->code == EN_CHANGE)
+        ++g_changes;
+    DWORD outer = g_countThread.exchange(GetCurrentThreadId());
+    LRESULT result = CallWindowProcW(g_origMainProc, hwnd, msg, wParam, lParam);
+    g_countThread = outer;
+    return result;
+}
+
+// Lets timers and paints run between keys as they would between real keystrokes.
+static void PumpMessages()
+{
+    MSG msg;
+    while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+    {
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+}
+
+static void Idle()
+{
+    DWORD until = GetTickCount() + REPLAY_IDLE_MS;
+    while (static_cast<LONG>(until - GetTickCount()) > 0)
+    {
+        MsgWaitForMultipleObjects(0, nullptr, FALSE, REPLAY_IDLE_MS, QS_ALLINPUT);
+        PumpMessages();
+    }
+}
+
+static double Percentile(const std::vector<double> &sorted, double p)
+{
+    return sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+}
+
+// Nothing is shown; a console or a redirected output gets the numbers, anything else only
+// the exit code.
+static void WriteReport(const char *text)
+{
+    HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (!out || out == INVALID_HANDLE_VALUE)
+    {
+        if (!AttachConsole(ATTACH_PARENT_PROCESS))
+            return;
+        out = GetStdHandle(STD_OUTPUT_HANDLE);
+        if (!out || out == INVALID_HANDLE_VALUE)
+            return;
+    }
+    DWORD written = 0;
+    WriteFile(out, text, static_cast<DWORD>(strlen(text)), &written, nullptr);
+}
+
+bool RunInputReplay(int keys)
+{
+    LARGE_INTEGER freq, start, end, replayStart, replayEnd;
+    QueryPerformanceFrequency(&freq);
+    std::vector<double> micros;
+    micros.reserve(keys);
+    size_t textLength = wcslen(g_replayText);
+    g_origMainProc = reinterpret_cast<WNDPROC>(SetWindowLongPtrW(g_hwndMain, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(ReplayMainProc)));
+    SetFocus(g_hwndEditor);
+    PumpMessages();
+    ThemeCounters before = GetThemeCounters();
+    QueryPerformanceCounter(&replayStart);
+    for (int i = 0; i < keys; ++i)
+    {
+        // Counting starts once the first keys have flipped the title and filled any caches
+        if (i == REPLAY_WARMUP_KEYS)
+        {
+            g_allocations = 0;
+            g_changes = 0;
+            g_refreshes = 0;
+        }
+        g_counting = true;
+        QueryPerformanceCounter(&start);
+        SendMessageW(g_hwndEditor, WM_CHAR, g_replayText[i % textLength], 1);
+        QueryPerformanceCounter(&end);
+        micros.push_back((end.QuadPart - start.QuadPart) * 1e6 / freq.QuadPart);
+        PumpMessages();
+        if ((i + 1) % REPLAY_IDLE_EVERY == 0)
+            Idle();
+    }
+    g_counting = false;
+    QueryPerformanceCounter(&replayEnd);
+    ThemeCounters after = GetThemeCounters();
+    SetWindowLongPtrW(g_hwndMain, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(g_origMainProc));
+
+    double seconds = static_cast<double>(replayEnd.QuadPart - replayStart.QuadPart) / freq.QuadPart;
+    double total = 0;
+    for (double us : micros)
+        total += us;
+    std::sort(micros.begin(), micros.end());
+    // Without EN_CHANGE and a status refresh reaching WndProc there was nothing to count
+    bool ok = g_allocations == 0 && g_changes > 0 && g_refreshes > 0;
+    char report[512];
+    snprintf(report, sizeof(report),
+             "%d keys\nmean %.1f us\np50 %.1f us\np99 %.1f us\nmax %.1f us\n"
+             "EN_CHANGE %u, status refreshes %u, allocations %u\n"
+             "theme registry reads %.0f/s\ntheme GDI objects %.0f/s\n%s\n",
+             keys, total / keys, Percentile(micros, 0.5), Percentile(micros, 0.99), micros.back(),
+             static_cast<unsigned>(g_changes), static_cast<unsigned>(g_refreshes), static_cast<unsigned>(g_allocations),
+             (after.registryReads - before.registryReads) / seconds, (after.gdiObjects - before.gdiObjects) / seconds,
+             ok ? "ok" : "FAILED");
+    WriteReport(report);
+    g_state.modified = false;
+    DestroyWindow(g_hwndMain);
+    return ok;
+}
@@ -0,0 +1,25 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Input replay test, built only into legacy-notepad-replay: types a sample text into the editor
+  through its window procedure and checks the title and status refresh it leads to does not
+  allocate once warmed up.
+*/
+
+#pragma once
+#include <windows.h>
+
+// Recognises --replay-input or --replay-input=N on the command line.
+bool ParseReplaySwitch(const wchar_t *cmdLine, int &keys);
+// Types keys characters, writes the timings to the standard output if there is one and closes
+// the window without saving. Fails when the main window allocated while handling EN_CHANGE,
+// EN_SELCHANGE or the status timer after the first few keys, or never got them.
+bool RunInputReplay(int keys);
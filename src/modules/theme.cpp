@@ -21,6 +21,14 @@
 #include "core/globals.h"
 #include "resource.h"
 
+// The System theme is read from the registry once and kept until Windows says it changed.
+// Status and menu fonts and brushes are made once per theme and metrics change.
+static int g_systemDark = -1;
+static HFONT g_statusFont = nullptr;
+static HFONT g_menuFont = nullptr;
+static HBRUSH g_hbrMenuHot = nullptr;
+static ThemeCounters g_themeCounters;
+
 bool SetTitleBarDark(HWND hwnd, BOOL dark)
 {
     const DWORD attrs[] = {DWMWA_USE_IMMERSIVE_DARK_MODE, 19};
@@ -31,12 +39,9 @@ bool SetTitleBarDark(HWND hwnd, BOOL dark)
     return applied;
 }
 
-bool IsDarkMode()
+static bool ReadSystemDarkMode()
 {
-    if (g_state.theme == Theme::Dark)
-        return true;
-    if (g_state.theme == Theme::Light)
-        return false;
+    ++g_themeCounters.registryReads;
     HKEY hKey;
     if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize", 0, KEY_READ, &hKey) == ERROR_SUCCESS)
     {
@@ -51,6 +56,85 @@ bool IsDarkMode()
     return false;
 }
 
+bool IsDarkMode()
+{
+    if (g_state.theme == Theme::Dark)
+        return true;
+    if (g_state.theme == Theme::Light)
+        return false;
+    if (g_systemDark < 0)
+        g_systemDark = ReadSystemDarkMode() ? 1 : 0;
+    return g_systemDark != 0;
+}
+
+void RefreshSystemTheme()
+{
+    g_systemDark = -1;
+}
+
+static HBRUSH CreateThemeBrush(COLORREF color)
+{
+    ++g_themeCounters.gdiObjects;
+    return CreateSolidBrush(color);
+}
+
+static HFONT CreateNonClientFont(bool menu)
+{
+    ++g_themeCounters.gdiObjects;
+    NONCLIENTMETRICSW ncm{};
+    ncm.cbSize = sizeof(ncm);
+    SystemParametersInfoW(SPI_GETNONCLIENTMETRICS, sizeof(ncm), &ncm, 0);
+    return CreateFontIndirectW(menu ? &ncm.lfMenuFont : &ncm.lfStatusFont);
+}
+
+template <typename Handle>
+static void DeleteThemeObject(Handle &obj)
+{
+    if (obj)
+    {
+        DeleteObject(obj);
+        obj = nullptr;
+    }
+}
+
+void ReleaseThemeFonts()
+{
+    DeleteThemeObject(g_statusFont);
+    DeleteThemeObject(g_menuFont);
+}
+
+HFONT GetStatusFont()
+{
+    if (!g_statusFont)
+        g_statusFont = CreateNonClientFont(false);
+    return g_statusFont;
+}
+
+HFONT GetMenuFont()
+{
+    if (!g_menuFont)
+        g_menuFont = CreateNonClientFont(true);
+    return g_menuFont;
+}
+
+HBRUSH GetMenuItemBrush(bool hot)
+{
+    if (!hot)
+    {
+        if (!g_hbrMenuDark)
+            g_hbrMenuDark = CreateThemeBrush(RGB(45, 45, 45));
+        return g_hbrMenuDark;
+    }
+    if (!g_hbrMenuHot)
+        g_hbrMenuHot = CreateThemeBrush(RGB(65, 65, 65));
+    return g_hbrMenuHot;
+}
+
+const ThemeCounters &GetThemeCounters()
+{
+    return g_themeCounters;
+}
+
 LRESULT CALLBACK StatusSubclassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
     if (IsDarkMode())
@@ -59,10 +143,9 @@ LRESULT CALLBACK StatusSubclassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
         {
             RECT rc;
             GetClientRect(hwnd, &rc);
-            HBRUSH hbr = g_hbrStatusDark ? g_hbrStatusDark : CreateSolidBrush(RGB(45, 45, 45));
-            FillRect(reinterpret_cast<HDC>(wParam), &rc, hbr);
             if (!g_hbrStatusDark)
-                DeleteObject(hbr);
+                g_hbrStatusDark = CreateThemeBrush(RGB(45, 45, 45));
+            FillRect(reinterpret_cast<HDC>(wParam), &rc, g_hbrStatusDark);
             return 1;
         }
         if (msg == WM_PAINT)
@@ -71,20 +154,16 @@ LRESULT CALLBACK StatusSubclassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
             HDC hdc = BeginPaint(hwnd, &ps);
             RECT rc;
             GetClientRect(hwnd, &rc);
-            HBRUSH hbr = g_hbrStatusDark ? g_hbrStatusDark : CreateSolidBrush(RGB(45, 45, 45));
-            FillRect(hdc, &rc, hbr);
             if (!g_hbrStatusDark)
-                DeleteObject(hbr);
-            NONCLIENTMETRICSW ncm = {sizeof(ncm)};
-            SystemParametersInfoW(SPI_GETNONCLIENTMETRICS, sizeof(ncm), &ncm, 0);
-            HFONT hFont = CreateFontIndirectW(&ncm.lfStatusFont);
-            HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(hdc, hFont));
+                g_hbrStatusDark = CreateThemeBrush(RGB(45, 45, 45));
+            FillRect(hdc, &rc, g_hbrStatusDark);
+            HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(hdc, GetStatusFont()));
             SetBkMode(hdc, TRANSPARENT);
             SetTextColor(hdc, RGB(255, 255, 255));
-            int parts[4];
-            int partCount = static_cast<int>(SendMessageW(hwnd, SB_GETPARTS, 4, reinterpret_cast<LPARAM>(parts)));
+            int parts[STATUS_PART_COUNT];
+            int partCount = static_cast<int>(SendMessageW(hwnd, SB_GETPARTS, STATUS_PART_COUNT, reinterpret_cast<LPARAM>(parts)));
             int left = 4;
-            for (int i = 0; i < partCount && i < 4; i++)
+            for (int i = 0; i < partCount && i < STATUS_PART_COUNT; i++)
             {
                 RECT rcPart = {left, rc.top + 2, (parts[i] == -1) ? rc.right : parts[i], rc.bottom - 2};
                 wchar_t szText[256] = {};
@@ -94,7 +173,6 @@ LRESULT CALLBACK StatusSubclassProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
                 left = rcPart.right + 2;
             }
             SelectObject(hdc, hOldFont);
-            DeleteObject(hFont);
             EndPaint(hwnd, &ps);
             return 0;
         }
@@ -138,26 +216,25 @@ void ApplyTheme()
     if (dark)
     {
         if (!g_hbrStatusDark)
-            g_hbrStatusDark = CreateSolidBrush(RGB(45, 45, 45));
+            g_hbrStatusDark = CreateThemeBrush(RGB(45, 45, 45));
         if (!g_hbrMenuDark)
-            g_hbrMenuDark = CreateSolidBrush(RGB(45, 45, 45));
+            g_hbrMenuDark = CreateThemeBrush(RGB(45, 45, 45));
     }
     else
     {
-        if (g_hbrStatusDark)
-        {
-            DeleteObject(g_hbrStatusDark);
-            g_hbrStatusDark = nullptr;
-        }
-        if (g_hbrMenuDark)
-        {
-            DeleteObject(g_hbrMenuDark);
-            g_hbrMenuDark = nullptr;
-        }
+        DeleteThemeObject(g_hbrStatusDark);
+        DeleteThemeObject(g_hbrMenuDark);
+        DeleteThemeObject(g_hbrMenuHot);
+        ReleaseThemeFonts();
     }
     SetTitleBarDark(g_hwndMain, dark);
     SetWindowTheme(g_hwndEditor, dark ? L"DarkMode_Explorer" : nullptr, nullptr);
     SetWindowTheme(g_hwndStatus, dark ? L"DarkMode_Explorer" : nullptr, nullptr);
+    if (g_hwndViewer)
+    {
+        SetWindowTheme(g_hwndViewer, dark ? L"DarkMode_Explorer" : nullptr, nullptr);
+        InvalidateRect(g_hwndViewer, nullptr, FALSE);
+    }
     SetWindowTheme(g_hwndMain, dark ? L"DarkMode_Explorer" : nullptr, nullptr);
     COLORREF bgColor = dark ? RGB(30, 30, 30) : GetSysColor(COLOR_WINDOW);
     COLORREF textColor = dark ? RGB(255, 255, 255) : GetSysColor(COLOR_WINDOWTEXT);
@@ -17,7 +17,21 @@
 
 #include <windows.h>
 
+struct ThemeCounters
+{
+    size_t registryReads = 0;
+    size_t gdiObjects = 0;
+};
+
 bool IsDarkMode();
+// Forgets the cached System theme so the next IsDarkMode reads it again.
+void RefreshSystemTheme();
+// Drops the cached status and menu fonts after a metrics or DPI change.
+void ReleaseThemeFonts();
+HFONT GetStatusFont();
+HFONT GetMenuFont();
+HBRUSH GetMenuItemBrush(bool hot);
+const ThemeCounters &GetThemeCounters();
 bool SetTitleBarDark(HWND hwnd, BOOL dark);
 void ApplyTheme();
 void ToggleDarkMode();
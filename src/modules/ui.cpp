@@ -17,22 +17,113 @@
 #include "core/globals.h"
 #include "editor.h"
 #include "file.h"
+#include "viewer.h"
+#include "findall.h"
 #include "lang/lang.h"
 #include <commctrl.h>
 #include <shlwapi.h>
 
+#define STATUS_REFRESH_MS 50
+
+// Built into fixed buffers so the keystroke path allocates nothing once it has run once.
+static const LangStrings *g_statusFormatLang = nullptr;
+static wchar_t g_statusFormat[STATUS_TEXT_MAX];
+
 void UpdateTitle()
 {
     const auto &lang = GetLangStrings();
-    std::wstring filename = g_state.filePath.empty() ? lang.untitled : PathFindFileNameW(g_state.filePath.c_str());
-    std::wstring title;
-    title.reserve(filename.size() + lang.appName.size() + 10);
-    if (g_state.modified)
-        title += L"*";
-    title += filename;
-    title += L" - ";
-    title += lang.appName;
-    SetWindowTextW(g_hwndMain, title.c_str());
+    const wchar_t *filename = g_state.filePath.empty() ? lang.untitled.c_str() : PathFindFileNameW(g_state.filePath.c_str());
+    wchar_t title[MAX_PATH * 2];
+    wcscpy_s(title, g_state.modified ? L"*" : L"");
+    wcsncat_s(title, filename, _TRUNCATE);
+    wcsncat_s(title, L" - ", _TRUNCATE);
+    wcsncat_s(title, lang.appName.c_str(), _TRUNCATE);
+    SetWindowTextW(g_hwndMain, title);
+}
+
+static void AppendFormatText(wchar_t *&out, const wchar_t *end, const std::wstring &text)
+{
+    for (wchar_t c : text)
+    {
+        if (end - out < 3)
+            break;
+        if (c == L'%')
+            *out++ = L'%';
+        *out++ = c;
+    }
+}
+
+// "Ln %d, Col %d " in the current language, rebuilt only when the language changes.
+static const wchar_t *StatusPositionFormat(const LangStrings &lang)
+{
+    if (g_statusFormatLang == &lang)
+        return g_statusFormat;
+    wchar_t *out = g_statusFormat;
+    const wchar_t *end = g_statusFormat + STATUS_TEXT_MAX - 8;
+    AppendFormatText(out, end, lang.statusLn);
+    wcscpy_s(out, 4, L"%d");
+    out += 2;
+    AppendFormatText(out, end, lang.statusCol);
+    wcscpy_s(out, 4, L"%d ");
+    g_statusFormatLang = &lang;
+    return g_statusFormat;
+}
+
+static UINT g_statusDirty = 0;
+static bool g_statusScheduled = false;
+
+// Sends a part only when its text changed and says whether it did.
+static bool SetStatusPart(int part, const wchar_t *text)
+{
+    if (wcscmp(g_statusTexts[part], text) == 0)
+        return false;
+    wcsncpy_s(g_statusTexts[part], text, _TRUNCATE);
+    SendMessageW(g_hwndStatus, SB_SETTEXTW, part | SBT_NOBORDERS, reinterpret_cast<LPARAM>(g_statusTexts[part]));
+    return true;
+}
+
+static void RefreshStatus(UINT fields)
+{
+    const auto &lang = GetLangStrings();
+    wchar_t buf[STATUS_TEXT_MAX];
+    bool changed = false;
+    if (fields & STATUS_POSITION)
+    {
+        if (IsLoading())
+            wsprintfW(buf, lang.statusLoading.c_str(), GetLoadProgress());
+        else if (IsViewerIndexing())
+            wsprintfW(buf, lang.statusIndexing.c_str(), GetViewerIndexProgress());
+        else if (IsViewerActive())
+        {
+            auto [line, col] = GetViewerCursorPos();
+            wsprintfW(buf, L"%s%I64u%s%I64u ", lang.statusLn.c_str(), line, lang.statusCol.c_str(), col);
+        }
+        else
+        {
+            auto [line, col] = GetCursorPos();
+            wsprintfW(buf, StatusPositionFormat(lang), line, col);
+        }
+        changed |= SetStatusPart(0, buf);
+    }
+    if (fields & STATUS_MATCHES)
+    {
+        buf[0] = L'\0';
+        if (IsFindAllActive())
+            wsprintfW(buf, (IsFindAllScanning() ? lang.statusMatchesScanning : lang.statusMatches).c_str(),
+                      static_cast<ULONGLONG>(GetFindAllCount()));
+        changed |= SetStatusPart(1, buf);
+    }
+    if (fields & STATUS_ENCODING)
+        changed |= SetStatusPart(2, GetEncodingName(g_state.encoding));
+    if (fields & STATUS_LINEENDING)
+        changed |= SetStatusPart(3, GetLineEndingName(g_state.lineEnding));
+    if (fields & STATUS_ZOOM)
+    {
+        wsprintfW(buf, L" %d%% ", g_state.zoomLevel);
+        changed |= SetStatusPart(4, buf);
+    }
+    if (changed)
+        InvalidateRect(g_hwndStatus, nullptr, TRUE);
 }
 
 void UpdateStatus()
@@ -43,18 +134,29 @@ void UpdateStatus()
         return;
     }
     ShowWindow(g_hwndStatus, SW_SHOW);
-    const auto &lang = GetLangStrings();
-    auto [line, col] = GetCursorPos();
-    wchar_t buf[256];
-    wsprintfW(buf, (lang.statusLn + L"%d" + lang.statusCol + L"%d ").c_str(), line, col);
-    g_statusTexts[0] = buf;
-    g_statusTexts[1] = GetEncodingName(g_state.encoding);
-    g_statusTexts[2] = GetLineEndingName(g_state.lineEnding);
-    wsprintfW(buf, L" %d%% ", g_state.zoomLevel);
-    g_statusTexts[3] = buf;
-    for (int i = 0; i < 4; i++)
-        SendMessageW(g_hwndStatus, SB_SETTEXTW, i | SBT_NOBORDERS, reinterpret_cast<LPARAM>(g_statusTexts[i].c_str()));
-    InvalidateRect(g_hwndStatus, nullptr, TRUE);
+    g_statusDirty = 0;
+    RefreshStatus(STATUS_ALL);
+}
+
+// Typing and caret moves only mark what changed; the status bar catches up once input pauses
+// for STATUS_REFRESH_MS or the next timer tick comes round.
+void ScheduleStatus(UINT fields)
+{
+    g_statusDirty |= fields;
+    if (g_statusScheduled)
+        return;
+    g_statusScheduled = true;
+    SetTimer(g_hwndMain, IDT_STATUS, STATUS_REFRESH_MS, nullptr);
+}
+
+void OnStatusTimer()
+{
+    KillTimer(g_hwndMain, IDT_STATUS);
+    g_statusScheduled = false;
+    UINT fields = g_statusDirty;
+    g_statusDirty = 0;
+    if (g_state.showStatusBar && fields)
+        RefreshStatus(fields);
 }
 
 void SetupStatusBarParts()
@@ -73,11 +175,19 @@ void SetupStatusBarParts()
     int wZoom = textW(L" 500% ");
     int wLE = textW(L" Windows (CRLF) ");
     int wEnc = textW(L" UTF-8 with BOM ");
+    // The match count only takes room while Find All has results
+    int wMatches = 0;
+    if (IsFindAllActive())
+    {
+        wchar_t buf[STATUS_TEXT_MAX];
+        wsprintfW(buf, GetLangStrings().statusMatchesScanning.c_str(), 99999999ull);
+        wMatches = textW(buf);
+    }
     SelectObject(hdc, old);
     ReleaseDC(g_hwndStatus, hdc);
     int w = rc.right;
-    int parts[4] = {w - (wEnc + wLE + wZoom), w - (wLE + wZoom), w - wZoom, -1};
-    SendMessageW(g_hwndStatus, SB_SETPARTS, 4, reinterpret_cast<LPARAM>(parts));
+    int parts[STATUS_PART_COUNT] = {w - (wMatches + wEnc + wLE + wZoom), w - (wEnc + wLE + wZoom), w - (wLE + wZoom), w - wZoom, -1};
+    SendMessageW(g_hwndStatus, SB_SETPARTS, STATUS_PART_COUNT, reinterpret_cast<LPARAM>(parts));
 }
 
 void ResizeControls()
@@ -96,5 +206,7 @@ void ResizeControls()
     else
         ShowWindow(g_hwndStatus, SW_HIDE);
     MoveWindow(g_hwndEditor, 0, 0, rc.right, rc.bottom - statusH, TRUE);
+    if (g_hwndViewer)
+        MoveWindow(g_hwndViewer, 0, 0, rc.right, rc.bottom - statusH, TRUE);
     SetupStatusBarParts();
 }
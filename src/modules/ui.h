@@ -17,9 +17,16 @@
 #include <windows.h>
 #include <string>
 
-extern std::wstring g_statusTexts[4];
+#define STATUS_POSITION 1
+#define STATUS_ENCODING 2
+#define STATUS_LINEENDING 4
+#define STATUS_ZOOM 8
+#define STATUS_MATCHES 16
+#define STATUS_ALL 31
 
 void UpdateTitle();
 void UpdateStatus();
+void ScheduleStatus(UINT fields);
+void OnStatusTimer();
 void SetupStatusBarParts();
 void ResizeControls();
@@ -0,0 +1,902 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Large file viewer that keeps the whole file mapped and indexes lines in the background.
+  Decodes and paints only the visible lines; Find and Go To work against the index.
+*/
+
+#include "viewer.h"
+#include "core/globals.h"
+#include "core/lineindex.h"
+#include "core/textscan.h"
+#include "editor.h"
+#include "file.h"
+#include "theme.h"
+#include "ui.h"
+#include "lang/lang.h"
+#include <uxtheme.h>
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#define VIEWER_CLASS L"NotepadViewerClass"
+#define VIEWER_INDEX_SLICE (16u << 20)
+#define VIEWER_FIND_BLOCK (4u << 20)
+#define VIEWER_LINE_LIMIT 4096
+#define VIEWER_LINE_BYTES (VIEWER_LINE_LIMIT * 4)
+#define VIEWER_COLUMN_SLICE (64u << 10)
+#define VIEWER_SCROLL_RANGE 0x40000000ull
+
+struct IndexBatch
+{
+    UINT generation = 0;
+    std::vector<uint64_t> checkpoints;
+    std::vector<LineMark> marks;
+    uint64_t lineCount = 1;
+    uint64_t indexed = 0;
+    bool complete = false;
+};
+
+struct ViewerDoc
+{
+    UINT generation = 0;
+    MappedFile file;
+    Encoding encoding = Encoding::UTF8;
+    Encoding displayEncoding = Encoding::UTF8;
+    LineIndex index;
+    HANDLE hThread = nullptr;
+    HANDLE hCancel = nullptr;
+    ULONGLONG topLine = 0;
+    int scrollX = 0;
+    ULONGLONG caretLine = 0;
+    size_t caretCol = 0;
+    size_t selLength = 0;
+    int lineHeight = 16;
+    int charWidth = 8;
+    std::wstring lineText;
+};
+
+static ViewerDoc *g_viewer = nullptr;
+static UINT g_viewerGeneration = 0;
+
+void LoadViewerSettings()
+{
+    HKEY hKey;
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\LegacyNotepad", 0, KEY_READ, &hKey) == ERROR_SUCCESS)
+    {
+        DWORD value = 0, size = sizeof(value);
+        if (RegQueryValueExW(hKey, L"ViewerThresholdMB", nullptr, nullptr, reinterpret_cast<LPBYTE>(&value), &size) == ERROR_SUCCESS && value)
+            g_state.viewerThreshold = static_cast<ULONGLONG>(value) << 20;
+        RegCloseKey(hKey);
+    }
+}
+
+// Indexes the mapped file in slices and posts the new checkpoints after each one, so the UI
+// thread owns its copy of the index and never shares it with this thread.
+static DWORD WINAPI IndexThreadProc(LPVOID param)
+{
+    ViewerDoc &doc = *static_cast<ViewerDoc *>(param);
+    LineIndex index;
+    InitLineIndex(index, doc.encoding, (std::min)(static_cast<ULONGLONG>(BomLength(doc.encoding)), doc.file.size));
+    size_t posted = index.checkpoints.size(), postedMarks = 0;
+    while (!index.complete && WaitForSingleObject(doc.hCancel, 0) == WAIT_TIMEOUT)
+    {
+        ULONGLONG end = (std::min)(index.indexed + VIEWER_INDEX_SLICE, doc.file.size);
+        ExtendLineIndex(index, doc.file.view, end);
+        if (end == doc.file.size)
+            FinishLineIndex(index);
+        IndexBatch *batch = new IndexBatch();
+        batch->generation = doc.generation;
+        batch->checkpoints.assign(index.checkpoints.begin() + posted, index.checkpoints.end());
+        batch->lineCount = index.lineCount;
+        batch->indexed = index.indexed;
+        batch->complete = index.complete;
+        batch->marks.assign(index.marks.begin() + postedMarks, index.marks.end());
+        posted = index.checkpoints.size();
+        postedMarks = index.marks.size();
+        if (!PostMessageW(g_hwndMain, WM_APP_INDEXCHUNK, 0, reinterpret_cast<LPARAM>(batch)))
+        {
+            delete batch;
+            break;
+        }
+    }
+    return 0;
+}
+
+// Decodes [start, end) into out and returns the bytes consumed, which stop short of a
+// character split at end unless final is set. BOM-less UTF-8 was only guessed from the prefix,
+// so the first invalid sequence switches the whole view to ANSI.
+static size_t DecodeRange(ViewerDoc &doc, ULONGLONG start, ULONGLONG end, bool final, std::wstring &out)
+{
+    size_t len = static_cast<size_t>(end - start);
+    out.resize(MaxDecodedLength(len));
+    if (!len)
+        return 0;
+    size_t consumed = 0;
+    bool invalid = false;
+    size_t written = DecodeAnyChunk(doc.displayEncoding, doc.file.view + start, len, &out[0], final, consumed, invalid);
+    if (invalid && doc.displayEncoding == Encoding::UTF8)
+    {
+        doc.displayEncoding = Encoding::ANSI;
+        g_state.encoding = Encoding::ANSI;
+        written = DecodeAnsiChunk(doc.file.view + start, len, &out[0], final, consumed);
+        UpdateStatus();
+    }
+    out.resize(written);
+    return consumed;
+}
+
+// Lines are cut at VIEWER_LINE_LIMIT units for display, and the search for their end stops
+// VIEWER_LINE_BYTES on, so one huge line cannot stall painting. Returns the end of the line,
+// or LINE_NPOS when it runs on past the cut.
+static ULONGLONG DecodeLine(ViewerDoc &doc, ULONGLONG start)
+{
+    if (start == LINE_NPOS)
+    {
+        doc.lineText.clear();
+        return LINE_NPOS;
+    }
+    ULONGLONG end = LineEndByte(doc.encoding, doc.file.view, doc.file.size, start, start + VIEWER_LINE_BYTES);
+    DecodeRange(doc, start, end != LINE_NPOS ? end : start + VIEWER_LINE_BYTES, end != LINE_NPOS, doc.lineText);
+    if (doc.lineText.size() > VIEWER_LINE_LIMIT)
+        doc.lineText.resize(VIEWER_LINE_LIMIT);
+    return end;
+}
+
+static int TextWidth(HDC hdc, const wchar_t *text, size_t length)
+{
+    if (!length)
+        return 0;
+    return LOWORD(GetTabbedTextExtentW(hdc, text, static_cast<int>(length), 0, nullptr));
+}
+
+static int VisibleRows(const ViewerDoc &doc)
+{
+    RECT rc{};
+    GetClientRect(g_hwndViewer, &rc);
+    int rows = rc.bottom / doc.lineHeight;
+    return rows > 0 ? rows : 1;
+}
+
+static ULONGLONG MaxTopLine(const ViewerDoc &doc)
+{
+    ULONGLONG rows = static_cast<ULONGLONG>(VisibleRows(doc));
+    return doc.index.lineCount > rows ? doc.index.lineCount - rows : 0;
+}
+
+// Scroll bar positions are 32-bit, so lines map onto VIEWER_SCROLL_RANGE steps.
+static ULONGLONG ScrollUnit(const ViewerDoc &doc)
+{
+    return doc.index.lineCount / VIEWER_SCROLL_RANGE + 1;
+}
+
+static void UpdateScrollBars(ViewerDoc &doc)
+{
+    ULONGLONG unit = ScrollUnit(doc);
+    SCROLLINFO si{};
+    si.cbSize = sizeof(si);
+    si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS;
+    si.nMax = static_cast<int>((doc.index.lineCount - 1) / unit);
+    si.nPage = static_cast<UINT>((std::max)(static_cast<ULONGLONG>(VisibleRows(doc)) / unit, 1ull));
+    si.nPos = static_cast<int>(doc.topLine / unit);
+    SetScrollInfo(g_hwndViewer, SB_VERT, &si, TRUE);
+    RECT rc;
+    GetClientRect(g_hwndViewer, &rc);
+    si.nMax = VIEWER_LINE_LIMIT * doc.charWidth;
+    si.nPage = static_cast<UINT>(rc.right);
+    si.nPos = doc.scrollX;
+    SetScrollInfo(g_hwndViewer, SB_HORZ, &si, TRUE);
+}
+
+static void UpdateCaret(ViewerDoc &doc)
+{
+    if (GetFocus() != g_hwndViewer)
+        return;
+    if (doc.caretLine < doc.topLine || doc.caretLine >= doc.topLine + VisibleRows(doc))
+    {
+        SetCaretPos(-doc.charWidth, -doc.lineHeight);
+        return;
+    }
+    HDC hdc = GetDC(g_hwndViewer);
+    HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(hdc, g_state.hFont));
+    DecodeLine(doc, LineStartByte(doc.index, doc.file.view, doc.file.size, doc.caretLine));
+    int x = TextWidth(hdc, doc.lineText.c_str(), (std::min)(doc.caretCol, doc.lineText.size()));
+    SelectObject(hdc, hOldFont);
+    ReleaseDC(g_hwndViewer, hdc);
+    SetCaretPos(x - doc.scrollX, static_cast<int>(doc.caretLine - doc.topLine) * doc.lineHeight);
+}
+
+static void ScrollToLine(ViewerDoc &doc, ULONGLONG top)
+{
+    top = (std::min)(top, MaxTopLine(doc));
+    if (top == doc.topLine)
+        return;
+    doc.topLine = top;
+    UpdateScrollBars(doc);
+    InvalidateRect(g_hwndViewer, nullptr, FALSE);
+    UpdateCaret(doc);
+}
+
+static void ScrollToX(ViewerDoc &doc, int x)
+{
+    x = (std::max)(0, (std::min)(x, VIEWER_LINE_LIMIT * doc.charWidth));
+    if (x == doc.scrollX)
+        return;
+    doc.scrollX = x;
+    UpdateScrollBars(doc);
+    InvalidateRect(g_hwndViewer, nullptr, FALSE);
+    UpdateCaret(doc);
+}
+
+static void EnsureCaretVisible(ViewerDoc &doc)
+{
+    ULONGLONG rows = static_cast<ULONGLONG>(VisibleRows(doc));
+    if (doc.caretLine < doc.topLine)
+        ScrollToLine(doc, doc.caretLine);
+    else if (doc.caretLine >= doc.topLine + rows)
+        ScrollToLine(doc, doc.caretLine - rows + 1);
+    RECT rc;
+    GetClientRect(g_hwndViewer, &rc);
+    HDC hdc = GetDC(g_hwndViewer);
+    HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(hdc, g_state.hFont));
+    DecodeLine(doc, LineStartByte(doc.index, doc.file.view, doc.file.size, doc.caretLine));
+    int x = TextWidth(hdc, doc.lineText.c_str(), (std::min)(doc.caretCol, doc.lineText.size()));
+    SelectObject(hdc, hOldFont);
+    ReleaseDC(g_hwndViewer, hdc);
+    if (x < doc.scrollX || x >= doc.scrollX + rc.right - doc.charWidth)
+        ScrollToX(doc, x - rc.right / 2);
+    UpdateCaret(doc);
+}
+
+static size_t CaretLineLength(ViewerDoc &doc)
+{
+    DecodeLine(doc, LineStartByte(doc.index, doc.file.view, doc.file.size, doc.caretLine));
+    return doc.lineText.size();
+}
+
+static void MoveCaret(ViewerDoc &doc, ULONGLONG line, size_t col)
+{
+    doc.caretLine = (std::min)(line, doc.index.lineCount - 1);
+    doc.caretCol = (std::min)(col, CaretLineLength(doc));
+    if (doc.selLength)
+        InvalidateRect(g_hwndViewer, nullptr, FALSE);
+    doc.selLength = 0;
+    EnsureCaretVisible(doc);
+    UpdateStatus();
+}
+
+static void PaintViewer(HWND hwnd)
+{
+    PAINTSTRUCT ps;
+    HDC hdc = BeginPaint(hwnd, &ps);
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    if (rc.right <= 0 || rc.bottom <= 0)
+    {
+        EndPaint(hwnd, &ps);
+        return;
+    }
+    bool dark = IsDarkMode();
+    COLORREF bgColor = dark ? RGB(30, 30, 30) : GetSysColor(COLOR_WINDOW);
+    COLORREF textColor = dark ? RGB(255, 255, 255) : GetSysColor(COLOR_WINDOWTEXT);
+    HDC hdcMem = CreateCompatibleDC(hdc);
+    HBITMAP hBmp = CreateCompatibleBitmap(hdc, rc.right, rc.bottom);
+    HBITMAP hOldBmp = reinterpret_cast<HBITMAP>(SelectObject(hdcMem, hBmp));
+    HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(hdcMem, g_state.hFont));
+    HBRUSH hbr = CreateSolidBrush(bgColor);
+    FillRect(hdcMem, &rc, hbr);
+    DeleteObject(hbr);
+    SetBkMode(hdcMem, TRANSPARENT);
+    if (g_viewer)
+    {
+        ViewerDoc &doc = *g_viewer;
+        ULONGLONG start = LineStartByte(doc.index, doc.file.view, doc.file.size, doc.topLine);
+        int rows = rc.bottom / doc.lineHeight + 1;
+        for (int row = 0; row < rows && start != LINE_NPOS; ++row)
+        {
+            ULONGLONG end = DecodeLine(doc, start);
+            const wchar_t *text = doc.lineText.c_str();
+            size_t length = doc.lineText.size();
+            int y = row * doc.lineHeight;
+            SetTextColor(hdcMem, textColor);
+            TabbedTextOutW(hdcMem, -doc.scrollX, y, text, static_cast<int>(length), 0, nullptr, -doc.scrollX);
+            if (doc.selLength && doc.topLine + row == doc.caretLine && doc.caretCol < length)
+            {
+                size_t count = (std::min)(doc.selLength, length - doc.caretCol);
+                int x = TextWidth(hdcMem, text, doc.caretCol) - doc.scrollX;
+                SetBkMode(hdcMem, OPAQUE);
+                SetBkColor(hdcMem, GetSysColor(COLOR_HIGHLIGHT));
+                SetTextColor(hdcMem, GetSysColor(COLOR_HIGHLIGHTTEXT));
+                TabbedTextOutW(hdcMem, x, y, text + doc.caretCol, static_cast<int>(count), 0, nullptr, -doc.scrollX);
+                SetBkMode(hdcMem, TRANSPARENT);
+            }
+            // Past a line cut for display the next one is looked up in the index, not scanned for
+            if (end != LINE_NPOS)
+                start = SkipLineBreak(doc.encoding, doc.file.view, doc.file.size, end);
+            else
+                start = LineStartByte(doc.index, doc.file.view, doc.file.size, doc.topLine + row + 1);
+        }
+    }
+    BitBlt(hdc, 0, 0, rc.right, rc.bottom, hdcMem, 0, 0, SRCCOPY);
+    SelectObject(hdcMem, hOldFont);
+    SelectObject(hdcMem, hOldBmp);
+    DeleteObject(hBmp);
+    DeleteDC(hdcMem);
+    EndPaint(hwnd, &ps);
+}
+
+static size_t ColumnFromX(ViewerDoc &doc, int x)
+{
+    HDC hdc = GetDC(g_hwndViewer);
+    HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(hdc, g_state.hFont));
+    size_t lo = 0, hi = doc.lineText.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi + 1) / 2;
+        if (TextWidth(hdc, doc.lineText.c_str(), mid) <= x)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    if (lo < doc.lineText.size())
+    {
+        int left = TextWidth(hdc, doc.lineText.c_str(), lo);
+        int right = TextWidth(hdc, doc.lineText.c_str(), lo + 1);
+        if (x - left > right - x)
+            ++lo;
+    }
+    SelectObject(hdc, hOldFont);
+    ReleaseDC(g_hwndViewer, hdc);
+    return lo;
+}
+
+static void OnScroll(ViewerDoc &doc, int bar, WORD code)
+{
+    SCROLLINFO si{};
+    si.cbSize = sizeof(si);
+    si.fMask = SIF_TRACKPOS;
+    GetScrollInfo(g_hwndViewer, bar, &si);
+    if (bar == SB_VERT)
+    {
+        ULONGLONG rows = static_cast<ULONGLONG>(VisibleRows(doc));
+        ULONGLONG top = doc.topLine;
+        switch (code)
+        {
+        case SB_LINEUP:
+            top = top ? top - 1 : 0;
+            break;
+        case SB_LINEDOWN:
+            ++top;
+            break;
+        case SB_PAGEUP:
+            top = top > rows ? top - rows : 0;
+            break;
+        case SB_PAGEDOWN:
+            top += rows;
+            break;
+        case SB_THUMBTRACK:
+        case SB_THUMBPOSITION:
+            top = static_cast<ULONGLONG>(si.nTrackPos) * ScrollUnit(doc);
+            break;
+        case SB_TOP:
+            top = 0;
+            break;
+        case SB_BOTTOM:
+            top = MaxTopLine(doc);
+            break;
+        }
+        ScrollToLine(doc, top);
+        return;
+    }
+    RECT rc;
+    GetClientRect(g_hwndViewer, &rc);
+    int x = doc.scrollX;
+    switch (code)
+    {
+    case SB_LINELEFT:
+        x -= doc.charWidth;
+        break;
+    case SB_LINERIGHT:
+        x += doc.charWidth;
+        break;
+    case SB_PAGELEFT:
+        x -= rc.right;
+        break;
+    case SB_PAGERIGHT:
+        x += rc.right;
+        break;
+    case SB_THUMBTRACK:
+    case SB_THUMBPOSITION:
+        x = si.nTrackPos;
+        break;
+    }
+    ScrollToX(doc, x);
+}
+
+static void OnKeyDown(ViewerDoc &doc, WPARAM key)
+{
+    bool ctrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+    ULONGLONG rows = static_cast<ULONGLONG>(VisibleRows(doc));
+    ULONGLONG line = doc.caretLine;
+    switch (key)
+    {
+    case VK_UP:
+        MoveCaret(doc, line ? line - 1 : 0, doc.caretCol);
+        break;
+    case VK_DOWN:
+        MoveCaret(doc, line + 1, doc.caretCol);
+        break;
+    case VK_PRIOR:
+        ScrollToLine(doc, doc.topLine > rows ? doc.topLine - rows : 0);
+        MoveCaret(doc, line > rows ? line - rows : 0, doc.caretCol);
+        break;
+    case VK_NEXT:
+        ScrollToLine(doc, doc.topLine + rows);
+        MoveCaret(doc, line + rows, doc.caretCol);
+        break;
+    case VK_HOME:
+        MoveCaret(doc, ctrl ? 0 : line, 0);
+        break;
+    case VK_END:
+        MoveCaret(doc, ctrl ? doc.index.lineCount - 1 : line, VIEWER_LINE_LIMIT);
+        break;
+    case VK_LEFT:
+        if (doc.caretCol)
+            MoveCaret(doc, line, doc.caretCol - 1);
+        else if (line)
+            MoveCaret(doc, line - 1, VIEWER_LINE_LIMIT);
+        break;
+    case VK_RIGHT:
+        if (doc.caretCol < CaretLineLength(doc))
+            MoveCaret(doc, line, doc.caretCol + 1);
+        else if (line + 1 < doc.index.lineCount)
+            MoveCaret(doc, line + 1, 0);
+        break;
+    }
+}
+
+static void UpdateMetrics(ViewerDoc &doc)
+{
+    HDC hdc = GetDC(g_hwndViewer);
+    HFONT hOldFont = reinterpret_cast<HFONT>(SelectObject(hdc, g_state.hFont));
+    TEXTMETRICW tm;
+    GetTextMetricsW(hdc, &tm);
+    SelectObject(hdc, hOldFont);
+    ReleaseDC(g_hwndViewer, hdc);
+    doc.lineHeight = (std::max)(1, static_cast<int>(tm.tmHeight + tm.tmExternalLeading));
+    doc.charWidth = (std::max)(1, static_cast<int>(tm.tmAveCharWidth));
+    if (GetFocus() == g_hwndViewer)
+    {
+        DestroyCaret();
+        CreateCaret(g_hwndViewer, nullptr, 2, doc.lineHeight);
+        ShowCaret(g_hwndViewer);
+    }
+    UpdateScrollBars(doc);
+    InvalidateRect(g_hwndViewer, nullptr, FALSE);
+    UpdateCaret(doc);
+}
+
+static LRESULT CALLBACK ViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    switch (msg)
+    {
+    case WM_ERASEBKGND:
+        return 1;
+    case WM_PAINT:
+        PaintViewer(hwnd);
+        return 0;
+    }
+    if (!g_viewer)
+        return DefWindowProcW(hwnd, msg, wParam, lParam);
+    ViewerDoc &doc = *g_viewer;
+    switch (msg)
+    {
+    case WM_SETFONT:
+        UpdateMetrics(doc);
+        return 0;
+    case WM_SIZE:
+        ScrollToLine(doc, doc.topLine);
+        UpdateScrollBars(doc);
+        return 0;
+    case WM_SETFOCUS:
+        CreateCaret(hwnd, nullptr, 2, doc.lineHeight);
+        ShowCaret(hwnd);
+        UpdateCaret(doc);
+        return 0;
+    case WM_KILLFOCUS:
+        DestroyCaret();
+        return 0;
+    case WM_VSCROLL:
+        OnScroll(doc, SB_VERT, LOWORD(wParam));
+        return 0;
+    case WM_HSCROLL:
+        OnScroll(doc, SB_HORZ, LOWORD(wParam));
+        return 0;
+    case WM_MOUSEWHEEL:
+        if (GetKeyState(VK_CONTROL) & 0x8000)
+            break;
+        {
+            UINT lines = 3;
+            SystemParametersInfoW(SPI_GETWHEELSCROLLLINES, 0, &lines, 0);
+            LONGLONG delta = static_cast<LONGLONG>(GET_WHEEL_DELTA_WPARAM(wParam)) * static_cast<LONGLONG>(lines) / WHEEL_DELTA;
+            ULONGLONG top = doc.topLine;
+            top = delta > 0 ? (top > static_cast<ULONGLONG>(delta) ? top - delta : 0) : top + static_cast<ULONGLONG>(-delta);
+            ScrollToLine(doc, top);
+        }
+        return 0;
+    case WM_LBUTTONDOWN:
+    {
+        SetFocus(hwnd);
+        int y = static_cast<short>(HIWORD(lParam));
+        int x = static_cast<short>(LOWORD(lParam));
+        ULONGLONG line = doc.topLine + static_cast<ULONGLONG>((std::max)(0, y) / doc.lineHeight);
+        line = (std::min)(line, doc.index.lineCount - 1);
+        DecodeLine(doc, LineStartByte(doc.index, doc.file.view, doc.file.size, line));
+        MoveCaret(doc, line, ColumnFromX(doc, x + doc.scrollX));
+        return 0;
+    }
+    case WM_KEYDOWN:
+        OnKeyDown(doc, wParam);
+        return 0;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+void OpenViewer(const std::wstring &path)
+{
+    ViewerDoc *doc = new ViewerDoc();
+    if (OpenMappedFile(path, doc->file) && doc->file.hMapping)
+        doc->file.view = static_cast<const BYTE *>(MapViewOfFile(doc->file.hMapping, FILE_MAP_READ, 0, 0, 0));
+    if (!doc->file.view)
+    {
+        CloseMappedFile(doc->file);
+        delete doc;
+        const auto &lang = GetLangStrings();
+        MessageBoxW(g_hwndMain, lang.msgCannotOpenFile.c_str(), lang.msgError.c_str(), MB_ICONERROR);
+        return;
+    }
+    doc->file.viewSize = static_cast<size_t>(doc->file.size);
+    CloseViewer();
+    size_t head = static_cast<size_t>((std::min)(doc->file.size, static_cast<ULONGLONG>(DETECT_PREFIX_SIZE)));
+    auto [enc, le] = DetectPrefixEncoding(doc->file.view, head, head == doc->file.size);
+    doc->encoding = enc;
+    doc->displayEncoding = enc;
+    InitLineIndex(doc->index, enc, (std::min)(static_cast<ULONGLONG>(BomLength(enc)), doc->file.size));
+    doc->generation = ++g_viewerGeneration;
+
+    static bool registered = false;
+    if (!registered)
+    {
+        WNDCLASSEXW wc{};
+        wc.cbSize = sizeof(wc);
+        wc.lpfnWndProc = ViewerProc;
+        wc.hInstance = GetModuleHandleW(nullptr);
+        wc.hCursor = LoadCursorW(nullptr, IDC_IBEAM);
+        wc.lpszClassName = VIEWER_CLASS;
+        registered = RegisterClassExW(&wc) != 0;
+    }
+    g_hwndViewer = CreateWindowExW(0, VIEWER_CLASS, nullptr, WS_CHILD | WS_VSCROLL | WS_HSCROLL,
+                                   0, 0, 100, 100, g_hwndMain, nullptr, GetModuleHandleW(nullptr), nullptr);
+    SetWindowTheme(g_hwndViewer, IsDarkMode() ? L"DarkMode_Explorer" : nullptr, nullptr);
+    g_viewer = doc;
+    SetEditorText(L"");
+    SendMessageW(g_hwndEditor, EM_SETREADONLY, TRUE, 0);
+    ShowWindow(g_hwndEditor, SW_HIDE);
+    ShowWindow(g_hwndViewer, SW_SHOW);
+    ResizeControls();
+    SendMessageW(g_hwndViewer, WM_SETFONT, reinterpret_cast<WPARAM>(g_state.hFont), TRUE);
+    SetFocus(g_hwndViewer);
+    g_state.filePath = path;
+    g_state.modified = false;
+    g_state.encoding = enc;
+    g_state.lineEnding = le;
+    doc->hCancel = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (doc->hCancel)
+        doc->hThread = CreateThread(nullptr, 0, IndexThreadProc, doc, 0, nullptr);
+    if (!doc->hThread)
+    {
+        ExtendLineIndex(doc->index, doc->file.view, doc->file.size);
+        FinishLineIndex(doc->index);
+        UpdateScrollBars(*doc);
+    }
+    UpdateTitle();
+    UpdateStatus();
+    AddRecentFile(path);
+}
+
+void CloseViewer()
+{
+    if (!g_viewer)
+        return;
+    ViewerDoc *doc = g_viewer;
+    g_viewer = nullptr;
+    if (doc->hThread)
+    {
+        SetEvent(doc->hCancel);
+        WaitForSingleObject(doc->hThread, INFINITE);
+        CloseHandle(doc->hThread);
+    }
+    if (doc->hCancel)
+        CloseHandle(doc->hCancel);
+    CloseMappedFile(doc->file);
+    delete doc;
+    bool focused = GetFocus() == g_hwndViewer;
+    DestroyWindow(g_hwndViewer);
+    g_hwndViewer = nullptr;
+    SendMessageW(g_hwndEditor, EM_SETREADONLY, FALSE, 0);
+    ShowWindow(g_hwndEditor, SW_SHOW);
+    if (focused)
+        SetFocus(g_hwndEditor);
+}
+
+bool IsViewerActive()
+{
+    return g_viewer != nullptr;
+}
+
+bool IsViewerIndexing()
+{
+    return g_viewer && !g_viewer->index.complete;
+}
+
+int GetViewerIndexProgress()
+{
+    if (!g_viewer || g_viewer->file.size == 0)
+        return 0;
+    return static_cast<int>(g_viewer->index.indexed * 100 / g_viewer->file.size);
+}
+
+std::pair<ULONGLONG, ULONGLONG> GetViewerCursorPos()
+{
+    if (!g_viewer)
+        return {1, 1};
+    return {g_viewer->caretLine + 1, g_viewer->caretCol + 1};
+}
+
+void OnViewerIndexChunk(LPARAM lParam)
+{
+    IndexBatch *batch = reinterpret_cast<IndexBatch *>(lParam);
+    if (g_viewer && batch->generation == g_viewer->generation)
+    {
+        LineIndex &index = g_viewer->index;
+        index.checkpoints.insert(index.checkpoints.end(), batch->checkpoints.begin(), batch->checkpoints.end());
+        index.marks.insert(index.marks.end(), batch->marks.begin(), batch->marks.end());
+        index.lineCount = batch->complete ? batch->lineCount : (std::max)(index.lineCount, batch->lineCount);
+        index.indexed = batch->indexed;
+        index.complete = batch->complete;
+        UpdateScrollBars(*g_viewer);
+        UpdateStatus();
+    }
+    delete batch;
+}
+
+// Returns the 0-based line and column of pos within decoded text whose first unit is at
+// firstCol of firstLine.
+static std::pair<ULONGLONG, size_t> PositionInBlock(const std::wstring &text, size_t pos, ULONGLONG firstLine, size_t firstCol)
+{
+    ULONGLONG line = firstLine;
+    size_t lineStart = 0;
+    for (size_t i = 0; i < pos; ++i)
+    {
+        if (text[i] == L'\r' && i + 1 < pos && text[i + 1] == L'\n')
+            ++i;
+        if (text[i] == L'\r' || text[i] == L'\n')
+        {
+            ++line;
+            lineStart = i + 1;
+        }
+    }
+    return {line, line == firstLine ? firstCol + pos : pos - lineStart};
+}
+
+// Units [from, to) decodes to, a block at a time.
+static size_t CountUnits(ViewerDoc &doc, ULONGLONG from, ULONGLONG to)
+{
+    std::wstring units;
+    size_t count = 0;
+    while (from < to)
+    {
+        ULONGLONG end = (std::min)(from + VIEWER_FIND_BLOCK, to);
+        size_t consumed = DecodeRange(doc, from, end, end == to, units);
+        count += units.size();
+        if (!consumed)
+            break;
+        from += consumed;
+    }
+    return count;
+}
+
+// Byte where column col of the line starting at start begins. The slice holding it is halved
+// down to the character boundary, so only VIEWER_COLUMN_SLICE bytes are decoded at a time.
+static ULONGLONG ColumnByte(ViewerDoc &doc, ULONGLONG start, size_t col)
+{
+    ULONGLONG size = doc.file.size;
+    std::wstring units;
+    while (col && start < size)
+    {
+        ULONGLONG end = (std::min)(start + VIEWER_COLUMN_SLICE, size);
+        size_t consumed = DecodeRange(doc, start, end, end == size, units);
+        if (units.size() > col)
+        {
+            size_t lo = 0, hi = consumed;
+            while (hi - lo > 1)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                DecodeRange(doc, start, start + mid, false, units);
+                if (units.size() <= col)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            return start + DecodeRange(doc, start, start + lo, false, units);
+        }
+        if (!consumed)
+            break;
+        col -= units.size();
+        start += consumed;
+    }
+    return start;
+}
+
+// Line and column of block[pos] in a block decoded from from.
+static std::pair<ULONGLONG, size_t> BlockPosition(ViewerDoc &doc, ULONGLONG from, const std::wstring &block, size_t pos)
+{
+    ULONGLONG line = LineAtByte(doc.index, doc.file.view, doc.file.size, from);
+    std::pair<ULONGLONG, size_t> at = PositionInBlock(block, pos, line, 0);
+    if (at.first == line)
+        at.second += CountUnits(doc, LineStartByte(doc.index, doc.file.view, doc.file.size, line), from);
+    return at;
+}
+
+static void SelectMatch(ViewerDoc &doc, std::pair<ULONGLONG, size_t> at, size_t length)
+{
+    doc.caretLine = at.first;
+    doc.caretCol = at.second;
+    doc.selLength = length;
+    InvalidateRect(g_hwndViewer, nullptr, FALSE);
+    EnsureCaretVisible(doc);
+    UpdateStatus();
+}
+
+// Blocks end VIEWER_FIND_BLOCK bytes on, where the decoder stops on a character boundary, and
+// the last pattern.size() - 1 units of each are searched again at the head of the next, so a
+// match split between blocks is still found. line and col follow the head of the block.
+static bool FindForward(ViewerDoc &doc, const std::wstring &pattern, ULONGLONG line, size_t col, ULONGLONG stop)
+{
+    const uint8_t *view = doc.file.view;
+    ULONGLONG size = doc.file.size;
+    ULONGLONG start = LineStartByte(doc.index, view, size, line);
+    if (start == LINE_NPOS)
+        return false;
+    // At least one unit is kept so a CRLF split between blocks still counts as one break
+    size_t overlap = (std::max)(pattern.size() - 1, static_cast<size_t>(1));
+    size_t from = col, headCol = 0;
+    std::wstring block, decoded;
+    while (start <= stop)
+    {
+        ULONGLONG end = (std::min)(start + VIEWER_FIND_BLOCK, size);
+        start += DecodeRange(doc, start, end, end == size, decoded);
+        block += decoded;
+        size_t pos = TEXT_NPOS;
+        if (from < block.size())
+            pos = FindNoCase(reinterpret_cast<const char16_t *>(block.c_str()), block.size(),
+                             reinterpret_cast<const char16_t *>(pattern.c_str()), pattern.size(), from);
+        if (pos != TEXT_NPOS)
+        {
+            SelectMatch(doc, PositionInBlock(block, pos, line, headCol), pattern.size());
+            return true;
+        }
+        if (end == size)
+            return false;
+        size_t keep = block.size() > overlap ? block.size() - overlap : 0;
+        if (keep && block[keep - 1] == L'\r' && block[keep] == L'\n')
+            --keep;
+        std::tie(line, headCol) = PositionInBlock(block, keep, line, headCol);
+        block.erase(0, keep);
+        from = from > keep ? from - keep : 0;
+    }
+    return false;
+}
+
+// Start of the block ending at end: VIEWER_FIND_BLOCK bytes back, moved on to the first line
+// start in the block's first half when there is one. In a longer line it is moved off UTF-8
+// continuation bytes and UTF-16 odd offsets; a DBCS code page has no way back to a boundary
+// there, so one character at the head of the block may decode wrongly.
+static ULONGLONG BackwardBlockStart(ViewerDoc &doc, ULONGLONG end, ULONGLONG dataStart)
+{
+    if (end - dataStart <= VIEWER_FIND_BLOCK)
+        return dataStart;
+    const uint8_t *view = doc.file.view;
+    ULONGLONG size = doc.file.size;
+    ULONGLONG from = end - VIEWER_FIND_BLOCK;
+    bool wide = doc.encoding == Encoding::UTF16LE || doc.encoding == Encoding::UTF16BE;
+    if (wide && ((from - dataStart) & 1))
+        ++from;
+    ULONGLONG lineEnd = LineEndByte(doc.encoding, view, size, from, from + VIEWER_FIND_BLOCK / 2);
+    if (lineEnd != LINE_NPOS)
+    {
+        ULONGLONG next = SkipLineBreak(doc.encoding, view, size, lineEnd);
+        if (next < end)
+            return next;
+    }
+    if (doc.encoding == Encoding::UTF8)
+        for (int i = 0; i < 3 && (view[from] & 0xC0) == 0x80; ++i)
+            ++from;
+    return from;
+}
+
+// Walks blocks back from end until the block holding stop. Matches start before end; tail
+// holds the units right after it, which such a match may run into.
+static bool FindBackward(ViewerDoc &doc, const std::wstring &pattern, ULONGLONG end, std::wstring tail, ULONGLONG stop)
+{
+    ULONGLONG dataStart = doc.index.checkpoints.front();
+    std::wstring block;
+    for (;;)
+    {
+        ULONGLONG from = BackwardBlockStart(doc, end, dataStart);
+        DecodeRange(doc, from, end, true, block);
+        size_t head = block.size();
+        block += tail;
+        size_t pos = TEXT_NPOS;
+        if (head)
+            pos = FindNoCaseBackward(reinterpret_cast<const char16_t *>(block.c_str()), block.size(),
+                                     reinterpret_cast<const char16_t *>(pattern.c_str()), pattern.size(), head - 1);
+        if (pos != TEXT_NPOS)
+        {
+            SelectMatch(doc, BlockPosition(doc, from, block, pos), pattern.size());
+            return true;
+        }
+        if (from <= stop || from == dataStart)
+            return false;
+        tail = block.substr(0, (std::min)(pattern.size() - 1, block.size()));
+        end = from;
+    }
+}
+
+bool ViewerFind(const std::wstring &pattern, bool forward)
+{
+    if (!g_viewer || pattern.empty())
+        return false;
+    ViewerDoc &doc = *g_viewer;
+    const uint8_t *view = doc.file.view;
+    ULONGLONG size = doc.file.size;
+    ULONGLONG caretStart = LineStartByte(doc.index, view, size, doc.caretLine);
+    if (caretStart == LINE_NPOS)
+        return false;
+    if (forward)
+        return FindForward(doc, pattern, doc.caretLine, doc.caretCol + doc.selLength, size) ||
+               FindForward(doc, pattern, 0, 0, caretStart);
+    ULONGLONG caret = ColumnByte(doc, caretStart, doc.caretCol);
+    std::wstring tail;
+    if (pattern.size() > 1)
+    {
+        ULONGLONG end = (std::min)(caret + (pattern.size() - 1) * 4, size);
+        DecodeRange(doc, caret, end, end == size, tail);
+        tail.resize((std::min)(tail.size(), pattern.size() - 1));
+    }
+    return FindBackward(doc, pattern, caret, tail, doc.index.checkpoints.front()) ||
+           FindBackward(doc, pattern, size, std::wstring(), caret);
+}
+
+void ViewerGotoLine(ULONGLONG line)
+{
+    if (!g_viewer || line == 0)
+        return;
+    ViewerDoc &doc = *g_viewer;
+    ULONGLONG target = line - 1;
+    if (LineStartByte(doc.index, doc.file.view, doc.file.size, target) == LINE_NPOS)
+        target = doc.index.lineCount - 1;
+    if (target >= doc.index.lineCount)
+        doc.index.lineCount = target + 1;
+    MoveCaret(doc, target, 0);
+    ScrollToLine(doc, target);
+    SetFocus(g_hwndViewer);
+}
@@ -0,0 +1,30 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Read-only viewer for files above the size threshold, bypassing RichEdit.
+  Paints only the visible lines of a mapped file through a sparse line index.
+*/
+
+#pragma once
+#include <windows.h>
+#include <string>
+#include <utility>
+
+void LoadViewerSettings();
+void OpenViewer(const std::wstring &path);
+void CloseViewer();
+bool IsViewerActive();
+bool IsViewerIndexing();
+int GetViewerIndexProgress();
+std::pair<ULONGLONG, ULONGLONG> GetViewerCursorPos();
+bool ViewerFind(const std::wstring &pattern, bool forward);
+void ViewerGotoLine(ULONGLONG line);
+void OnViewerIndexChunk(LPARAM lParam);
@@ -55,6 +55,7 @@
 #define IDM_VIEW_DARKMODE 40044
 #define IDM_VIEW_TRANSPARENCY 40045
 #define IDM_VIEW_ALWAYSONTOP 40046
+#define IDM_VIEW_FOLLOW 40047
 
 #define IDM_VIEW_BG_SELECT 40050
 #define IDM_VIEW_BG_CLEAR 40051
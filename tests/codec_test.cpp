@@ -0,0 +1,194 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for textcodec: EncodeChunk against a reference encoder and DecodeChunk back to the
+  text, both with the input cut in two at every position, and the UTF-16 kernels at every
+  SIMD level.
+*/
+
+#include "test.h"
+#include "core/textcodec.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void PutReferenceUnit(std::string &out, Encoding encoding, uint32_t unit)
+{
+    char lo = static_cast<char>(unit & 0xFF), hi = static_cast<char>(unit >> 8);
+    if (encoding == Encoding::UTF16BE)
+        out += {hi, lo};
+    else
+        out += {lo, hi};
+}
+
+static void PutReferenceUtf8(std::string &out, uint32_t cp)
+{
+    if (cp < 0x80)
+        out += static_cast<char>(cp);
+    else if (cp < 0x800)
+        out += {static_cast<char>(0xC0 | cp >> 6), static_cast<char>(0x80 | (cp & 0x3F))};
+    else if (cp < 0x10000)
+        out += {static_cast<char>(0xE0 | cp >> 12), static_cast<char>(0x80 | ((cp >> 6) & 0x3F)), static_cast<char>(0x80 | (cp & 0x3F))};
+    else
+        out += {static_cast<char>(0xF0 | cp >> 18), static_cast<char>(0x80 | ((cp >> 12) & 0x3F)), static_cast<char>(0x80 | ((cp >> 6) & 0x3F)),
+                static_cast<char>(0x80 | (cp & 0x3F))};
+}
+
+// The text with every CRLF, CR or LF written as le.
+static std::u16string NormalizeBreaks(const std::u16string &text, LineEnding le)
+{
+    std::u16string out;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char16_t c = text[i];
+        if (c != u'\r' && c != u'\n')
+        {
+            out += c;
+            continue;
+        }
+        if (c == u'\r' && i + 1 < text.size() && text[i + 1] == u'\n')
+            ++i;
+        out += le == LineEnding::CRLF ? u"\r\n" : le == LineEnding::LF ? u"\n" : u"\r";
+    }
+    return out;
+}
+
+static std::string ReferenceEncode(const std::u16string &text, Encoding encoding, LineEnding le)
+{
+    std::u16string units = NormalizeBreaks(text, le);
+    std::string out;
+    for (size_t i = 0; i < units.size(); ++i)
+    {
+        uint32_t cp = units[i];
+        if (encoding == Encoding::UTF16LE || encoding == Encoding::UTF16BE)
+        {
+            PutReferenceUnit(out, encoding, cp);
+            continue;
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF)
+        {
+            if (cp <= 0xDBFF && i + 1 < units.size() && units[i + 1] >= 0xDC00 && units[i + 1] <= 0xDFFF)
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (units[++i] - 0xDC00);
+            else
+                cp = 0xFFFD;
+        }
+        PutReferenceUtf8(out, cp);
+    }
+    return out;
+}
+
+// Encodes text[0, split) without final, then what it left plus the rest with final.
+static std::string EncodeSplit(const std::u16string &text, Encoding encoding, LineEnding le, size_t split)
+{
+    std::vector<uint8_t> buffer(MaxEncodedLength(encoding, text.size()) + 1);
+    EncodeResult first = EncodeChunk(encoding, le, text.data(), split, buffer.data(), false);
+    CHECK(first.consumed <= split && split - first.consumed <= 1);
+    CHECK(first.written <= MaxEncodedLength(encoding, split));
+    std::string out(reinterpret_cast<const char *>(buffer.data()), first.written);
+    EncodeResult rest = EncodeChunk(encoding, le, text.data() + first.consumed, text.size() - first.consumed, buffer.data(), true);
+    CHECK(rest.consumed == text.size() - first.consumed);
+    out.append(reinterpret_cast<const char *>(buffer.data()), rest.written);
+    return out;
+}
+
+static std::u16string DecodeSplit(const std::string &bytes, Encoding encoding, size_t split, bool &invalid)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(bytes.data());
+    std::vector<char16_t> buffer(MaxDecodedLength(bytes.size()) + 1);
+    DecodeResult first = DecodeChunk(encoding, data, split, buffer.data(), false);
+    CHECK(first.consumed <= split && split - first.consumed <= 3);
+    std::u16string out(buffer.data(), first.written);
+    DecodeResult rest = DecodeChunk(encoding, data + first.consumed, bytes.size() - first.consumed, buffer.data(), true);
+    CHECK(rest.consumed == bytes.size() - first.consumed);
+    out.append(buffer.data(), rest.written);
+    invalid = first.invalid || rest.invalid;
+    return out;
+}
+
+// Valid UTF-16 with line breaks of every kind and surrogate pairs that a split can cut.
+static std::u16string RandomText(TestRandom &rng, size_t length)
+{
+    static const char16_t *pieces[] = {u"a", u"\r", u"\n", u"\r\n", u"é", u"あ", u"\U0001F600", u"z\t"};
+    std::u16string text;
+    while (text.size() < length)
+        text += pieces[rng.Below(sizeof(pieces) / sizeof(pieces[0]))];
+    return text;
+}
+
+static void TestRoundTrip(TestRandom &rng)
+{
+    static const Encoding encodings[] = {Encoding::UTF8, Encoding::UTF8BOM, Encoding::UTF16LE, Encoding::UTF16BE};
+    static const LineEnding endings[] = {LineEnding::CRLF, LineEnding::LF, LineEnding::CR};
+    for (int iteration = 0; iteration < 300; ++iteration)
+    {
+        std::u16string text = RandomText(rng, rng.Below(40));
+        for (Encoding encoding : encodings)
+        {
+            for (LineEnding le : endings)
+            {
+                std::string expected = ReferenceEncode(text, encoding, le);
+                std::u16string decoded = NormalizeBreaks(text, le);
+                for (size_t split = 0; split <= text.size(); ++split)
+                    CHECK(EncodeSplit(text, encoding, le, split) == expected);
+                for (size_t split = 0; split <= expected.size(); ++split)
+                {
+                    bool invalid = false;
+                    CHECK(DecodeSplit(expected, encoding, split, invalid) == decoded);
+                    CHECK(!invalid);
+                }
+            }
+        }
+    }
+    // A lone surrogate has no UTF-8 form; it is written as U+FFFD
+    std::u16string lone = u"a";
+    lone += static_cast<char16_t>(0xD800);
+    lone += u"b";
+    lone += static_cast<char16_t>(0xDC00);
+    CHECK(EncodeSplit(lone, Encoding::UTF8, LineEnding::CRLF, 2) == "a\xEF\xBF\xBD" "b\xEF\xBF\xBD");
+}
+
+static void TestUtf16Kernels(TestRandom &rng)
+{
+    for (int iteration = 0; iteration < 2000; ++iteration)
+    {
+        size_t units = rng.Below(200), offset = rng.Below(3);
+        std::vector<uint8_t> source(units * 2 + offset);
+        for (uint8_t &b : source)
+            b = rng.Below(4) ? static_cast<uint8_t>(rng.Next()) : '\n';
+        std::vector<char16_t> text(units + 1);
+        for (size_t k = 0; k < units; ++k)
+            text[k] = static_cast<char16_t>(source[offset + 2 * k] | source[offset + 2 * k + 1] << 8);
+        size_t lineBreak = 0;
+        while (lineBreak < units && text[lineBreak] != u'\r' && text[lineBreak] != u'\n')
+            ++lineBreak;
+        for (SimdLevel level : kSimdLevels)
+        {
+            ForceSimdLevel(level);
+            for (bool swap : {false, true})
+            {
+                std::vector<uint8_t> copy(units * 2 + offset + 1, 0);
+                CopyUtf16Units(source.data() + offset, copy.data() + 1, units, swap);
+                bool same = true;
+                for (size_t k = 0; k < units * 2; ++k)
+                    same = same && copy[1 + k] == source[offset + (swap ? k ^ 1 : k)];
+                CHECK(same);
+            }
+            CHECK(FindLineBreak(text.data(), units) == lineBreak);
+        }
+    }
+}
+
+void RunCodecTests()
+{
+    TestRandom rng(11);
+    TestRoundTrip(rng);
+    TestUtf16Kernels(rng);
+}
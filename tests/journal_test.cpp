@@ -0,0 +1,259 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for the edit journal's records: each kind written and read back, torn and corrupt
+  records ending the read, and random edits replayed onto a piece table the way recovery
+  does, from whole journals and from ones cut short anywhere.
+*/
+
+#include "test.h"
+#include "core/editjournal.h"
+#include "core/piecetable.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// The record checksum, written out again here so a change to the format shows up as a failure.
+static uint32_t Checksum(const uint8_t *p, size_t size)
+{
+    uint64_t h = 1469598103934665603ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t w = 0;
+        for (int b = 0; b < 8; ++b)
+            w |= static_cast<uint64_t>(p[i + b]) << (8 * b);
+        h = (h ^ w) * 1099511628211ull;
+    }
+    for (; i < size; ++i)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+static void PutU32(uint8_t *o, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        o[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+// Rewrites the size and checksum of the one record in bytes after its payload was changed.
+static void Reseal(std::vector<uint8_t> &bytes)
+{
+    size_t payload = bytes.size() - JOURNAL_RECORD_HEADER;
+    PutU32(bytes.data(), static_cast<uint32_t>(payload));
+    PutU32(bytes.data() + 4, Checksum(bytes.data() + JOURNAL_RECORD_HEADER, payload));
+}
+
+static size_t Read(const std::vector<uint8_t> &bytes, JournalRecord &record)
+{
+    return ReadJournalRecord(bytes.data(), bytes.size(), record);
+}
+
+static std::u16string RandomText(TestRandom &rng, size_t length)
+{
+    std::u16string text;
+    for (size_t i = 0; i < length; ++i)
+        text += u"ab \r\n\x00e9\xd800\x0000"[rng.Below(8)];
+    return text;
+}
+
+static void TestRoundTrip()
+{
+    std::vector<uint8_t> bytes;
+    JournalRecord record;
+    CHECK(!CheckJournalHeader(bytes.data(), 0));
+    AppendJournalHeader(bytes);
+    CHECK(bytes.size() == JOURNAL_HEADER_SIZE && CheckJournalHeader(bytes.data(), bytes.size()));
+    CHECK(!CheckJournalHeader(bytes.data(), bytes.size() - 1));
+    bytes[0] ^= 1;
+    CHECK(!CheckJournalHeader(bytes.data(), bytes.size()));
+
+    std::u16string path = u"C:\\Logs\\\x00e9t\x00e9.txt";
+    bytes.clear();
+    AppendJournalDocument(bytes, path.data(), path.size(), Encoding::UTF16BE, LineEnding::LF, 1ull << 40, 0x01D9ABCDEF012345ull);
+    CHECK(Read(bytes, record) == bytes.size());
+    CHECK(record.type == JournalRecordType::Document && record.text == path && record.encoding == Encoding::UTF16BE &&
+          record.lineEnding == LineEnding::LF && record.fileSize == 1ull << 40 && record.fileTime == 0x01D9ABCDEF012345ull);
+
+    std::u16string text = u"one\rtwo\x0000\xdc00";
+    for (const std::u16string &snapshot : {std::u16string(), text})
+    {
+        bytes.clear();
+        AppendJournalSnapshot(bytes, snapshot.data(), snapshot.size());
+        CHECK(Read(bytes, record) == bytes.size() && record.type == JournalRecordType::Snapshot && record.text == snapshot);
+    }
+
+    bytes.clear();
+    AppendJournalEdit(bytes, 0x123456789Aull, 7, text.data(), text.size());
+    AppendJournalEdit(bytes, 3, 0, nullptr, 0);
+    size_t first = Read(bytes, record);
+    CHECK(first > 0 && record.type == JournalRecordType::Edit && record.offset == 0x123456789Aull && record.removed == 7 &&
+          record.text == text);
+    CHECK(ReadJournalRecord(bytes.data() + first, bytes.size() - first, record) == bytes.size() - first);
+    CHECK(record.type == JournalRecordType::Edit && record.offset == 3 && record.removed == 0 && record.text.empty());
+}
+
+// Each of these ends the read with 0. The resealed ones carry a valid checksum, so it is the
+// check after it that turns them down.
+static void TestCorrupt()
+{
+    std::u16string text = u"hello";
+    std::vector<uint8_t> edit;
+    JournalRecord record;
+    AppendJournalEdit(edit, 2, 1, text.data(), text.size());
+
+    // A record cut anywhere, as a crash mid-write leaves it
+    for (size_t size = 0; size < edit.size(); ++size)
+        CHECK(ReadJournalRecord(edit.data(), size, record) == 0);
+
+    // Any flipped byte of the checksum or the payload
+    for (size_t i = 4; i < edit.size(); ++i)
+    {
+        std::vector<uint8_t> bytes = edit;
+        bytes[i] ^= 0x10;
+        CHECK(Read(bytes, record) == 0);
+    }
+
+    // A size past the data, and no payload at all
+    std::vector<uint8_t> bytes = edit;
+    PutU32(bytes.data(), static_cast<uint32_t>(bytes.size()));
+    CHECK(Read(bytes, record) == 0);
+    bytes.assign(JOURNAL_RECORD_HEADER + 1, 0);
+    PutU32(bytes.data(), 0);
+    PutU32(bytes.data() + 4, Checksum(bytes.data() + JOURNAL_RECORD_HEADER, 0));
+    CHECK(Read(bytes, record) == 0);
+
+    // Resealing an untouched record keeps it readable
+    bytes = edit;
+    Reseal(bytes);
+    CHECK(Read(bytes, record) == bytes.size());
+
+    // Half a unit of text, and fixed fields cut short
+    bytes = edit;
+    bytes.pop_back();
+    Reseal(bytes);
+    CHECK(Read(bytes, record) == 0);
+    bytes.resize(JOURNAL_RECORD_HEADER + 1 + 15);
+    Reseal(bytes);
+    CHECK(Read(bytes, record) == 0);
+
+    // Types that are not records
+    for (uint8_t type : {0, 4, 0xFF})
+    {
+        bytes = edit;
+        bytes[JOURNAL_RECORD_HEADER] = type;
+        Reseal(bytes);
+        CHECK(Read(bytes, record) == 0);
+    }
+
+    // Encoding and line ending bytes past the last value
+    std::vector<uint8_t> document;
+    AppendJournalDocument(document, text.data(), text.size(), Encoding::ANSI, LineEnding::CR, 1, 2);
+    CHECK(Read(document, record) == document.size());
+    for (size_t field = 0; field < 2; ++field)
+    {
+        bytes = document;
+        ++bytes[JOURNAL_RECORD_HEADER + 1 + field];
+        Reseal(bytes);
+        CHECK(Read(bytes, record) == 0);
+    }
+}
+
+// Reads records from the start of journal and applies them as RecoverJournal does: a snapshot
+// replaces the text and the edits after it are made on a piece table.
+static std::u16string Replay(const std::vector<uint8_t> &journal, size_t size)
+{
+    std::u16string base;
+    std::vector<JournalRecord> edits;
+    JournalRecord record;
+    for (size_t pos = JOURNAL_HEADER_SIZE; CheckJournalHeader(journal.data(), size) && pos < size;)
+    {
+        size_t n = ReadJournalRecord(journal.data() + pos, size - pos, record);
+        if (!n)
+            break;
+        pos += n;
+        if (record.type == JournalRecordType::Snapshot)
+        {
+            base = record.text;
+            edits.clear();
+        }
+        else if (record.type == JournalRecordType::Edit)
+            edits.push_back(record);
+    }
+    PieceTable table;
+    AppendPieceBuffer(table, std::move(base));
+    for (const JournalRecord &edit : edits)
+    {
+        if (edit.offset > table.length || edit.removed > table.length - edit.offset)
+            break;
+        ReplacePieces(table, static_cast<size_t>(edit.offset), static_cast<size_t>(edit.removed), edit.text.data(), edit.text.size());
+    }
+    std::u16string text(table.length, u'\0');
+    CopyPieces(table, 0, table.length, &text[0]);
+    return text;
+}
+
+// ends[k] is where record k ends and texts[k] the text once it is applied, so a journal cut
+// anywhere replays to the text of the last whole record before the cut.
+static void TestReplay(TestRandom &rng)
+{
+    for (int round = 0; round < 100; ++round)
+    {
+        std::vector<uint8_t> journal;
+        std::vector<size_t> ends;
+        std::vector<std::u16string> texts;
+        AppendJournalHeader(journal);
+        std::u16string path = u"a.txt";
+        AppendJournalDocument(journal, path.data(), path.size(), Encoding::UTF8, LineEnding::CRLF, 10, 20);
+        ends.push_back(journal.size());
+        texts.push_back(std::u16string());
+        std::u16string text = RandomText(rng, rng.Below(500));
+        AppendJournalSnapshot(journal, text.data(), text.size());
+        ends.push_back(journal.size());
+        texts.push_back(text);
+        for (int op = 0; op < 200; ++op)
+        {
+            if (rng.Below(50) == 0)
+            {
+                text = RandomText(rng, rng.Below(100));
+                AppendJournalSnapshot(journal, text.data(), text.size());
+            }
+            else
+            {
+                size_t offset = rng.Below(text.size() + 1);
+                size_t removed = rng.Below((std::min)(text.size() - offset, static_cast<size_t>(8)) + 1);
+                std::u16string inserted = RandomText(rng, rng.Below(6));
+                text.replace(offset, removed, inserted);
+                AppendJournalEdit(journal, offset, removed, inserted.data(), inserted.size());
+            }
+            ends.push_back(journal.size());
+            texts.push_back(text);
+        }
+        if (!CHECK(Replay(journal, journal.size()) == text))
+            break;
+        for (int cut = 0; cut < 10; ++cut)
+        {
+            size_t size = JOURNAL_HEADER_SIZE + rng.Below(journal.size() - JOURNAL_HEADER_SIZE);
+            size_t k = 0;
+            while (k + 1 < ends.size() && ends[k + 1] <= size)
+                ++k;
+            CHECK(Replay(journal, size) == texts[k]);
+        }
+    }
+}
+
+void RunJournalTests()
+{
+    TestRandom rng(43);
+    TestRoundTrip();
+    TestCorrupt();
+    TestReplay(rng);
+}
@@ -0,0 +1,281 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for the viewer's line index: files built slice by slice, with CRs and LFs falling on
+  slice ends, against a plain split of the whole file, in every encoding and with long lines
+  that get marks; and LineEndByte with and without a limit.
+*/
+
+#include "test.h"
+#include "core/lineindex.h"
+#include <algorithm>
+#include <vector>
+
+// Start of every line and the offset of the break ending it, or the size for the last one.
+struct PlainLines
+{
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> ends;
+};
+
+static uint64_t UnitBytes(Encoding encoding)
+{
+    return encoding == Encoding::UTF16LE || encoding == Encoding::UTF16BE ? 2 : 1;
+}
+
+static uint64_t DataStart(Encoding encoding)
+{
+    switch (encoding)
+    {
+    case Encoding::UTF8BOM:
+        return 3;
+    case Encoding::UTF16LE:
+    case Encoding::UTF16BE:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static uint32_t UnitOf(Encoding encoding, const std::vector<uint8_t> &file, uint64_t p)
+{
+    if (encoding == Encoding::UTF16LE)
+        return file[p] | static_cast<uint32_t>(file[p + 1]) << 8;
+    if (encoding == Encoding::UTF16BE)
+        return static_cast<uint32_t>(file[p]) << 8 | file[p + 1];
+    return file[p];
+}
+
+static void PutUnit(Encoding encoding, std::vector<uint8_t> &file, uint32_t unit)
+{
+    if (encoding == Encoding::UTF16LE)
+    {
+        file.push_back(static_cast<uint8_t>(unit));
+        file.push_back(static_cast<uint8_t>(unit >> 8));
+    }
+    else if (encoding == Encoding::UTF16BE)
+    {
+        file.push_back(static_cast<uint8_t>(unit >> 8));
+        file.push_back(static_cast<uint8_t>(unit));
+    }
+    else
+        file.push_back(static_cast<uint8_t>(unit));
+}
+
+// A file holding just the BOM for the encoding; the units go after it.
+static std::vector<uint8_t> EmptyFile(Encoding encoding)
+{
+    switch (encoding)
+    {
+    case Encoding::UTF8BOM:
+        return {0xEF, 0xBB, 0xBF};
+    case Encoding::UTF16LE:
+        return {0xFF, 0xFE};
+    case Encoding::UTF16BE:
+        return {0xFE, 0xFF};
+    default:
+        return {};
+    }
+}
+
+static PlainLines SplitPlain(Encoding encoding, const std::vector<uint8_t> &file)
+{
+    uint64_t w = UnitBytes(encoding), size = file.size();
+    PlainLines lines;
+    lines.starts.push_back(DataStart(encoding));
+    for (uint64_t p = DataStart(encoding); p + w <= size; p += w)
+    {
+        uint32_t u = UnitOf(encoding, file, p);
+        if (u != '\r' && u != '\n')
+            continue;
+        lines.ends.push_back(p);
+        if (u == '\r' && p + 2 * w <= size && UnitOf(encoding, file, p + w) == '\n')
+            p += w;
+        lines.starts.push_back(p + w);
+    }
+    lines.ends.push_back(size);
+    return lines;
+}
+
+// Indexes the file in slices of up to maxUnits units, as the viewer's index thread does.
+static LineIndex BuildIndex(TestRandom &rng, Encoding encoding, const std::vector<uint8_t> &file, size_t maxUnits)
+{
+    uint64_t w = UnitBytes(encoding), size = file.size();
+    LineIndex index;
+    InitLineIndex(index, encoding, DataStart(encoding));
+    for (uint64_t end = DataStart(encoding); end < size;)
+    {
+        end = (std::min)(end + w * (1 + rng.Below(maxUnits)), size);
+        ExtendLineIndex(index, file.data(), end);
+    }
+    FinishLineIndex(index);
+    return index;
+}
+
+// Looks up line i both ways, and its end with a random limit.
+static bool CheckLine(TestRandom &rng, const LineIndex &index, const std::vector<uint8_t> &file, const PlainLines &lines, size_t i)
+{
+    const uint8_t *data = file.data();
+    uint64_t w = UnitBytes(index.encoding), size = file.size();
+    uint64_t start = lines.starts[i], end = lines.ends[i];
+    if (!CHECK(LineStartByte(index, data, size, i) == start) || !CHECK(LineAtByte(index, data, size, start) == i) ||
+        !CHECK(LineAtByte(index, data, size, end) == i) || !CHECK(LineEndByte(index.encoding, data, size, start, size) == end))
+        return false;
+    // The LF of a CRLF is still on the line the CR ends
+    if (i + 1 < lines.starts.size() && end + w < lines.starts[i + 1] && !CHECK(LineAtByte(index, data, size, end + w) == i))
+        return false;
+    uint64_t limit = start + w * rng.Below((end - start) / w + 3);
+    uint64_t to = (std::min)(limit, size);
+    uint64_t expected = end < size && end + w <= to ? end : to == size ? size : LINE_NPOS;
+    return CHECK(LineEndByte(index.encoding, data, size, start, limit) == expected);
+}
+
+// Checks the counts and every step-th line, and the last.
+static bool CheckLines(TestRandom &rng, const LineIndex &index, const std::vector<uint8_t> &file, const PlainLines &lines, size_t step)
+{
+    size_t count = lines.starts.size();
+    if (!CHECK(index.complete && index.lineCount == count) ||
+        !CHECK(LineStartByte(index, file.data(), file.size(), count) == LINE_NPOS) ||
+        !CHECK(index.checkpoints.size() == (count - 1) / LINE_INDEX_STRIDE + 1))
+        return false;
+    for (size_t i = 0; i < count; i += step)
+        if (!CheckLine(rng, index, file, lines, i))
+            return false;
+    return CheckLine(rng, index, file, lines, count - 1);
+}
+
+// Every unit offset of a small file, including the BOM and the end.
+static bool CheckOffsets(const LineIndex &index, const std::vector<uint8_t> &file, const PlainLines &lines)
+{
+    uint64_t w = UnitBytes(index.encoding);
+    for (uint64_t offset = 0; offset <= file.size(); offset += offset < DataStart(index.encoding) ? 1 : w)
+    {
+        size_t expected = std::upper_bound(lines.starts.begin(), lines.starts.end(), offset) - lines.starts.begin();
+        if (!CHECK(LineAtByte(index, file.data(), file.size(), offset) == (expected ? expected - 1 : 0)))
+            return false;
+    }
+    return true;
+}
+
+static const Encoding kEncodings[] = {Encoding::UTF8, Encoding::UTF8BOM, Encoding::UTF16LE, Encoding::UTF16BE, Encoding::ANSI};
+
+// Short lines of every break kind, sliced a few units at a time so CRs often end a slice with
+// their LF in the next. UTF-16 units holding a CR or LF byte are not breaks; in UTF-8 a run of
+// plain bytes now and then takes the eight-at-a-time skip.
+static void TestSlices(TestRandom &rng)
+{
+    static const uint32_t narrow[] = {'a', ' ', '\r', '\n', 0xC3, 0xA9, 0x0B, 0x0E};
+    static const uint32_t wide[] = {'a', ' ', '\r', '\n', 0x0D0A, 0x0A0D, 0x0D00, 0x000A};
+    for (int round = 0; round < 300; ++round)
+    {
+        Encoding encoding = kEncodings[round % 5];
+        bool isWide = UnitBytes(encoding) == 2;
+        std::vector<uint8_t> file = EmptyFile(encoding);
+        size_t units = rng.Below(round % 10 == 0 ? 4 : 1500);
+        for (size_t i = 0; i < units; ++i)
+        {
+            if (rng.Below(40) == 0)
+            {
+                for (size_t run = 8 + rng.Below(60); run > 0; --run)
+                    PutUnit(encoding, file, 'x');
+            }
+            PutUnit(encoding, file, isWide ? wide[rng.Below(8)] : narrow[rng.Below(8)]);
+        }
+        LineIndex index = BuildIndex(rng, encoding, file, round % 3 == 0 ? 2 : 16);
+        PlainLines lines = SplitPlain(encoding, file);
+        if (!CheckLines(rng, index, file, lines, 1) || !CheckOffsets(index, file, lines))
+            break;
+    }
+}
+
+// Line counts on and either side of a checkpoint, with and without a break at the very end.
+static void TestStride(TestRandom &rng)
+{
+    static const char *breaks[] = {"\n", "\r\n", "\r"};
+    for (uint64_t count : {1u, 1023u, 1024u, 1025u, 2048u, 2049u, 3071u})
+    {
+        for (int kind = 0; kind < 3; ++kind)
+        {
+            Encoding encoding = kEncodings[(count + kind) % 5];
+            std::vector<uint8_t> file = EmptyFile(encoding);
+            bool trailing = count % 2 == 0;
+            for (uint64_t line = 0; line < count; ++line)
+            {
+                if (!trailing || line + 1 < count)
+                    PutUnit(encoding, file, 'a' + line % 26);
+                if (line + 1 < count)
+                    for (const char *b = breaks[kind]; *b; ++b)
+                        PutUnit(encoding, file, *b);
+            }
+            LineIndex index = BuildIndex(rng, encoding, file, 300);
+            PlainLines lines = SplitPlain(encoding, file);
+            CHECK(lines.starts.size() == count);
+            CheckLines(rng, index, file, lines, 1);
+        }
+    }
+}
+
+// Lines longer than LINE_INDEX_MARK_BYTES between runs of short ones: the line after each
+// long one is marked unless it is a checkpoint, and lookups start from the marks.
+static void TestLongLines(TestRandom &rng)
+{
+    for (Encoding encoding : {Encoding::UTF8, Encoding::UTF16BE})
+    {
+        uint64_t w = UnitBytes(encoding);
+        std::vector<uint8_t> file = EmptyFile(encoding);
+        for (int run = 0; run < 4; ++run)
+        {
+            for (size_t line = 300 + rng.Below(900); line > 0; --line)
+            {
+                PutUnit(encoding, file, 'a');
+                PutUnit(encoding, file, line % 3 ? '\n' : '\r');
+            }
+            for (uint64_t unit = (LINE_INDEX_MARK_BYTES + rng.Below(LINE_INDEX_MARK_BYTES)) / w; unit > 0; --unit)
+                PutUnit(encoding, file, 'x');
+            PutUnit(encoding, file, '\r');
+            PutUnit(encoding, file, '\n');
+        }
+        LineIndex index = BuildIndex(rng, encoding, file, 100000);
+        PlainLines lines = SplitPlain(encoding, file);
+        CheckLines(rng, index, file, lines, 7);
+        size_t longLines = 0;
+        for (size_t i = 0; i + 1 < lines.starts.size(); ++i)
+        {
+            if (lines.ends[i] - lines.starts[i] < LINE_INDEX_MARK_BYTES || (i + 1) % LINE_INDEX_STRIDE == 0)
+                continue;
+            ++longLines;
+            auto mark = std::find_if(index.marks.begin(), index.marks.end(), [&](const LineMark &m) { return m.line == i + 1; });
+            CHECK(mark != index.marks.end() && mark->start == lines.starts[i + 1]);
+        }
+        CHECK(longLines > 0);
+        for (const LineMark &mark : index.marks)
+            CHECK(mark.line % LINE_INDEX_STRIDE != 0 && mark.start == lines.starts[mark.line]);
+
+        // A limit inside the long line stops the search there
+        for (size_t i = 0; i + 1 < lines.starts.size(); ++i)
+        {
+            if (lines.ends[i] - lines.starts[i] < LINE_INDEX_MARK_BYTES)
+                continue;
+            uint64_t start = lines.starts[i], end = lines.ends[i];
+            CHECK(LineEndByte(encoding, file.data(), file.size(), start, end) == LINE_NPOS);
+            CHECK(LineEndByte(encoding, file.data(), file.size(), start, end + w) == end);
+            CHECK(LineAtByte(index, file.data(), file.size(), end - w) == i);
+        }
+    }
+}
+
+void RunLineIndexTests()
+{
+    TestRandom rng(41);
+    TestSlices(rng);
+    TestStride(rng);
+    TestLongLines(rng);
+}
@@ -0,0 +1,91 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Test harness entry point for the portable notepad_core library.
+  Usage: notepad_core_tests [suite]. Exits with 1 when any check fails.
+*/
+
+#include "test.h"
+#include <cstdio>
+#include <cstring>
+
+static int g_failures = 0;
+
+bool Check(bool ok, const char *expr, const char *file, int line)
+{
+    if (ok)
+        return true;
+    if (g_failures < TEST_PRINT_MAX)
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    ++g_failures;
+    return false;
+}
+
+int FailureCount()
+{
+    return g_failures;
+}
+
+uint32_t TestRandom::Next()
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 8;
+}
+
+size_t TestRandom::Below(size_t bound)
+{
+    return Next() % bound;
+}
+
+const SimdLevel kSimdLevels[4] = {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::SSSE3, SimdLevel::AVX2};
+
+struct TestSuite
+{
+    const char *name;
+    void (*run)();
+};
+
+static const TestSuite kSuites[] = {
+    {"scan", RunScanTests},
+    {"codec", RunCodecTests},
+    {"utf8", RunUtf8Tests},
+    {"piece", RunPieceTests},
+    {"undo", RunUndoTests},
+    {"regex", RunRegexTests},
+    {"replace", RunReplaceTests},
+    {"workpool", RunWorkPoolTests},
+    {"matchset", RunMatchSetTests},
+    {"lineindex", RunLineIndexTests},
+    {"journal", RunJournalTests},
+};
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : nullptr;
+    bool ran = false;
+    for (const TestSuite &suite : kSuites)
+    {
+        if (filter && strcmp(filter, suite.name) != 0)
+            continue;
+        int before = FailureCount();
+        suite.run();
+        // Suites switch the SIMD level; the next one starts from the best again
+        ForceSimdLevel(SimdLevel::AVX2);
+        printf("%-8s %s\n", suite.name, FailureCount() == before ? "ok" : "FAILED");
+        ran = true;
+    }
+    if (!ran)
+    {
+        fprintf(stderr, "unknown suite: %s\n", filter);
+        return 2;
+    }
+    return FailureCount() ? 1 : 0;
+}
@@ -0,0 +1,191 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for the Find All match set: random edits kept up with EditMatches from the settled
+  offset the editor uses, against searching the whole chain again, for literals and regexes,
+  and the index lookups over many blocks.
+*/
+
+#include "test.h"
+#include "core/matchset.h"
+#include "core/piecetable.h"
+#include "core/textregex.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static std::vector<TextSpan> FindChain(const MatchFinder &find)
+{
+    std::vector<TextSpan> chain;
+    TextSpan match;
+    for (size_t from = 0; find(from, match); from = NextMatchFrom(match))
+        chain.push_back(match);
+    return chain;
+}
+
+// Blocks hold at most MATCH_BLOCK_MAX matches, none empty, and firsts counts what is before.
+static bool SameMatches(const MatchSet &set, const std::vector<TextSpan> &chain)
+{
+    size_t count = 0;
+    for (size_t b = 0; b < set.blocks.size(); ++b)
+    {
+        const MatchBlock &block = set.blocks[b];
+        if (block.starts.empty() || block.starts.size() > MATCH_BLOCK_MAX || block.lengths.size() != block.starts.size() ||
+            set.firsts[b] != count)
+            return false;
+        count += block.starts.size();
+    }
+    if (count != set.count || count != chain.size())
+        return false;
+    for (size_t i = 0; i < chain.size(); ++i)
+    {
+        TextSpan match = MatchAt(set, i);
+        if (match.start != chain[i].start || match.length != chain[i].length)
+            return false;
+    }
+    return true;
+}
+
+static std::u16string RandomText(TestRandom &rng, size_t length)
+{
+    std::u16string text;
+    for (size_t i = 0; i < length; ++i)
+        text += u"aabx \r"[rng.Below(6)];
+    return text;
+}
+
+// Documents long enough for several blocks get many small edits, short ones a few that now
+// and then cut the rest of the text away.
+static void TestEdits(TestRandom &rng)
+{
+    static const char *patterns[] = {"ab", "aa", "a", "b\\w*", "^a", "a*", "\\ba", "x|ab?", "b$", "a\\b", "a.b", "\\S+"};
+    for (int round = 0; round < 400; ++round)
+    {
+        bool regex = round % 2 != 0, large = round % 40 < 2;
+        PieceTable table;
+        AppendPieceBuffer(table, RandomText(rng, large ? 20000 + rng.Below(10000) : rng.Below(300)));
+        NoCasePattern literal;
+        Regex compiled;
+        const char *pattern = regex ? patterns[rng.Below(sizeof(patterns) / sizeof(patterns[0]))] : rng.Below(2) ? "ab" : "aA";
+        std::u16string wide(pattern, pattern + std::char_traits<char>::length(pattern));
+        if (regex)
+            CHECK(CompileRegex(compiled, wide.data(), wide.size(), true) && !compiled.crossesLines);
+        else
+            PrepareNoCase(literal, wide.data(), wide.size());
+        MatchFinder find = [&](size_t from, TextSpan &match)
+        {
+            if (!regex)
+            {
+                size_t pos = FindPiecesPrepared(table, literal, from);
+                match.start = pos;
+                match.length = literal.length;
+                return pos != TEXT_NPOS;
+            }
+            RegexMatch found;
+            if (from > table.length || !FindPiecesRegex(compiled, table, from, TEXT_NPOS, found))
+                return false;
+            match.start = found.start;
+            match.length = found.end - found.start;
+            return true;
+        };
+        MatchSet set;
+        std::vector<TextSpan> chain = FindChain(find);
+        AppendMatches(set, chain.data(), chain.size());
+        for (int edit = 0; edit < (large ? 100 : 30); ++edit)
+        {
+            size_t offset = rng.Below(table.length + 1);
+            size_t removed = !large && rng.Below(20) == 0 ? table.length - offset : rng.Below(4);
+            if (offset + removed > table.length)
+                removed = table.length - offset;
+            std::u16string inserted = RandomText(rng, rng.Below(4));
+            ReplacePieces(table, offset, removed, inserted.data(), inserted.size());
+            size_t settled = MatchSettledOffset(table, offset, literal.length, regex ? &compiled : nullptr);
+            EditMatches(set, offset, removed, inserted.size(), settled, find);
+            chain = FindChain(find);
+            if (!CHECK(SameMatches(set, chain)))
+            {
+                fprintf(stderr, "  %s \"%s\" after edit %d\n", regex ? "regex" : "literal", pattern, edit);
+                break;
+            }
+        }
+    }
+}
+
+// Anything that takes a line break lets a match start lines before an edit and reach it, so
+// those patterns have no settled offset short of searching everything again.
+static void TestCrossingLines()
+{
+    static const char *within[] = {"a.b", "\\w+", "[ab]", "^a$", "\\S", "[^\\s]", "\\bx\\B"};
+    static const char *crossing[] = {"\\s", "[^x]", "[\\s\\S]", "\\n", "a\\D", "\\W", "[^a]y"};
+    PieceTable table;
+    AppendPieceBuffer(table, u"a\r\r b");
+    for (bool ignoreCase : {false, true})
+    {
+        for (const char *pattern : within)
+        {
+            std::u16string wide(pattern, pattern + std::char_traits<char>::length(pattern));
+            Regex regex;
+            CHECK(CompileRegex(regex, wide.data(), wide.size(), ignoreCase) && !regex.crossesLines);
+            CHECK(MatchSettledOffset(table, 4, 0, &regex) == 2);
+        }
+        for (const char *pattern : crossing)
+        {
+            std::u16string wide(pattern, pattern + std::char_traits<char>::length(pattern));
+            Regex regex;
+            CHECK(CompileRegex(regex, wide.data(), wide.size(), ignoreCase) && regex.crossesLines);
+            CHECK(MatchSettledOffset(table, 4, 0, &regex) == TEXT_NPOS);
+        }
+    }
+
+    // Typing y after "a\r\r b" makes a[^x]*y match from the first line, two lines up
+    Regex regex;
+    std::u16string pattern = u"a[^x]*y";
+    CHECK(CompileRegex(regex, pattern.data(), pattern.size(), false));
+    RegexMatch match;
+    CHECK(!FindPiecesRegex(regex, table, 0, TEXT_NPOS, match));
+    ReplacePieces(table, 5, 0, u"y", 1);
+    CHECK(FindPiecesRegex(regex, table, 0, TEXT_NPOS, match) && match.start == 0 && match.end == 6);
+
+    // A literal match starting at settled still takes in the unit at the edit
+    CHECK(MatchSettledOffset(table, 5, 3, nullptr) == 3 && MatchSettledOffset(table, 1, 3, nullptr) == 0);
+}
+
+static void TestIndex()
+{
+    const size_t count = 100000;
+    std::vector<TextSpan> matches(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        matches[i].start = i * 3;
+        matches[i].length = 2;
+    }
+    MatchSet set;
+    AppendMatches(set, matches.data(), count / 2);
+    AppendMatches(set, matches.data() + count / 2, count - count / 2);
+    CHECK(SameMatches(set, matches));
+    CHECK(set.blocks.size() == (count + MATCH_BLOCK_MAX - 1) / MATCH_BLOCK_MAX);
+    for (size_t offset = 0; offset < count * 3 + 10; offset += 7)
+    {
+        size_t at = (offset + 2) / 3, endingAfter = offset < 2 ? 0 : (offset - 2) / 3 + 1;
+        CHECK(MatchIndexAt(set, offset) == (at < count ? at : count));
+        CHECK(MatchIndexEndingAfter(set, offset) == (endingAfter < count ? endingAfter : count));
+    }
+    ClearMatches(set);
+    CHECK(set.count == 0 && MatchIndexAt(set, 0) == 0 && MatchIndexEndingAfter(set, 0) == 0);
+}
+
+void RunMatchSetTests()
+{
+    TestRandom rng(37);
+    TestEdits(rng);
+    TestCrossingLines();
+    TestIndex();
+}
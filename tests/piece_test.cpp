@@ -0,0 +1,298 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for the piece table: random edits mirrored on a std::u16string, with the blocks, line
+  counts, copies, searches, line lookups, cursors and word bounds checked against it.
+*/
+
+#include "test.h"
+#include "core/piecetable.h"
+#include <algorithm>
+#include <cwctype>
+#include <string>
+#include <vector>
+
+static std::u16string RandomText(TestRandom &rng, const char16_t *alphabet, size_t size, size_t length)
+{
+    std::u16string text(length, u' ');
+    for (char16_t &c : text)
+        c = alphabet[rng.Below(size)];
+    return text;
+}
+
+static std::u16string Contents(const PieceTable &table)
+{
+    std::u16string text(table.length, u'\0');
+    CHECK(CopyPieces(table, 0, table.length, &text[0]) == table.length);
+    return text;
+}
+
+// Cached block lengths and line counts add up, and no block is empty of length or too full.
+static void CheckStructure(const PieceTable &table)
+{
+    size_t length = 0, lines = 0;
+    for (const PieceBlock &block : table.blocks)
+    {
+        size_t blockLength = 0, blockLines = 0;
+        for (const Piece &piece : block.pieces)
+        {
+            CHECK(piece.length > 0);
+            blockLength += piece.length;
+            blockLines += piece.lines;
+        }
+        CHECK(blockLength == block.length && blockLines == block.lines);
+        CHECK(block.pieces.size() <= PIECE_BLOCK_MAX);
+        length += blockLength;
+        lines += blockLines;
+    }
+    CHECK(length == table.length && lines == table.lines);
+}
+
+static bool IsSpace(char16_t c)
+{
+    return iswspace(static_cast<wint_t>(c)) != 0;
+}
+
+static void CheckAgainstModel(TestRandom &rng, const PieceTable &table, const std::u16string &model, bool crOnly)
+{
+    CheckStructure(table);
+    CHECK(Contents(table) == model);
+
+    size_t from = rng.Below(model.size() + 1), count = rng.Below(40);
+    std::u16string copy(count, u'\0');
+    copy.resize(CopyPieces(table, from, count, &copy[0]));
+    CHECK(copy == model.substr(from, count));
+    if (!model.empty())
+    {
+        size_t at = rng.Below(model.size());
+        CHECK(PieceCharAt(table, at) == model[at]);
+    }
+
+    // Forward and backward runs cover exactly the range, in order
+    size_t start = rng.Below(model.size() + 1), end = start + rng.Below(model.size() - start + 1);
+    std::u16string forward, backward;
+    ForEachPieceSpan(table, start, end, [&](const char16_t *text, size_t length, size_t offset) {
+        CHECK(offset == start + forward.size());
+        forward.append(text, length);
+        return true;
+    });
+    ForEachPieceSpanBackward(table, start, end, [&](const char16_t *text, size_t length, size_t offset) {
+        CHECK(offset + length == end - backward.size());
+        backward.insert(0, text, length);
+        return true;
+    });
+    CHECK(forward == model.substr(start, end - start) && backward == forward);
+
+    // Every line break counts once, so line lookups match the flat scan. With LF in the
+    // text a CRLF split across buffers counts twice, so only the CR-only text is compared.
+    if (crOnly)
+    {
+        size_t line = 0;
+        for (size_t i = 0; i <= model.size(); ++i)
+        {
+            if (i > 0 && model[i - 1] == u'\r')
+                ++line;
+            if (i == 0 || model[i - 1] == u'\r')
+                CHECK(PieceLineStart(table, line + 1) == i);
+            CHECK(PieceLineAt(table, i) == line);
+        }
+        CHECK(line == table.lines);
+        CHECK(PieceLineStart(table, line + 2) == model.size());
+        std::vector<TextSpan> lines = SplitLines(model.data(), model.size());
+        PieceLineReader reader;
+        const char16_t *text = nullptr;
+        size_t length = 0, index = 0;
+        while (NextPieceLine(table, reader, text, length) && CHECK(index < lines.size()))
+        {
+            CHECK(std::u16string(text, length) == model.substr(lines[index].start, lines[index].length));
+            ++index;
+        }
+        CHECK(index == lines.size());
+    }
+
+    size_t offset = rng.Below(model.size() + 1);
+    size_t wordStart = offset;
+    while (wordStart > 0 && IsSpace(model[wordStart - 1]))
+        --wordStart;
+    while (wordStart > 0 && !IsSpace(model[wordStart - 1]))
+        --wordStart;
+    size_t wordEnd = offset;
+    while (wordEnd < model.size() && !IsSpace(model[wordEnd]))
+        ++wordEnd;
+    while (wordEnd < model.size() && IsSpace(model[wordEnd]))
+        ++wordEnd;
+    CHECK(PieceWordStart(table, offset) == wordStart);
+    CHECK(PieceWordEnd(table, offset) == wordEnd);
+
+    PieceCursor cursor;
+    SeekPieceCursor(cursor, offset);
+    char16_t c = 0;
+    size_t pos = offset;
+    while (NextPieceChar(table, cursor, c) && CHECK(pos < model.size()))
+        CHECK(c == model[pos++]);
+    CHECK(pos == model.size());
+    SeekPieceCursor(cursor, offset);
+    pos = offset;
+    while (PrevPieceChar(table, cursor, c) && CHECK(pos > 0))
+        CHECK(c == model[--pos]);
+    CHECK(pos == 0);
+}
+
+// Edits go through ReplacePieces, or through collected pieces and AddPieceText as undo does.
+static void TestEdits(TestRandom &rng)
+{
+    for (int round = 0; round < 24; ++round)
+    {
+        bool crOnly = round % 2 == 0;
+        const char16_t *alphabet = crOnly ? u"a AB\r\rx" : u"abAB\r\nx";
+        PieceTable table;
+        std::u16string model;
+        for (size_t chunks = rng.Below(5); chunks > 0; --chunks)
+        {
+            std::u16string text = RandomText(rng, alphabet, 7, rng.Below(50));
+            model += text;
+            AppendPieceBuffer(table, std::move(text));
+        }
+        for (int op = 0; op < 1500; ++op)
+        {
+            size_t offset = rng.Below(model.size() + 1);
+            size_t removed = (std::min)(rng.Below(4) == 0 ? rng.Below(20) : rng.Below(2), model.size() - offset);
+            std::u16string inserted = rng.Below(3) == 0 ? std::u16string() : RandomText(rng, alphabet, 7, rng.Below(5));
+            if (rng.Below(4) == 0 && !model.empty())
+            {
+                // Moves a copy of existing text by its pieces, then adds new text after it
+                size_t source = rng.Below(model.size()), count = (std::min)(rng.Below(30), model.size() - source);
+                std::vector<Piece> pieces;
+                CollectPieces(table, source, count, pieces);
+                std::u16string moved = model.substr(source, count);
+                if (!inserted.empty())
+                    pieces.push_back(AddPieceText(table, inserted.data(), inserted.size()));
+                SplicePieces(table, offset, removed, pieces.data(), pieces.size());
+                model.replace(offset, removed, moved + inserted);
+            }
+            else
+            {
+                ReplacePieces(table, offset, removed, inserted.data(), inserted.size());
+                model.replace(offset, removed, inserted);
+            }
+            CHECK(table.length == model.size());
+            if (op % 100 == 0)
+                CheckAgainstModel(rng, table, model, crOnly);
+        }
+        CheckAgainstModel(rng, table, model, crOnly);
+
+        // Left to right collection gives the same pieces as seeking each range
+        PieceCollector collector;
+        size_t offset = 0;
+        while (offset < model.size())
+        {
+            size_t count = (std::min)(1 + rng.Below(30), model.size() - offset);
+            std::vector<Piece> seeked, walked;
+            CollectPieces(table, offset, count, seeked);
+            CollectNextPieces(table, collector, offset, count, walked);
+            std::u16string a, b;
+            for (const Piece &piece : seeked)
+                a.append(PieceText(table, piece), piece.length);
+            for (const Piece &piece : walked)
+                b.append(PieceText(table, piece), piece.length);
+            CHECK(a == model.substr(offset, count) && b == a);
+            offset += count + rng.Below(10);
+        }
+    }
+}
+
+static size_t NaiveFind(const std::u16string &text, const std::u16string &pattern, size_t from, size_t lastStart)
+{
+    if (pattern.empty())
+        return TEXT_NPOS;
+    for (size_t i = from; i + pattern.size() <= text.size() && i <= lastStart; ++i)
+    {
+        size_t k = 0;
+        while (k < pattern.size() && towlower(static_cast<wint_t>(text[i + k])) == towlower(static_cast<wint_t>(pattern[k])))
+            ++k;
+        if (k == pattern.size())
+            return i;
+    }
+    return TEXT_NPOS;
+}
+
+static size_t NaiveFindBackward(const std::u16string &text, const std::u16string &pattern, size_t last)
+{
+    if (pattern.empty() || pattern.size() > text.size())
+        return TEXT_NPOS;
+    for (size_t i = (std::min)(last, text.size() - pattern.size()) + 1; i-- > 0;)
+        if (NaiveFind(text, pattern, i, i) == i)
+            return i;
+    return TEXT_NPOS;
+}
+
+// Matches crossing piece edges, with letters whose folds have many variants (Kelvin sign,
+// final sigma) so the SIMD filter is sometimes skipped.
+static void TestFind(TestRandom &rng)
+{
+    static const char16_t alphabet[] = {u'a', u'A', u'b', u'B', u'k', u'K', 0x212A, 0xE9, 0xC9, u' ', u'\r', 0x3A3, 0x3C3, 0x3C2};
+    const size_t letters = sizeof(alphabet) / sizeof(alphabet[0]);
+    for (SimdLevel level : kSimdLevels)
+    {
+        ForceSimdLevel(level);
+        for (int round = 0; round < 150; ++round)
+        {
+            size_t used = rng.Below(3) == 0 ? 3 : letters;
+            std::u16string text = RandomText(rng, alphabet, used, rng.Below(4) == 0 ? rng.Below(400) : rng.Below(60));
+            PieceTable table;
+            for (size_t pos = 0; pos < text.size();)
+            {
+                size_t count = (std::min)(1 + rng.Below(rng.Below(2) ? 5 : 80), text.size() - pos);
+                AppendPieceBuffer(table, text.substr(pos, count));
+                pos += count;
+            }
+            for (int edit = 0; edit < 5 && !text.empty(); ++edit)
+            {
+                size_t at = rng.Below(text.size());
+                ReplacePieces(table, at, 1, &text[at], 1);
+            }
+            for (int query = 0; query < 10; ++query)
+            {
+                size_t length = 1 + rng.Below(rng.Below(5) == 0 ? 80 : 6);
+                std::u16string pattern;
+                if (text.size() >= length && rng.Below(2))
+                {
+                    pattern = text.substr(rng.Below(text.size() - length + 1), length);
+                    for (char16_t &c : pattern)
+                        if (rng.Below(2))
+                            c = static_cast<char16_t>(towupper(static_cast<wint_t>(c)));
+                }
+                else
+                    pattern = RandomText(rng, alphabet, used, length);
+                size_t from = rng.Below(text.size() + 2);
+                size_t last = rng.Below(3) == 0 ? TEXT_NPOS : rng.Below(text.size() + 2);
+                NoCasePattern prepared;
+                PrepareNoCase(prepared, pattern.data(), pattern.size());
+                CHECK(FindPiecesNoCase(table, pattern.data(), pattern.size(), from) == NaiveFind(text, pattern, from, TEXT_NPOS));
+                CHECK(FindPiecesPrepared(table, prepared, from, last) == NaiveFind(text, pattern, from, last));
+                CHECK(FindPiecesNoCaseBackward(table, pattern.data(), pattern.size(), last) == NaiveFindBackward(text, pattern, last));
+                size_t at = rng.Below(text.size() + 1), count = (std::min)(pattern.size(), text.size() - at);
+                CHECK(PiecesEqualNoCase(table, at, pattern.data(), count) == (NaiveFind(text.substr(0, at + count), pattern.substr(0, count), at, at) == at || !count));
+                size_t selStart = rng.Below(text.size() + 1), selEnd = selStart + rng.Below(text.size() - selStart + 1);
+                for (bool forward : {true, false})
+                    CHECK(FindPiecesWrapped(table, pattern.data(), pattern.size(), selStart, selEnd, forward) ==
+                          FindWrapped(text.data(), text.size(), pattern.data(), pattern.size(), selStart, selEnd, forward));
+            }
+        }
+    }
+}
+
+void RunPieceTests()
+{
+    TestRandom rng(17);
+    TestEdits(rng);
+    TestFind(rng);
+}
@@ -0,0 +1,229 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for textregex: random patterns over a small alphabet matched against std::regex in
+  ECMAScript multiline mode from every start, in flat text and in a piece table, Find
+  Previous against the forward matches, and the replacement syntax.
+*/
+
+#include "test.h"
+#include "core/piecetable.h"
+#include "core/textregex.h"
+#include <cstdio>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define REGEX_TEST_ALPHABET "abcAB1 \r"
+
+// Quantifiers only go on atoms that cannot match empty, as the two engines differ on how an
+// empty iteration ends a loop. Groups inside a repeat are flagged: ECMAScript clears them on
+// every iteration, so only the whole match is compared then.
+static std::string RandomPattern(TestRandom &rng, int depth, bool &groupInRepeat)
+{
+    static const char *quantifiers[] = {"*", "+", "?", "{1,3}", "*?", "+?"};
+    std::string out;
+    for (size_t n = 1 + rng.Below(3); n > 0; --n)
+    {
+        std::string atom;
+        bool nullable = false;
+        size_t kind = rng.Below(12);
+        if (depth < 3 && kind <= 1)
+        {
+            bool inner = false;
+            atom = kind == 0 ? "(" + RandomPattern(rng, depth + 1, inner) + ")"
+                             : "(?:" + RandomPattern(rng, depth + 1, inner) + "|" + RandomPattern(rng, depth + 1, inner) + ")";
+            groupInRepeat = groupInRepeat || inner;
+            try
+            {
+                nullable = std::regex_match(std::string(), std::regex(atom)) || atom.find_first_of("^$\\") != std::string::npos;
+            }
+            catch (const std::regex_error &)
+            {
+                nullable = true;
+            }
+        }
+        else if (kind == 2)
+            atom = "[ab]";
+        else if (kind == 3)
+            atom = "[^a]";
+        else if (kind == 4)
+            atom = ".";
+        else if (kind == 5)
+            atom = rng.Below(2) ? "\\d" : "\\s";
+        else if (kind == 6 && rng.Below(3) == 0)
+            atom = rng.Below(2) ? "^" : "$";
+        else if (kind == 7 && rng.Below(3) == 0)
+            atom = rng.Below(2) ? "\\b" : "\\B";
+        else
+            atom = std::string(1, "abcAB1 "[rng.Below(7)]);
+        size_t q = rng.Below(8);
+        bool assertion = atom == "^" || atom == "$" || atom == "\\b" || atom == "\\B";
+        if (q < 6 && !nullable && !assertion)
+        {
+            if (atom[0] == '(' && atom[1] != '?')
+                groupInRepeat = true;
+            atom += quantifiers[q];
+        }
+        out += atom;
+    }
+    if (rng.Below(6) == 0)
+        out += "|" + RandomPattern(rng, depth + 1, groupInRepeat);
+    return out;
+}
+
+static std::u16string Widen(const std::string &s)
+{
+    return std::u16string(s.begin(), s.end());
+}
+
+static PieceTable SplitTable(const std::u16string &text, size_t step)
+{
+    PieceTable table;
+    for (size_t i = 0; i < text.size(); i += step)
+        AppendPieceBuffer(table, text.substr(i, step));
+    return table;
+}
+
+static void TestAgainstStd(TestRandom &rng)
+{
+    for (int round = 0; round < 2500; ++round)
+    {
+        bool groupInRepeat = false;
+        std::string pattern = RandomPattern(rng, 0, groupInRepeat);
+        bool ignoreCase = rng.Below(2) != 0;
+        std::string text;
+        for (size_t n = rng.Below(24); n > 0; --n)
+            text += REGEX_TEST_ALPHABET[rng.Below(round % 2 ? 8 : 7)];
+        std::regex reference;
+        try
+        {
+            auto flags = std::regex::ECMAScript | std::regex::multiline;
+            reference = std::regex(pattern, ignoreCase ? flags | std::regex::icase : flags);
+        }
+        catch (const std::regex_error &)
+        {
+            continue;
+        }
+        std::u16string wide = Widen(pattern), wideText = Widen(text);
+        Regex regex;
+        if (!CHECK(CompileRegex(regex, wide.data(), wide.size(), ignoreCase)))
+            continue;
+        PieceTable table = SplitTable(wideText, 1 + rng.Below(4));
+        for (size_t from = 0; from <= text.size(); ++from)
+        {
+            std::smatch expected;
+            auto flags = from ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+            bool found = std::regex_search(text.cbegin() + from, text.cend(), expected, reference, flags);
+            RegexMatch flat, pieces;
+            bool bad = FindRegex(regex, wideText.data(), wideText.size(), from, TEXT_NPOS, flat) != found;
+            bad = bad || FindPiecesRegex(regex, table, from, TEXT_NPOS, pieces) != found;
+            if (!bad && found)
+            {
+                size_t start = from + expected.position(0), end = start + expected.length(0);
+                bad = flat.start != start || flat.end != end || pieces.start != start || pieces.end != end;
+                for (size_t g = 1; !bad && !groupInRepeat && g < expected.size() && g < REGEX_GROUPS; ++g)
+                {
+                    size_t groupStart = expected[g].matched ? from + expected.position(g) : TEXT_NPOS;
+                    bad = flat.groups[g * 2] != groupStart || pieces.groups[g * 2] != groupStart ||
+                          (expected[g].matched && flat.groups[g * 2 + 1] != groupStart + expected.length(g));
+                }
+            }
+            if (!CHECK(!bad))
+            {
+                fprintf(stderr, "  /%s/%s on \"%s\" from %zu\n", pattern.c_str(), ignoreCase ? "i" : "", text.c_str(), from);
+                break;
+            }
+        }
+    }
+}
+
+// Find Previous gives the last of the matches Find Next would step through up to last. In a
+// document longer than the first window the walk starts at a line start inside it, so there
+// it has only to be a real match between that one and last.
+static void TestBackward(TestRandom &rng)
+{
+    static const char *patterns[] = {"ab", "a+b", "b*", "\\bA\\w*", "^a", "c$", "[ab]{2,3}c", "1 ?A", "(a)(b)?", "x|ab|c", "\\d+", "^$"};
+    for (int round = 0; round < 24; ++round)
+    {
+        size_t length = round % 12 == 0 ? REGEX_BACK_WINDOW * 3 : rng.Below(2000);
+        std::u16string text;
+        for (size_t i = 0; i < length; ++i)
+            text += REGEX_TEST_ALPHABET[rng.Below(round % 4 == 0 ? 7 : 8)];
+        PieceTable table = SplitTable(text, 777);
+        for (const char *pattern : patterns)
+        {
+            std::u16string wide = Widen(pattern);
+            Regex regex;
+            CHECK(CompileRegex(regex, wide.data(), wide.size(), rng.Below(2) != 0));
+            std::vector<std::pair<size_t, size_t>> all;
+            RegexMatch match;
+            for (size_t pos = 0; pos <= text.size() && FindRegex(regex, text.data(), text.size(), pos, TEXT_NPOS, match);)
+            {
+                all.emplace_back(match.start, match.end);
+                pos = match.end > match.start ? match.end : match.start + 1;
+            }
+            for (int query = 0; query < 20; ++query)
+            {
+                size_t last = query == 0 ? TEXT_NPOS : rng.Below(text.size() + 2);
+                const std::pair<size_t, size_t> *expected = nullptr;
+                for (const auto &m : all)
+                    if (m.first <= last)
+                        expected = &m;
+                RegexMatch got;
+                bool found = FindPiecesRegexBackward(regex, table, last, got);
+                if (!CHECK(found == (expected != nullptr)) || !found)
+                    continue;
+                if (text.size() <= REGEX_BACK_WINDOW)
+                    CHECK(got.start == expected->first && got.end == expected->second);
+                else
+                {
+                    RegexMatch at;
+                    CHECK(got.start >= expected->first && got.start <= last);
+                    CHECK(FindRegex(regex, text.data(), text.size(), got.start, got.start, at) && at.end == got.end);
+                }
+            }
+        }
+    }
+}
+
+static void TestReplacement()
+{
+    PieceTable table;
+    AppendPieceBuffer(table, u"key=val x");
+    Regex regex;
+    std::u16string pattern = u"(\\w+)=(\\w+)(y)?";
+    CHECK(CompileRegex(regex, pattern.data(), pattern.size(), false));
+    RegexMatch match;
+    CHECK(FindPiecesRegex(regex, table, 0, TEXT_NPOS, match) && match.start == 0 && match.end == 7);
+    std::u16string replacement = u"$2:$1 [$&] $$ \\t\\n\\\\ $3$9 $", out;
+    AppendRegexReplacement(out, replacement.data(), replacement.size(), match, table);
+    CHECK(out == u"val:key [key=val] $ \t\r\\  $");
+    CHECK(RegexReplacementHasGroups(replacement.data(), replacement.size()));
+    CHECK(!RegexReplacementHasGroups(u"a$$1\\$1", 7));
+
+    // Patterns std::regex rejects are rejected here too, with where parsing stopped
+    for (const char *bad : {"(", "a)", "[a", "*a", "(?:a"})
+    {
+        std::u16string wide = Widen(bad);
+        Regex rejected;
+        CHECK(!CompileRegex(rejected, wide.data(), wide.size(), false) && rejected.errorAt <= wide.size());
+    }
+}
+
+void RunRegexTests()
+{
+    TestRandom rng(23);
+    TestAgainstStd(rng);
+    TestBackward(rng);
+    TestReplacement();
+}
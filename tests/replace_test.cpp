@@ -0,0 +1,244 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for Replace All: the piece-table edit it builds against replacing in a plain string,
+  for literal and regex patterns, with the selection carried through and the edit undone
+  again the way the document commits it.
+*/
+
+#include "test.h"
+#include "core/textreplace.h"
+#include <cstring>
+#include <regex>
+#include <string>
+
+static std::u16string Contents(const PieceTable &table)
+{
+    std::u16string text(table.length, u'\0');
+    CopyPieces(table, 0, table.length, &text[0]);
+    return text;
+}
+
+static PieceTable SplitTable(const std::u16string &text, size_t step)
+{
+    PieceTable table;
+    for (size_t i = 0; i < text.size(); i += step)
+        AppendPieceBuffer(table, text.substr(i, step));
+    return table;
+}
+
+// Where an offset lands after the match [start, end) became replacement text ending at
+// mappedEnd: before or at the start it stays, inside it goes to the replacement's end.
+static size_t MapOffset(size_t offset, size_t mapped, size_t start, size_t end, size_t mappedEnd)
+{
+    if (offset <= start)
+        return mapped;
+    return offset < end ? mappedEnd : offset - end + mappedEnd;
+}
+
+// Replaces the non-overlapping matches in text left to right; out gets the new text and the
+// selection carried through it.
+struct NaiveReplace
+{
+    std::u16string text;
+    size_t count = 0;
+    size_t selStart = 0;
+    size_t selEnd = 0;
+};
+
+template <typename Next>
+static NaiveReplace ReplaceNaive(const std::u16string &text, size_t selStart, size_t selEnd, Next next)
+{
+    NaiveReplace out;
+    out.selStart = selStart;
+    out.selEnd = selEnd;
+    size_t last = 0, from = 0, start = 0, end = 0;
+    std::u16string replacement;
+    while (from <= text.size() && next(from, start, end, replacement))
+    {
+        out.text.append(text, last, start - last);
+        out.text += replacement;
+        out.selStart = MapOffset(selStart, out.selStart, start, end, out.text.size());
+        out.selEnd = MapOffset(selEnd, out.selEnd, start, end, out.text.size());
+        last = end;
+        from = end > start ? end : start + 1;
+        ++out.count;
+    }
+    out.text.append(text, last, std::u16string::npos);
+    return out;
+}
+
+// Applies the edit as the document does and checks it, then undoes it.
+static void CheckReplace(PieceTable &table, ReplaceAllEdit &replace, size_t count, const NaiveReplace &expected)
+{
+    std::u16string before = Contents(table);
+    CHECK(count == expected.count && replace.count == count);
+    CHECK(replace.newSelStart == expected.selStart && replace.newSelEnd == expected.selEnd);
+    if (!count)
+        return;
+    UndoEdit &edit = replace.edit;
+    CHECK(edit.offset + edit.removedLength <= table.length);
+    CollectPieces(table, edit.offset, edit.removedLength, edit.removed);
+    SplicePieces(table, edit.offset, edit.removedLength, edit.inserted.data(), edit.inserted.size());
+    CHECK(Contents(table) == expected.text);
+    size_t lines = 0;
+    for (char16_t c : expected.text)
+        lines += c == u'\r';
+    CHECK(table.lines == lines);
+    for (const PieceBlock &block : table.blocks)
+        for (const Piece &piece : block.pieces)
+            CHECK(piece.length > 0);
+
+    UndoHistory history;
+    RecordUndo(history, std::move(edit), false);
+    const UndoStep *step = TakeUndo(history);
+    if (CHECK(step && step->edits.size() == 1))
+    {
+        const UndoEdit &undo = step->edits[0];
+        SplicePieces(table, undo.offset, undo.insertedLength, undo.removed.data(), undo.removed.size());
+        CHECK(Contents(table) == before);
+    }
+}
+
+// A literal and the same text as a regex replace the same spans; a line break in either
+// is a CR in the document.
+static void TestLiteral(TestRandom &rng)
+{
+    static const char16_t *finds[] = {u"a", u"ab", u"aa", u"b\r", u"AbA"};
+    static const char16_t *replacements[] = {u"", u"X", u"xyz", u"\n"};
+    for (int round = 0; round < 3000; ++round)
+    {
+        std::u16string text;
+        for (size_t n = rng.Below(300); n > 0; --n)
+            text += u"aAb\rc"[rng.Below(5)];
+        PieceTable table = SplitTable(text, 13);
+        for (int edit = 0; edit < 5; ++edit)
+        {
+            size_t offset = rng.Below(table.length + 1);
+            ReplacePieces(table, offset, rng.Below(3), u"ab", 2);
+        }
+        text = Contents(table);
+        std::u16string find = finds[rng.Below(5)], replacement = replacements[rng.Below(4)];
+        std::u16string inserted = replacement == u"\n" ? u"\r" : replacement;
+        size_t selStart = rng.Below(text.size() + 1), selEnd = selStart + rng.Below(text.size() - selStart + 1);
+
+        std::u16string folded = text, foldedFind = find;
+        for (char16_t &c : folded)
+            c = c == u'A' ? u'a' : c;
+        for (char16_t &c : foldedFind)
+            c = c == u'A' ? u'a' : c;
+        NaiveReplace expected = ReplaceNaive(text, selStart, selEnd, [&](size_t from, size_t &start, size_t &end, std::u16string &out) {
+            start = folded.find(foldedFind, from);
+            end = start + find.size();
+            out = inserted;
+            return start != std::u16string::npos;
+        });
+
+        NoCasePattern pattern;
+        PrepareNoCase(pattern, find.data(), find.size());
+        ReplaceAllEdit replace;
+        replace.selStart = selStart;
+        replace.selEnd = selEnd;
+        size_t count = BuildReplaceAll(table, pattern, replacement.data(), replacement.size(), replace);
+        CheckReplace(table, replace, count, expected);
+
+        PieceTable regexTable = SplitTable(text, 7);
+        std::u16string regexFind, regexReplacement = replacement == u"\n" ? u"\\n" : replacement;
+        for (char16_t c : find)
+            regexFind += c == u'\r' ? std::u16string(u"\\n") : std::u16string(1, c);
+        Regex regex;
+        CHECK(CompileRegex(regex, regexFind.data(), regexFind.size(), true));
+        ReplaceAllEdit regexReplace;
+        regexReplace.selStart = selStart;
+        regexReplace.selEnd = selEnd;
+        count = BuildReplaceAllRegex(regexTable, regex, regexReplacement.data(), regexReplacement.size(), regexReplace);
+        CheckReplace(regexTable, regexReplace, count, expected);
+    }
+}
+
+// Patterns that can match empty and replacements with groups, against stepping through the
+// matches with FindRegex and expanding each one.
+static void TestRegex(TestRandom &rng)
+{
+    static const char *patterns[] = {"a*", "(a)(b)?", "\\b", "b|$", "^a", "[ab]{2}", "x?", "(\\w)c", "a\\nb"};
+    static const char16_t *replacements[] = {u"", u"X", u"$1-$2", u"\\n$&", u"$$[$0]"};
+    for (int round = 0; round < 3000; ++round)
+    {
+        std::u16string text;
+        for (size_t n = rng.Below(200); n > 0; --n)
+            text += u"aAb\rc x"[rng.Below(7)];
+        PieceTable table = SplitTable(text, 1 + rng.Below(12));
+        const char *pattern = patterns[rng.Below(sizeof(patterns) / sizeof(patterns[0]))];
+        std::u16string wide(pattern, pattern + strlen(pattern));
+        std::u16string replacement = replacements[rng.Below(5)];
+        Regex regex;
+        CHECK(CompileRegex(regex, wide.data(), wide.size(), rng.Below(2) != 0));
+        size_t selStart = rng.Below(text.size() + 1), selEnd = selStart + rng.Below(text.size() - selStart + 1);
+
+        Regex naive = regex;
+        NaiveReplace expected = ReplaceNaive(text, selStart, selEnd, [&](size_t from, size_t &start, size_t &end, std::u16string &out) {
+            RegexMatch match;
+            if (!FindRegex(naive, text.data(), text.size(), from, TEXT_NPOS, match))
+                return false;
+            start = match.start;
+            end = match.end;
+            out.clear();
+            AppendRegexReplacement(out, replacement.data(), replacement.size(), match, table);
+            return true;
+        });
+
+        ReplaceAllEdit replace;
+        replace.selStart = selStart;
+        replace.selEnd = selEnd;
+        size_t count = BuildReplaceAllRegex(table, regex, replacement.data(), replacement.size(), replace);
+        CheckReplace(table, replace, count, expected);
+    }
+}
+
+// $&, $n and $$ mean what they do in ECMAScript, so patterns that never match empty give
+// the text std::regex_replace does.
+static void TestStdFormat(TestRandom &rng)
+{
+    static const char *patterns[] = {"(a+)(b)", "(\\w)(\\w)", "b(c)?", "(a)(b)?c", "(x)|(c)"};
+    static const char *replacements[] = {"$2$1", "[$&]", "$$", "<$1>", "$2$2"};
+    for (int round = 0; round < 1000; ++round)
+    {
+        std::string text;
+        for (size_t n = rng.Below(80); n > 0; --n)
+            text += "abc x"[rng.Below(5)];
+        const char *pattern = patterns[rng.Below(5)], *replacement = replacements[rng.Below(5)];
+        std::string expected = std::regex_replace(text, std::regex(pattern), replacement);
+
+        std::u16string widePattern(pattern, pattern + strlen(pattern));
+        std::u16string wideReplacement(replacement, replacement + strlen(replacement));
+        PieceTable table = SplitTable(std::u16string(text.begin(), text.end()), 5);
+        Regex regex;
+        if (!CHECK(CompileRegex(regex, widePattern.data(), widePattern.size(), false)))
+            continue;
+        ReplaceAllEdit replace;
+        if (!BuildReplaceAllRegex(table, regex, wideReplacement.data(), wideReplacement.size(), replace))
+        {
+            CHECK(expected == text);
+            continue;
+        }
+        UndoEdit &edit = replace.edit;
+        SplicePieces(table, edit.offset, edit.removedLength, edit.inserted.data(), edit.inserted.size());
+        CHECK(Contents(table) == std::u16string(expected.begin(), expected.end()));
+    }
+}
+
+void RunReplaceTests()
+{
+    TestRandom rng(29);
+    TestLiteral(rng);
+    TestRegex(rng);
+    TestStdFormat(rng);
+}
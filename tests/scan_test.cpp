@@ -0,0 +1,150 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for textscan: the prepared and wrapped searches at every SIMD level against a naive
+  towlower search, and line splitting and line-offset lookup against a plain scan.
+*/
+
+#include "test.h"
+#include "core/textscan.h"
+#include <algorithm>
+#include <cwctype>
+#include <string>
+#include <vector>
+
+static bool NaiveMatchAt(const std::u16string &text, const std::u16string &pattern, size_t at)
+{
+    for (size_t k = 0; k < pattern.size(); ++k)
+        if (towlower(static_cast<wint_t>(text[at + k])) != towlower(static_cast<wint_t>(pattern[k])))
+            return false;
+    return true;
+}
+
+static size_t NaiveFind(const std::u16string &text, const std::u16string &pattern, size_t from)
+{
+    if (pattern.empty() || pattern.size() > text.size())
+        return TEXT_NPOS;
+    for (size_t i = from; i + pattern.size() <= text.size(); ++i)
+        if (NaiveMatchAt(text, pattern, i))
+            return i;
+    return TEXT_NPOS;
+}
+
+static size_t NaiveFindBackward(const std::u16string &text, const std::u16string &pattern, size_t last)
+{
+    if (pattern.empty() || pattern.size() > text.size())
+        return TEXT_NPOS;
+    for (size_t i = (std::min)(last, text.size() - pattern.size()) + 1; i-- > 0;)
+        if (NaiveMatchAt(text, pattern, i))
+            return i;
+    return TEXT_NPOS;
+}
+
+static size_t NaiveWrapped(const std::u16string &text, const std::u16string &pattern, size_t selStart, size_t selEnd, bool forward)
+{
+    if (forward)
+    {
+        size_t pos = NaiveFind(text, pattern, selEnd);
+        return pos != TEXT_NPOS ? pos : NaiveFind(text, pattern, 0);
+    }
+    size_t pos = selStart > 0 ? NaiveFindBackward(text, pattern, selStart - 1) : TEXT_NPOS;
+    return pos != TEXT_NPOS ? pos : NaiveFindBackward(text, pattern, TEXT_NPOS);
+}
+
+// Few distinct letters in both cases, so short patterns match often and runs cross the SIMD
+// block edges.
+static std::u16string RandomText(TestRandom &rng, size_t length)
+{
+    static const char16_t alphabet[] = u"aAbBéÉİi \r\nx";
+    std::u16string text(length, u' ');
+    for (char16_t &c : text)
+        c = alphabet[rng.Below(sizeof(alphabet) / sizeof(alphabet[0]) - 1)];
+    return text;
+}
+
+static void TestFind(TestRandom &rng)
+{
+    for (int iteration = 0; iteration < 3000; ++iteration)
+    {
+        std::u16string text = RandomText(rng, rng.Below(300));
+        std::u16string pattern;
+        // Mostly a piece of the text, so there is something to find; sometimes past the inline size
+        size_t length = iteration % 10 == 0 ? TEXT_PATTERN_INLINE + 1 + rng.Below(8) : 1 + rng.Below(8);
+        if (length <= text.size() && rng.Below(4))
+            pattern = text.substr(rng.Below(text.size() - length + 1), length);
+        else
+            pattern = RandomText(rng, length);
+        NoCasePattern prepared;
+        PrepareNoCase(prepared, pattern.data(), pattern.size());
+        size_t from = rng.Below(text.size() + 2);
+        size_t selStart = rng.Below(text.size() + 1);
+        size_t selEnd = selStart + rng.Below(text.size() - selStart + 1);
+        for (SimdLevel level : kSimdLevels)
+        {
+            ForceSimdLevel(level);
+            CHECK(FindPrepared(prepared, text.data(), text.size(), from) == NaiveFind(text, pattern, from));
+            CHECK(FindPreparedBackward(prepared, text.data(), text.size(), from) == NaiveFindBackward(text, pattern, from));
+            CHECK(FindPreparedBackward(prepared, text.data(), text.size(), TEXT_NPOS) == NaiveFindBackward(text, pattern, TEXT_NPOS));
+            for (bool forward : {true, false})
+                CHECK(FindWrapped(text.data(), text.size(), pattern.data(), pattern.size(), selStart, selEnd, forward) ==
+                      NaiveWrapped(text, pattern, selStart, selEnd, forward));
+        }
+    }
+}
+
+static void TestLines(TestRandom &rng)
+{
+    for (int iteration = 0; iteration < 3000; ++iteration)
+    {
+        std::u16string text = RandomText(rng, rng.Below(80));
+        std::vector<size_t> starts{0};
+        std::vector<TextSpan> lines;
+        for (size_t i = 0; i <= text.size(); ++i)
+        {
+            if (i < text.size() && text[i] != u'\r' && text[i] != u'\n')
+                continue;
+            TextSpan line;
+            line.start = starts.back();
+            line.length = i - line.start;
+            lines.push_back(line);
+            if (i == text.size())
+                break;
+            if (text[i] == u'\r' && i + 1 < text.size() && text[i + 1] == u'\n')
+                ++i;
+            starts.push_back(i + 1);
+        }
+        std::vector<TextSpan> split = SplitLines(text.data(), text.size());
+        if (CHECK(split.size() == lines.size()))
+        {
+            for (size_t k = 0; k < lines.size(); ++k)
+                CHECK(split[k].start == lines[k].start && split[k].length == lines[k].length);
+        }
+        for (size_t line = 1; line <= starts.size() + 2; ++line)
+            CHECK(LineStartOffset(text.data(), text.size(), line) == (line <= starts.size() ? starts[line - 1] : text.size()));
+
+        std::u16string collapsed;
+        for (size_t k = 0; k < lines.size(); ++k)
+        {
+            collapsed += text.substr(lines[k].start, lines[k].length);
+            if (k + 1 < lines.size())
+                collapsed += u'\r';
+        }
+        size_t size = CollapseLineBreaks(&text[0], text.size());
+        CHECK(text.substr(0, size) == collapsed);
+    }
+}
+
+void RunScanTests()
+{
+    TestRandom rng(7);
+    TestFind(rng);
+    TestLines(rng);
+}
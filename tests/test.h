@@ -0,0 +1,55 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Shared helpers for the notepad_core test harness: checks that count failures instead of
+  aborting, a seeded generator so every run sees the same cases, and the suite list.
+*/
+
+#pragma once
+
+#include "core/cpu.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Failures past this many per run are counted but not printed
+#define TEST_PRINT_MAX 20
+
+bool Check(bool ok, const char *expr, const char *file, int line);
+#define CHECK(expr) Check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+
+int FailureCount();
+
+// Linear congruential generator, the same one MakeCorpus in the bench uses.
+struct TestRandom
+{
+    uint32_t seed;
+    explicit TestRandom(uint32_t s) : seed(s) {}
+    uint32_t Next();
+    // Uniform in [0, bound); bound must not be zero.
+    size_t Below(size_t bound);
+};
+
+// The levels the dispatchers choose between, lowest first; ForceSimdLevel caps each at what the
+// CPU has, so the higher ones repeat the best level on an older machine.
+extern const SimdLevel kSimdLevels[4];
+
+void RunScanTests();
+void RunCodecTests();
+void RunUtf8Tests();
+void RunPieceTests();
+void RunUndoTests();
+void RunRegexTests();
+void RunReplaceTests();
+void RunWorkPoolTests();
+void RunMatchSetTests();
+void RunLineIndexTests();
+void RunJournalTests();
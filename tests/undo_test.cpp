@@ -0,0 +1,308 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for the undo history: random edits, groups, undos and redos on a piece table, with the
+  text after every step kept to check each undo and redo lands on it, and typing runs joined
+  into one step the way the editor records them.
+*/
+
+#include "test.h"
+#include "core/undohistory.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static std::u16string Contents(const PieceTable &table)
+{
+    std::u16string text(table.length, u'\0');
+    CopyPieces(table, 0, table.length, &text[0]);
+    return text;
+}
+
+// Makes the edit on the table and records it, as the document does.
+static void Edit(PieceTable &table, UndoHistory &history, size_t offset, size_t removed, const std::u16string &text, bool typing)
+{
+    UndoEdit edit;
+    edit.offset = offset;
+    edit.removedLength = removed;
+    edit.insertedLength = text.size();
+    CollectPieces(table, offset, removed, edit.removed);
+    if (!text.empty())
+        edit.inserted.push_back(AddPieceText(table, text.data(), text.size()));
+    SplicePieces(table, offset, removed, edit.inserted.data(), edit.inserted.size());
+    RecordUndo(history, std::move(edit), typing);
+}
+
+static bool Undo(PieceTable &table, UndoHistory &history)
+{
+    const UndoStep *step = TakeUndo(history);
+    if (!step)
+        return false;
+    for (size_t i = step->edits.size(); i-- > 0;)
+    {
+        const UndoEdit &edit = step->edits[i];
+        SplicePieces(table, edit.offset, edit.insertedLength, edit.removed.data(), edit.removed.size());
+    }
+    return true;
+}
+
+static bool Redo(PieceTable &table, UndoHistory &history)
+{
+    const UndoStep *step = TakeRedo(history);
+    if (!step)
+        return false;
+    for (const UndoEdit &edit : step->edits)
+        SplicePieces(table, edit.offset, edit.removedLength, edit.inserted.data(), edit.inserted.size());
+    return true;
+}
+
+// Steps are evicted when an edit is recorded; an undo or redo may leave the cost past the limit.
+static void CheckCost(const UndoHistory &history, bool recorded)
+{
+    size_t cost = 0;
+    for (const UndoStep &step : history.steps)
+        cost += step.cost;
+    CHECK(cost == history.cost);
+    CHECK(!recorded || history.cost <= history.limit || history.done <= 1);
+}
+
+static std::u16string RandomText(TestRandom &rng, size_t length)
+{
+    std::u16string text;
+    for (size_t i = 0; i < length; ++i)
+        text += u"ab \rxy"[rng.Below(6)];
+    return text;
+}
+
+// states[k] is the text with k steps done. Without a limit nothing is evicted, so a record
+// that leaves done unchanged joined the last step and one that adds to it began a new one.
+static void TestAgainstStates(TestRandom &rng)
+{
+    for (int round = 0; round < 400; ++round)
+    {
+        bool limited = round % 3 == 0;
+        PieceTable table;
+        UndoHistory history;
+        if (limited)
+            history.limit = 2000;
+        std::u16string base = RandomText(rng, 200);
+        AppendPieceBuffer(table, std::u16string(base));
+        std::vector<std::u16string> states{base};
+        for (int op = 0; op < 400; ++op)
+        {
+            size_t kind = rng.Below(10);
+            if (limited && op % 50 == 49)
+                CompactUndoBuffers(history, table);
+            if (kind < 6)
+            {
+                size_t offset = rng.Below(table.length + 1);
+                size_t removed = rng.Below(3) == 0 ? rng.Below(4) : 0;
+                if (offset + removed > table.length)
+                    removed = table.length - offset;
+                std::u16string text = RandomText(rng, rng.Below(3));
+                if (!removed && text.empty())
+                    continue;
+                size_t before = history.done;
+                bool group = rng.Below(8) == 0;
+                if (group)
+                    BeginUndoGroup(history);
+                Edit(table, history, offset, removed, text, rng.Below(2) != 0);
+                if (group)
+                {
+                    BeginUndoGroup(history);
+                    Edit(table, history, rng.Below(table.length + 1), 0, u"G", true);
+                    EndUndoGroup(history);
+                    EndUndoGroup(history);
+                }
+                if (!limited && CHECK(history.done == before || history.done == before + 1))
+                {
+                    CHECK(!group || history.done == before + 1);
+                    states.resize(history.done + 1);
+                    states[history.done] = Contents(table);
+                }
+            }
+            else if (kind < 8)
+            {
+                size_t before = history.done;
+                bool undone = Undo(table, history);
+                CHECK(undone == (before > 0));
+                if (!limited && undone)
+                    CHECK(Contents(table) == states[history.done]);
+            }
+            else if (Redo(table, history) && !limited)
+                CHECK(Contents(table) == states[history.done]);
+            CheckCost(history, kind < 6);
+
+            // Undoing everything and redoing it again comes back to the same text
+            if (op % 37 == 0)
+            {
+                std::u16string now = Contents(table);
+                size_t done = history.done;
+                while (Undo(table, history))
+                    ;
+                CHECK(limited || Contents(table) == base);
+                for (size_t k = 0; k < done; ++k)
+                    CHECK(Redo(table, history));
+                CHECK(history.done == done && Contents(table) == now);
+            }
+        }
+    }
+}
+
+static void TestTyping()
+{
+    PieceTable table;
+    UndoHistory history;
+    AppendPieceBuffer(table, u"one two");
+
+    // Keystrokes next to each other are one step; a jump elsewhere starts another
+    Edit(table, history, 3, 0, u"a", true);
+    Edit(table, history, 4, 0, u"b", true);
+    Edit(table, history, 5, 0, u"c", true);
+    CHECK(history.done == 1 && Contents(table) == u"oneabc two");
+    Edit(table, history, 0, 0, u"X", true);
+    CHECK(history.done == 2);
+    CHECK(Undo(table, history) && Contents(table) == u"oneabc two");
+    CHECK(Undo(table, history) && Contents(table) == u"one two");
+
+    // An undo seals the step, so typing after a redo does not join it
+    CHECK(Redo(table, history));
+    Edit(table, history, 6, 0, u"d", true);
+    CHECK(history.done == 2 && history.steps.size() == 2);
+
+    // Backspaces and deletes join too, with the removed text kept in document order
+    Edit(table, history, 6, 1, u"", true);
+    Edit(table, history, 5, 1, u"", true);
+    Edit(table, history, 4, 1, u"", true);
+    CHECK(history.done == 3 && Contents(table) == u"onea two");
+    Edit(table, history, 4, 1, u"", true);
+    Edit(table, history, 4, 1, u"", true);
+    CHECK(history.done == 3 && Contents(table) == u"oneawo");
+    CHECK(Undo(table, history) && Contents(table) == u"oneabcd two");
+    CHECK(Undo(table, history) && Contents(table) == u"oneabc two");
+
+    // A plain edit is never joined, and a group is one step however it nests
+    ClearUndo(history);
+    Edit(table, history, 0, 0, u"p", false);
+    Edit(table, history, 1, 0, u"q", false);
+    CHECK(history.done == 2);
+    BeginUndoGroup(history);
+    Edit(table, history, 0, 1, u"", true);
+    BeginUndoGroup(history);
+    Edit(table, history, 0, 1, u"R", false);
+    CHECK(!TakeUndo(history));
+    EndUndoGroup(history);
+    EndUndoGroup(history);
+    CHECK(history.done == 3 && Contents(table) == u"Roneabc two");
+    CHECK(Undo(table, history) && Contents(table) == u"pqoneabc two");
+}
+
+// Past the limit the oldest steps go, but never the newest one however large it is.
+static void TestLimit()
+{
+    PieceTable table;
+    UndoHistory history;
+    history.limit = 3 * sizeof(UndoEdit);
+    for (int i = 0; i < 20; ++i)
+        Edit(table, history, 0, 0, u"ab", false);
+    CheckCost(history, true);
+    CHECK(history.done >= 1 && history.done < 20);
+    history.limit = 1;
+    Edit(table, history, 0, 0, u"c", false);
+    CHECK(history.done == 1 && history.steps.size() == 1);
+    CHECK(Undo(table, history) && table.length == 40);
+}
+
+// Text counts toward the limit: what an applied step removed, what an undone one inserted.
+static void TestTextCost()
+{
+    PieceTable table;
+    UndoHistory history;
+    AppendPieceBuffer(table, std::u16string(1000, u'a'));
+    Edit(table, history, 0, 1000, u"b", false);
+    size_t applied = history.cost;
+    CHECK(applied >= 1000 * sizeof(char16_t));
+    CHECK(Undo(table, history) && history.cost < applied);
+    CHECK(Redo(table, history) && history.cost == applied);
+    CheckCost(history, true);
+}
+
+static size_t BufferUnits(const PieceTable &table)
+{
+    size_t units = table.added.size();
+    for (const std::u16string &original : table.original)
+        units += original.size();
+    return units;
+}
+
+// Pastes and deletes under a small limit leave the evicted text in the add buffer until it is
+// compacted; after that only what the document and the kept steps use is left, and undo and
+// redo still land on the same text.
+static void TestCompaction(TestRandom &rng)
+{
+    PieceTable table;
+    UndoHistory history;
+    history.limit = 16 << 10;
+    std::u16string base = RandomText(rng, 3000);
+    AppendPieceBuffer(table, std::u16string(base));
+    for (int i = 0; i < 200; ++i)
+    {
+        size_t offset = rng.Below(table.length + 1);
+        size_t removed = (std::min)(static_cast<size_t>(rng.Below(2000)), table.length - offset);
+        Edit(table, history, offset, removed, RandomText(rng, rng.Below(2000)), false);
+    }
+    CHECK(Undo(table, history) && Undo(table, history));
+    std::vector<std::u16string> states;
+    for (;;)
+    {
+        states.push_back(Contents(table));
+        if (!Redo(table, history))
+            break;
+    }
+    for (size_t k = states.size() - 1; k-- > 0;)
+        CHECK(Undo(table, history));
+    size_t before = BufferUnits(table);
+    CHECK(history.released > 0);
+    size_t dropped = CompactUndoBuffers(history, table);
+    CHECK(dropped > 0 && BufferUnits(table) == before - dropped && history.released == 0);
+    CHECK(BufferUnits(table) * sizeof(char16_t) <= history.cost + table.length * sizeof(char16_t));
+    CHECK(Contents(table) == states[0]);
+    for (size_t k = 1; k < states.size(); ++k)
+        CHECK(Redo(table, history) && Contents(table) == states[k]);
+    CHECK(CompactUndoBuffers(history, table) == 0);
+    CHECK(Undo(table, history) && Contents(table) == states[states.size() - 2]);
+
+    // The break offsets are moved with the text, so lines split by later edits count the same
+    // as in a table that was never compacted
+    PieceTable kept = table;
+    ClearUndo(history);
+    CHECK(CompactUndoBuffers(history, table) > 0);
+    for (int i = 0; i < 200; ++i)
+    {
+        size_t offset = rng.Below(table.length + 1), removed = rng.Below(50);
+        std::u16string text = RandomText(rng, rng.Below(50));
+        ReplacePieces(table, offset, removed, text.data(), text.size());
+        ReplacePieces(kept, offset, removed, text.data(), text.size());
+    }
+    CHECK(Contents(table) == Contents(kept) && table.lines == kept.lines);
+    for (size_t line = 1; line <= kept.lines + 1; ++line)
+        CHECK(PieceLineStart(table, line) == PieceLineStart(kept, line));
+}
+
+void RunUndoTests()
+{
+    TestRandom rng(19);
+    TestAgainstStates(rng);
+    TestTyping();
+    TestLimit();
+    TestTextCost();
+    TestCompaction(rng);
+}
@@ -0,0 +1,199 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for the UTF-8 kernels: DecodeUtf8 and Utf8ValidPrefix at every SIMD level against a
+  byte-at-a-time reference, on valid and broken input and with the input cut at every byte.
+*/
+
+#include "test.h"
+#include "core/textcodec.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Well-formed sequences as in table 3-7 of the Unicode standard. Returns the bytes the sequence
+// at i takes, 0 when it is cut off by the end of a chunk that is not final, and sets bad (with
+// one byte used) when it is not well formed.
+static size_t ReferenceSequence(const std::string &bytes, size_t i, bool final, uint32_t &cp, bool &bad)
+{
+    static const struct
+    {
+        uint8_t first, last, lo, hi;
+        size_t length;
+    } kinds[] = {
+        {0xC2, 0xDF, 0x80, 0xBF, 2}, {0xE0, 0xE0, 0xA0, 0xBF, 3}, {0xE1, 0xEC, 0x80, 0xBF, 3}, {0xED, 0xED, 0x80, 0x9F, 3},
+        {0xEE, 0xEF, 0x80, 0xBF, 3}, {0xF0, 0xF0, 0x90, 0xBF, 4}, {0xF1, 0xF3, 0x80, 0xBF, 4}, {0xF4, 0xF4, 0x80, 0x8F, 4},
+    };
+    uint8_t lead = static_cast<uint8_t>(bytes[i]);
+    bad = true;
+    for (const auto &kind : kinds)
+    {
+        if (lead < kind.first || lead > kind.last)
+            continue;
+        cp = lead & (0x7F >> kind.length);
+        for (size_t k = 1; k < kind.length; ++k)
+        {
+            if (i + k == bytes.size())
+                return final ? 1 : 0;
+            uint8_t b = static_cast<uint8_t>(bytes[i + k]);
+            if (b < (k == 1 ? kind.lo : 0x80) || b > (k == 1 ? kind.hi : 0xBF))
+                return 1;
+            cp = cp << 6 | (b & 0x3F);
+        }
+        bad = false;
+        return kind.length;
+    }
+    return 1;
+}
+
+static DecodeResult ReferenceDecode(const std::string &bytes, bool final, std::u16string &out)
+{
+    DecodeResult r;
+    size_t i = 0;
+    while (i < bytes.size())
+    {
+        uint8_t lead = static_cast<uint8_t>(bytes[i]);
+        if (lead < 0x80)
+        {
+            out += static_cast<char16_t>(lead);
+            ++i;
+            continue;
+        }
+        uint32_t cp = 0;
+        bool bad = false;
+        size_t n = ReferenceSequence(bytes, i, final, cp, bad);
+        if (!n)
+            break;
+        if (bad)
+        {
+            r.invalid = true;
+            out += static_cast<char16_t>(0xFFFD);
+        }
+        else if (cp >= 0x10000)
+        {
+            out += static_cast<char16_t>(0xD800 + ((cp - 0x10000) >> 10));
+            out += static_cast<char16_t>(0xDC00 + ((cp - 0x10000) & 0x3FF));
+        }
+        else
+            out += static_cast<char16_t>(cp);
+        i += n;
+    }
+    r.consumed = i;
+    r.written = out.size();
+    return r;
+}
+
+// Leading bytes up to the first sequence that is broken or cut off.
+static size_t ReferenceValidPrefix(const std::string &bytes, bool &invalid)
+{
+    invalid = false;
+    size_t i = 0;
+    while (i < bytes.size())
+    {
+        if (static_cast<uint8_t>(bytes[i]) < 0x80)
+        {
+            ++i;
+            continue;
+        }
+        uint32_t cp = 0;
+        bool bad = false;
+        size_t n = ReferenceSequence(bytes, i, false, cp, bad);
+        if (!n)
+            break;
+        if (bad)
+        {
+            invalid = true;
+            break;
+        }
+        i += n;
+    }
+    return i;
+}
+
+// ASCII runs long enough to fill SIMD blocks between valid, overlong, surrogate, out of range
+// and cut sequences.
+static std::string RandomBytes(TestRandom &rng, bool validOnly)
+{
+    static const char *valid[] = {"a", "abc\n", "\xC3\xA9", "\xE3\x81\x82", "\xF0\x9F\x98\x80", "\xEF\xBF\xBD", "\xF4\x8F\xBF\xBF"};
+    static const char *broken[] = {"\xED\xA0\x80", "\xC0\xAF", "\x80", "\xE3\x81", "\xF4\x90\x80\x80", "\xFF", "\xE0\x9F\x80", "\xF0\x8F\xBF\xBF"};
+    std::string bytes;
+    size_t pieces = rng.Below(60);
+    for (size_t k = 0; k < pieces; ++k)
+    {
+        if (rng.Below(3) == 0)
+            bytes.append(rng.Below(40), 'x');
+        if (!validOnly && rng.Below(4) == 0)
+            bytes += broken[rng.Below(sizeof(broken) / sizeof(broken[0]))];
+        else
+            bytes += valid[rng.Below(sizeof(valid) / sizeof(valid[0]))];
+    }
+    return bytes;
+}
+
+static void TestAgainstReference(TestRandom &rng)
+{
+    for (int iteration = 0; iteration < 4000; ++iteration)
+    {
+        std::string bytes = RandomBytes(rng, iteration % 2 == 0);
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(bytes.data());
+        bool expectedInvalid = false;
+        size_t expectedPrefix = ReferenceValidPrefix(bytes, expectedInvalid);
+        for (bool final : {false, true})
+        {
+            std::u16string expected;
+            DecodeResult reference = ReferenceDecode(bytes, final, expected);
+            for (SimdLevel level : kSimdLevels)
+            {
+                ForceSimdLevel(level);
+                std::vector<char16_t> out(MaxDecodedLength(bytes.size()) + 1);
+                DecodeResult r = DecodeUtf8(data, bytes.size(), out.data(), final);
+                CHECK(r.consumed == reference.consumed && r.written == reference.written && r.invalid == reference.invalid);
+                CHECK(std::u16string(out.data(), r.written) == expected);
+                bool invalid = false;
+                CHECK(Utf8ValidPrefix(data, bytes.size(), invalid) == expectedPrefix);
+                CHECK(invalid == expectedInvalid);
+            }
+        }
+    }
+}
+
+// A chunk boundary anywhere gives the same text as decoding in one piece.
+static void TestSplits(TestRandom &rng)
+{
+    for (int iteration = 0; iteration < 300; ++iteration)
+    {
+        std::string bytes = RandomBytes(rng, false);
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(bytes.data());
+        std::u16string whole;
+        ReferenceDecode(bytes, true, whole);
+        std::vector<char16_t> out(MaxDecodedLength(bytes.size()) + 1);
+        for (SimdLevel level : kSimdLevels)
+        {
+            ForceSimdLevel(level);
+            for (size_t split = 0; split <= bytes.size(); ++split)
+            {
+                DecodeResult first = DecodeUtf8(data, split, out.data(), false);
+                std::u16string text(out.data(), first.written);
+                DecodeResult rest = DecodeUtf8(data + first.consumed, bytes.size() - first.consumed, out.data(), true);
+                text.append(out.data(), rest.written);
+                CHECK(rest.consumed == bytes.size() - first.consumed);
+                CHECK(text == whole);
+            }
+        }
+    }
+}
+
+void RunUtf8Tests()
+{
+    TestRandom rng(13);
+    TestAgainstReference(rng);
+    TestSplits(rng);
+}
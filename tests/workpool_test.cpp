@@ -0,0 +1,146 @@
+/*
+   ▄████████  ▄██████▄     ▄████████  ▄█        ▄██████▄   ▄██████▄     ▄███████▄
+  ███    ███ ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+  ███    █▀  ███    ███   ███    ███ ███       ███    ███ ███    ███   ███    ███
+ ▄███▄▄▄     ███    ███  ▄███▄▄▄▄██▀ ███       ███    ███ ███    ███   ███    ███
+▀▀███▀▀▀     ███    ███ ▀▀███▀▀▀▀▀   ███       ███    ███ ███    ███ ▀█████████▀
+  ███        ███    ███ ▀███████████ ███       ███    ███ ███    ███   ███
+  ███        ███    ███   ███    ███ ███▌    ▄ ███    ███ ███    ███   ███
+  ███         ▀██████▀    ███    ███ █████▄▄██  ▀██████▀   ▀██████▀   ▄████▀
+                          ███    ███ ▀
+
+  Tests for the work-stealing pool and the parallel Replace All built on it: every task runs
+  once, slow shares get stolen from, and documents cut into several chunks give the serial
+  builder's edit piece for piece.
+*/
+
+#include "test.h"
+#include "core/textreplace.h"
+#include "core/workpool.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+static void TestPool()
+{
+    for (size_t count : {0, 1, 3, 64, 1000})
+    {
+        for (size_t threads : {0, 1, 2, 4, 7})
+        {
+            std::unique_ptr<std::atomic<int>[]> runs(new std::atomic<int>[count + 1]);
+            for (size_t i = 0; i < count; ++i)
+                runs[i] = 0;
+            std::atomic<bool> badWorker{false};
+            RunWorkStealing(count, threads, [&](size_t index, size_t worker) {
+                ++runs[index];
+                if (worker >= (threads ? threads : 1))
+                    badWorker = true;
+            });
+            bool once = true;
+            for (size_t i = 0; i < count; ++i)
+                once = once && runs[i] == 1;
+            CHECK(once && !badWorker);
+        }
+    }
+
+    // Worker 0's share is slow, so the others finish theirs and take from its back
+    std::atomic<size_t> stolen{0};
+    RunWorkStealing(64, 4, [&](size_t index, size_t worker) {
+        if (index < 16)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            if (worker)
+                ++stolen;
+        }
+    });
+    CHECK(stolen > 0);
+}
+
+static PieceTable SplitTable(const std::u16string &text, size_t step)
+{
+    PieceTable table;
+    for (size_t i = 0; i < text.size(); i += step)
+        AppendPieceBuffer(table, text.substr(i, step));
+    return table;
+}
+
+// Pieces of the original text must be the same ones; added text lives at other offsets in
+// each table's add buffer, so only what it says is compared.
+static bool SameEdit(const PieceTable &serialTable, const ReplaceAllEdit &serial, const PieceTable &parallelTable,
+                     const ReplaceAllEdit &parallel)
+{
+    if (serial.count != parallel.count || serial.last != parallel.last || serial.edit.offset != parallel.edit.offset ||
+        serial.edit.removedLength != parallel.edit.removedLength || serial.edit.insertedLength != parallel.edit.insertedLength ||
+        serial.newSelStart != parallel.newSelStart || serial.newSelEnd != parallel.newSelEnd ||
+        serial.edit.inserted.size() != parallel.edit.inserted.size())
+        return false;
+    for (size_t i = 0; i < serial.edit.inserted.size(); ++i)
+    {
+        const Piece &a = serial.edit.inserted[i], &b = parallel.edit.inserted[i];
+        if (a.buffer != b.buffer || a.length != b.length || a.lines != b.lines || (a.buffer && a.start != b.start) ||
+            memcmp(PieceText(serialTable, a), PieceText(parallelTable, b), a.length * sizeof(char16_t)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Documents of a few chunks, dense with short matches that straddle chunk edges or sparse
+// with long ones that run through several chunks.
+static void TestParallelReplace(TestRandom &rng)
+{
+    static const char16_t *finds[] = {u"a", u"aa", u"aAa", u"b\rc"};
+    static const char *patterns[] = {"a", "aa", "(a)(b)?", "a*", "\\b", "b|$", "^a", "[ab]{2}", "x?", "\\w+", "a[^ ]*b"};
+    static const char16_t *replacements[] = {u"", u"X", u"$1-$2", u"\\n$&", u"yy"};
+    for (int round = 0; round < 32; ++round)
+    {
+        bool sparse = round % 2 != 0;
+        size_t length = REPLACE_CHUNK_MIN_UNITS * (1 + rng.Below(4)) + rng.Below(REPLACE_CHUNK_MIN_UNITS);
+        std::u16string text(length, u'a');
+        for (char16_t &c : text)
+        {
+            if (sparse)
+                c = rng.Below(50000) == 0 ? u' ' : rng.Below(1000) == 0 ? u'b' : u'a';
+            else
+                c = u"aAb\rc"[rng.Below(5)];
+        }
+        PieceTable serialTable = SplitTable(text, 100000), parallelTable = SplitTable(text, 100000);
+        size_t selStart = rng.Below(length + 1), selEnd = selStart + rng.Below(length - selStart + 1);
+        size_t threads = 1 + rng.Below(5);
+        const char16_t *replacement = replacements[rng.Below(5)];
+        size_t replacementLength = std::char_traits<char16_t>::length(replacement);
+        ReplaceAllEdit serial, parallel;
+        serial.selStart = parallel.selStart = selStart;
+        serial.selEnd = parallel.selEnd = selEnd;
+        size_t serialCount, parallelCount;
+        if (round % 4 < 2)
+        {
+            const char16_t *find = finds[rng.Below(4)];
+            NoCasePattern pattern;
+            PrepareNoCase(pattern, find, std::char_traits<char16_t>::length(find));
+            serialCount = BuildReplaceAll(serialTable, pattern, replacement, replacementLength, serial);
+            parallelCount = BuildReplaceAllParallel(parallelTable, pattern, replacement, replacementLength, parallel, threads);
+        }
+        else
+        {
+            const char *pattern = patterns[rng.Below(sizeof(patterns) / sizeof(patterns[0]))];
+            std::u16string wide(pattern, pattern + strlen(pattern));
+            Regex regex;
+            CHECK(CompileRegex(regex, wide.data(), wide.size(), true));
+            Regex copy = regex;
+            serialCount = BuildReplaceAllRegex(serialTable, regex, replacement, replacementLength, serial);
+            parallelCount = BuildReplaceAllRegexParallel(parallelTable, copy, replacement, replacementLength, parallel, threads);
+        }
+        CHECK(serialCount == parallelCount);
+        CHECK(SameEdit(serialTable, serial, parallelTable, parallel));
+    }
+}
+
+void RunWorkPoolTests()
+{
+    TestRandom rng(31);
+    TestPool();
+    TestParallelReplace(rng);
+}